@@ -27,10 +27,17 @@
 
 #include "nvme.h"
 
-#define MAX_THREADS 4
+#define MAX_THREADS 16
 
 #define IO_QUEUE_DEPTH 1024
 
+/* each CPU slot gets a queue pair for regular I/O and one for polled I/O */
+#define NVME_QUEUES_PER_CPU 2
+
+/* requests up to this size are polled for when io_poll is on */
+#define NVME_POLL_MAX_SIZE (16 << 10)
+#define NVME_POLL_MAX_US   100
+
 static const char* name = "nvme-pci";
 static int instance;
 static int open_count = 0;
@@ -49,8 +56,16 @@ static u32 db_stride;
 
 static int pin_irq_hook;
 
+static unsigned int nr_cpus;
+static u32 tsc_mhz;
+
+static int io_poll;
+static unsigned int coalesce_thr, coalesce_time;
+
 static u32 cqe_status[MAX_THREADS];
 static union nvme_result cqe_result[MAX_THREADS];
+static int cmd_done[MAX_THREADS];
+static u64 cmd_start[MAX_THREADS];
 
 struct nvme_queue {
     u16 q_depth;
@@ -67,6 +82,16 @@ struct nvme_queue {
     phys_bytes sq_phys;
     phys_bytes cq_phys;
     u32* q_db;
+
+    /* statistics, latencies are in TSC cycles */
+    u64 nr_submitted;
+    u64 nr_completed;
+    u64 nr_polled;
+    unsigned int depth;
+    unsigned int max_depth;
+    u64 lat_total;
+    u64 lat_max;
+    u64 lat_avg;
 };
 
 static struct nvme_queue* nvme_queues;
@@ -103,6 +128,8 @@ static ssize_t nvme_pci_rdwt(dev_t minor, int do_write, loff_t pos,
                              size_t count);
 static struct part_info* nvme_pci_part(dev_t device);
 static void nvme_pci_intr(unsigned mask);
+static void nvme_pci_other(MESSAGE* msg);
+static int nvme_process_cq(struct nvme_queue* nvmeq);
 
 static struct blockdriver nvme_pci_driver = {
     .bdr_open = nvme_pci_open,
@@ -110,6 +137,7 @@ static struct blockdriver nvme_pci_driver = {
     .bdr_readwrite = nvme_pci_rdwt,
     .bdr_part = nvme_pci_part,
     .bdr_intr = nvme_pci_intr,
+    .bdr_other = nvme_pci_other,
 };
 
 #define SQ_SIZE(q) ((q)->q_depth << (q)->sqes)
@@ -141,7 +169,10 @@ static void nvme_pci_write64(void* addr, u64 val)
     nvme_pci_write32(addr + 4, val >> 32);
 }
 
-static unsigned int max_io_queues(void) { return MAX_THREADS; }
+static unsigned int max_io_queues(void)
+{
+    return min(nr_cpus, MAX_THREADS) * NVME_QUEUES_PER_CPU;
+}
 
 static unsigned int max_queue_count(void) { return 1 + max_io_queues(); }
 
@@ -249,6 +280,69 @@ static void nvme_pci_submit_sq_cmd(struct nvme_queue* nvmeq,
     nvme_pci_write_sq_db(nvmeq, write_sq);
 }
 
+/* The driver cannot tell which CPU a request was issued on, so workers are
+ * bound to CPU slots instead and each slot owns NVME_QUEUES_PER_CPU queue
+ * pairs. */
+static struct nvme_queue* nvme_io_queue(blockdriver_worker_id_t tid,
+                                        int polled)
+{
+    unsigned int nr_io_queues = online_queues - 1;
+    unsigned int slot;
+
+    if (nr_io_queues < NVME_QUEUES_PER_CPU) return &nvme_queues[1];
+
+    slot = tid % (nr_io_queues / NVME_QUEUES_PER_CPU);
+
+    return &nvme_queues[1 + slot * NVME_QUEUES_PER_CPU + !!polled];
+}
+
+static void nvme_start_cmd(struct nvme_queue* nvmeq, struct nvme_command* cmd)
+{
+    blockdriver_worker_id_t tid = cmd->common.command_id;
+
+    cmd_done[tid] = FALSE;
+    read_tsc_64(&cmd_start[tid]);
+
+    nvmeq->nr_submitted++;
+    if (++nvmeq->depth > nvmeq->max_depth) nvmeq->max_depth = nvmeq->depth;
+
+    nvme_pci_submit_sq_cmd(nvmeq, cmd, TRUE);
+}
+
+/* How long to spin on the completion queue before falling back to the
+ * interrupt: a bit longer than a typical completion on this queue, and not at
+ * all if completions take too long for polling to pay off. */
+static u64 nvme_poll_window(struct nvme_queue* nvmeq)
+{
+    u64 max_window = (u64)NVME_POLL_MAX_US * tsc_mhz;
+
+    if (!nvmeq->lat_avg) return max_window;
+    if (nvmeq->lat_avg > max_window) return 0;
+
+    return min(nvmeq->lat_avg * 2, max_window);
+}
+
+static void nvme_wait_cmd(struct nvme_queue* nvmeq, blockdriver_worker_id_t tid,
+                          int polled)
+{
+    u64 now, deadline;
+
+    if (polled) {
+        read_tsc_64(&now);
+        deadline = now + nvme_poll_window(nvmeq);
+
+        while (!cmd_done[tid] && now < deadline) {
+            nvme_process_cq(nvmeq);
+            read_tsc_64(&now);
+        }
+
+        if (cmd_done[tid]) nvmeq->nr_polled++;
+    }
+
+    while (!cmd_done[tid])
+        blockdriver_async_sleep();
+}
+
 static int nvme_fill_buffers(struct iovec_grant* iov, struct umap_phys* phys,
                              size_t count, endpoint_t endpoint)
 {
@@ -418,9 +512,8 @@ static int nvme_submit_cmd(struct nvme_queue* nvmeq, struct nvme_command* cmd,
         if (retval) return retval;
     }
 
-    nvme_pci_submit_sq_cmd(nvmeq, cmd, TRUE);
-
-    blockdriver_async_sleep();
+    nvme_start_cmd(nvmeq, cmd);
+    nvme_wait_cmd(nvmeq, tid, FALSE);
 
     if (buffer && bufflen) {
         nvme_unmap_data(&iod);
@@ -455,6 +548,13 @@ static int nvme_set_features(unsigned int fid, unsigned int dword11,
     return nvme_features(nvme_admin_set_features, fid, dword11, result);
 }
 
+static int nvme_set_irq_coalesce(unsigned int thr, unsigned int time)
+{
+    /* the aggregation threshold is 0's based, the time is in 100us units */
+    return nvme_set_features(NVME_FEAT_IRQ_COALESCE,
+                             (time << 8) | (thr ? thr - 1 : 0), NULL);
+}
+
 static int nvme_set_queue_count(int* count)
 {
     u32 result;
@@ -520,6 +620,7 @@ static ssize_t nvme_pci_rdwt(dev_t minor, int do_write, loff_t pos,
     size_t size, tmp_size;
     struct nvme_iod iod;
     u32 status;
+    int polled;
     int retval;
 
     if (count > NR_IOREQS) {
@@ -535,8 +636,6 @@ static ssize_t nvme_pci_rdwt(dev_t minor, int do_write, loff_t pos,
         return -ENXIO;
     }
 
-    nvmeq = &nvme_queues[1 + (tid % (online_queues - 1))];
-
     pos += part->base;
 
     if (pos & ((1 << ns->lba_shift) - 1)) {
@@ -583,8 +682,12 @@ static ssize_t nvme_pci_rdwt(dev_t minor, int do_write, loff_t pos,
         return -EINVAL;
     }
 
+    polled = io_poll && tsc_mhz && size <= NVME_POLL_MAX_SIZE;
+    nvmeq = nvme_io_queue(tid, polled);
+
     retval = nvme_setup_rw(ns, &cmd, do_write, pos, size);
     if (retval) return retval;
+    cmd.common.command_id = (u16)tid;
 
     retval = nvme_fill_buffers(virs, phys, count, endpoint);
     if (retval) return retval;
@@ -592,9 +695,8 @@ static ssize_t nvme_pci_rdwt(dev_t minor, int do_write, loff_t pos,
     retval = nvme_map_data(&cmd, phys, count, size, &iod);
     if (retval) return retval;
 
-    nvme_pci_submit_sq_cmd(nvmeq, &cmd, TRUE);
-
-    blockdriver_async_sleep();
+    nvme_start_cmd(nvmeq, &cmd);
+    nvme_wait_cmd(nvmeq, tid, polled);
 
     status = cqe_status[tid];
 
@@ -899,12 +1001,23 @@ static inline void nvme_handle_cqe(struct nvme_queue* nvmeq, u16 idx)
 {
     volatile struct nvme_completion* cqe = &nvmeq->cqes[idx];
     blockdriver_worker_id_t tid;
+    u64 now, lat;
 
     tid = (blockdriver_worker_id_t)cqe->command_id;
 
     cqe_status[tid] = cqe->status >> 1;
     cqe_result[tid] = cqe->result;
 
+    read_tsc_64(&now);
+    lat = now - cmd_start[tid];
+
+    nvmeq->nr_completed++;
+    nvmeq->depth--;
+    nvmeq->lat_total += lat;
+    if (lat > nvmeq->lat_max) nvmeq->lat_max = lat;
+    nvmeq->lat_avg = nvmeq->lat_avg ? (nvmeq->lat_avg * 7 + lat) / 8 : lat;
+
+    cmd_done[tid] = TRUE;
     blockdriver_async_wakeup(tid);
 }
 
@@ -1041,6 +1154,11 @@ static int nvme_reset(void)
     retval = nvme_setup_io_queues();
     if (retval) return retval;
 
+    if (coalesce_thr > 1 || coalesce_time) {
+        if (nvme_set_irq_coalesce(coalesce_thr, coalesce_time))
+            printl("%s: failed to set interrupt coalescing\n", name);
+    }
+
     return 0;
 }
 
@@ -1156,6 +1274,8 @@ static int nvme_pci_probe(int instance)
     struct device_info devinf;
     int ioflag;
     int irq;
+    struct machine machine;
+    struct cpu_info cpu_info[CONFIG_SMP_MAX_CPUS];
     int retval;
 
     retval = pci_first_dev(&devind, &vid, &did, &dev_id);
@@ -1168,6 +1288,9 @@ static int nvme_pci_probe(int instance)
 
     if (retval || instance) return ENXIO;
 
+    nr_cpus = get_machine(&machine) ? 1 : max(machine.cpu_count, 1);
+    tsc_mhz = get_cpuinfo(cpu_info) ? 0 : cpu_info[0].freq_mhz;
+
     nvme_queues = calloc(max_queue_count(), sizeof(struct nvme_queue));
     if (!nvme_queues) return ENOMEM;
 
@@ -1297,12 +1420,130 @@ static void nvme_register_ns(struct nvme_ns* ns)
     }
 }
 
+static ssize_t nvme_io_poll_show(struct device_attribute* attr, char* buf)
+{
+    return sprintf(buf, "%d\n", io_poll);
+}
+
+static ssize_t nvme_io_poll_store(struct device_attribute* attr,
+                                  const char* buf, size_t count)
+{
+    if (!count) return -EINVAL;
+
+    switch (buf[0]) {
+    case '0':
+        io_poll = FALSE;
+        break;
+    case '1':
+        io_poll = TRUE;
+        break;
+    default:
+        return -EINVAL;
+    }
+
+    return count;
+}
+
+static ssize_t nvme_irq_coalesce_show(struct device_attribute* attr, char* buf)
+{
+    return sprintf(buf, "%u %u\n", coalesce_thr, coalesce_time);
+}
+
+/* "<threshold> <time>": completions per interrupt (1-256) and the longest
+ * delay in 100us units (0-255) */
+static ssize_t nvme_irq_coalesce_store(struct device_attribute* attr,
+                                       const char* buf, size_t count)
+{
+    char str[32];
+    unsigned int thr, time;
+    int retval;
+
+    if (count >= sizeof(str)) return -EINVAL;
+    memcpy(str, buf, count);
+    str[count] = '\0';
+
+    if (sscanf(str, "%u %u", &thr, &time) != 2) return -EINVAL;
+    if (thr > 256 || time > 255) return -EINVAL;
+
+    retval = nvme_set_irq_coalesce(thr, time);
+    if (retval < 0) return retval;
+    if (retval > 0) return -EIO;
+
+    coalesce_thr = thr;
+    coalesce_time = time;
+
+    return count;
+}
+
+static u64 tsc_to_ns(u64 cycles)
+{
+    if (!tsc_mhz) return 0;
+    return cycles * 1000 / tsc_mhz;
+}
+
+static ssize_t nvme_queue_stats_show(struct device_attribute* attr, char* buf)
+{
+    struct nvme_queue* nvmeq = attr->cb_data;
+    u64 avg = 0;
+
+    if (nvmeq->nr_completed) avg = nvmeq->lat_total / nvmeq->nr_completed;
+
+    return sprintf(buf,
+                   "submitted %llu\ncompleted %llu\npolled %llu\n"
+                   "depth %u\nmax_depth %u\n"
+                   "avg_lat_ns %llu\nmax_lat_ns %llu\n",
+                   nvmeq->nr_submitted, nvmeq->nr_completed, nvmeq->nr_polled,
+                   nvmeq->depth, nvmeq->max_depth, tsc_to_ns(avg),
+                   tsc_to_ns(nvmeq->lat_max));
+}
+
+static void nvme_register_attrs(void)
+{
+    struct device_attribute attr;
+    char name[ATTR_NAME_MAX];
+    int i;
+
+    dm_init_device_attr(&attr, nvme_dev_id, "io_poll", SF_PRIV_OVERWRITE,
+                        NULL, nvme_io_poll_show, nvme_io_poll_store);
+    dm_device_attr_add(&attr);
+
+    dm_init_device_attr(&attr, nvme_dev_id, "irq_coalesce", SF_PRIV_OVERWRITE,
+                        NULL, nvme_irq_coalesce_show, nvme_irq_coalesce_store);
+    dm_device_attr_add(&attr);
+
+    for (i = 1; i < online_queues; i++) {
+        snprintf(name, sizeof(name), "queues/q%d", i);
+        dm_init_device_attr(&attr, nvme_dev_id, name, SF_PRIV_OVERWRITE,
+                            &nvme_queues[i], nvme_queue_stats_show, NULL);
+        dm_device_attr_add(&attr);
+    }
+}
+
+static void nvme_pci_other(MESSAGE* msg)
+{
+    switch (msg->type) {
+    case DM_DEVICE_ATTR_SHOW:
+    case DM_DEVICE_ATTR_STORE:
+        msg->CNT = dm_device_attr_handle(msg);
+        break;
+    default:
+        msg->RETVAL = ENOSYS;
+        break;
+    }
+
+    if (msg->RETVAL != SUSPEND) {
+        msg->type = SYSCALL_RET;
+        send_recv(SEND_NONBLOCK, msg->source, msg);
+    }
+}
+
 static void nvme_pci_post_init(void)
 {
     struct nvme_ns* ns;
 
     nvme_reset();
     nvme_scan();
+    nvme_register_attrs();
 
     list_for_each_entry(ns, &namespaces, list)
     {
@@ -35,6 +35,23 @@ static struct virtio_device* vdev;
 static struct virtqueue** vqs;
 static unsigned int num_vqs;
 
+/* requests wait here until the end of the batch, one plug per virtqueue */
+static struct blockdriver_plug* plugs;
+
+/* workers are spread over the virtqueues */
+#define worker_vq(tid) ((tid) % num_vqs)
+
+struct virtio_blk_req {
+    struct blockdriver_req req;
+    blockdriver_worker_id_t tid;
+    struct umap_phys phys[NR_IOREQS];
+
+    /* next request submitted in the same descriptor chain */
+    struct virtio_blk_req* merge_next;
+};
+
+static struct virtio_blk_req reqs[MAX_THREADS];
+
 struct virtio_blk_config blk_config;
 
 static struct virtio_blk_outhdr* hdrs_vir;
@@ -53,7 +70,8 @@ struct virtio_feature features[] = {{"barrier", VIRTIO_BLK_F_BARRIER, 0, 0},
                                     {"scsi", VIRTIO_BLK_F_SCSI, 0, 0},
                                     {"flush", VIRTIO_BLK_F_FLUSH, 0, 0},
                                     {"topology", VIRTIO_BLK_F_TOPOLOGY, 0, 0},
-                                    {"idbytes", VIRTIO_BLK_ID_BYTES, 0, 0}};
+                                    {"idbytes", VIRTIO_BLK_ID_BYTES, 0, 0},
+                                    {"mq", VIRTIO_BLK_F_MQ, 0, 1}};
 
 static int virtio_blk_open(dev_t minor, int access);
 static int virtio_blk_close(dev_t minor);
@@ -63,6 +81,7 @@ static ssize_t virtio_blk_rdwt(dev_t minor, int do_write, loff_t pos,
 static struct part_info* virtio_blk_part(dev_t device);
 static void virtio_blk_other(MESSAGE* msg);
 static void virtio_blk_intr(unsigned mask);
+static void virtio_blk_unplug(void);
 static int virtio_blk_status2error(u8 status);
 
 static int virtio_blk_get_id(char* id_str);
@@ -75,6 +94,7 @@ static struct blockdriver virtio_blk_driver = {
     .bdr_part = virtio_blk_part,
     .bdr_intr = virtio_blk_intr,
     .bdr_other = virtio_blk_other,
+    .bdr_unplug = virtio_blk_unplug,
 };
 
 static struct part_info* virtio_blk_part(dev_t device)
@@ -131,7 +151,7 @@ static ssize_t virtio_blk_rdwt(dev_t minor, int do_write, loff_t pos,
     struct part_info* part;
     u64 part_end, sector;
     struct iovec_grant virs[NR_IOREQS];
-    struct umap_phys phys[NR_IOREQS + 2];
+    struct virtio_blk_req* req;
     blockdriver_worker_id_t tid;
     size_t size, tmp_size;
     int retval;
@@ -141,6 +161,7 @@ static ssize_t virtio_blk_rdwt(dev_t minor, int do_write, loff_t pos,
     }
 
     tid = blockdriver_async_worker_id();
+    req = &reqs[tid];
 
     part = virtio_blk_part(minor);
 
@@ -207,21 +228,18 @@ static ssize_t virtio_blk_rdwt(dev_t minor, int do_write, loff_t pos,
     hdrs_vir[tid].ioprio = 0;
     hdrs_vir[tid].sector = sector;
 
-    /* setup header */
-    phys[0].phys_addr = hdrs_phys + tid * sizeof(*hdrs_vir);
-    phys[0].size = sizeof(struct virtio_blk_outhdr);
-
-    retval = fill_buffers(virs, &phys[1], count, endpoint, do_write);
+    retval = fill_buffers(virs, req->phys, count, endpoint, do_write);
     if (retval) return -retval;
 
-    /* status */
-    phys[count + 1].phys_addr = status_phys + tid * sizeof(*status_vir);
-    phys[count + 1].phys_addr |= 1;
-    phys[count + 1].size = sizeof(u8);
-
-    virtqueue_add_buffers(vqs[0], phys, count + 2, (void*)(unsigned long)tid);
+    req->tid = tid;
+    req->req.do_write = do_write;
+    req->req.sector = sector;
+    req->req.nr_sectors = size / blk_config.blk_size;
+    req->req.nr_segs = count;
 
-    virtqueue_kick(vqs[0]);
+    /* submitted and kicked by virtio_blk_unplug() once all workers of this
+     * round have queued their requests */
+    blockdriver_plug_add(&plugs[worker_vq(tid)], &req->req);
 
     blockdriver_async_sleep();
 
@@ -232,6 +250,60 @@ static ssize_t virtio_blk_rdwt(dev_t minor, int do_write, loff_t pos,
     return -virtio_blk_status2error(mystatus(tid));
 }
 
+/* Submit a run of contiguous requests as one descriptor chain: the header
+ * and status of the first request around the data buffers of all of them. */
+static void virtio_blk_submit(struct blockdriver_req** breqs,
+                              unsigned int count, void* arg)
+{
+    static struct umap_phys phys[NR_IOREQS + 2];
+    struct virtqueue* vq = arg;
+    struct virtio_blk_req *head, *req;
+    unsigned int i, n;
+
+    head = list_entry(breqs[0], struct virtio_blk_req, req);
+
+    /* setup header */
+    phys[0].phys_addr = hdrs_phys + head->tid * sizeof(*hdrs_vir);
+    phys[0].size = sizeof(struct virtio_blk_outhdr);
+    n = 1;
+
+    for (i = 0; i < count; i++) {
+        req = list_entry(breqs[i], struct virtio_blk_req, req);
+
+        memcpy(&phys[n], req->phys, sizeof(phys[0]) * req->req.nr_segs);
+        n += req->req.nr_segs;
+
+        req->merge_next = (i + 1 < count)
+                              ? list_entry(breqs[i + 1], struct virtio_blk_req,
+                                           req)
+                              : NULL;
+    }
+
+    /* status */
+    phys[n].phys_addr = status_phys + head->tid * sizeof(*status_vir);
+    phys[n].phys_addr |= 1;
+    phys[n].size = sizeof(u8);
+    n++;
+
+    virtqueue_add_buffers(vq, phys, n, (void*)(unsigned long)head->tid);
+}
+
+static void virtio_blk_unplug(void)
+{
+    unsigned int i, max_segs;
+
+    max_segs = NR_IOREQS;
+    if (blk_config.seg_max && blk_config.seg_max < max_segs)
+        max_segs = blk_config.seg_max;
+
+    for (i = 0; i < num_vqs; i++) {
+        if (!plugs[i].nr_reqs) continue;
+
+        blockdriver_unplug(&plugs[i], max_segs, virtio_blk_submit, vqs[i]);
+        virtqueue_kick(vqs[i]);
+    }
+}
+
 static int virtio_blk_status2error(u8 status)
 {
     switch (status) {
@@ -250,12 +322,22 @@ static void virtio_blk_intr(unsigned mask)
 {
     void* data;
     blockdriver_worker_id_t tid;
+    struct virtio_blk_req *req, *next;
+    unsigned int i;
 
     if (virtio_had_irq(vdev)) {
-        while (!virtqueue_get_buffer(vqs[0], NULL, &data)) {
-            tid = (blockdriver_worker_id_t)(unsigned long)data;
-
-            blockdriver_async_wakeup(tid);
+        for (i = 0; i < num_vqs; i++) {
+            while (!virtqueue_get_buffer(vqs[i], NULL, &data)) {
+                tid = (blockdriver_worker_id_t)(unsigned long)data;
+
+                /* the status of a merged chain belongs to all its requests */
+                for (req = &reqs[tid]; req; req = next) {
+                    next = req->merge_next;
+
+                    status_vir[req->tid] = status_vir[tid];
+                    blockdriver_async_wakeup(req->tid);
+                }
+            }
         }
     }
 
@@ -266,9 +348,13 @@ static int virtio_blk_get_id(char* id_str)
 {
     struct umap_phys phys[3];
     blockdriver_worker_id_t tid;
+    struct virtqueue* vq;
     int retval;
 
     tid = blockdriver_async_worker_id();
+    vq = vqs[worker_vq(tid)];
+    reqs[tid].tid = tid;
+    reqs[tid].merge_next = NULL;
 
     memset(&hdrs_vir[tid], 0, sizeof(*hdrs_vir));
 
@@ -293,9 +379,9 @@ static int virtio_blk_get_id(char* id_str)
     phys[2].phys_addr |= 1;
     phys[2].size = sizeof(u8);
 
-    virtqueue_add_buffers(vqs[0], phys, 3, (void*)(unsigned long)tid);
+    virtqueue_add_buffers(vq, phys, 3, (void*)(unsigned long)tid);
 
-    virtqueue_kick(vqs[0]);
+    virtqueue_kick(vq);
 
     blockdriver_async_sleep();
 
@@ -326,19 +412,39 @@ static ssize_t virtio_blk_serial_show(struct device_attribute* attr, char* buf)
 
 static int virtio_blk_init_vqs(void)
 {
-    int retval;
+    int i, retval;
 
     num_vqs = 1;
 
+    if (virtio_host_supports(vdev, VIRTIO_BLK_F_MQ)) {
+        virtio_cread(vdev, struct virtio_blk_config, num_queues,
+                     &blk_config.num_queues);
+
+        if (blk_config.num_queues > 1)
+            num_vqs = min(blk_config.num_queues, MAX_THREADS);
+    }
+
     vqs = calloc(num_vqs, sizeof(*vqs));
 
     if (!vqs) {
         return ENOMEM;
     }
 
+    plugs = calloc(num_vqs, sizeof(*plugs));
+
+    if (!plugs) {
+        free(vqs);
+        return ENOMEM;
+    }
+
+    for (i = 0; i < num_vqs; i++) {
+        blockdriver_plug_init(&plugs[i]);
+    }
+
     retval = virtio_find_vqs(vdev, num_vqs, vqs);
 
     if (retval) {
+        free(plugs);
         free(vqs);
     }
 
@@ -415,6 +521,8 @@ static int virtio_blk_config(void)
         printl("  Block size: %d\n", blk_config.blk_size);
     }
 
+    printl("  Queues: %d\n", num_vqs);
+
     return 0;
 }
 
@@ -33,4 +33,6 @@
 
 void init_screen(TTY* tty) {}
 
+void cons_sysfs_event(void) {}
+
 void select_console(int nr_console) {}
@@ -32,6 +32,8 @@
 
 void init_screen(TTY* tty) {}
 
+void cons_sysfs_event(void) {}
+
 int is_current_console(CONSOLE* con) { return FALSE; }
 
 void select_console(int nr_console) {}
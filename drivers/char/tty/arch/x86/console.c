@@ -23,16 +23,22 @@
 #include <lyos/vm.h>
 #include <sys/mman.h>
 #include <lyos/sysutils.h>
+#include <limits.h>
 #include "proto.h"
 #include "global.h"
 
 #include <libchardriver/libchardriver.h>
+#include <libsysfs/libsysfs.h>
 
 #define V_MEM_BASE 0xB8000 /* base of color video memory */
 #define V_MEM_SIZE 0x8000  /* 32K: B8000H -> BFFFFH */
 
 char* console_mem = NULL;
 
+/* the first console is moved to the framebuffer once PCI can tell us there
+ * is one */
+static int fbcon_probed = FALSE;
+
 static int ansi_colors[8] = {0, 4, 2, 6, 1, 5, 3, 7};
 
 /* #define __TTY_DEBUG__ */
@@ -44,6 +50,7 @@ static void do_escape(CONSOLE* con, char c);
 static void flush(CONSOLE* con);
 static void w_copy(unsigned int dst, const unsigned int src, int size);
 static void clear_screen(int pos, int len);
+static void setup_screen(TTY* tty);
 
 #define buflen(buf) (sizeof(buf) / sizeof((buf)[0]))
 #define bufend(buf) ((buf) + buflen(buf))
@@ -123,9 +130,29 @@ void init_screen(TTY* tty)
     if (!console_mem) {
         console_mem = mm_map_phys(SELF, V_MEM_BASE, V_MEM_SIZE, 0);
         if (console_mem == MAP_FAILED) panic("can't map console memory");
+
+        /* no framebuffer if we can't hear about PCI */
+        if (sysfs_subscribe("services\\.pci\\.endpoint", SF_CHECK_NOW) != 0)
+            fbcon_probed = TRUE;
     }
 
     vgacon_init_con(con);
+    setup_screen(tty);
+}
+
+/*****************************************************************************
+ *                                setup_screen
+ *****************************************************************************/
+/**
+ * Set up the parts of a console that follow from the size given to it by
+ * vgacon or fbcon.
+ *
+ * @param tty  Whose console is to be set up.
+ *****************************************************************************/
+static void setup_screen(TTY* tty)
+{
+    int nr_tty = tty - tty_table;
+    CONSOLE* con = console_table + nr_tty;
 
     /*
      * NOTE:
@@ -151,6 +178,30 @@ void init_screen(TTY* tty)
     flush((CONSOLE*)tty->tty_dev);
 }
 
+/*****************************************************************************
+ *                                cons_sysfs_event
+ *****************************************************************************/
+/**
+ * Handle sysfs events. When the PCI driver comes up, look for a Bochs/VBE
+ * adapter and move the first console to the framebuffer. The VGA text
+ * console stays if there is none.
+ *****************************************************************************/
+void cons_sysfs_event(void)
+{
+    char key[PATH_MAX];
+    int type, event;
+
+    while (sysfs_get_event(key, &type, &event) == 0) {
+        if (fbcon_probed || !(event & SF_EVENT_PUBLISH)) continue;
+        fbcon_probed = TRUE;
+
+        if (!fbcon_init()) continue;
+
+        fbcon_init_con(console_table);
+        setup_screen(tty_table);
+    }
+}
+
 /*****************************************************************************
  *                                out_char
  *****************************************************************************/
@@ -40,15 +40,75 @@
 #define XRES_DEFAULT 1024
 #define YRES_DEFAULT 768
 
+#define FBCON_FLUSH_RATE 50 /* shadow buffer flushes per second (max) */
+
 int fb_scr_width, fb_scr_height;
 
+/* Set by the backend if the framebuffer is taller than the screen and can be
+ * panned vertically. */
+int fb_virt_height;
+void (*fb_pan_display)(int yoffset);
+
 extern int fbcon_init_bochs(int devind, int x_res, int y_res);
 
 static void fbcon_outchar(CONSOLE* con, char ch);
 static void fbcon_flush(CONSOLE* con);
 static void update_cursor(struct timer_list* tp);
+static void fbcon_flush_timeout(struct timer_list* tp);
 
 static struct timer_list cursor_timer;
+static struct timer_list flush_timer;
+static int flush_pending;
+
+/* The screen is drawn into a cached shadow buffer which is a ring of text
+ * rows: scrolling only moves shadow_top and clears the new rows. Changed
+ * rows are copied to the framebuffer by the flush timer. */
+static u32* shadow;
+static int shadow_top;
+
+/* Text row of the framebuffer shown at the top of the screen when panning. */
+static int fb_top;
+static int fb_virt_rows;
+static int nr_scrolled; /* rows scrolled since the last flush */
+
+/* Dirty columns [x1, x2) of each screen row */
+static struct {
+    int x1, x2;
+} * dirty_rows;
+
+/* Glyph rows expanded to pixels for the current colors */
+static u32 glyph_rows[256][FONT_WIDTH];
+static int glyph_fg = -1, glyph_bg = -1;
+
+static int fbcon_init_shadow(void)
+{
+    int i;
+
+    shadow =
+        mmap(NULL, x_resolution * fb_scr_height * FONT_HEIGHT * sizeof(u32),
+             PROT_READ | PROT_WRITE, MAP_ANONYMOUS | MAP_POPULATE | MAP_PRIVATE,
+             -1, 0);
+    if (shadow == MAP_FAILED) {
+        shadow = NULL;
+        return 0;
+    }
+
+    dirty_rows = malloc(sizeof(*dirty_rows) * fb_scr_height);
+    if (!dirty_rows) return 0;
+
+    for (i = 0; i < fb_scr_height; i++) {
+        dirty_rows[i].x1 = fb_scr_width;
+        dirty_rows[i].x2 = 0;
+    }
+
+    fb_virt_rows = fb_scr_height;
+    if (fb_pan_display && fb_virt_height / FONT_HEIGHT > fb_scr_height)
+        fb_virt_rows = fb_virt_height / FONT_HEIGHT;
+
+    init_timer(&flush_timer);
+
+    return 1;
+}
 
 int fbcon_init()
 {
@@ -76,7 +136,9 @@ int fbcon_init()
     while (retval == 0) {
         if (vid == 0x1234 &&
             did == 0x1111) { /* 0x1234:0x1111: Bochs VBE Extension */
-            return fbcon_init_bochs(devind, x_resolution, y_resolution);
+            if (!fbcon_init_bochs(devind, x_resolution, y_resolution))
+                return 0;
+            return fbcon_init_shadow();
         }
 
         retval = pci_next_dev(&devind, &vid, &did, NULL);
@@ -85,17 +147,36 @@ int fbcon_init()
     return 0;
 }
 
-static u32 get_pixel(int x, int y)
+/* Pixel line y of the screen in the shadow buffer */
+static inline u32* shadow_line(int y)
+{
+    int row = (shadow_top + y / FONT_HEIGHT) % fb_scr_height;
+
+    return &shadow[(row * FONT_HEIGHT + y % FONT_HEIGHT) * x_resolution];
+}
+
+/* Pixel line y of the screen in the framebuffer */
+static inline u32* fb_line(int y)
 {
-    u32* vmem = (u32*)fb_mem_base;
-    return vmem[y * x_resolution + x];
+    return &((u32*)fb_mem_base)[(fb_top * FONT_HEIGHT + y) * x_resolution];
 }
 
-static void set_pixel(int x, int y, int val)
+static void fbcon_schedule_flush(void)
 {
-    u32* vmem = (u32*)fb_mem_base;
-    u32* pixel = &vmem[y * x_resolution + x];
-    *pixel = val;
+    clock_t ticks = get_system_hz() / FBCON_FLUSH_RATE;
+
+    if (flush_pending) return;
+
+    flush_pending = TRUE;
+    set_timer(&flush_timer, ticks ? ticks : 1, fbcon_flush_timeout, NULL);
+}
+
+static void mark_dirty(int row, int x1, int x2)
+{
+    if (x1 < dirty_rows[row].x1) dirty_rows[row].x1 = x1;
+    if (x2 > dirty_rows[row].x2) dirty_rows[row].x2 = x2;
+
+    fbcon_schedule_flush();
 }
 
 #define RGB_RED       0x0000aa
@@ -122,47 +203,83 @@ static void color_to_rgb(u8 color, u8 attr, int* fg, int* bg)
     if (bg_color & BLUE) *bg |= b;
 }
 
-static void print_char(CONSOLE* con, int x, int y, char ch)
+static void expand_glyph_rows(int fg_color, int bg_color)
 {
-    u8 color = con->color;
-    int fg_color, bg_color;
-    const u8* font = &number_font[ch * FONT_HEIGHT];
-    int i, j;
+    int bits, j;
 
-    color_to_rgb(color, con->attributes, &fg_color, &bg_color);
+    if (fg_color == glyph_fg && bg_color == glyph_bg) return;
 
-    for (i = 0; i < FONT_HEIGHT; i++) {
+    for (bits = 0; bits < 256; bits++) {
         for (j = 0; j < FONT_WIDTH; j++) {
-            if (font[i] & (1 << (FONT_WIDTH - j))) {
-                set_pixel(x + j, y + i, fg_color);
-            } else {
-                set_pixel(x + j, y + i, bg_color);
-            }
+            glyph_rows[bits][j] =
+                (bits & (1 << (FONT_WIDTH - j))) ? fg_color : bg_color;
         }
     }
+
+    glyph_fg = fg_color;
+    glyph_bg = bg_color;
+}
+
+static void print_char(CONSOLE* con, int col, int row, char ch)
+{
+    const u8* font = &number_font[(u8)ch * FONT_HEIGHT];
+    int fg_color, bg_color;
+    int i, y = row * FONT_HEIGHT;
+
+    color_to_rgb(con->color, con->attributes, &fg_color, &bg_color);
+    expand_glyph_rows(fg_color, bg_color);
+
+    for (i = 0; i < FONT_HEIGHT; i++) {
+        memcpy(shadow_line(y + i) + col * FONT_WIDTH, glyph_rows[font[i]],
+               sizeof(glyph_rows[0]));
+    }
+
+    mark_dirty(row, col, col + 1);
 }
 
-static void print_cursor(CONSOLE* con, int x, int y)
+static void print_cursor(CONSOLE* con, int col, int row)
 {
-    u8 color = con->color;
     int fg_color, bg_color;
-    u32 pixel;
+    u32* pixel;
     int i, j;
 
-    color_to_rgb(color, con->attributes, &fg_color, &bg_color);
+    color_to_rgb(con->color, con->attributes, &fg_color, &bg_color);
 
     for (i = 0; i < FONT_HEIGHT; i++) {
+        pixel = shadow_line(row * FONT_HEIGHT + i) + col * FONT_WIDTH;
+
         for (j = 0; j < FONT_WIDTH; j++) {
-            pixel = get_pixel(x + j, y + i);
+            pixel[j] = (pixel[j] == bg_color) ? fg_color : bg_color;
+        }
+    }
 
-            if (pixel == bg_color) {
-                pixel = fg_color;
-            } else {
-                pixel = bg_color;
-            }
+    mark_dirty(row, col, col + 1);
+}
+
+/* Scroll the screen up by n text rows */
+static void fbcon_scroll(int n)
+{
+    int i, row;
 
-            set_pixel(x + j, y + i, pixel);
+    if (n <= 0) return;
+    if (n > fb_scr_height) n = fb_scr_height;
+
+    shadow_top = (shadow_top + n) % fb_scr_height;
+    nr_scrolled += n;
+
+    /* dirty areas move up with their rows */
+    memmove(dirty_rows, dirty_rows + n,
+            sizeof(*dirty_rows) * (fb_scr_height - n));
+
+    for (row = fb_scr_height - n; row < fb_scr_height; row++) {
+        for (i = 0; i < FONT_HEIGHT; i++) {
+            memset(shadow_line(row * FONT_HEIGHT + i), 0,
+                   x_resolution * sizeof(u32));
         }
+
+        dirty_rows[row].x1 = fb_scr_width;
+        dirty_rows[row].x2 = 0;
+        mark_dirty(row, 0, fb_scr_width);
     }
 }
 
@@ -203,7 +320,7 @@ static void fbcon_outchar(CONSOLE* con, char ch)
         con->last_cursor_state = 0;
     }
 
-    print_char(con, col * FONT_WIDTH, line * FONT_HEIGHT, ch);
+    print_char(con, col, line, ch);
 }
 
 static void fbcon_flush(CONSOLE* con)
@@ -211,24 +328,69 @@ static void fbcon_flush(CONSOLE* con)
     if (con->visible_origin != con->origin) {
         u32 delta = con->visible_origin - con->origin;
 
-        u32 visible_origin = con->visible_origin;
-        int line = visible_origin / con->cols;
-        int col = visible_origin % con->cols;
-        u32 offset = line * FONT_HEIGHT * x_resolution + col * FONT_WIDTH;
-
-        u32* base = (u32*)fb_mem_base;
-        u32* new_base = base + offset;
-        memmove(base, new_base,
-                (x_resolution * y_resolution - offset) * sizeof(u32));
-        new_base = base + (x_resolution * y_resolution - offset);
-        memset(new_base, 0, offset * sizeof(u32));
+        fbcon_scroll(delta / con->cols);
 
         con->visible_origin -= delta;
         con->scr_end -= delta;
         con->cursor -= delta;
+
+        /* the cursor cell moved up with the screen */
+        if (con->last_cursor >= delta) {
+            con->last_cursor -= delta;
+        } else {
+            con->last_cursor = con->cursor;
+            con->last_cursor_state = 0;
+        }
     }
 }
 
+/* Copy the dirty parts of the shadow buffer to the framebuffer. After a
+ * scroll the framebuffer is panned instead of copied if the backend can, so
+ * only the new rows are written until the end of the framebuffer is hit. */
+static void fbcon_flush_timeout(struct timer_list* tp)
+{
+    int row, i, x1, x2, y;
+    int panned = FALSE;
+
+    flush_pending = FALSE;
+
+    if (nr_scrolled) {
+        if (fb_virt_rows > fb_scr_height) {
+            fb_top += nr_scrolled;
+            panned = TRUE;
+        }
+
+        if (!panned || fb_top + fb_scr_height > fb_virt_rows) {
+            /* redraw the whole screen at the top of the framebuffer */
+            fb_top = 0;
+            for (row = 0; row < fb_scr_height; row++) {
+                dirty_rows[row].x1 = 0;
+                dirty_rows[row].x2 = fb_scr_width;
+            }
+        }
+
+        nr_scrolled = 0;
+    }
+
+    for (row = 0; row < fb_scr_height; row++) {
+        x1 = dirty_rows[row].x1;
+        x2 = dirty_rows[row].x2;
+        if (x1 >= x2) continue;
+
+        for (i = 0; i < FONT_HEIGHT; i++) {
+            y = row * FONT_HEIGHT + i;
+            memcpy(fb_line(y) + x1 * FONT_WIDTH,
+                   shadow_line(y) + x1 * FONT_WIDTH,
+                   (x2 - x1) * FONT_WIDTH * sizeof(u32));
+        }
+
+        dirty_rows[row].x1 = fb_scr_width;
+        dirty_rows[row].x2 = 0;
+    }
+
+    if (panned) fb_pan_display(fb_top * FONT_HEIGHT);
+}
+
 static void update_cursor(struct timer_list* tp)
 {
     clock_t ticks = get_system_hz() / CURSOR_BLINK_RATE;
@@ -247,7 +409,7 @@ static void update_cursor(struct timer_list* tp)
         if (con->last_cursor_state) {
             line = last_cursor / con->cols;
             col = last_cursor % con->cols;
-            print_cursor(con, col * FONT_WIDTH, line * FONT_HEIGHT);
+            print_cursor(con, col, line);
         }
     }
 
@@ -257,7 +419,7 @@ static void update_cursor(struct timer_list* tp)
     line = cursor / con->cols;
     col = cursor % con->cols;
 
-    print_cursor(con, col * FONT_WIDTH, line * FONT_HEIGHT);
+    print_cursor(con, col, line);
 
     set_timer(tp, ticks, update_cursor, NULL);
 }
@@ -55,12 +55,20 @@
 #define VBE_DISPI_LFB_ENABLED 0x40
 #define VBE_DISPI_NOCLEARMEM  0x80
 
+extern int fb_virt_height;
+extern void (*fb_pan_display)(int yoffset);
+
 static void bochs_write(u16 reg, u16 val)
 {
     portio_outw(VBE_DISPI_IOPORT_INDEX, reg);
     portio_outw(VBE_DISPI_IOPORT_DATA, val);
 }
 
+static void bochs_pan_display(int yoffset)
+{
+    bochs_write(VBE_DISPI_INDEX_Y_OFFSET, yoffset);
+}
+
 int fbcon_init_bochs(int devind, int x_res, int y_res)
 {
     bochs_write(VBE_DISPI_INDEX_ENABLE, VBE_DISPI_DISABLED);
@@ -80,5 +88,9 @@ int fbcon_init_bochs(int devind, int x_res, int y_res)
     fb_mem_base = vmem_base;
     fb_mem_size = vmem_size;
 
+    /* the mapping holds two screens to pan over */
+    fb_virt_height = y_res * 2;
+    fb_pan_display = bochs_pan_display;
+
     return 1;
 }
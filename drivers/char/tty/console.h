@@ -97,6 +97,7 @@ typedef struct s_console {
 #define CURSOR_BLINK_RATE 3 /* cursor blink rate (hz) */
 
 void vgacon_init_con(CONSOLE* con);
+int fbcon_init(void);
 void fbcon_init_con(CONSOLE* con);
 
 #endif /* _CONSOLE_H_ */
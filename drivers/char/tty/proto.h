@@ -29,6 +29,7 @@ void out_char(TTY* tty, char ch);
 void scroll_screen(CONSOLE* p_con, int direction);
 void select_console(int nr_console);
 void init_screen(TTY* p_tty);
+void cons_sysfs_event(void);
 int is_current_console(CONSOLE* p_con);
 
 int init_rs();
@@ -144,6 +144,9 @@ int main()
             case CLOCK:
                 expire_timer(msg.TIMESTAMP);
                 break;
+            case TASK_SYSFS:
+                cons_sysfs_event();
+                break;
             }
             continue;
         }
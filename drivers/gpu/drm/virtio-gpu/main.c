@@ -36,6 +36,13 @@
 #define XRES_MAX 8192
 #define YRES_MAX 8192
 
+/* Commands that can be in flight without waiting for the device. */
+#define NR_CMD_SLOTS 64
+
+/* Damage rectangles transferred one by one per plane update before they are
+ * merged into their bounding box. */
+#define MAX_DAMAGE_RECTS 8
+
 static const char* name = DRIVER_NAME;
 static int instance;
 static struct virtio_device* vdev;
@@ -50,6 +57,22 @@ static struct virtqueue* cursor_q;
 
 static struct virtio_gpu_ctrl_hdr* hdrs_vir;
 static phys_bytes hdrs_phys;
+static int hdrs_done;
+
+/* Slots for commands queued by plane updates. A slot is only reused after
+ * the device has returned it. */
+union virtio_gpu_cmd_slot {
+    struct virtio_gpu_ctrl_hdr hdr;
+    struct virtio_gpu_transfer_to_host_2d transfer_to_host_2d;
+    struct virtio_gpu_set_scanout set_scanout;
+    struct virtio_gpu_resource_flush resource_flush;
+};
+
+static union virtio_gpu_cmd_slot* cmd_slots;
+static phys_bytes cmd_slots_phys;
+static union virtio_gpu_cmd_slot* free_cmd_slots[NR_CMD_SLOTS];
+static int nr_free_cmd_slots;
+static int nr_queued_cmds;
 
 static struct idr resource_idr;
 
@@ -93,6 +116,7 @@ struct virtio_gpu_object {
     list_entry((gobj), struct virtio_gpu_object, base)
 
 static void virtio_gpu_interrupt_wait(void);
+static void virtio_gpu_submit_sync(struct umap_phys* phys, size_t count);
 
 static int virtio_gpu_mode_dumb_create(struct drm_device* dev,
                                        struct drm_mode_create_dumb* args);
@@ -164,11 +188,7 @@ static int virtio_gpu_cmd_get_display_info(void)
     phys[1].phys_addr |= 1;
     phys[1].size = sizeof(resp);
 
-    virtqueue_add_buffers(control_q, phys, 2, NULL);
-
-    virtqueue_kick(control_q);
-
-    virtio_gpu_interrupt_wait();
+    virtio_gpu_submit_sync(phys, 2);
 
     for (i = 0; i < gpu_config.num_scanouts; i++) {
         outputs[i].info = resp.pmodes[i];
@@ -203,11 +223,7 @@ static int virtio_gpu_cmd_get_edids(void)
     for (i = 0; i < gpu_config.num_scanouts; i++) {
         cmd->scanout = i;
 
-        virtqueue_add_buffers(control_q, phys, 2, NULL);
-
-        virtqueue_kick(control_q);
-
-        virtio_gpu_interrupt_wait();
+        virtio_gpu_submit_sync(phys, 2);
     }
 
     return 0;
@@ -232,11 +248,7 @@ virtio_gpu_cmd_create_resource(struct virtio_gpu_object* bo,
     phys[0].phys_addr = hdrs_phys;
     phys[0].size = sizeof(struct virtio_gpu_resource_create_2d);
 
-    virtqueue_add_buffers(control_q, phys, 1, NULL);
-
-    virtqueue_kick(control_q);
-
-    virtio_gpu_interrupt_wait();
+    virtio_gpu_submit_sync(phys, 1);
 
     bo->created = TRUE;
     return 0;
@@ -266,11 +278,7 @@ static int virtio_gpu_cmd_resource_attach_backing(
     }
     phys[1].size = sizeof(*ents) * nents;
 
-    virtqueue_add_buffers(control_q, phys, 2, NULL);
-
-    virtqueue_kick(control_q);
-
-    virtio_gpu_interrupt_wait();
+    virtio_gpu_submit_sync(phys, 2);
 
     return 0;
 }
@@ -283,16 +291,49 @@ static int virtio_gpu_object_attach(struct virtio_gpu_object* bo,
                                                   nents);
 }
 
-static int virtio_gpu_cmd_transfer_to_host_2d(struct virtio_gpu_object* bo,
-                                              uint64_t offset, uint32_t width,
-                                              uint32_t height, uint32_t x,
-                                              uint32_t y)
+static void virtio_gpu_queue_cmd(union virtio_gpu_cmd_slot* slot, size_t size)
 {
     struct umap_phys phys[1];
-    struct virtio_gpu_transfer_to_host_2d* cmd =
-        (struct virtio_gpu_transfer_to_host_2d*)hdrs_vir;
 
-    memset(cmd, 0, sizeof(*cmd));
+    phys[0].phys_addr = cmd_slots_phys + ((char*)slot - (char*)cmd_slots);
+    phys[0].size = size;
+
+    virtqueue_add_buffers(control_q, phys, 1, slot);
+    nr_queued_cmds++;
+}
+
+/* Let the device process everything queued so far. */
+static void virtio_gpu_kick_cmds(void)
+{
+    if (!nr_queued_cmds) return;
+
+    virtqueue_kick(control_q);
+    nr_queued_cmds = 0;
+}
+
+static union virtio_gpu_cmd_slot* virtio_gpu_alloc_cmd(void)
+{
+    union virtio_gpu_cmd_slot* slot;
+
+    while (!nr_free_cmd_slots) {
+        virtio_gpu_kick_cmds();
+        virtio_gpu_interrupt_wait();
+    }
+
+    slot = free_cmd_slots[--nr_free_cmd_slots];
+    memset(slot, 0, sizeof(*slot));
+
+    return slot;
+}
+
+static void virtio_gpu_cmd_transfer_to_host_2d(struct virtio_gpu_object* bo,
+                                               uint64_t offset, uint32_t width,
+                                               uint32_t height, uint32_t x,
+                                               uint32_t y)
+{
+    union virtio_gpu_cmd_slot* slot = virtio_gpu_alloc_cmd();
+    struct virtio_gpu_transfer_to_host_2d* cmd = &slot->transfer_to_host_2d;
+
     cmd->hdr.type = VIRTIO_GPU_CMD_TRANSFER_TO_HOST_2D;
     cmd->resource_id = bo->hw_res_handle;
     cmd->offset = offset;
@@ -301,28 +342,16 @@ static int virtio_gpu_cmd_transfer_to_host_2d(struct virtio_gpu_object* bo,
     cmd->r.x = x;
     cmd->r.y = y;
 
-    /* setup header */
-    phys[0].phys_addr = hdrs_phys;
-    phys[0].size = sizeof(*cmd);
-
-    virtqueue_add_buffers(control_q, phys, 1, NULL);
-
-    virtqueue_kick(control_q);
-
-    virtio_gpu_interrupt_wait();
-
-    return 0;
+    virtio_gpu_queue_cmd(slot, sizeof(*cmd));
 }
 
-static int virtio_gpu_cmd_set_scanout(uint32_t scanout_id, uint32_t resource_id,
-                                      uint32_t width, uint32_t height,
-                                      uint32_t x, uint32_t y)
+static void virtio_gpu_cmd_set_scanout(uint32_t scanout_id,
+                                       uint32_t resource_id, uint32_t width,
+                                       uint32_t height, uint32_t x, uint32_t y)
 {
-    struct umap_phys phys[1];
-    struct virtio_gpu_set_scanout* cmd =
-        (struct virtio_gpu_set_scanout*)hdrs_vir;
+    union virtio_gpu_cmd_slot* slot = virtio_gpu_alloc_cmd();
+    struct virtio_gpu_set_scanout* cmd = &slot->set_scanout;
 
-    memset(cmd, 0, sizeof(*cmd));
     cmd->hdr.type = VIRTIO_GPU_CMD_SET_SCANOUT;
     cmd->resource_id = resource_id;
     cmd->scanout_id = scanout_id;
@@ -331,28 +360,16 @@ static int virtio_gpu_cmd_set_scanout(uint32_t scanout_id, uint32_t resource_id,
     cmd->r.x = x;
     cmd->r.y = y;
 
-    /* setup header */
-    phys[0].phys_addr = hdrs_phys;
-    phys[0].size = sizeof(*cmd);
-
-    virtqueue_add_buffers(control_q, phys, 1, NULL);
-
-    virtqueue_kick(control_q);
-
-    virtio_gpu_interrupt_wait();
-
-    return 0;
+    virtio_gpu_queue_cmd(slot, sizeof(*cmd));
 }
 
-static int virtio_gpu_cmd_resource_flush(uint32_t resource_id, uint32_t width,
-                                         uint32_t height, uint32_t x,
-                                         uint32_t y)
+static void virtio_gpu_cmd_resource_flush(uint32_t resource_id, uint32_t width,
+                                          uint32_t height, uint32_t x,
+                                          uint32_t y)
 {
-    struct umap_phys phys[1];
-    struct virtio_gpu_resource_flush* cmd =
-        (struct virtio_gpu_resource_flush*)hdrs_vir;
+    union virtio_gpu_cmd_slot* slot = virtio_gpu_alloc_cmd();
+    struct virtio_gpu_resource_flush* cmd = &slot->resource_flush;
 
-    memset(cmd, 0, sizeof(*cmd));
     cmd->hdr.type = VIRTIO_GPU_CMD_RESOURCE_FLUSH;
     cmd->resource_id = resource_id;
     cmd->r.width = width;
@@ -360,17 +377,7 @@ static int virtio_gpu_cmd_resource_flush(uint32_t resource_id, uint32_t width,
     cmd->r.x = x;
     cmd->r.y = y;
 
-    /* setup header */
-    phys[0].phys_addr = hdrs_phys;
-    phys[0].size = sizeof(*cmd);
-
-    virtqueue_add_buffers(control_q, phys, 1, NULL);
-
-    virtqueue_kick(control_q);
-
-    virtio_gpu_interrupt_wait();
-
-    return 0;
+    virtio_gpu_queue_cmd(slot, sizeof(*cmd));
 }
 
 static int virtio_gpu_mmap(struct drm_gem_object* obj, endpoint_t endpoint,
@@ -491,25 +498,52 @@ static int virtio_gpu_mode_dumb_create(struct drm_device* dev,
     return retval;
 }
 
-static void virtio_gpu_interrupt(unsigned int mask) { virtio_enable_irq(vdev); }
+/* Collect the commands the device is done with. */
+static void virtio_gpu_reap(void)
+{
+    void* data;
+
+    while (!virtqueue_get_buffer(control_q, NULL, &data)) {
+        if (data == hdrs_vir)
+            hdrs_done = TRUE;
+        else if (data)
+            free_cmd_slots[nr_free_cmd_slots++] = data;
+    }
+}
+
+static void virtio_gpu_interrupt(unsigned int mask)
+{
+    if (virtio_had_irq(vdev)) virtio_gpu_reap();
 
+    virtio_enable_irq(vdev);
+}
+
+/* Wait for the next interrupt and collect finished commands. */
 static void virtio_gpu_interrupt_wait(void)
 {
     MESSAGE msg;
-    void* data;
 
-    while (TRUE) {
-        send_recv(RECEIVE, INTERRUPT, &msg);
+    send_recv(RECEIVE, INTERRUPT, &msg);
 
-        if (virtio_had_irq(vdev)) {
-            while (!virtqueue_get_buffer(control_q, NULL, &data))
-                ;
+    virtio_gpu_interrupt(msg.INTERRUPTS);
+}
 
-            virtio_enable_irq(vdev);
-            break;
-        }
+/* Submit a command in hdrs_vir and wait for the device to finish it. Queued
+ * commands before it are kicked too. */
+static void virtio_gpu_submit_sync(struct umap_phys* phys, size_t count)
+{
+    hdrs_done = FALSE;
 
-        virtio_enable_irq(vdev);
+    virtqueue_add_buffers(control_q, phys, count, hdrs_vir);
+
+    virtqueue_kick(control_q);
+    nr_queued_cmds = 0;
+
+    while (TRUE) {
+        virtio_gpu_reap();
+        if (hdrs_done) break;
+
+        virtio_gpu_interrupt_wait();
     }
 }
 
@@ -564,6 +598,8 @@ static int virtio_gpu_config(void)
 
 static int virtio_gpu_alloc_requests(void)
 {
+    int i;
+
     hdrs_vir = mmap(
         NULL, roundup(sizeof(*hdrs_vir), ARCH_PG_SIZE), PROT_READ | PROT_WRITE,
         MAP_POPULATE | MAP_ANONYMOUS | MAP_CONTIG | MAP_PRIVATE, -1, 0);
@@ -577,50 +613,95 @@ static int virtio_gpu_alloc_requests(void)
         panic("%s: umap failed", name);
     }
 
+    cmd_slots = mmap(NULL,
+                     roundup(sizeof(*cmd_slots) * NR_CMD_SLOTS, ARCH_PG_SIZE),
+                     PROT_READ | PROT_WRITE,
+                     MAP_POPULATE | MAP_ANONYMOUS | MAP_CONTIG | MAP_PRIVATE,
+                     -1, 0);
+
+    if (cmd_slots == MAP_FAILED) {
+        return ENOMEM;
+    }
+
+    if (umap(SELF, UMT_VADDR, (vir_bytes)cmd_slots,
+             sizeof(*cmd_slots) * NR_CMD_SLOTS, &cmd_slots_phys) != 0) {
+        panic("%s: umap failed", name);
+    }
+
+    for (i = 0; i < NR_CMD_SLOTS; i++)
+        free_cmd_slots[i] = &cmd_slots[i];
+    nr_free_cmd_slots = NR_CMD_SLOTS;
+
     return 0;
 }
 
+static void virtio_gpu_transfer_rect(struct virtio_gpu_object* bo,
+                                     struct drm_framebuffer* fb,
+                                     const struct drm_mode_rect* rect)
+{
+    uint64_t offset;
+
+    offset = fb->offsets[0] + rect->y1 * fb->pitches[0] + rect->x1 * 4;
+
+    virtio_gpu_cmd_transfer_to_host_2d(bo, offset, rect->x2 - rect->x1,
+                                       rect->y2 - rect->y1, rect->x1,
+                                       rect->y1);
+}
+
+/* Only the damaged parts of the plane are transferred and flushed. The
+ * commands are queued and kicked once the whole commit is done. */
 static void virtio_gpu_primary_plane_update(struct drm_plane* plane,
                                             struct drm_plane_state* old_state)
 {
+    struct drm_plane_state* state = plane->state;
     struct virtio_gpu_output* output = NULL;
     struct virtio_gpu_object* bo = NULL;
+    struct drm_atomic_helper_damage_iter iter;
+    struct drm_mode_rect rect, damage;
+    int damaged;
 
-    if (plane->state->crtc) {
-        output = drm_crtc_to_virtio_gpu_output(plane->state->crtc);
+    if (state->crtc) {
+        output = drm_crtc_to_virtio_gpu_output(state->crtc);
     }
     if (old_state->crtc) {
         output = drm_crtc_to_virtio_gpu_output(old_state->crtc);
     }
     if (!output) return;
 
-    if (!plane->state->fb) {
-        virtio_gpu_cmd_set_scanout(output->index, 0, plane->state->src_w >> 16,
-                                   plane->state->src_h >> 16, 0, 0);
+    if (!state->fb) {
+        virtio_gpu_cmd_set_scanout(output->index, 0, state->src_w >> 16,
+                                   state->src_h >> 16, 0, 0);
         return;
     }
 
-    bo = gem_to_virtio_gpu_obj(plane->state->fb->obj[0]);
+    bo = gem_to_virtio_gpu_obj(state->fb->obj[0]);
+
+    damaged = drm_atomic_helper_damage_merged(old_state, state, &damage);
 
-    if (bo->dumb) {
-        virtio_gpu_cmd_transfer_to_host_2d(bo, 0, plane->state->src_w >> 16,
-                                           plane->state->src_h >> 16, 0, 0);
+    if (bo->dumb && damaged) {
+        if (state->num_fb_damage_clips > MAX_DAMAGE_RECTS) {
+            virtio_gpu_transfer_rect(bo, state->fb, &damage);
+        } else {
+            drm_atomic_helper_damage_iter_init(&iter, old_state, state);
+            while (drm_atomic_helper_damage_iter_next(&iter, &rect))
+                virtio_gpu_transfer_rect(bo, state->fb, &rect);
+        }
     }
 
-    if (plane->state->fb != old_state->fb ||
-        plane->state->src_w != old_state->src_w ||
-        plane->state->src_h != old_state->src_h ||
-        plane->state->src_x != old_state->src_x ||
-        plane->state->src_y != old_state->src_y) {
-        virtio_gpu_cmd_set_scanout(
-            output->index, bo->hw_res_handle, plane->state->src_w >> 16,
-            plane->state->src_h >> 16, plane->state->src_x >> 16,
-            plane->state->src_y >> 16);
+    if (state->fb != old_state->fb || state->src_w != old_state->src_w ||
+        state->src_h != old_state->src_h ||
+        state->src_x != old_state->src_x ||
+        state->src_y != old_state->src_y) {
+        virtio_gpu_cmd_set_scanout(output->index, bo->hw_res_handle,
+                                   state->src_w >> 16, state->src_h >> 16,
+                                   state->src_x >> 16, state->src_y >> 16);
     }
 
-    virtio_gpu_cmd_resource_flush(
-        bo->hw_res_handle, plane->state->src_w >> 16, plane->state->src_h >> 16,
-        plane->state->src_x >> 16, plane->state->src_y >> 16);
+    if (damaged) {
+        virtio_gpu_cmd_resource_flush(bo->hw_res_handle, damage.x2 - damage.x1,
+                                      damage.y2 - damage.y1, damage.x1,
+                                      damage.y1);
+    }
 }
 
 static struct drm_plane_helper_funcs virtio_gpu_primary_helper_funcs = {
@@ -722,6 +803,7 @@ static int virtio_gpu_fb_create(struct drm_device* dev,
 
     memset(fb, 0, sizeof(*fb));
 
+    drm_helper_mode_fill_fb_struct(&fb->base, cmd);
     fb->base.obj[0] = obj;
 
     retval = drm_framebuffer_init(dev, &fb->base);
@@ -744,6 +826,8 @@ static void virtio_gpu_mode_commit(struct drm_atomic_state* state)
     struct drm_device* dev = state->dev;
 
     drm_helper_commit_planes(dev, state);
+
+    virtio_gpu_kick_cmds();
 }
 
 struct drm_mode_config_funcs virtio_gpu_mode_funcs = {
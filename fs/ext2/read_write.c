@@ -164,13 +164,16 @@ static int ext2_rw_chunk(ext2_inode_t* pin, loff_t position, size_t chunk,
         if (b != 0)
             fsdriver_copyout(data, data_offset, (char*)bp->data + offset,
                              chunk);
+
+        /* VFS keeps file data in the page cache */
+        fsdriver_put_block_once(bp);
     } else {
         /* copy the data from userspace */
         fsdriver_copyin(data, data_offset, (char*)bp->data + offset, chunk);
         fsdriver_mark_dirty(bp);
-    }
 
-    if (bp != NULL) fsdriver_put_block(bp);
+        if (bp != NULL) fsdriver_put_block(bp);
+    }
 
     return 0;
 }
@@ -219,6 +219,9 @@ int ext2_readsuper(dev_t dev, struct fsdriver_context* fc, void* data,
         write_ext2_super_block(dev);
     }
 
+    /* file data is cached by MM, our buffer cache keeps the metadata */
+    fc->sb_flags |= RF_PAGECACHE;
+
     /* fill result */
     node->fn_num = pin->i_num;
     node->fn_uid = pin->i_uid;
@@ -17,6 +17,7 @@
 #define _INITFS_CONST_H_
 
 #define TAR_MAX_PATH 100
-#define MAX_HEADERS 100
+
+#define INITFS_ROOT_INODE 0
 
 #endif
@@ -17,6 +17,7 @@
 #define _INITFS_GLOBAL_H_
 
 #include "const.h"
+#include "types.h"
 
 /* EXTERN is extern except for global.c */
 #ifdef _INITFS_GLOBAL_VARIABLE_HERE_
@@ -24,7 +25,13 @@
 #define EXTERN
 #endif
 
-EXTERN int initfs_headers_count;
-EXTERN unsigned initfs_headers[MAX_HEADERS];
+/* inodes indexed by number, built from the archive at mount time */
+EXTERN struct initfs_inode** initfs_inodes;
+EXTERN ino_t initfs_inodes_count;
+
+/* the archive mapped into our address space, or NULL if it is read through
+ * the buffer cache */
+EXTERN char* initfs_image;
+EXTERN size_t initfs_image_len;
 
 #endif
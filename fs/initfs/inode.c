@@ -0,0 +1,200 @@
+/*  This file is part of Lyos.
+
+    Lyos is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Lyos is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Lyos.  If not, see <http://www.gnu.org/licenses/>. */
+
+#include <lyos/types.h>
+#include <lyos/ipc.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <lyos/const.h>
+#include <lyos/list.h>
+#include <sys/stat.h>
+
+#include "const.h"
+#include "proto.h"
+#include "global.h"
+#include "types.h"
+
+#define INITFS_NAME_HASH_LOG2 9
+#define INITFS_NAME_HASH_SIZE ((unsigned long)1 << INITFS_NAME_HASH_LOG2)
+#define INITFS_NAME_HASH_MASK (INITFS_NAME_HASH_SIZE - 1)
+
+/* all inodes hashed by (parent, name) */
+static struct list_head initfs_name_table[INITFS_NAME_HASH_SIZE];
+
+static ino_t inodes_size;
+
+static unsigned int initfs_name_gethash(const struct initfs_inode* dir,
+                                        const char* name, size_t len)
+{
+    unsigned long hash = (unsigned long)dir->num;
+
+    while (len--) {
+        hash = (hash << 5) + hash + (unsigned char)*name++;
+    }
+
+    return (hash ^ (hash >> INITFS_NAME_HASH_LOG2)) & INITFS_NAME_HASH_MASK;
+}
+
+struct initfs_inode* initfs_find_inode(ino_t num)
+{
+    if (num >= initfs_inodes_count) return NULL;
+    return initfs_inodes[num];
+}
+
+struct initfs_inode* initfs_lookup_child(struct initfs_inode* dir,
+                                         const char* name, size_t len)
+{
+    unsigned int hash = initfs_name_gethash(dir, name, len);
+    struct initfs_inode* pin;
+
+    list_for_each_entry(pin, &initfs_name_table[hash], hash)
+    {
+        if (pin->parent == dir && !strncmp(pin->name, name, len) &&
+            pin->name[len] == '\0')
+            return pin;
+    }
+
+    return NULL;
+}
+
+static struct initfs_inode* alloc_inode(struct initfs_inode* dir,
+                                        const char* name, size_t len)
+{
+    struct initfs_inode** inodes;
+    struct initfs_inode* pin;
+
+    if (initfs_inodes_count == inodes_size) {
+        ino_t new_size = inodes_size ? inodes_size * 2 : 64;
+
+        inodes = realloc(initfs_inodes, new_size * sizeof(*inodes));
+        if (!inodes) return NULL;
+
+        initfs_inodes = inodes;
+        inodes_size = new_size;
+    }
+
+    pin = calloc(1, sizeof(*pin));
+    if (!pin) return NULL;
+
+    pin->name = malloc(len + 1);
+    if (!pin->name) {
+        free(pin);
+        return NULL;
+    }
+    memcpy(pin->name, name, len);
+    pin->name[len] = '\0';
+
+    pin->num = initfs_inodes_count;
+    pin->parent = dir ? dir : pin;
+    INIT_LIST_HEAD(&pin->children);
+    INIT_LIST_HEAD(&pin->list);
+    INIT_LIST_HEAD(&pin->hash);
+
+    if (dir) {
+        list_add_tail(&pin->list, &dir->children);
+        list_add(&pin->hash,
+                 &initfs_name_table[initfs_name_gethash(dir, name, len)]);
+    }
+
+    initfs_inodes[initfs_inodes_count++] = pin;
+
+    return pin;
+}
+
+/* Move an inode to its new hash chain after its name was changed. */
+void initfs_rehash(struct initfs_inode* pin)
+{
+    list_del(&pin->hash);
+    list_add(&pin->hash, &initfs_name_table[initfs_name_gethash(
+                             pin->parent, pin->name, strlen(pin->name))]);
+}
+
+void initfs_free_inodes(void)
+{
+    ino_t i;
+
+    for (i = 0; i < initfs_inodes_count; i++) {
+        free(initfs_inodes[i]->name);
+        free(initfs_inodes[i]->data);
+        free(initfs_inodes[i]);
+    }
+
+    free(initfs_inodes);
+    initfs_inodes = NULL;
+    initfs_inodes_count = inodes_size = 0;
+
+    for (i = 0; i < INITFS_NAME_HASH_SIZE; i++) {
+        INIT_LIST_HEAD(&initfs_name_table[i]);
+    }
+}
+
+struct initfs_inode* initfs_alloc_root(void)
+{
+    struct initfs_inode* root;
+
+    initfs_free_inodes();
+
+    root = alloc_inode(NULL, "", 0);
+    if (!root) return NULL;
+
+    root->mode = S_IFDIR | S_IRWXU;
+
+    return root;
+}
+
+/* Find or create the inode for an archive path. Missing parent directories
+ * are created since archives do not always list them before their entries. */
+struct initfs_inode* initfs_add_path(const char* path)
+{
+    struct initfs_inode *dir, *pin;
+    const char* end;
+    size_t len;
+
+    dir = initfs_inodes[INITFS_ROOT_INODE];
+    pin = dir;
+
+    for (;;) {
+        while (*path == '/')
+            path++;
+        if (*path == '\0') break;
+
+        end = path;
+        while (*end && *end != '/')
+            end++;
+        len = end - path;
+
+        if (len == 1 && path[0] == '.') {
+            path = end;
+            continue;
+        }
+
+        if (!S_ISDIR(dir->mode)) return NULL;
+
+        pin = initfs_lookup_child(dir, path, len);
+        if (!pin) {
+            pin = alloc_inode(dir, path, len);
+            if (!pin) return NULL;
+
+            /* until the archive tells us otherwise */
+            pin->mode = S_IFDIR | 0755;
+        }
+
+        dir = pin;
+        path = end;
+    }
+
+    return pin;
+}
@@ -23,81 +23,35 @@
 #include "global.h"
 #include "tar.h"
 
-static void fill_node(ino_t num, struct fsdriver_node* fn,
-                      const struct posix_tar_header* phdr)
+static void fill_node(struct fsdriver_node* fn, const struct initfs_inode* pin)
 {
-    dev_t major, minor;
-
-    fn->fn_num = num;
-    fn->fn_uid = initfs_get8(phdr->uid);
-    fn->fn_gid = initfs_get8(phdr->gid);
-    fn->fn_size = initfs_getsize(phdr->size);
-
-    if (!num) {
-        /* special hack for root inode */
-        fn->fn_mode = S_IFDIR | S_IRWXU;
-    } else {
-        fn->fn_mode = initfs_getmode(phdr);
-    }
-
-    major = initfs_get8(phdr->devmajor);
-    minor = initfs_get8(phdr->devminor);
-    fn->fn_device = MAKE_DEV(major, minor);
+    fn->fn_num = pin->num;
+    fn->fn_uid = pin->uid;
+    fn->fn_gid = pin->gid;
+    fn->fn_size = pin->size;
+    fn->fn_mode = pin->mode;
+    fn->fn_device = pin->spec_dev;
 }
 
 int initfs_lookup(dev_t dev, ino_t start, const char* name,
                   struct fsdriver_node* fn, int* is_mountpoint)
 {
-    char header[512];
-    struct posix_tar_header* phdr = (struct posix_tar_header*)header;
-    char string[TAR_MAX_PATH], *p, filename[TAR_MAX_PATH];
-    size_t base_len, name_len;
-    int i, retval;
+    struct initfs_inode *dir, *pin;
 
     *is_mountpoint = FALSE;
 
-    if ((retval = initfs_read_header(dev, start, header, sizeof(header))) != 0)
-        return retval;
+    if (!(dir = initfs_find_inode(start))) return EINVAL;
+    if (!S_ISDIR(dir->mode)) return ENOTDIR;
 
     if (!strcmp(name, ".")) {
-        fill_node(start, fn, phdr);
-        return 0;
-    }
-
-    if (!start) {
-        /* do not include the file name for root inode */
-        base_len = 0;
+        pin = dir;
+    } else if (!strcmp(name, "..")) {
+        pin = dir->parent;
     } else {
-        /* include the parent name */
-        base_len = strlen(phdr->name);
-        strlcpy(string, phdr->name, TAR_MAX_PATH);
-    }
-
-    strlcpy(string + base_len, name, TAR_MAX_PATH - base_len);
-
-    /* skip leading slashes */
-    p = string;
-    while (*p && *p == '/')
-        p++;
-
-    for (i = 0; i < initfs_headers_count; i++) {
-        if ((retval = initfs_read_header(dev, i, header, sizeof(header))) != 0)
-            return retval;
-
-        strlcpy(filename, phdr->name, TAR_MAX_PATH);
-        name_len = strlen(filename);
-
-        /* remove trailing slashes */
-        while (name_len && filename[name_len - 1] == '/') {
-            filename[name_len - 1] = '\0';
-            name_len--;
-        }
-
-        if (!strcmp(p, filename)) {
-            fill_node(i, fn, phdr);
-            return 0;
-        }
+        pin = initfs_lookup_child(dir, name, strlen(name));
+        if (!pin) return ENOENT;
     }
 
-    return ENOENT;
+    fill_node(fn, pin);
+    return 0;
 }
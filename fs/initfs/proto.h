@@ -23,6 +23,7 @@
 #include <libfsdriver/libfsdriver.h>
 
 #include "tar.h"
+#include "types.h"
 
 int initfs_readsuper(dev_t dev, struct fsdriver_context* fc, void* data,
                      struct fsdriver_node* node);
@@ -39,6 +40,18 @@ int initfs_stat(dev_t dev, ino_t num, struct fsdriver_data* data);
 unsigned int initfs_getsize(const char* in);
 unsigned int initfs_get8(const char* in);
 unsigned int initfs_getmode(const struct posix_tar_header* phdr);
-int initfs_read_header(dev_t dev, ino_t num, char* header, size_t header_size);
+int initfs_read_raw(dev_t dev, loff_t pos, char* buf, size_t len);
+
+struct initfs_inode* initfs_find_inode(ino_t num);
+struct initfs_inode* initfs_lookup_child(struct initfs_inode* dir,
+                                         const char* name, size_t len);
+struct initfs_inode* initfs_alloc_root(void);
+void initfs_rehash(struct initfs_inode* pin);
+void initfs_free_inodes(void);
+struct initfs_inode* initfs_add_path(const char* path);
+
+size_t lz4_frame_header(const char* src, size_t src_len, u64* content_size);
+ssize_t lz4_decompress_frame(const char* src, size_t src_len, char* dst,
+                             size_t dst_len);
 
 #endif
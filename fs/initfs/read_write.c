@@ -18,7 +18,9 @@
 #include "errno.h"
 #include "lyos/const.h"
 #include "string.h"
+#include <stdlib.h>
 #include <sys/dirent.h>
+#include <sys/stat.h>
 #include <asm/page.h>
 
 #include "proto.h"
@@ -27,12 +29,53 @@
 
 #include <libfsdriver/libfsdriver.h>
 
-static ssize_t initfs_rdwt(dev_t dev, ino_t num, int rw_flag,
-                           struct fsdriver_data* data, loff_t rwpos,
-                           size_t count)
+/* Inflate a compressed file the first time it is read. The archive stays
+ * compressed in memory so only files that are used take up the space. */
+static int inflate_inode(dev_t dev, struct initfs_inode* pin)
 {
-    char header[512];
-    struct posix_tar_header* phdr = (struct posix_tar_header*)header;
+    char *src, *dst;
+    ssize_t len;
+    int retval;
+
+    if (pin->data) return 0;
+
+    if (initfs_image) {
+        src = initfs_image + pin->data_off;
+    } else {
+        if (!(src = malloc(pin->data_len))) return ENOMEM;
+
+        retval = initfs_read_raw(dev, pin->data_off, src, pin->data_len);
+        if (retval) {
+            free(src);
+            return retval;
+        }
+    }
+
+    dst = malloc(pin->size ? pin->size : 1);
+    if (!dst) {
+        retval = ENOMEM;
+        goto out;
+    }
+
+    len = lz4_decompress_frame(src, pin->data_len, dst, pin->size);
+    if (len < 0) {
+        free(dst);
+        retval = -len;
+        goto out;
+    }
+
+    pin->data = dst;
+    retval = 0;
+
+out:
+    if (!initfs_image) free(src);
+    return retval;
+}
+
+ssize_t initfs_read(dev_t dev, ino_t num, struct fsdriver_data* data,
+                    loff_t rwpos, size_t count)
+{
+    struct initfs_inode* pin;
     size_t block;
     loff_t block_pos;
     off_t block_off;
@@ -40,18 +83,27 @@ static ssize_t initfs_rdwt(dev_t dev, ino_t num, int rw_flag,
     struct fsdriver_buffer* bp;
     int retval;
 
-    if (num >= initfs_headers_count) return -EINVAL;
+    if (!(pin = initfs_find_inode(num))) return -EINVAL;
+    if (S_ISDIR(pin->mode)) return -EISDIR;
 
-    if ((retval = initfs_read_header(dev, num, header, sizeof(header))) != 0)
-        return -retval;
+    if (rwpos >= pin->size) return 0;
+    count = min(count, pin->size - rwpos);
 
-    off_t filesize = initfs_getsize(phdr->size);
+    if (pin->flags & IF_COMPRESSED) {
+        if ((retval = inflate_inode(dev, pin)) != 0) return -retval;
 
-    if (filesize < rwpos + count) {
-        count = filesize - rwpos;
+        retval = fsdriver_copyout(data, 0, pin->data + rwpos, count);
+        return retval ? -retval : count;
     }
 
-    block_pos = initfs_headers[num] + 512 + rwpos;
+    if (initfs_image) {
+        /* straight from the initrd mapping */
+        retval = fsdriver_copyout(data, 0, initfs_image + pin->data_off + rwpos,
+                                  count);
+        return retval ? -retval : count;
+    }
+
+    block_pos = pin->data_off + rwpos;
     cum_io = 0;
 
     while (count > 0) {
@@ -61,19 +113,12 @@ static ssize_t initfs_rdwt(dev_t dev, ino_t num, int rw_flag,
 
         if ((retval = fsdriver_get_block(&bp, dev, block)) != 0) return -retval;
 
-        if (rw_flag == READ) {
-            if ((retval = fsdriver_copyout(data, cum_io, bp->data + block_off,
-                                           bytes_rdwt)) != 0)
-                return -retval;
-        } else {
-            if ((retval = fsdriver_copyin(data, cum_io, bp->data + block_off,
-                                          bytes_rdwt)) != 0)
-                return -retval;
-            fsdriver_mark_dirty(bp);
-        }
-
+        retval = fsdriver_copyout(data, cum_io, bp->data + block_off,
+                                  bytes_rdwt);
         fsdriver_put_block(bp);
 
+        if (retval) return -retval;
+
         block_pos += bytes_rdwt;
         count -= bytes_rdwt;
         cum_io += bytes_rdwt;
@@ -82,59 +127,26 @@ static ssize_t initfs_rdwt(dev_t dev, ino_t num, int rw_flag,
     return cum_io;
 }
 
-ssize_t initfs_read(dev_t dev, ino_t num, struct fsdriver_data* data,
-                    loff_t rwpos, size_t count)
-{
-    return initfs_rdwt(dev, num, READ, data, rwpos, count);
-}
-
 ssize_t initfs_write(dev_t dev, ino_t num, struct fsdriver_data* data,
                      loff_t rwpos, size_t count)
 {
     return -EROFS;
 }
 
-static int match_dirname(const char* dirname, const char* pathname)
-{
-    size_t dir_len, path_len;
-    const char* path_lim;
-
-    dir_len = strlen(dirname);
-    path_len = strlen(pathname);
-    path_lim = pathname + path_len;
-
-    if (path_len < dir_len) {
-        return FALSE;
-    }
-
-    if (memcmp(dirname, pathname, dir_len)) return FALSE;
-
-    pathname += dir_len;
-
-    while (path_lim > pathname && *(path_lim - 1) == '/')
-        path_lim--;
-
-    while (pathname < path_lim)
-        if (*pathname++ == '/') return FALSE;
-
-    return TRUE;
-}
-
-static int header_type(const struct posix_tar_header* phdr)
+static int inode_type(const struct initfs_inode* pin)
 {
-    switch (phdr->typeflag) {
-    case REGTYPE:
-    case AREGTYPE:
+    switch (pin->mode & S_IFMT) {
+    case S_IFREG:
         return DT_REG;
-    case SYMTYPE:
+    case S_IFLNK:
         return DT_LNK;
-    case CHRTYPE:
+    case S_IFCHR:
         return DT_CHR;
-    case BLKTYPE:
+    case S_IFBLK:
         return DT_BLK;
-    case DIRTYPE:
+    case S_IFDIR:
         return DT_DIR;
-    case FIFOTYPE:
+    case S_IFIFO:
         return DT_FIFO;
     }
 
@@ -148,55 +160,49 @@ ssize_t initfs_getdents(dev_t dev, ino_t num, struct fsdriver_data* data,
 #define GETDENTS_ENTRIES 8
     static char getdents_buf[GETDENTS_BUFSIZE * GETDENTS_ENTRIES];
     struct fsdriver_dentry_list list;
-    char header[512];
-    struct posix_tar_header* phdr = (struct posix_tar_header*)header;
-    char dirname[TAR_MAX_PATH];
-    size_t name_len;
-    char* p;
-    const char dot = '.';
+    struct initfs_inode *dir, *pin;
     loff_t pos = *ppos, new_pos = *ppos;
-    int i, retval;
-
-    if (num >= initfs_headers_count) return -EINVAL;
+    int retval = 0;
 
-    if ((retval = initfs_read_header(dev, num, header, sizeof(header))) != 0)
-        return -retval;
-    strlcpy(dirname, phdr->name, TAR_MAX_PATH);
+    if (!(dir = initfs_find_inode(num))) return -EINVAL;
+    if (!S_ISDIR(dir->mode)) return -ENOTDIR;
 
     fsdriver_dentry_list_init(&list, data, count, getdents_buf,
                               sizeof(getdents_buf));
 
-    for (i = 0; i < initfs_headers_count; i++) {
-        if ((retval = initfs_read_header(dev, i, header, sizeof(header))) != 0)
-            return -retval;
+    /* "." and ".." come first, then the children in archive order */
+    if (pos == 0) {
+        retval = fsdriver_dentry_list_add(&list, dir->num, ".", 1, DT_DIR);
+        if (retval > 0) new_pos++;
+    }
 
-        if (!match_dirname(dirname, phdr->name)) continue;
+    if (retval >= 0 && new_pos == 1) {
+        retval =
+            fsdriver_dentry_list_add(&list, dir->parent->num, "..", 2, DT_DIR);
+        if (retval > 0) new_pos++;
+    }
 
-        if (pos > 0) {
-            pos--;
-            continue;
-        }
+    if (retval < 0) return retval;
 
-        p = phdr->name;
-        p += strlen(dirname);
+    if (new_pos >= 2) {
+        pos = max(pos, 2) - 2;
 
-        name_len = 0;
-        while (p[name_len] && p[name_len] != '/')
-            name_len++;
+        list_for_each_entry(pin, &dir->children, list)
+        {
+            if (pos > 0) {
+                pos--;
+                continue;
+            }
 
-        if (!name_len) {
-            /* parent directory itself */
-            retval =
-                fsdriver_dentry_list_add(&list, i, &dot, 1, header_type(phdr));
-        } else {
-            retval = fsdriver_dentry_list_add(&list, i, p, name_len - 1,
-                                              header_type(phdr));
-        }
+            retval = fsdriver_dentry_list_add(&list, pin->num, pin->name,
+                                              strlen(pin->name),
+                                              inode_type(pin));
 
-        if (retval < 0) return retval;
-        if (retval == 0) break;
+            if (retval < 0) return retval;
+            if (retval == 0) break;
 
-        new_pos++;
+            new_pos++;
+        }
     }
 
     if (retval >= 0 && (retval = fsdriver_dentry_list_finish(&list)) >= 0) {
@@ -34,27 +34,21 @@
 int initfs_stat(dev_t dev, ino_t num, struct fsdriver_data* data)
 {
     struct stat sbuf;
-    char header[512];
-    struct posix_tar_header* phdr = (struct posix_tar_header*)header;
-    int retval;
+    struct initfs_inode* pin;
 
-    if (num >= initfs_headers_count) return -EINVAL;
+    if (!(pin = initfs_find_inode(num))) return EINVAL;
 
     memset(&sbuf, 0, sizeof(struct stat));
-    if ((retval = initfs_read_header(dev, num, header, sizeof(header))) != 0)
-        return retval;
 
     /* fill in the information */
     sbuf.st_dev = dev;
     sbuf.st_ino = num;
-    sbuf.st_mode = initfs_getmode(phdr);
+    sbuf.st_mode = pin->mode;
     sbuf.st_nlink = 0;
-    sbuf.st_uid = initfs_get8(phdr->uid);
-    sbuf.st_gid = initfs_get8(phdr->gid);
-    int major = initfs_get8(phdr->devmajor);
-    int minor = initfs_get8(phdr->devminor);
-    sbuf.st_rdev = MAKE_DEV(major, minor);
-    sbuf.st_size = (off_t)initfs_getsize(phdr->size);
+    sbuf.st_uid = pin->uid;
+    sbuf.st_gid = pin->gid;
+    sbuf.st_rdev = pin->spec_dev;
+    sbuf.st_size = (off_t)pin->size;
 
     sbuf.st_atime = 0;
     sbuf.st_mtime = 0;
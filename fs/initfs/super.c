@@ -19,6 +19,11 @@
 #include "lyos/const.h"
 #include "string.h"
 #include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <lyos/param.h>
+#include <lyos/sysutils.h>
+#include <lyos/vm.h>
 #include <asm/page.h>
 
 #include "proto.h"
@@ -27,46 +32,144 @@
 
 #include <libfsdriver/libfsdriver.h>
 
+static void map_image(dev_t dev)
+{
+    struct kinfo kinfo;
+    void* base;
+
+    if (initfs_image) return;
+
+    /* the initrd is already in memory so read it in place instead of
+     * copying it through the ramdisk driver and the buffer cache */
+    if (dev != MAKE_DEV(DEV_RD, MINOR_INITRD)) return;
+    if (get_kinfo(&kinfo) != 0 || !kinfo.initrd_len) return;
+
+    base = mm_map_phys(SELF, kinfo.initrd_base_phys, kinfo.initrd_len, 0);
+    if (base == MAP_FAILED) return;
+
+    initfs_image = base;
+    initfs_image_len = kinfo.initrd_len;
+}
+
+static int set_contents(dev_t dev, struct initfs_inode* pin,
+                        const struct posix_tar_header* header,
+                        loff_t data_off, size_t size)
+{
+    char buf[32];
+    size_t name_len, hdr_len;
+    u64 content_size;
+    int retval;
+
+    pin->data_off = data_off;
+    pin->data_len = size;
+    pin->size = size;
+
+    name_len = strnlen(header->name, TAR_MAX_PATH);
+    if (!S_ISREG(pin->mode) || name_len <= 4 ||
+        memcmp(&header->name[name_len - 4], ".lz4", 4))
+        return 0;
+
+    if ((retval = initfs_read_raw(dev, data_off, buf, min(size, sizeof(buf)))))
+        return retval;
+
+    hdr_len = lz4_frame_header(buf, min(size, sizeof(buf)), &content_size);
+    if (!hdr_len) return 0;
+
+    /* serve foo.lz4 as foo */
+    name_len = strlen(pin->name);
+    pin->name[name_len - 4] = '\0';
+    if (initfs_lookup_child(pin->parent, pin->name, name_len - 4)) {
+        pin->name[name_len - 4] = '.';
+        return 0;
+    }
+    initfs_rehash(pin);
+
+    pin->flags |= IF_COMPRESSED;
+    pin->size = content_size;
+
+    return 0;
+}
+
+static int add_entry(dev_t dev, const struct posix_tar_header* header,
+                     loff_t data_off, size_t size)
+{
+    char path[TAR_MAX_PATH + 1];
+    struct initfs_inode *pin, *target;
+
+    strlcpy(path, header->name, sizeof(path));
+
+    if (header->typeflag == LNKTYPE) {
+        char linkname[TAR_MAX_PATH + 1];
+
+        strlcpy(linkname, header->linkname, sizeof(linkname));
+        target = initfs_add_path(linkname);
+        if (!target || !S_ISREG(target->mode)) return 0;
+
+        /* hard links share the contents of the target */
+        pin = initfs_add_path(path);
+        if (!pin || pin == target) return 0;
+
+        pin->mode = target->mode;
+        pin->uid = target->uid;
+        pin->gid = target->gid;
+        pin->size = target->size;
+        pin->data_off = target->data_off;
+        pin->data_len = target->data_len;
+        pin->flags = target->flags;
+        return 0;
+    }
+
+    pin = initfs_add_path(path);
+    if (!pin) return ENOMEM;
+
+    pin->mode = initfs_getmode(header);
+    if (pin->num == INITFS_ROOT_INODE) pin->mode = S_IFDIR | S_IRWXU;
+    pin->uid = initfs_get8(header->uid);
+    pin->gid = initfs_get8(header->gid);
+    pin->spec_dev =
+        MAKE_DEV(initfs_get8(header->devmajor), initfs_get8(header->devminor));
+
+    return set_contents(dev, pin, header, data_off, size);
+}
+
 int initfs_readsuper(dev_t dev, struct fsdriver_context* fc, void* data,
                      struct fsdriver_node* node)
 {
     char buf[512];
     struct posix_tar_header* header = (struct posix_tar_header*)buf;
+    struct initfs_inode* root;
     loff_t position;
-    struct fsdriver_buffer* bp;
-    size_t block;
-    off_t block_off;
-    size_t bytes_rdwt;
-    int i, retval;
+    size_t size;
+    int retval;
 
-    initfs_headers_count = 0;
-    position = 0;
+    map_image(dev);
+
+    if (!(root = initfs_alloc_root())) return ENOMEM;
 
-    for (i = 0;; i++) {
-        block = position / ARCH_PG_SIZE;
-        block_off = position % ARCH_PG_SIZE;
-        bytes_rdwt = min(ARCH_PG_SIZE - block_off, sizeof(buf));
+    /* walk the archive once and index every entry */
+    position = 0;
+    for (;;) {
+        if (initfs_image && position + sizeof(buf) > initfs_image_len) break;
 
-        if ((retval = fsdriver_get_block(&bp, dev, block)) != 0) return retval;
-        memcpy(buf, bp->data + block_off, bytes_rdwt);
-        fsdriver_put_block(bp);
+        if ((retval = initfs_read_raw(dev, position, buf, sizeof(buf))) != 0)
+            return retval;
 
         if (header->name[0] == '\0') break;
 
-        size_t size = initfs_getsize(header->size);
-        initfs_headers[i] = position;
-        position += ((size / 512) + 1) * 512;
-        if (size % 512) position += 512;
+        size = initfs_getsize(header->size);
+
+        if ((retval = add_entry(dev, header, position + 512, size)) != 0)
+            return retval;
 
-        initfs_headers_count++;
+        position += roundup(size, 512) + 512;
     }
 
     /* fill result */
-    node->fn_num = 0;
-    node->fn_uid = 0;
-    node->fn_gid = 0;
+    node->fn_num = root->num;
+    node->fn_uid = root->uid;
+    node->fn_gid = root->gid;
     node->fn_size = 0;
-    node->fn_mode = S_IFDIR | S_IRWXU;
+    node->fn_mode = root->mode;
 
     return 0;
 }
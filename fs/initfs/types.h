@@ -0,0 +1,46 @@
+/*  This file is part of Lyos.
+
+    Lyos is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Lyos is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Lyos.  If not, see <http://www.gnu.org/licenses/>. */
+
+#ifndef _INITFS_TYPES_H_
+#define _INITFS_TYPES_H_
+
+#include <sys/types.h>
+#include <lyos/list.h>
+
+/* contents are an LZ4 frame, inflated on first read */
+#define IF_COMPRESSED 0x1
+
+struct initfs_inode {
+    struct list_head hash; /* hashed by (parent, name) */
+    struct list_head list; /* in the parent's children */
+    struct list_head children;
+
+    ino_t num;
+    struct initfs_inode* parent;
+    char* name;
+
+    mode_t mode;
+    uid_t uid;
+    gid_t gid;
+    dev_t spec_dev;
+    size_t size; /* size seen by clients */
+
+    loff_t data_off; /* position of the contents in the archive */
+    size_t data_len; /* bytes stored in the archive */
+    int flags;
+    char* data; /* inflated contents */
+};
+
+#endif
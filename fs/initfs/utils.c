@@ -13,9 +13,9 @@
     You should have received a copy of the GNU General Public License
     along with Lyos.  If not, see <http://www.gnu.org/licenses/>. */
 
+#include <lyos/types.h>
 #include <lyos/ipc.h>
 #include "errno.h"
-#include "assert.h"
 #include "lyos/const.h"
 #include "string.h"
 #include <fcntl.h>
@@ -25,6 +25,7 @@
 #include "global.h"
 #include "tar.h"
 
+#include <libfsdriver/libfsdriver.h>
 
 unsigned int initfs_getsize(const char* in)
 {
@@ -83,24 +84,36 @@ unsigned int initfs_getmode(const struct posix_tar_header* phdr)
     return mode;
 }
 
-int initfs_read_header(dev_t dev, ino_t num, char* header, size_t header_size)
+/* Read from the archive, directly if it is mapped. */
+int initfs_read_raw(dev_t dev, loff_t pos, char* buf, size_t len)
 {
     struct fsdriver_buffer* bp;
-    size_t header_block;
+    size_t block;
     off_t block_off;
     size_t bytes_rdwt;
     int retval;
 
-    header_block = initfs_headers[num] / ARCH_PG_SIZE;
-    block_off = initfs_headers[num] % ARCH_PG_SIZE;
-    bytes_rdwt = min(ARCH_PG_SIZE - block_off, header_size);
+    if (initfs_image) {
+        if (pos > initfs_image_len || len > initfs_image_len - pos)
+            return EINVAL;
 
-    if ((retval = fsdriver_get_block(&bp, dev, header_block)) != 0)
-        return retval;
-    memcpy(header, bp->data + block_off, bytes_rdwt);
-    fsdriver_put_block(bp);
+        memcpy(buf, initfs_image + pos, len);
+        return 0;
+    }
+
+    while (len > 0) {
+        block = pos / ARCH_PG_SIZE;
+        block_off = pos % ARCH_PG_SIZE;
+        bytes_rdwt = min(ARCH_PG_SIZE - block_off, len);
 
-    assert(bytes_rdwt == header_size);
+        if ((retval = fsdriver_get_block(&bp, dev, block)) != 0) return retval;
+        memcpy(buf, bp->data + block_off, bytes_rdwt);
+        fsdriver_put_block(bp);
+
+        pos += bytes_rdwt;
+        buf += bytes_rdwt;
+        len -= bytes_rdwt;
+    }
 
     return 0;
 }
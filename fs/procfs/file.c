@@ -27,6 +27,8 @@ static void pid_read(struct memfs_inode* pin)
     int slot = memfs_node_index(parent);
     int index = memfs_node_index(pin);
 
+    if (update_proc_slot(slot) != 0) return;
+
     ((void (*)(int))pid_files[index].data)(slot);
 }
 
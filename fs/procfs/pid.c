@@ -22,16 +22,24 @@
 #include "string.h"
 #include <lyos/sysutils.h>
 #include <sys/stat.h>
+#include <lyos/vm.h>
+#include <asm/page.h>
 #include "type.h"
 #include "proto.h"
 #include "global.h"
 
 static void pid_status(int slot);
 static void pid_environ(int slot);
+static void pid_stat(int slot);
+static void pid_statm(int slot);
+static void pid_io(int slot);
 
 struct procfs_file pid_files[] = {
     {"status", S_IFREG | S_IRUSR | S_IRGRP | S_IROTH, pid_status},
     {"environ", S_IFREG | S_IRUSR | S_IRGRP | S_IROTH, pid_environ},
+    {"stat", S_IFREG | S_IRUSR | S_IRGRP | S_IROTH, pid_stat},
+    {"statm", S_IFREG | S_IRUSR | S_IRGRP | S_IROTH, pid_statm},
+    {"io", S_IFREG | S_IRUSR, pid_io},
     {"fd", S_IFDIR | S_IRUSR | S_IXUSR, NULL},
     {NULL, 0, NULL},
 };
@@ -82,3 +90,78 @@ static void pid_environ(int slot)
     printl("environ %d, %x, %x\n", slot, pmproc[slot].frame_addr,
            pmproc[slot].frame_size);
 }
+
+static char state_char(int pst)
+{
+    if (pst == 0) return 'R';
+    if (pst & PST_STOPPED) return 'T';
+    if (pst & PST_PAGEFAULT) return 'D';
+
+    return 'S';
+}
+
+/* Same field order as Linux so that ps/top can parse it. Fields we don't
+ * keep track of are reported as zero. */
+static void pid_stat(int slot)
+{
+    int pi = slot - NR_TASKS;
+    struct mm_proc_info info;
+    pid_t pid, ppid = 0, pgrp = 0;
+    int parent_slot;
+
+    memset(&info, 0, sizeof(info));
+
+    if (pi >= 0) {
+        pid = pmproc[pi].pid;
+        pgrp = pmproc[pi].procgrp;
+
+        parent_slot = ENDPOINT_P(pmproc[pi].parent);
+        if (parent_slot >= 0 && parent_slot < NR_PROCS)
+            ppid = pmproc[parent_slot].pid;
+
+        mm_get_procinfo(proc[slot].endpoint, &info);
+    } else {
+        pid = pi;
+    }
+
+    /* pid (comm) state ppid pgrp session tty_nr tpgid flags */
+    buf_printf("%d (%s) %c %d %d %d 0 0 0 ", pid, proc[slot].name,
+               state_char(proc[slot].state), ppid, pgrp, pgrp);
+    /* minflt cminflt majflt cmajflt utime stime cutime cstime */
+    buf_printf("0 0 0 0 %lu %lu 0 0 ", (unsigned long)proc[slot].user_time,
+               (unsigned long)proc[slot].sys_time);
+    /* priority nice num_threads itrealvalue starttime vsize rss */
+    buf_printf("%d 0 1 0 0 %lu %lu\n", proc[slot].priority,
+               (unsigned long)info.vm_size,
+               (unsigned long)(info.resident / ARCH_PG_SIZE));
+}
+
+static void pid_statm(int slot)
+{
+    struct mm_proc_info info;
+
+    memset(&info, 0, sizeof(info));
+    if (slot >= NR_TASKS) mm_get_procinfo(proc[slot].endpoint, &info);
+
+    /* size resident shared text lib data dt, in pages */
+    buf_printf("%lu %lu %lu %lu 0 %lu 0\n",
+               (unsigned long)(info.vm_size / ARCH_PG_SIZE),
+               (unsigned long)(info.resident / ARCH_PG_SIZE),
+               (unsigned long)(info.shared / ARCH_PG_SIZE),
+               (unsigned long)(info.text / ARCH_PG_SIZE),
+               (unsigned long)(info.data / ARCH_PG_SIZE));
+}
+
+static void pid_io(int slot)
+{
+    struct vfs_proc_io io;
+
+    memset(&io, 0, sizeof(io));
+    if (slot >= NR_TASKS)
+        vfs_getinfo(VFS_INFO_PROCIO, proc[slot].endpoint, &io, sizeof(io));
+
+    buf_printf("rchar: %llu\n", io.rchar);
+    buf_printf("wchar: %llu\n", io.wchar);
+    buf_printf("syscr: %llu\n", io.syscr);
+    buf_printf("syscw: %llu\n", io.syscw);
+}
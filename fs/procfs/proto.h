@@ -24,6 +24,8 @@ ssize_t procfs_read_hook(struct memfs_inode* inode, char* ptr, size_t count,
 int procfs_lookup_hook(struct memfs_inode* parent, const char* name,
                        cbdata_t data);
 int procfs_getdents_hook(struct memfs_inode* inode, cbdata_t data);
+int update_proc_slot(int slot);
+
 int procfs_rdlink_hook(struct memfs_inode* inode, char* ptr, size_t max,
                        endpoint_t user_endpt, cbdata_t data);
 
@@ -23,6 +23,7 @@
 #include <lyos/sysutils.h>
 #include <sys/utsname.h>
 #include <sys/stat.h>
+#include <string.h>
 #include "type.h"
 #include "proto.h"
 
@@ -32,6 +33,7 @@ static void root_uptime(void);
 void root_cpuinfo(void);
 void root_meminfo(void);
 static void root_stat(void);
+static void root_execstat(void);
 int root_self(char* ptr, size_t max, endpoint_t user_endpt);
 
 struct procfs_file root_files[] = {
@@ -41,6 +43,7 @@ struct procfs_file root_files[] = {
     {"cpuinfo", S_IFREG | S_IRUSR | S_IRGRP | S_IROTH, root_cpuinfo},
     {"meminfo", S_IFREG | S_IRUSR | S_IRGRP | S_IROTH, root_meminfo},
     {"stat", S_IFREG | S_IRUSR | S_IRGRP | S_IROTH, root_stat},
+    {"execstat", S_IFREG | S_IRUSR | S_IRGRP | S_IROTH, root_execstat},
     {"self", S_IFLNK | S_IRWXU | S_IRWXG | S_IRWXO, root_self},
     {NULL, 0, NULL},
 };
@@ -112,3 +115,27 @@ static void root_stat(void)
         buf_printf("\n");
     }
 }
+
+static void root_execstat(void)
+{
+    struct vfs_exec_stat stat;
+    u64 execs;
+
+    memset(&stat, 0, sizeof(stat));
+    if (vfs_getinfo(VFS_INFO_EXECSTAT, NO_TASK, &stat, sizeof(stat)) != 0)
+        return;
+
+    buf_printf("execs: %llu\n", stat.execs);
+    buf_printf("cache_hits: %llu\n", stat.cache_hits);
+    buf_printf("cache_misses: %llu\n", stat.cache_misses);
+    buf_printf("map_batches: %llu\n", stat.map_batches);
+    buf_printf("map_fallbacks: %llu\n", stat.map_fallbacks);
+
+    /* average latency of each phase in nanoseconds */
+    execs = stat.execs ? stat.execs : 1;
+    buf_printf("lookup_ns: %llu\n", stat.lookup_ns / execs);
+    buf_printf("header_ns: %llu\n", stat.header_ns / execs);
+    buf_printf("load_ns: %llu\n", stat.load_ns / execs);
+    buf_printf("stack_ns: %llu\n", stat.stack_ns / execs);
+    buf_printf("total_ns: %llu\n", stat.total_ns / execs);
+}
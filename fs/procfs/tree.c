@@ -35,24 +35,72 @@ typedef int (*rdlink_func_t)(char* ptr, size_t max, endpoint_t user_endpt);
 /* slot == NR_TASKS + proc_nr */
 static int slot_in_use(int slot) { return !(proc[slot].state & PST_FREE_SLOT); }
 
-static int update_proc_table() { return get_proctab(proc); }
+/* generations of the snapshots above */
+static int tables_valid = FALSE;
+static unsigned int proc_gen, pmproc_gen;
+
+static int update_proc_table()
+{
+    unsigned int gen = get_proctab_gen();
+    int retval;
+
+    /* read the generation first so a change during the copy is seen next
+     * time */
+    if (tables_valid && gen == proc_gen) return 0;
+
+    if ((retval = get_proctab(proc)) != 0) return retval;
+    proc_gen = gen;
+
+    return 0;
+}
 
 static int update_pmproc_table()
 {
-    return pm_getinfo(PM_INFO_PROCTAB, pmproc, sizeof(pmproc));
+    unsigned int gen;
+    int retval;
+
+    if ((retval = pm_getinfo(PM_INFO_PROCTAB_GEN, &gen, sizeof(gen))) != 0)
+        return retval;
+
+    if (tables_valid && gen == pmproc_gen) return 0;
+
+    if ((retval = pm_getinfo(PM_INFO_PROCTAB, pmproc, sizeof(pmproc))) != 0)
+        return retval;
+    pmproc_gen = gen;
+
+    return 0;
 }
 
+/* Refetch the kernel and PM process tables if a process has been created,
+ * has exited or has changed since the last snapshot. */
 static int update_tables()
 {
     int retval;
 
     if ((retval = update_proc_table()) != 0) return retval;
 
-    if ((retval = update_pmproc_table()) != 0) return retval;
+    if ((retval = update_pmproc_table()) != 0) {
+        tables_valid = FALSE;
+        return retval;
+    }
+
+    tables_valid = TRUE;
 
     return 0;
 }
 
+/* Refresh the kernel part of one process which changes on every tick. */
+int update_proc_slot(int slot)
+{
+    int retval;
+
+    if ((retval = update_tables()) != 0) return retval;
+
+    if (!slot_in_use(slot)) return ESRCH;
+
+    return get_proc(slot - NR_TASKS, &proc[slot]);
+}
+
 static void make_stat(struct memfs_stat* stat, int slot, int index)
 {
     if (index == NO_INDEX)
@@ -146,16 +194,7 @@ static void build_pid_entries(struct memfs_inode* pin, const char* name)
 int procfs_lookup_hook(struct memfs_inode* parent, const char* name,
                        cbdata_t data)
 {
-    static clock_t last_update = 0;
-
-    clock_t now;
-    get_ticks(&now, NULL);
-
-    if (last_update != now) {
-        update_tables();
-
-        last_update = now;
-    }
+    update_tables();
 
     if (parent == memfs_get_root_inode()) {
         build_pid_dirs();
@@ -3,6 +3,13 @@
 
 #define TMPFS_ROOT_INODE 1
 
+/* file data is allocated 1 << TMPFS_EXTENT_ORDER pages at a time */
+#define TMPFS_EXTENT_ORDER 4
+#define TMPFS_EXTENT_PAGES (1 << TMPFS_EXTENT_ORDER)
+#define TMPFS_EXTENT_SHIFT (ARCH_PG_SHIFT + TMPFS_EXTENT_ORDER)
+#define TMPFS_EXTENT_SIZE  (1UL << TMPFS_EXTENT_SHIFT)
+#define TMPFS_EXTENT_MASK  (TMPFS_EXTENT_SIZE - 1)
+
 /* tmpfs_search_dir() flags */
 #define SD_LOOK_UP  0 /* tells search_dir to lookup string */
 #define SD_MAKE     1 /* tells search_dir to make dir entry */
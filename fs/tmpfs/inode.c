@@ -22,6 +22,7 @@
 #include <string.h>
 #include <lyos/list.h>
 #include <lyos/sysutils.h>
+#include <lyos/vm.h>
 #include <sys/mman.h>
 #include <sys/stat.h>
 #include <asm/page.h>
@@ -38,6 +39,14 @@
 
 static struct list_head tmpfs_inode_table[TMPFS_INODE_HASH_SIZE];
 
+/* Extents released while clients still had them mapped. */
+struct deferred_extent {
+    struct list_head list;
+    char* extent;
+};
+
+static DEF_LIST(deferred_extents);
+
 void init_inode(void)
 {
     int i;
@@ -97,11 +106,62 @@ struct tmpfs_inode* tmpfs_get_inode(dev_t dev, ino_t num)
     return pin;
 }
 
+static int extent_remapped(char* extent)
+{
+    struct mm_region_info info;
+
+    if (mm_get_regioninfo(SELF, extent, &info) != 0) return FALSE;
+
+    return info.remaps > 0;
+}
+
+/* Unmap the deferred extents that are no longer mapped by any client. */
+static void reap_extents(void)
+{
+    struct deferred_extent *de, *tmp;
+
+    list_for_each_entry_safe(de, tmp, &deferred_extents, list)
+    {
+        if (extent_remapped(de->extent)) continue;
+
+        munmap(de->extent, TMPFS_EXTENT_SIZE);
+        list_del(&de->list);
+        free(de);
+    }
+}
+
+static void release_extent(char* extent)
+{
+    struct deferred_extent* de;
+
+    reap_extents();
+
+    if (!extent_remapped(extent)) {
+        munmap(extent, TMPFS_EXTENT_SIZE);
+        return;
+    }
+
+    /* a client still maps the pages, unmapping them here would leave it
+     * with a mapping that faults; keep them until it is gone (or forever
+     * if we can't even remember them) */
+    if (!(de = malloc(sizeof(*de)))) return;
+
+    de->extent = extent;
+    list_add(&de->list, &deferred_extents);
+}
+
 static void free_inode(struct tmpfs_inode* pin)
 {
-    if (pin->nr_pages) {
-        free(pin->pages);
-        pin->pages = NULL;
+    int i;
+
+    /* extents may be left past the end of file by mappings */
+    for (i = 0; i < pin->nr_extents; i++) {
+        if (pin->extents[i]) release_extent(pin->extents[i]);
+    }
+
+    if (pin->nr_extents) {
+        free(pin->extents);
+        pin->extents = NULL;
     }
 
     free(pin);
@@ -196,93 +256,111 @@ int tmpfs_putinode(dev_t dev, ino_t num, unsigned int count)
     return 0;
 }
 
-int tmpfs_inode_getpage(struct tmpfs_inode* pin, unsigned int index,
-                        char** page)
+int tmpfs_inode_getextent(struct tmpfs_inode* pin, unsigned int index,
+                          char** extent)
 {
-    char** new_pages;
-    char* new_page;
-    size_t page_count;
+    char** new_extents;
+    char* new_extent;
+    size_t extent_count;
 
-    page_count = pin->nr_pages;
-    while (index >= page_count) {
-        page_count = (page_count + 3) * 2;
+    extent_count = pin->nr_extents;
+    while (index >= extent_count) {
+        extent_count = (extent_count + 3) * 2;
     }
 
-    if (page_count > pin->nr_pages) {
-        new_pages = realloc(pin->pages, sizeof(*pin->pages) * page_count);
-        if (!new_pages) return ENOMEM;
+    if (extent_count > pin->nr_extents) {
+        new_extents =
+            realloc(pin->extents, sizeof(*pin->extents) * extent_count);
+        if (!new_extents) return ENOMEM;
 
-        memset(&new_pages[pin->nr_pages], 0,
-               sizeof(*pin->pages) * (page_count - pin->nr_pages));
-        pin->nr_pages = page_count;
-        pin->pages = new_pages;
+        memset(&new_extents[pin->nr_extents], 0,
+               sizeof(*pin->extents) * (extent_count - pin->nr_extents));
+        pin->nr_extents = extent_count;
+        pin->extents = new_extents;
     }
 
-    *page = pin->pages[index];
-    if (*page) return 0;
+    *extent = pin->extents[index];
+    if (*extent) return 0;
 
-    new_page = mmap(0, ARCH_PG_SIZE, PROT_READ | PROT_WRITE,
-                    MAP_POPULATE | MAP_ANONYMOUS | MAP_PRIVATE, -1, 0);
-    if (new_page == MAP_FAILED) return ENOMEM;
+    reap_extents();
 
-    memset(new_page, 0, ARCH_PG_SIZE);
+    /* MM zero-fills the pages as they are touched */
+    new_extent = mmap(0, TMPFS_EXTENT_SIZE, PROT_READ | PROT_WRITE,
+                      MAP_ANONYMOUS | MAP_SHARED, -1, 0);
+    if (new_extent == MAP_FAILED) return ENOMEM;
 
-    pin->pages[index] = new_page;
-    *page = new_page;
+    pin->extents[index] = new_extent;
+    *extent = new_extent;
 
     return 0;
 }
 
-static void zero_range(struct tmpfs_inode* pin, loff_t pos, size_t len)
+int tmpfs_inode_getpage(struct tmpfs_inode* pin, unsigned int index,
+                        char** page)
 {
-    unsigned int index;
-    off_t offset;
-    char* page;
+    char* extent;
+    int retval;
+
+    retval = tmpfs_inode_getextent(pin, index >> TMPFS_EXTENT_ORDER, &extent);
+    if (retval) return retval;
+
+    *page = &extent[(index & (TMPFS_EXTENT_PAGES - 1)) << ARCH_PG_SHIFT];
+    return 0;
+}
 
-    index = pos >> ARCH_PG_SHIFT;
+static void zero_range(struct tmpfs_inode* pin, loff_t start, loff_t end)
+{
+    unsigned int index;
+    loff_t ext_start;
+    size_t offset, len;
 
-    if (!len) return;
-    if (index >= pin->nr_pages || !pin->pages[index]) return;
+    for (index = start >> TMPFS_EXTENT_SHIFT; index < pin->nr_extents;
+         index++) {
+        ext_start = (loff_t)index << TMPFS_EXTENT_SHIFT;
+        if (ext_start >= end) break;
+        if (!pin->extents[index]) continue;
 
-    page = pin->pages[index];
-    offset = pos % ARCH_PG_SIZE;
-    assert(offset + len <= ARCH_PG_SIZE);
+        offset = start > ext_start ? start - ext_start : 0;
+        len = min(end - ext_start, (loff_t)TMPFS_EXTENT_SIZE) - offset;
 
-    memset(&page[offset], 0, len);
+        memset(&pin->extents[index][offset], 0, len);
+    }
 }
 
 int tmpfs_free_range(struct tmpfs_inode* pin, loff_t start, loff_t end)
 {
-    int zero_first, zero_last;
-    unsigned int start_index, end_index;
+    unsigned int index, end_index;
 
-    if (pin->nr_pages == 0) return 0;
+    if (pin->nr_extents == 0) return 0;
 
     if (end > pin->size) end = pin->size;
     if (end <= start) return EINVAL;
 
-    zero_first = start % ARCH_PG_SIZE;
-    zero_last = end % ARCH_PG_SIZE && end < pin->size;
-    if (start >> ARCH_PG_SHIFT == (end - 1) >> ARCH_PG_SHIFT &&
-        (zero_last || zero_first))
-        zero_range(pin, start, end - start);
-    else {
-        if (zero_first)
-            zero_range(pin, start, ARCH_PG_SIZE - (start % ARCH_PG_SIZE));
-        if (zero_last)
-            zero_range(pin, end - (end % ARCH_PG_SIZE), end % ARCH_PG_SIZE);
-
-        start_index = (start + ARCH_PG_SIZE - 1) >> ARCH_PG_SHIFT;
-        end_index = end >> ARCH_PG_SHIFT;
-
-        if (end_index > pin->nr_pages) end_index = pin->nr_pages;
-
-        for (; start_index < end_index; start_index++) {
-            if (pin->pages[start_index]) {
-                munmap(pin->pages[start_index], ARCH_PG_SIZE);
-                pin->pages[start_index] = NULL;
-            }
+    /* mappings may have left data past the end of file */
+    if (end == pin->size) end = (loff_t)pin->nr_extents << TMPFS_EXTENT_SHIFT;
+
+    index = (start + TMPFS_EXTENT_SIZE - 1) >> TMPFS_EXTENT_SHIFT;
+    end_index = end >> TMPFS_EXTENT_SHIFT;
+
+    /* clear the partial extents at both ends, release the whole ones */
+    zero_range(pin, start, min(end, (loff_t)index << TMPFS_EXTENT_SHIFT));
+    if (index < end_index)
+        zero_range(pin, (loff_t)end_index << TMPFS_EXTENT_SHIFT, end);
+
+    if (end_index > pin->nr_extents) end_index = pin->nr_extents;
+
+    for (; index < end_index; index++) {
+        if (!pin->extents[index]) continue;
+
+        /* a mapped extent stays with the file so that the mapping and the
+         * file still share the pages when it grows again */
+        if (extent_remapped(pin->extents[index])) {
+            memset(pin->extents[index], 0, TMPFS_EXTENT_SIZE);
+            continue;
         }
+
+        munmap(pin->extents[index], TMPFS_EXTENT_SIZE);
+        pin->extents[index] = NULL;
     }
 
     pin->update |= CTIME | MTIME;
@@ -300,8 +378,7 @@ int tmpfs_truncate_inode(struct tmpfs_inode* pin, off_t new_size)
         if (retval) return retval;
     }
 
-    if (new_size > pin->size)
-        zero_range(pin, pin->size, ARCH_PG_SIZE - (pin->size % ARCH_PG_SIZE));
+    if (new_size > pin->size) zero_range(pin, pin->size, new_size);
 
     pin->size = new_size;
     pin->update |= CTIME | MTIME;
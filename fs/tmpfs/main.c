@@ -51,6 +51,7 @@ struct fsdriver tmpfs_driver = {
     .fs_getdents = tmpfs_getdents,
     .fs_utime = tmpfs_utime,
     .fs_ftrunc = tmpfs_ftrunc,
+    .fs_map = tmpfs_map,
 };
 
 static int tmpfs_mountpoint(dev_t dev, ino_t num)
@@ -77,6 +78,7 @@ static int init_tmpfs(void)
     printl("tmpfs: Tmpfs driver is running.\n");
 
     init_inode();
+    init_dentry();
 
     return 0;
 }
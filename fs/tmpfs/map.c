@@ -0,0 +1,119 @@
+/*  This file is part of Lyos.
+
+    Lyos is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Lyos is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Lyos.  If not, see <http://www.gnu.org/licenses/>. */
+
+#include <lyos/types.h>
+#include <lyos/ipc.h>
+#include <errno.h>
+#include <lyos/const.h>
+#include <lyos/sysutils.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <asm/page.h>
+
+#include <libfsdriver/libfsdriver.h>
+
+#include "const.h"
+#include "types.h"
+#include "proto.h"
+
+static void* remap_extent(endpoint_t endpoint, void* vaddr, char* extent,
+                          size_t len)
+{
+    void* addr;
+
+    addr = mm_remap(endpoint, SELF, vaddr, extent, len);
+    if (addr == MAP_FAILED && vaddr)
+        addr = mm_remap(endpoint, SELF, NULL, extent, len);
+
+    return addr;
+}
+
+/* Map the pages of a regular file into endpoint. The client shares the
+ * extents with us so writes on either side are seen by the other without
+ * going through the page cache. */
+int tmpfs_map(dev_t dev, ino_t num, endpoint_t endpoint, void** vaddr,
+              loff_t offset, size_t length)
+{
+    struct tmpfs_inode* pin;
+    unsigned int index, first, last;
+    char* extent;
+    char *base, *addr;
+    size_t chunk, done;
+    int retval = 0;
+
+    if ((offset & (ARCH_PG_SIZE - 1)) || !length) return EINVAL;
+    length = roundup(length, ARCH_PG_SIZE);
+
+    pin = tmpfs_get_inode(dev, num);
+    if (!pin) return EINVAL;
+
+    if (!S_ISREG(pin->mode)) {
+        retval = EINVAL;
+        goto out;
+    }
+
+    first = offset >> TMPFS_EXTENT_SHIFT;
+    last = (offset + length - 1) >> TMPFS_EXTENT_SHIFT;
+
+    for (index = first; index <= last; index++) {
+        retval = tmpfs_inode_getextent(pin, index, &extent);
+        if (retval) goto out;
+    }
+
+    if (first == last) {
+        addr = remap_extent(endpoint, *vaddr,
+                            &pin->extents[first][offset & TMPFS_EXTENT_MASK],
+                            length);
+        if (addr == MAP_FAILED) {
+            retval = ENOMEM;
+            goto out;
+        }
+
+        *vaddr = addr;
+        goto out;
+    }
+
+    /* the extents are not contiguous here, so find a hole in the client
+     * large enough for all of them and remap them one by one */
+    base = mmap_for(endpoint, *vaddr, length, PROT_READ,
+                    MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (base == MAP_FAILED) {
+        retval = ENOMEM;
+        goto out;
+    }
+    munmap_for(endpoint, base, length);
+
+    for (done = 0; done < length; done += chunk) {
+        loff_t pos = offset + done;
+
+        index = pos >> TMPFS_EXTENT_SHIFT;
+        chunk = min(TMPFS_EXTENT_SIZE - (pos & TMPFS_EXTENT_MASK),
+                    length - done);
+
+        addr = mm_remap(endpoint, SELF, base + done,
+                        &pin->extents[index][pos & TMPFS_EXTENT_MASK], chunk);
+        if (addr == MAP_FAILED) {
+            if (done) munmap_for(endpoint, base, done);
+            retval = ENOMEM;
+            goto out;
+        }
+    }
+
+    *vaddr = base;
+
+out:
+    tmpfs_put_inode(pin);
+    return retval;
+}
@@ -29,7 +29,35 @@
 
 #define BOGO_DIRENT_SIZE 20
 
-static inline struct tmpfs_dentry* alloc_dentry(const char* name,
+#define TMPFS_DENTRY_HASH_LOG2 9
+#define TMPFS_DENTRY_HASH_SIZE ((unsigned long)1 << TMPFS_DENTRY_HASH_LOG2)
+#define TMPFS_DENTRY_HASH_MASK (TMPFS_DENTRY_HASH_SIZE - 1)
+
+/* dentries of all directories hashed by (directory, name) */
+static struct list_head tmpfs_dentry_table[TMPFS_DENTRY_HASH_SIZE];
+
+void init_dentry(void)
+{
+    int i;
+    for (i = 0; i < TMPFS_DENTRY_HASH_SIZE; i++) {
+        INIT_LIST_HEAD(&tmpfs_dentry_table[i]);
+    }
+}
+
+static unsigned int tmpfs_dentry_gethash(struct tmpfs_inode* dir_pin,
+                                         const char* name)
+{
+    unsigned long hash = (unsigned long)dir_pin->num;
+
+    while (*name) {
+        hash = (hash << 5) + hash + (unsigned char)*name++;
+    }
+
+    return (hash ^ (hash >> TMPFS_DENTRY_HASH_LOG2)) & TMPFS_DENTRY_HASH_MASK;
+}
+
+static inline struct tmpfs_dentry* alloc_dentry(struct tmpfs_inode* dir_pin,
+                                                const char* name,
                                                 struct tmpfs_inode* pin)
 {
     struct tmpfs_dentry* dp;
@@ -39,12 +67,33 @@ static inline struct tmpfs_dentry* alloc_dentry(const char* name,
 
     strlcpy(dp->name, name, sizeof(dp->name));
     dp->inode = pin;
+    dp->dir = dir_pin;
     INIT_LIST_HEAD(&dp->list);
+    list_add(&dp->hash,
+             &tmpfs_dentry_table[tmpfs_dentry_gethash(dir_pin, dp->name)]);
 
     return dp;
 }
 
-static inline void free_dentry(struct tmpfs_dentry* dp) { free(dp); }
+static inline void free_dentry(struct tmpfs_dentry* dp)
+{
+    list_del(&dp->hash);
+    free(dp);
+}
+
+static struct tmpfs_dentry* find_dentry(struct tmpfs_inode* dir_pin,
+                                        const char* name)
+{
+    unsigned int hash = tmpfs_dentry_gethash(dir_pin, name);
+    struct tmpfs_dentry* dp;
+
+    list_for_each_entry(dp, &tmpfs_dentry_table[hash], hash)
+    {
+        if (dp->dir == dir_pin && !strcmp(dp->name, name)) return dp;
+    }
+
+    return NULL;
+}
 
 int tmpfs_advance(struct tmpfs_inode* parent, const char* name,
                   struct tmpfs_inode** ppin)
@@ -68,47 +117,47 @@ int tmpfs_advance(struct tmpfs_inode* parent, const char* name,
 int tmpfs_search_dir(struct tmpfs_inode* dir_pin, const char* string,
                      struct tmpfs_inode** ppin, int flag)
 {
-    struct tmpfs_dentry *dp, *tmp;
-    int match;
-    int retval = 0;
+    struct tmpfs_dentry* dp;
 
     if (!S_ISDIR(dir_pin->mode)) return ENOTDIR;
 
-    list_for_each_entry_safe(dp, tmp, &dir_pin->children, list)
-    {
-        match = 0;
-
-        if (flag != SD_MAKE) {
-            if (flag == SD_IS_EMPTY)
-                match = strcmp(dp->name, ".") && strcmp(dp->name, "..");
-            else
-                match = !strcmp(dp->name, string);
+    if (flag == SD_IS_EMPTY) {
+        list_for_each_entry(dp, &dir_pin->children, list)
+        {
+            if (strcmp(dp->name, ".") && strcmp(dp->name, ".."))
+                return ENOTEMPTY;
         }
 
-        retval = 0;
-        if (match) {
-            if (flag == SD_IS_EMPTY)
-                retval = ENOTEMPTY;
-            else if (flag == SD_DELETE) {
-                list_del(&dp->list);
-                free_dentry(dp);
-
-                dir_pin->size -= BOGO_DIRENT_SIZE;
-                dir_pin->update |= CTIME | MTIME;
-            } else {
-                *ppin = dp->inode;
-            }
-
-            return retval;
-        }
+        return 0;
     }
 
-    if (flag != SD_MAKE) return flag == SD_IS_EMPTY ? 0 : ENOENT;
+    dp = find_dentry(dir_pin, string);
+
+    switch (flag) {
+    case SD_LOOK_UP:
+        if (!dp) return ENOENT;
+
+        *ppin = dp->inode;
+        return 0;
 
-    dp = alloc_dentry(string, *ppin);
-    list_add(&dp->list, &dir_pin->children);
+    case SD_DELETE:
+        if (!dp) return ENOENT;
+
+        list_del(&dp->list);
+        free_dentry(dp);
+        break;
+
+    case SD_MAKE:
+        if (!(dp = alloc_dentry(dir_pin, string, *ppin))) return ENOMEM;
+
+        list_add(&dp->list, &dir_pin->children);
+        break;
+    }
 
-    dir_pin->size += BOGO_DIRENT_SIZE;
+    if (flag == SD_MAKE)
+        dir_pin->size += BOGO_DIRENT_SIZE;
+    else
+        dir_pin->size -= BOGO_DIRENT_SIZE;
     dir_pin->update |= CTIME | MTIME;
 
     return 0;
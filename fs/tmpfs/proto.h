@@ -16,6 +16,8 @@ int tmpfs_putinode(dev_t dev, ino_t num, unsigned int count);
 int tmpfs_new_inode(struct tmpfs_inode* dir_pin, const char* pathname,
                     mode_t mode, uid_t uid, gid_t gid,
                     struct tmpfs_inode** ppin);
+int tmpfs_inode_getextent(struct tmpfs_inode* pin, unsigned int index,
+                          char** extent);
 int tmpfs_inode_getpage(struct tmpfs_inode* pin, unsigned int index,
                         char** page);
 int tmpfs_free_range(struct tmpfs_inode* pin, loff_t start, loff_t end);
@@ -24,7 +26,8 @@ int tmpfs_truncate_inode(struct tmpfs_inode* pin, off_t new_size);
 /* stat.c */
 int tmpfs_stat(dev_t dev, ino_t num, struct fsdriver_data* data);
 
-/* lookup.c */
+/* path.c */
+void init_dentry(void);
 int tmpfs_lookup(dev_t dev, ino_t start, const char* name,
                  struct fsdriver_node* fn, int* is_mountpoint);
 int tmpfs_advance(struct tmpfs_inode* parent, const char* name,
@@ -40,6 +43,10 @@ ssize_t tmpfs_write(dev_t dev, ino_t num, struct fsdriver_data* data,
 ssize_t tmpfs_getdents(dev_t dev, ino_t num, struct fsdriver_data* data,
                        loff_t* ppos, size_t count);
 
+/* map.c */
+int tmpfs_map(dev_t dev, ino_t num, endpoint_t endpoint, void** vaddr,
+              loff_t offset, size_t length);
+
 /* open.c */
 int tmpfs_create(dev_t dev, ino_t dir_num, const char* name, mode_t mode,
                  uid_t uid, gid_t gid, struct fsdriver_node* fn);
@@ -34,16 +34,34 @@ static ssize_t rw_chunk(struct tmpfs_inode* pin, loff_t position, size_t chunk,
                         off_t offset, int rw_flag, struct fsdriver_data* data,
                         off_t data_offset)
 {
-    char* page;
+    static char zero_page[ARCH_PG_SIZE];
+    unsigned int index = position >> TMPFS_EXTENT_SHIFT;
+    char* extent;
+    size_t len;
     ssize_t retval;
 
-    retval = tmpfs_inode_getpage(pin, offset >> ARCH_PG_SHIFT, &page);
+    /* don't allocate anything for reads from holes */
+    if (rw_flag == READ &&
+        (index >= pin->nr_extents || !pin->extents[index])) {
+        while (chunk > 0) {
+            len = min(chunk, ARCH_PG_SIZE);
+            retval = fsdriver_copyout(data, data_offset, zero_page, len);
+            if (retval) return retval;
+
+            data_offset += len;
+            chunk -= len;
+        }
+
+        return 0;
+    }
+
+    retval = tmpfs_inode_getextent(pin, index, &extent);
     if (retval) return retval;
 
     if (rw_flag == READ)
-        retval = fsdriver_copyout(data, data_offset, &page[offset], chunk);
+        retval = fsdriver_copyout(data, data_offset, &extent[offset], chunk);
     else
-        retval = fsdriver_copyin(data, data_offset, &page[offset], chunk);
+        retval = fsdriver_copyin(data, data_offset, &extent[offset], chunk);
 
     return retval;
 }
@@ -67,8 +85,8 @@ static ssize_t tmpfs_rdwt(dev_t dev, ino_t num, int rw_flag,
     bytes_rdwt = 0;
 
     while (nbytes > 0) {
-        offset = pos % ARCH_PG_SIZE;
-        chunk = min(ARCH_PG_SIZE - offset, nbytes);
+        offset = pos & TMPFS_EXTENT_MASK;
+        chunk = min(TMPFS_EXTENT_SIZE - offset, nbytes);
         eof = 0;
 
         if (rw_flag == READ) {
@@ -30,14 +30,18 @@ struct tmpfs_inode {
 
     struct list_head children;
 
-    char** pages;
-    size_t nr_pages;
+    /* file data in TMPFS_EXTENT_SIZE chunks of shared anonymous memory so
+     * that they can be remapped into clients */
+    char** extents;
+    size_t nr_extents;
 
     unsigned int mountpoint : 1;
 };
 
 struct tmpfs_dentry {
     struct list_head list;
+    struct list_head hash;
+    struct tmpfs_inode* dir;
     char name[NAME_MAX];
     struct tmpfs_inode* inode;
 };
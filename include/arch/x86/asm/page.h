@@ -125,10 +125,16 @@ extern unsigned long va_pa_offset;
 #define I386_CR0_WP 0x00010000 /* Enable paging */
 #define I386_CR0_PG 0x80000000 /* Enable paging */
 
-#define I386_CR4_PSE 0x00000010 /* Page size extensions */
-#define I386_CR4_PAE 0x00000020 /* Physical addr extens. */
-#define I386_CR4_MCE 0x00000040 /* Machine check enable */
-#define I386_CR4_PGE 0x00000080 /* Global page flag enable */
+#define I386_CR4_PSE   0x00000010 /* Page size extensions */
+#define I386_CR4_PAE   0x00000020 /* Physical addr extens. */
+#define I386_CR4_MCE   0x00000040 /* Machine check enable */
+#define I386_CR4_PGE   0x00000080 /* Global page flag enable */
+#define I386_CR4_PCIDE 0x00020000 /* Process-context identifiers */
+
+#define X86_CR3_PCID_MASK 0xfffUL /* PCID of the loaded cr3 */
+#ifdef CONFIG_X86_64
+#define X86_CR3_NOFLUSH (1UL << 63) /* keep the PCID's translations */
+#endif
 
 #define I386_PF_PROT(x)   ((x)&I386_PG_PRESENT)
 #define I386_PF_NOPAGE(x) (!I386_PF_PROT(x))
@@ -116,6 +116,24 @@ static inline int pmde_large(pmd_t pmde)
            (ARCH_PG_PRESENT | ARCH_PG_BIGPAGE);
 }
 
+/* A PMD entry can map a big page directly. */
+#define ARCH_HAS_HUGE_PMD 1
+
+static inline pmd_t pfn_pmd_large(unsigned long pfn, pgprot_t prot)
+{
+    return __pmd((pfn << ARCH_PG_SHIFT) | pgprot_val(prot) | ARCH_PG_BIGPAGE);
+}
+
+static inline unsigned long pmde_pfn(pmd_t pmde)
+{
+    return (pmd_val(pmde) & ~(ARCH_BIG_PAGE_SIZE - 1)) >> ARCH_PG_SHIFT;
+}
+
+static inline pgprot_t pmde_pgprot(pmd_t pmde)
+{
+    return __pgprot(pmd_val(pmde) & ~ARCH_PG_MASK & ~ARCH_PG_BIGPAGE);
+}
+
 static inline int pmde_none(pmd_t pmde) { return pmd_val(pmde) == 0; }
 
 static inline int pmde_bad(pmd_t pmde)
@@ -118,11 +118,19 @@ void disable_paging();
 unsigned long read_cr2();
 unsigned long read_cr3();
 void reload_cr3();
+void x86_invlpg(void* addr);
 void cut_memmap(kinfo_t* pk, phys_bytes start, phys_bytes end);
 void pg_map(phys_bytes phys_addr, void* vir_addr, void* vir_end, kinfo_t* pk);
 phys_bytes pg_alloc_pages(kinfo_t* pk, unsigned int nr_pages);
 phys_bytes pg_alloc_lowest(kinfo_t* pk, phys_bytes size);
 
+/* tlb.c */
+extern volatile unsigned int tlb_flush_gen;
+void tlb_init_cpu(void);
+void tlb_switch_address_space(phys_bytes cr3);
+void tlb_shootdown(phys_bytes cr3, vir_bytes start, vir_bytes end);
+void tlb_shootdown_int_handler(void);
+
 void clear_memcache();
 
 void arch_set_syscall_result(struct proc* p, int result);
@@ -1,19 +1,34 @@
 #ifndef _DRM_DRM_FRAMEBUFFER_H_
 #define _DRM_DRM_FRAMEBUFFER_H_
 
+#include <stdint.h>
 #include <lyos/list.h>
 #include <drm/drm_mode_object.h>
 
 struct drm_gem_object;
+struct drm_mode_fb_cmd2;
+struct drm_mode_rect;
 
 struct drm_framebuffer {
     struct list_head head;
     struct drm_mode_object base;
 
+    uint32_t format;
+    unsigned int width, height;
+    unsigned int pitches[4];
+    unsigned int offsets[4];
+
     struct drm_gem_object* obj[4];
 };
 
 int drm_framebuffer_init(struct drm_device* dev, struct drm_framebuffer* fb);
+void drm_helper_mode_fill_fb_struct(struct drm_framebuffer* fb,
+                                    const struct drm_mode_fb_cmd2* cmd);
+
+int drm_atomic_helper_dirtyfb(struct drm_device* dev,
+                              struct drm_framebuffer* fb,
+                              const struct drm_mode_rect* clips,
+                              unsigned int num_clips);
 
 #define obj_to_fb(x) list_entry(x, struct drm_framebuffer, base)
 static inline struct drm_framebuffer*
@@ -3,6 +3,7 @@
 
 #include <sys/types.h>
 #include <lyos/list.h>
+#include <drm/drm_mode.h>
 #include <drm/drm_mode_object.h>
 
 struct drm_device;
@@ -23,6 +24,19 @@ struct drm_plane_state {
 
     int crtc_x, crtc_y, crtc_w, crtc_h;
     int src_x, src_y, src_w, src_h;
+
+    /* Damaged areas of fb in framebuffer coordinates, only valid for the
+     * commit that sets them. No clips means the whole plane is damaged. */
+    const struct drm_mode_rect* fb_damage_clips;
+    unsigned int num_fb_damage_clips;
+};
+
+struct drm_atomic_helper_damage_iter {
+    struct drm_mode_rect plane_src;
+    const struct drm_mode_rect* clips;
+    unsigned int num_clips;
+    unsigned int curr_clip;
+    int full_update;
 };
 
 struct drm_plane_helper_funcs {
@@ -47,6 +61,16 @@ int drm_plane_init(struct drm_device* dev, struct drm_plane* plane,
 void drm_helper_commit_planes(struct drm_device* dev,
                               struct drm_atomic_state* old_state);
 
+void drm_atomic_helper_damage_iter_init(
+    struct drm_atomic_helper_damage_iter* iter,
+    const struct drm_plane_state* old_state,
+    const struct drm_plane_state* state);
+int drm_atomic_helper_damage_iter_next(
+    struct drm_atomic_helper_damage_iter* iter, struct drm_mode_rect* rect);
+int drm_atomic_helper_damage_merged(const struct drm_plane_state* old_state,
+                                    const struct drm_plane_state* state,
+                                    struct drm_mode_rect* rect);
+
 static inline void
 drm_plane_add_helper_funcs(struct drm_plane* plane,
                            struct drm_plane_helper_funcs* funcs)
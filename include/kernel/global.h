@@ -84,6 +84,9 @@ EXTERN struct proc* mmrequest; /* first proc in mm request queue */
 
 EXTERN int system_hz;
 
+/* bumped whenever a proc table slot is taken, freed or renamed */
+EXTERN unsigned int proc_table_gen;
+
 extern int err_code;
 
 extern struct sysinfo sysinfo;
@@ -107,8 +110,7 @@ extern struct kclockinfo kclockinfo;
 #if CONFIG_PROFILING
 #include <lyos/profile.h>
 
-EXTERN char profile_sample_buf[KPROF_SAMPLE_BUFSIZE];
 extern int kprofiling;
-EXTERN struct kprof_info kprof_info;
+extern int ipc_tracing;
 
 #endif
@@ -51,7 +51,6 @@
     0x001 /* set when we have to resume syscall execution */
 #define PF_TRACE_SYSCALL    0x002 /* syscall tracing */
 #define PF_LEAVE_SYSCALL    0x004 /* syscall tracing: leaving syscall */
-#define PF_PROFILE_RECORDED 0x008 /* recorded in the sample buffer */
 #define PF_RECV_ASYNC       0x010 /* proc can receive async message */
 #define PF_FPU_INITIALIZED  0x020 /* proc has used FPU */
 #define PF_DELIVER_MSG      0x040 /* copy message before resuming */
@@ -172,6 +171,13 @@ struct proc {
     clock_t user_time; /* user time in ticks */
     clock_t sys_time;  /* sys time in ticks */
 
+#if CONFIG_PROFILING
+    u64 ipc_send_ts; /* when the pending send was queued */
+    u64 ipc_call_ts; /* when the pending sendrec(BOTH) started */
+    endpoint_t ipc_call_dest;
+    int ipc_call_type;
+#endif
+
     struct {
         struct proc* next_request;
 
@@ -73,6 +73,8 @@ void setup_local_timer_one_shot(void);
 void setup_local_timer_periodic(void);
 void restart_local_timer(void);
 void stop_local_timer(void);
+void program_local_timer(struct proc* p);
+u64 clock_get_ns(void);
 
 /* proc.c */
 void init_proc();
@@ -88,6 +90,7 @@ void dump_proc(struct proc* p);
 int send_recv(int function, int src_dest, MESSAGE* msg);
 void enqueue_proc(struct proc* p);
 void dequeue_proc(struct proc* p);
+int sched_queue_empty(void);
 void copr_not_available_handler(void);
 void release_fpu(struct proc* p);
 
@@ -98,13 +101,41 @@ void init_sched();
 #if CONFIG_PROFILING
 void init_profile_clock(u32 freq);
 void stop_profile_clock();
-void nmi_profile_handler(int in_kernel, void* pc);
+void nmi_profile_handler(int in_kernel, void* pc, reg_t fp);
+void profile_reset(void);
+int profile_drain(endpoint_t endpt, void* buf, size_t size,
+                  struct kprof_info* info);
+int arch_get_callchain(struct proc* p, int in_kernel, reg_t fp, void** chain,
+                       int max_depth);
+#endif
+
+/* ipctrace.c */
+#if CONFIG_PROFILING
+void ipctrace_block(struct proc* sender);
+void ipctrace_call(struct proc* sender, endpoint_t dest, int type);
+void ipctrace_deliver(struct proc* sender, struct proc* receiver, int type,
+                      int blocked);
+void ipctrace_notify(struct proc* sender, struct proc* receiver, int pending);
+void ipctrace_async(struct proc* sender, struct proc* receiver, int type,
+                    int pending);
+void ipctrace_reset(void);
+int ipctrace_drain(endpoint_t endpt, void* buf, size_t size,
+                   struct kprof_ipc_info* info);
+
+#define IPCTRACE(call)                    \
+    do {                                  \
+        if (ipc_tracing) ipctrace_##call; \
+    } while (0)
+#else
+#define IPCTRACE(call) \
+    do {               \
+    } while (0)
 #endif
 
 /* watchdog.c */
 int init_profile_nmi(unsigned int freq);
 void stop_profile_nmi(void);
-void nmi_watchdog_handler(int in_kernel, void* pc);
+void nmi_watchdog_handler(int in_kernel, void* pc, reg_t fp);
 
 /* direct_tty.c */
 void direct_put_str(const char* str);
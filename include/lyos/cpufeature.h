@@ -23,6 +23,7 @@
 #define _CPUF_I386_HAS_X2APIC   19 /* Supports X2APIC */
 #define _CPUF_I386_GBPAGES      20
 #define _CPUF_I386_XSAVE        21 /* XSAVE, XRESTOR, XSETBV, XGETBV */
+#define _CPUF_I386_PCID         22 /* Process-context identifiers */
 
 /* CPUID flags */
 #define CPUID1_EDX_FPU          (1L)       /* FPU presence */
@@ -37,6 +38,7 @@
 #define CPUID1_EDX_SSE2         (1L << 26)
 #define CPUID1_ECX_SSE3         (1L)
 #define CPUID1_ECX_SSSE3        (1L << 9)
+#define CPUID1_ECX_PCID         (1L << 17)
 #define CPUID1_ECX_SSE4_1       (1L << 19)
 #define CPUID1_ECX_SSE4_2       (1L << 20)
 #define CPUID1_ECX_X2APIC       (1L << 21)
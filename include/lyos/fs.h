@@ -66,6 +66,7 @@
 #define MMROFFSET    u.m3.m3l1
 #define MMRLENGTH    u.m3.m3l2
 #define MMRMODE      u.m3.m3l2
+#define MMRACCESS    u.m3.m3l2 /* R_BIT/W_BIT the mapping needs on lookup */
 #define MMRBUF       u.m3.m3p1
 
 #define RET_RETVAL   u.m5.m5i1
@@ -78,8 +79,9 @@
 #define RET_SPECDEV  u.m5.m5i8
 
 #define MS_READONLY 0x001
-#define RF_READONLY 0x001
-#define RF_ISROOT   0x002
+#define RF_READONLY  0x001
+#define RF_ISROOT    0x002
+#define RF_PAGECACHE 0x004 /* reply: regular file data may be page cached */
 
 /* User credential info */
 struct vfs_ucred {
@@ -35,6 +35,7 @@ struct priv {
     int kernlog_request;
 
     struct timer_list timer;
+    struct hrtimer hrtimer;
 
     void* async_table;
     size_t async_len;
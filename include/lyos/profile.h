@@ -21,15 +21,29 @@
 #include <lyos/const.h>
 
 #define KPROF_SAMPLE_BUFSIZE (4 << 20)
+#define KPROF_MAX_DEPTH      32
 
 #define KPROF_START 1
 #define KPROF_STOP  2
+#define KPROF_DRAIN 3
+
+/* IPC tracing */
+#define KPROF_IPC_START 4
+#define KPROF_IPC_STOP  5
+#define KPROF_IPC_DRAIN 6
 
 #define KPROF_TYPE_PROC   ((u8)1)
 #define KPROF_TYPE_SAMPLE ((u8)2)
 
+/* Sample flags */
+#define KPROF_SAMPLE_USER 0x01 /* sampled in user mode */
+
+/* A sample record is followed by depth return addresses, innermost first. */
 struct kprof_sample {
     endpoint_t endpt;
+    u16 cpu;
+    u8 flags;
+    u8 depth;
     void* pc;
 };
 
@@ -39,6 +53,7 @@ struct kprof_info {
     int system_samples;
     int user_samples;
     int total_samples;
+    int dropped_samples;
 };
 
 struct kprof_proc {
@@ -46,6 +61,32 @@ struct kprof_proc {
     char name[PROC_NAME_LEN];
 };
 
+/* IPC trace events */
+#define KPROF_IPC_SEND   1 /* message delivered to the receiver */
+#define KPROF_IPC_NOTIFY 2 /* notification sent */
+#define KPROF_IPC_ASYNC  3 /* asynchronous message delivered */
+#define KPROF_IPC_CALL   4 /* sendrec(BOTH) got its reply */
+
+/* IPC trace flags */
+#define KPROF_IPC_BLOCKED 0x01 /* the message was not delivered immediately */
+
+struct kprof_ipc_record {
+    u64 timestamp; /* ns since tracing started */
+    u64 wait;      /* ns spent queued, or the round trip for calls */
+    endpoint_t src;
+    endpoint_t dest;
+    int type;
+    u16 cpu;
+    u8 event;
+    u8 flags;
+};
+
+struct kprof_ipc_info {
+    int mem_used;
+    int records;
+    int dropped;
+};
+
 int kprof(int action, size_t size, int freq, void* info, void* buf);
 
 #endif
@@ -38,6 +38,9 @@ int get_machine(struct machine* machine);
 int get_cpuinfo(struct cpu_info* cpuinfo);
 int get_proctab(struct proc* proc);
 int get_cputicks(unsigned int cpu, u64* ticks);
+void read_tsc_64(u64* v);
+unsigned int get_proctab_gen();
+int get_proc(int proc_nr, struct proc* proc);
 int privctl(int whom, int request, void* data);
 
 int data_copy(endpoint_t dest_ep, void* dest_addr, endpoint_t src_ep,
@@ -83,22 +86,30 @@ int get_ksig(endpoint_t* ep, sigset_t* set);
 int end_ksig(endpoint_t ep);
 
 int get_system_hz();
-#define BOOT_TICKS u.m3.m3l1
-#define IDLE_TICKS u.m3.m3l2
+#define BOOT_TICKS  u.m3.m3l1
+#define IDLE_TICKS  u.m3.m3l2
+#define TIMES_FLAGS u.m3.m3i1
+#define BOOT_NS     u.m3.m3l2 /* instead of IDLE_TICKS with TIMES_NS */
+#define TIMES_NS    0x1
 int get_ticks(clock_t* ticks, clock_t* idle_ticks);
+int get_uptime_ns(u64* ns);
 
 #define EXP_TIME  u.m3.m3l1
 #define ABS_TIME  u.m3.m3i2
 #define TIME_LEFT u.m3.m3l1
+#define ALARM_ABS 0x1 /* expire time is absolute */
+#define ALARM_NS  0x2 /* expire time is in ns of uptime */
 #define kernel_alarm(expire_time, abs_time) \
     kernel_alarm2(expire_time, abs_time, NULL)
 int kernel_alarm2(clock_t expire_time, int abs_time, clock_t* time_left);
+int kernel_alarm_ns(u64 expire_ns, int flags);
 
 u32 now();
 
 int kernel_trace(int request, endpoint_t endpoint, void* addr, void* data);
 
-#define PM_INFO_PROCTAB 1
+#define PM_INFO_PROCTAB     1
+#define PM_INFO_PROCTAB_GEN 2
 int pm_getinfo(int request, void* dest, int size);
 
 int kernel_kprofile(int action, size_t size, int freq, endpoint_t endpt,
@@ -106,6 +117,7 @@ int kernel_kprofile(int action, size_t size, int freq, endpoint_t endpt,
 
 void* mmap_for(endpoint_t forwhom, void* addr, size_t len, int prot, int flags,
                int fd, off_t offset);
+int munmap_for(endpoint_t forwhom, void* addr, size_t len);
 void* mm_remap(endpoint_t dest, endpoint_t src, void* dest_addr, void* src_addr,
                size_t size);
 
@@ -125,6 +137,28 @@ int copyfd(endpoint_t who, int fd, int how);
 #define COPYFD_CLOEXEC    0x1000
 #define COPYFD_FLAGS_MASK 0xf000
 
+#define VFS_INFO_PROCIO 1
+struct vfs_proc_io {
+    u64 rchar;  /* bytes read */
+    u64 wchar;  /* bytes written */
+    u64 syscr;  /* read calls */
+    u64 syscw;  /* write calls */
+};
+#define VFS_INFO_EXECSTAT 2
+struct vfs_exec_stat {
+    u64 execs;         /* successful execs */
+    u64 cache_hits;    /* header served from the exec cache */
+    u64 cache_misses;  /* header read from the file system */
+    u64 map_batches;   /* batched MM mapping requests */
+    u64 map_fallbacks; /* batches that fell back to copying */
+    u64 lookup_ns;     /* path resolution and stat */
+    u64 header_ns;     /* header read or cache lookup */
+    u64 load_ns;       /* segment loading and mapping */
+    u64 stack_ns;      /* initial stack setup */
+    u64 total_ns;
+};
+int vfs_getinfo(int request, endpoint_t who, void* dest, int size);
+
 int kernel_stime(time_t boot_time);
 
 #endif
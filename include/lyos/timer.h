@@ -16,6 +16,7 @@
 #ifndef _TIMER_H_
 #define _TIMER_H_
 
+#include <lyos/types.h>
 #include <lyos/list.h>
 
 struct timer_list;
@@ -31,6 +32,60 @@ struct timer_list {
 
 #define TIMER_UNSET ((clock_t)0xffffffff)
 
+/* Hierarchical timer wheel for timeouts in ticks. The first level has one
+ * slot per tick, every further level covers TVN_SIZE slots of the level
+ * below. */
+#define TVR_BITS   8
+#define TVN_BITS   6
+#define TVR_SIZE   (1 << TVR_BITS)
+#define TVN_SIZE   (1 << TVN_BITS)
+#define TVR_MASK   (TVR_SIZE - 1)
+#define TVN_MASK   (TVN_SIZE - 1)
+#define TVN_LEVELS 4
+
+struct timer_wheel {
+    clock_t clk; /* next tick to be processed */
+    int inited;
+    struct list_head tv1[TVR_SIZE];
+    struct list_head tvn[TVN_LEVELS][TVN_SIZE];
+};
+
+void timer_add(struct timer_wheel* wheel, struct timer_list* timer,
+               clock_t now);
+void timer_expire(struct timer_wheel* wheel, clock_t timestamp);
+clock_t timer_next_expiry(struct timer_wheel* wheel);
+
+/* High-resolution timers with deadlines in ns of uptime, kept in a
+ * pairing heap. */
+struct hrtimer;
+
+typedef void (*hrtimer_callback_t)(struct hrtimer* timer);
+
+struct hrtimer {
+    struct hrtimer* child;
+    struct hrtimer* sibling;
+    struct hrtimer* prev; /* parent if first child, else previous sibling */
+    u64 expires;
+    hrtimer_callback_t callback;
+    void* arg;
+};
+
+#define HRTIMER_UNSET ((u64)-1)
+
+struct hrtimer_queue {
+    struct hrtimer* root;
+};
+
+void hrtimer_init(struct hrtimer* timer);
+void hrtimer_enqueue(struct hrtimer_queue* queue, struct hrtimer* timer);
+int hrtimer_dequeue(struct hrtimer_queue* queue, struct hrtimer* timer);
+void hrtimer_expire(struct hrtimer_queue* queue, u64 now);
+
+static inline u64 hrtimer_next_expiry(struct hrtimer_queue* queue)
+{
+    return queue->root ? queue->root->expires : HRTIMER_UNSET;
+}
+
 void init_timer(struct timer_list* timer);
 void set_timer(struct timer_list* timer, clock_t ticks, timer_callback_t cb,
                void* arg);
@@ -38,9 +93,16 @@ int cancel_timer(struct timer_list* timer);
 void expire_timer(clock_t timestamp);
 clock_t timer_expires_remaining(struct timer_list* tp);
 
+void set_hrtimer(struct hrtimer* timer, u64 ns, hrtimer_callback_t cb,
+                 void* arg);
+int cancel_hrtimer(struct hrtimer* timer);
+u64 hrtimer_expires_remaining(struct hrtimer* timer);
+
 #ifdef __kernel__
 void set_sys_timer(struct timer_list* timer);
 void reset_sys_timer(struct timer_list* timer);
+void set_sys_hrtimer(struct hrtimer* timer);
+void reset_sys_hrtimer(struct hrtimer* timer);
 #endif
 
 #endif
@@ -45,6 +45,7 @@
 #define VMCTL_GETKPDBR       12
 #define VMCTL_SET_KADDRSPACE 13
 #endif
+#define VMCTL_FLUSHTLB_RANGE 14
 
 #define VMCTL_GET_KM_INDEX  u.m3.m3i2
 #define VMCTL_GET_KM_RETVAL u.m3.m3i2
@@ -62,6 +63,9 @@
 #define VMCTL_PHYS_ADDR u.m3.m3l1
 #define VMCTL_VIR_ADDR  u.m3.m3p1
 
+#define VMCTL_FLUSH_ADDR u.m3.m3p1
+#define VMCTL_FLUSH_LEN  u.m3.m3l2
+
 #define VMCTL_MMREQ_TARGET    u.m3.m3i1
 #define VMCTL_MMREQ_ADDR      u.m3.m3p1
 #define VMCTL_MMREQ_LEN       u.m3.m3i2
@@ -86,7 +90,12 @@
 #define KMF_EXEC  0x04
 #define KMF_IO    0x08
 
-#define MM_GET_MEMINFO 1
+#define MM_GET_MEMINFO    1
+#define MM_GET_REGIONINFO 2
+#define MM_GET_PROCINFO   3
+
+#define MM_GETINFO_WHO  u.m3.m3i4
+#define MM_GETINFO_ADDR u.m3.m3p1
 
 /* Fault flags */
 #define FAULT_FLAG_WRITE       0x1
@@ -102,6 +111,27 @@ struct mem_info {
     size_t vmalloc_used;
 };
 
+struct mm_region_info {
+    void* vaddr;
+    size_t length;
+    int remaps; /* number of shared mappings of this region */
+    size_t huge; /* bytes backed by big pages */
+
+    /* source of a shared mapping, NO_TASK if the region is not shared */
+    endpoint_t shared_endpoint;
+    void* shared_vaddr;
+};
+
+/* memory usage of a process, all sizes in bytes */
+struct mm_proc_info {
+    size_t vm_size;  /* total size of the mapped regions */
+    size_t resident; /* pages backed by physical memory */
+    size_t shared;   /* resident pages shared with other mappings */
+    size_t text;     /* executable regions */
+    size_t data;     /* writable regions */
+    size_t huge;     /* resident memory backed by big pages */
+};
+
 struct mm_fork_info {
     endpoint_t parent;
     int slot;
@@ -110,6 +140,22 @@ struct mm_fork_info {
     void* tls;
 };
 
+/* One file-backed segment of a batched VFS mapping request. */
+struct vfs_mmap_seg {
+    void* vaddr;
+    size_t len;
+    off_t offset;
+    int prot;
+    size_t clearend;
+};
+#define VFS_MMAP_BATCH_MAX 8
+
+/* Page cache requests from VFS */
+#define MMPC_READ 1 /* copy cached file data to a process */
+#define MMPC_FILL 2 /* add whole pages of file data read by VFS */
+#define MMPC_DROP 3 /* forget the cached pages of a file range */
+#define MMPC_DROP_DEV 4 /* forget the cached pages of a device */
+
 struct mm_map_phys_request {
     endpoint_t who;
     phys_bytes phys_addr;
@@ -131,9 +177,21 @@ int vmctl_get_mmrequest(endpoint_t* target, void** start, size_t* len,
                         int* flags, endpoint_t* caller);
 int vmctl_reply_mmreq(endpoint_t who, int result);
 int vmctl_flushtlb(endpoint_t who);
+int vmctl_flushtlb_range(unsigned long pgd_phys, void* addr, size_t len);
 int get_meminfo(struct mem_info* mem_info);
+int mm_get_regioninfo(endpoint_t who, void* addr, struct mm_region_info* info);
+int mm_get_procinfo(endpoint_t who, struct mm_proc_info* info);
 int vfs_mmap(endpoint_t who, off_t offset, size_t len, dev_t dev, ino_t ino,
              int fd, void* vaddr, int flags, int prot, size_t clearend);
+int vfs_mmap_batch(endpoint_t who, dev_t dev, ino_t ino, int fd, int flags,
+                   const struct vfs_mmap_seg* segs, int nr_segs);
+int mm_page_cache_read(dev_t dev, ino_t ino, u64 position, u64 size,
+                       endpoint_t endpoint, void* buf, size_t count,
+                       size_t* copied);
+int mm_page_cache_fill(dev_t dev, ino_t ino, u64 position, const void* buf,
+                       size_t count);
+int mm_page_cache_drop(dev_t dev, ino_t ino, u64 start, u64 end);
+int mm_page_cache_drop_dev(dev_t dev);
 
 #ifdef __aarch64__
 int vmctl_getkpdbr(endpoint_t who, unsigned long* kpdbr);
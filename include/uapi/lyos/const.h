@@ -68,6 +68,7 @@
 #define IPCF_FROMKERNEL 0x1
 #define IPCF_NONBLOCK   0x2
 #define IPCF_ASYNC      0x4
+#define IPCF_CALL       0x8 /* send half of sendrec(BOTH) */
 
 /* Get/set ID requests. */
 #define GS_GETUID    1
@@ -96,15 +97,17 @@
 #define PRIVCTL_ALLOW    2
 
 /* getinfo requests. */
-#define GETINFO_SYSINFO   1
-#define GETINFO_KINFO     2
-#define GETINFO_CMDLINE   3
-#define GETINFO_BOOTPROCS 4
-#define GETINFO_HZ        5
-#define GETINFO_MACHINE   6
-#define GETINFO_CPUINFO   7
-#define GETINFO_PROCTAB   8
-#define GETINFO_CPUTICKS  9
+#define GETINFO_SYSINFO     1
+#define GETINFO_KINFO       2
+#define GETINFO_CMDLINE     3
+#define GETINFO_BOOTPROCS   4
+#define GETINFO_HZ          5
+#define GETINFO_MACHINE     6
+#define GETINFO_CPUINFO     7
+#define GETINFO_PROCTAB     8
+#define GETINFO_CPUTICKS    9
+#define GETINFO_PROCTAB_GEN 10
+#define GETINFO_PROC        11
 
 #define VFS_REQ_BASE     1001
 #define VFS_TXN_BASE     1101
@@ -241,6 +244,9 @@ enum msgtype {
     FTRUNCATE, /* 100 */
     MREMAP,
     CLOCK_SETTIME,
+    RING_SETUP,
+    RING_ENTER,
+    RING_REGISTER,
 
     /* DEVMAN */
     DM_DEVICE_ADD = 500,
@@ -280,10 +286,12 @@ enum msgtype {
     FS_UTIME,
     FS_CHOWN,
     FS_LINK,
+    FS_MAP,
 
     VFS_MAPDRIVER,
     VFS_SOCKETPATH,
     VFS_COPYFD,
+    VFS_GETINFO,
 
     FS_TXN_ID = VFS_TXN_BASE,
 
@@ -293,6 +301,8 @@ enum msgtype {
     MM_VFS_REPLY,
     MM_GETINFO,
     MM_REMAP,
+    MM_MMAP_BATCH,
+    MM_PAGE_CACHE,
 
     /* message type for pm calls */
     PM_VFS_INIT = PM_REQ_BASE, /* 1501 */
@@ -392,6 +402,16 @@ enum msgtype {
     /* IPC */
     IPC_SHMGET = IPC_REQ_BASE,
     IPC_SHMAT,
+    IPC_SHMDT,
+    IPC_SHMCTL,
+    IPC_SEMGET,
+    IPC_SEMCTL,
+    IPC_SEMOP,
+    IPC_MSGGET,
+    IPC_MSGCTL,
+    IPC_MSGSND,
+    IPC_MSGRCV,
+    IPC_PM_EXIT,
 
     DEVPTS_CLEAR = DEVPTS_BASE,
     DEVPTS_SET,
@@ -486,7 +506,12 @@ enum msgtype {
 #define IPC_SIZE    u.m3.m3i2
 #define IPC_FLAGS   u.m3.m3i3
 #define IPC_ADDR    u.m3.m3p1
+#define IPC_CMD     u.m3.m3i4
+#define IPC_SEMNUM  u.m3.m3i2
+#define IPC_VAL     u.m3.m3l1
+#define IPC_MSGTYP  u.m3.m3l1
 #define IPC_RETID   u.m3.m3i2
+#define IPC_RETNUM  u.m3.m3i2
 #define IPC_RETADDR u.m3.m3p2
 
 /* Macros for getepinfo(). */
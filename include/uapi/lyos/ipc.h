@@ -146,6 +146,22 @@ struct mess_mm_remap {
 } __attribute__((packed));
 VERIFY_MESS_SIZE(mess_mm_remap);
 
+BEGIN_MESS_DECL(mess_mm_page_cache)
+{
+    int op;
+    __endpoint_t endpoint;
+    dev_t dev;
+    ino_t ino;
+    __u64 position;
+    __u64 limit;
+    void* buf;
+    size_t count;
+
+    __u8 _pad[48 - sizeof(dev_t) - sizeof(ino_t) - sizeof(void*) -
+              sizeof(size_t)];
+}
+END_MESS_DECL(mess_mm_page_cache)
+
 struct mess_pm_signal {
     int signum;
     void* act;
@@ -436,6 +452,23 @@ BEGIN_MESS_DECL(mess_vfs_inotify)
 }
 END_MESS_DECL(mess_vfs_inotify)
 
+BEGIN_MESS_DECL(mess_vfs_ring)
+{
+    int ring;
+    int opcode;
+    __u32 flags;
+    __u32 entries;
+    __u32 sq_idle;
+    __u32 to_submit;
+    __u32 min_complete;
+    __u32 nr_args;
+    void* addr;
+    size_t size;
+
+    __u8 _pad[40 - sizeof(void*) - sizeof(size_t)];
+}
+END_MESS_DECL(mess_vfs_ring)
+
 BEGIN_MESS_DECL(mess_vfs_fs_readsuper)
 {
     dev_t dev;
@@ -556,8 +589,9 @@ BEGIN_MESS_DECL(mess_fs_vfs_create_reply)
     gid_t gid;
     mode_t mode;
     size_t size;
+    unsigned int flags;
 
-    __u8 _pad[68 - sizeof(ino_t) - sizeof(uid_t) - sizeof(gid_t) -
+    __u8 _pad[64 - sizeof(ino_t) - sizeof(uid_t) - sizeof(gid_t) -
               sizeof(size_t) - sizeof(mode_t)];
 }
 END_MESS_DECL(mess_fs_vfs_create_reply)
@@ -642,6 +676,21 @@ BEGIN_MESS_DECL(mess_vfs_fs_putinode)
 }
 END_MESS_DECL(mess_vfs_fs_putinode)
 
+BEGIN_MESS_DECL(mess_vfs_fs_map)
+{
+    int status;
+    dev_t dev;
+    ino_t num;
+    __endpoint_t endpoint;
+    __u64 offset;
+    size_t length;
+    void* vaddr; /* address hint, replaced with the mapped address */
+
+    __u8 _pad[56 - sizeof(dev_t) - sizeof(ino_t) - sizeof(size_t) -
+              sizeof(void*)];
+}
+END_MESS_DECL(mess_vfs_fs_map)
+
 struct mess_vfs_cdev_openclose {
     __u64 minor;
     __u32 id;
@@ -1022,6 +1071,7 @@ typedef struct {
         struct mess_mm_mremap m_mm_mremap;
         struct mess_mm_mmap_reply m_mm_mmap_reply;
         struct mess_mm_remap m_mm_remap;
+        struct mess_mm_page_cache m_mm_page_cache;
         struct mess_pm_signal m_pm_signal;
         struct mess_pm_clone m_pm_clone;
         struct mess_pm_time m_pm_time;
@@ -1047,6 +1097,7 @@ typedef struct {
         struct mess_vfs_fchownat m_vfs_fchownat;
         struct mess_vfs_truncate m_vfs_truncate;
         struct mess_vfs_inotify m_vfs_inotify;
+        struct mess_vfs_ring m_vfs_ring;
         struct mess_vfs_fs_readsuper m_vfs_fs_readsuper;
         struct mess_vfs_fs_lookup m_vfs_fs_lookup;
         struct mess_fs_vfs_lookup_reply m_fs_vfs_lookup_reply;
@@ -1061,6 +1112,7 @@ typedef struct {
         struct mess_vfs_fs_utime m_vfs_fs_utime;
         struct mess_vfs_fs_chown m_vfs_fs_chown;
         struct mess_vfs_fs_putinode m_vfs_fs_putinode;
+        struct mess_vfs_fs_map m_vfs_fs_map;
         struct mess_vfs_cdev_openclose m_vfs_cdev_openclose;
         struct mess_vfs_cdev_readwrite m_vfs_cdev_readwrite;
         struct mess_vfs_cdev_mmap m_vfs_cdev_mmap;
@@ -0,0 +1,82 @@
+#ifndef _UAPI_LYOS_VFS_RING_H_
+#define _UAPI_LYOS_VFS_RING_H_
+
+#include <lyos/types.h>
+
+/* Shared submission/completion rings between a process and VFS.
+ *
+ * The process fills submission queue entries and advances sq_tail, VFS
+ * consumes them, advances sq_head and posts one completion queue entry per
+ * request at cq_tail. The process consumes completions by advancing cq_head.
+ * All indices are free-running and masked with (entries - 1). */
+
+#define VRING_MAX_ENTRIES 4096
+
+/* Flags for vfs_ring_setup() */
+#define VRING_SETUP_SQPOLL 0x1 /* VFS keeps polling the SQ for sq_idle ms */
+
+/* Shared flags in vfs_ring_hdr.flags */
+#define VRING_SQ_NEED_WAKEUP 0x1 /* VFS stopped polling, call vfs_ring_enter */
+
+/* Flags for vfs_ring_enter() */
+#define VRING_ENTER_GETEVENTS 0x1 /* wait for min_complete completions */
+
+/* Opcodes for vfs_ring_register() */
+#define VRING_REGISTER_BUFFERS   1
+#define VRING_UNREGISTER_BUFFERS 2
+#define VRING_RELEASE            3 /* tear the ring down */
+
+#define VRING_MAX_FIXED_BUFS 64
+
+/* Request opcodes */
+#define VRING_OP_NOP         0
+#define VRING_OP_READ        1
+#define VRING_OP_WRITE       2
+#define VRING_OP_READ_FIXED  3
+#define VRING_OP_WRITE_FIXED 4
+#define VRING_OP_OPENAT      5
+#define VRING_OP_CLOSE       6
+#define VRING_OP_FSTAT       7
+#define VRING_OP_FSTATAT     8
+
+/* Submission queue entry flags */
+#define VRSQE_LINK 0x1 /* the next entry only runs if this one succeeds */
+
+/* Use and advance the file position instead of off */
+#define VRING_OFF_CURRENT ((__u64)-1)
+
+struct vfs_ring_sqe {
+    __u8 opcode;
+    __u8 flags;
+    __u16 buf_index; /* registered buffer of READ_FIXED/WRITE_FIXED */
+    __s32 fd;        /* file, or directory fd of OPENAT/FSTATAT */
+    __u64 off;       /* file offset, or mode of OPENAT */
+    __u64 addr;      /* data buffer, or pathname */
+    __u32 len;       /* buffer or pathname length */
+    __u32 op_flags;  /* open or stat flags */
+    __u64 addr2;     /* struct stat of FSTAT/FSTATAT */
+    __u64 user_data; /* passed back in the completion */
+};
+
+struct vfs_ring_cqe {
+    __u64 user_data;
+    __s32 res; /* result, or negative error code */
+    __u32 flags;
+};
+
+struct vfs_ring_hdr {
+    volatile __u32 sq_head;
+    volatile __u32 sq_tail;
+    __u32 sq_entries;
+    __u32 sqes_off; /* offset of the SQE array from the header */
+
+    volatile __u32 cq_head;
+    volatile __u32 cq_tail;
+    __u32 cq_entries;
+    __u32 cqes_off; /* offset of the CQE array from the header */
+
+    volatile __u32 flags;       /* VRING_SQ_* */
+    volatile __u32 cq_overflow; /* completions dropped on a full CQ */
+};
+
+#endif
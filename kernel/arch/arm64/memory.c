@@ -330,6 +330,7 @@ int arch_vmctl(MESSAGE* m, struct proc* p)
         setttbr1((unsigned long)m->VMCTL_PHYS_ADDR);
         return 0;
     case VMCTL_FLUSHTLB:
+    case VMCTL_FLUSHTLB_RANGE:
         flush_tlb();
         return 0;
     }
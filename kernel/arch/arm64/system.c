@@ -189,3 +189,9 @@ void arch_init_profile_clock() {}
 void arch_stop_profile_clock() {}
 
 void arch_ack_profile_clock() {}
+
+int arch_get_callchain(struct proc* p, int in_kernel, reg_t fp, void** chain,
+                       int max_depth)
+{
+    return 0;
+}
@@ -756,6 +756,7 @@ void apic_hwint63();
 void apic_timer_intr();
 void apic_spurious_intr();
 void apic_error_intr();
+void apic_tlb_shootdown_intr();
 
 void apic_init_idt(int reset)
 {
@@ -896,6 +897,10 @@ void apic_init_idt(int reset)
                   PRIVILEGE_KRNL);
     init_idt_desc(APIC_ERROR_INT_VECTOR, DA_386IGate, apic_error_intr,
                   PRIVILEGE_KRNL);
+#if CONFIG_SMP
+    init_idt_desc(APIC_TLB_SHOOTDOWN_VECTOR, DA_386IGate,
+                  apic_tlb_shootdown_intr, PRIVILEGE_KRNL);
+#endif
     init_idt_desc(INT_VECTOR_SYS_CALL, DA_386IGate, sys_call, PRIVILEGE_USER);
 
     u32 val;
@@ -1002,6 +1007,18 @@ int apic_send_init_ipi(unsigned cpu, phys_bytes trampoline)
 
     return 0;
 }
+
+/* Send a fixed interrupt with the given vector to one CPU. */
+void apic_send_ipi(unsigned cpu, int vector)
+{
+    /* wait for the previous IPI to be accepted */
+    while (apic->icr_read() & APIC_ICR_DELIVERY_PENDING)
+        arch_pause();
+
+    apic->icr_write(cpuid2apicid[cpu], APIC_ICR_DM_FIXED | APIC_ICR_DM_PHYSICAL |
+                                           APIC_ICR_LEVEL_ASSERT |
+                                           APIC_ICR_TM_EDGE | vector);
+}
 #endif
 
 void ioapic_mask(struct irq_data* data) { ioapic_disable_irq(data->irq); }
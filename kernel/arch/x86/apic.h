@@ -32,6 +32,7 @@
 #define APIC_TIMER_INT_VECTOR      0xf0
 #define APIC_SMP_SCHED_PROC_VECTOR 0xf1
 #define APIC_SMP_CPU_HALT_VECTOR   0xf2
+#define APIC_TLB_SHOOTDOWN_VECTOR  0xf3
 #define APIC_ERROR_INT_VECTOR      0xfe
 #define APIC_SPURIOUS_INT_VECTOR   0xff
 
@@ -117,6 +118,7 @@ void apic_init_idt(int reset);
 #if CONFIG_SMP
 int apic_send_startup_ipi(unsigned cpu, phys_bytes trampoline);
 int apic_send_init_ipi(unsigned cpu, phys_bytes trampoline);
+void apic_send_ipi(unsigned cpu, int vector);
 #endif
 void lapic_setup_timer_one_shot(void);
 void lapic_setup_timer_periodic(void);
@@ -71,6 +71,7 @@ global  apic_hwint63
 global  apic_timer_intr
 global  apic_spurious_intr
 global  apic_error_intr
+global  apic_tlb_shootdown_intr
 
 extern  save
 extern  stop_context
@@ -81,6 +82,7 @@ extern  apic_eoi_write
 extern  apic_timer_int_handler
 extern  apic_spurious_int_handler
 extern  apic_error_int_handler
+extern  tlb_shootdown_int_handler
 
 ; interrupt and exception - hardware interrupt
 ; ---------------------------------
@@ -135,6 +137,9 @@ apic_spurious_intr:
 ALIGN   16
 apic_error_intr:
     lapic_int	apic_error_int_handler
+ALIGN   16
+apic_tlb_shootdown_intr:
+    lapic_int	tlb_shootdown_int_handler
 
 ALIGN	16
 apic_hwint00:
@@ -68,6 +68,7 @@ global  write_cr3
 global	read_cr4
 global  write_cr4
 global  reload_cr3
+global  x86_invlpg
 global  i8259_eoi_master
 global  i8259_eoi_slave
 global  arch_pause
@@ -446,6 +447,14 @@ reload_cr3:
     pop ebp
     ret
 
+x86_invlpg:
+    push ebp
+    mov ebp, esp
+    mov eax, [ebp + 8]
+    invlpg [eax]
+    pop ebp
+    ret
+
 i8259_eoi_master:
     mov	al, EOI				; `. Set EOI bit
     out	INT_M_CTL, al		; /
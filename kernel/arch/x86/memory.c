@@ -41,6 +41,7 @@ extern int syscall_style;
 #define TEMPPDE_SRC  0
 #define TEMPPDE_DST  1
 static unsigned long temppdes[MAX_TEMPPDES];
+static unsigned int temp_map_gen[CONFIG_SMP_MAX_CPUS];
 
 #define _SRC_       0
 #define _DEST_      1
@@ -110,8 +111,12 @@ static void* create_temp_map(struct proc* p, void* la, size_t* len, int index,
 
     if (!get_cpulocal_var(pt_proc)->seg.cr3_vir)
         panic("create_temp_map: pt_proc cr3_vir not set");
-    if (get_cpulocal_var(pt_proc)->seg.cr3_vir[pde] != pde_val(pdeval)) {
+    /* a shootdown since the window was last loaded may have invalidated
+     * what it maps even if the PDE itself is unchanged */
+    if (get_cpulocal_var(pt_proc)->seg.cr3_vir[pde] != pde_val(pdeval) ||
+        temp_map_gen[cpuid] != tlb_flush_gen) {
         get_cpulocal_var(pt_proc)->seg.cr3_vir[pde] = pde_val(pdeval);
+        temp_map_gen[cpuid] = tlb_flush_gen;
         *changed = 1;
     }
 
@@ -126,7 +131,8 @@ static int la_la_copy(struct proc* p_dest, void* dest_la, struct proc* p_src,
                       void* src_la, size_t len)
 {
     if (!get_cpulocal_var(pt_proc)) panic("pt_proc not present");
-    if (read_cr3() != get_cpulocal_var(pt_proc)->seg.cr3_phys)
+    if ((read_cr3() & ~X86_CR3_PCID_MASK) !=
+        get_cpulocal_var(pt_proc)->seg.cr3_phys)
         panic("bad pt_proc cr3 value");
 
     while (len > 0) {
@@ -199,6 +205,10 @@ phys_bytes va2pa(endpoint_t ep, void* va)
         return -1;
     }
 
+    if (pmde_large(*pmde))
+        return (pmde_pfn(*pmde) << ARCH_PG_SHIFT) +
+               ((uintptr_t)va % ARCH_BIG_PAGE_SIZE);
+
     pte = pte_offset(pmde, (unsigned long)va);
     if (!pte_present(*pte)) {
         return -1;
@@ -207,6 +217,85 @@ phys_bytes va2pa(endpoint_t ep, void* va)
     return (pte_pfn(*pte) << ARCH_PG_SHIFT) + ((uintptr_t)va % ARCH_PG_SIZE);
 }
 
+#if CONFIG_PROFILING
+
+/* Read a word from the user address space of p. Unlike data_vir_copy() this
+ * never touches the temporary mappings or takes a page fault, so it can be
+ * used from NMI context. Only works when p's page table is loaded. */
+static int read_user_word(struct proc* p, unsigned long addr, reg_t* val)
+{
+    pde_t* pde;
+    pud_t* pude;
+    pmd_t* pmde;
+    pte_t* pte;
+
+    if (p != get_cpulocal_var(pt_proc) || !p->seg.cr3_vir) return EFAULT;
+    if ((addr & (sizeof(reg_t) - 1)) || addr >= VM_STACK_TOP) return EFAULT;
+
+    pde = pgd_offset((pde_t*)p->seg.cr3_vir, addr);
+    if (pde_none(*pde)) return EFAULT;
+
+    pude = pud_offset(pde, addr);
+    if (pude_none(*pude)) return EFAULT;
+
+    pmde = pmd_offset(pude, addr);
+    if (pmde_none(*pmde)) return EFAULT;
+
+    if (!pmde_large(*pmde)) {
+        pte = pte_offset(pmde, addr);
+        if (!pte_present(*pte)) return EFAULT;
+    }
+
+    *val = *(reg_t*)addr;
+    return 0;
+}
+
+/**
+ * <Ring 0> Walk the frame pointer chain starting at fp and store up to
+ * max_depth return addresses in chain. Kernel chains are bounded by the
+ * current CPU's kernel stack, user chains are read through the page table
+ * of p. Safe to call from the NMI handler.
+ */
+int arch_get_callchain(struct proc* p, int in_kernel, reg_t fp, void** chain,
+                       int max_depth)
+{
+    unsigned long lo, hi;
+    reg_t next, ret;
+    int depth = 0;
+
+    if (in_kernel) {
+        hi = (unsigned long)get_k_stack_top(cpuid);
+        lo = hi - K_STACK_SIZE;
+    } else {
+        lo = 0;
+        hi = VM_STACK_TOP;
+    }
+
+    while (depth < max_depth && fp) {
+        if (fp < lo || fp + 2 * sizeof(reg_t) > hi) break;
+
+        if (in_kernel) {
+            if (fp & (sizeof(reg_t) - 1)) break;
+            next = ((reg_t*)fp)[0];
+            ret = ((reg_t*)fp)[1];
+        } else {
+            if (read_user_word(p, fp, &next) != 0) break;
+            if (read_user_word(p, fp + sizeof(reg_t), &ret) != 0) break;
+        }
+
+        if (!ret) break;
+        chain[depth++] = (void*)ret;
+
+        /* the stack grows down, so caller frames must be above us */
+        if (next <= fp) break;
+        fp = next;
+    }
+
+    return depth;
+}
+
+#endif
+
 #define KM_USERMAPPED   0
 #define KM_LAPIC        1
 #define KM_IOAPIC_FIRST 2
@@ -347,9 +436,8 @@ static void setcr3(struct proc* p, unsigned long cr3, void* cr3_v)
         cmb();
 #endif
 
-        write_cr3((u32)cr3);
-        reload_cr3();
-        get_cpulocal_var(pt_proc) = proc_addr(TASK_MM);
+        tlb_init_cpu();
+        switch_address_space(p);
         /* using virtual address now */
         lapic_addr = lapic_vaddr;
         lapic_eoi_addr = lapic_addr + LAPIC_EOI;
@@ -381,9 +469,17 @@ int arch_vmctl(MESSAGE* m, struct proc* p)
         return 0;
     case VMCTL_SET_ADDRESS_SPACE:
         setcr3(p, (unsigned long)m->VMCTL_PHYS_ADDR, __va(m->VMCTL_PHYS_ADDR));
+        /* the page directory may have belonged to an exited process whose
+         * translations are still cached somewhere */
+        tlb_shootdown(p->seg.cr3_phys, 0, ~0UL);
         return 0;
     case VMCTL_FLUSHTLB:
-        reload_cr3();
+        tlb_shootdown(p->seg.cr3_phys, 0, ~0UL);
+        return 0;
+    case VMCTL_FLUSHTLB_RANGE:
+        tlb_shootdown((phys_bytes)m->VMCTL_PHYS_ADDR,
+                      (vir_bytes)m->VMCTL_FLUSH_ADDR,
+                      (vir_bytes)m->VMCTL_FLUSH_ADDR + m->VMCTL_FLUSH_LEN);
         return 0;
     }
 
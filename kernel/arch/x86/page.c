@@ -350,7 +350,7 @@ void pg_load(pde_t* pgd)
 void switch_address_space(struct proc* p)
 {
     get_cpulocal_var(pt_proc) = p;
-    write_cr3(p->seg.cr3_phys);
+    tlb_switch_address_space(p->seg.cr3_phys);
 }
 
 void enable_paging()
@@ -580,7 +580,22 @@ void exception_handler(int in_kernel, struct exception_frame* frame)
 #endif
 
     if (frame->vec_no == 2) {
-        nmi_watchdog_handler(in_kernel, (void*)frame->eip);
+        reg_t fp;
+
+        /* The kernel-mode entry path saves the interrupted frame pointer just
+         * below the exception frame (first push on x86-64, pushad on i386);
+         * for user mode it is in the process context. */
+        if (in_kernel) {
+#ifdef CONFIG_X86_32
+            fp = ((reg_t*)frame)[-6];
+#else
+            fp = ((reg_t*)frame)[-1];
+#endif
+        } else {
+            fp = fault_proc->regs.bp;
+        }
+
+        nmi_watchdog_handler(in_kernel, (void*)frame->eip, fp);
         return;
     }
 
@@ -230,6 +230,7 @@ static void ap_finish_booting()
         arch_pause();
 
     /* flush TLB */
+    tlb_init_cpu();
     switch_address_space(proc_addr(TASK_MM));
 
     switch_to_user();
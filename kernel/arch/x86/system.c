@@ -145,7 +145,12 @@ void idle_stop()
     int is_idle = get_cpu_var(cpu, cpu_is_idle);
     get_cpu_var(cpu, cpu_is_idle) = 0;
 
-    if (is_idle) restart_local_timer();
+    if (!is_idle) return;
+
+    /* the tick may be stopped, so jiffies have not moved while we were
+     * halted; catch them up before the clock handler compares them */
+    stop_context(get_cpulocal_var_ptr(idle_proc));
+    restart_local_timer();
 }
 
 int arch_init_proc(struct proc* p, void* sp, void* ip, struct ps_strings* ps,
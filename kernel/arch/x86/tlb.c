@@ -0,0 +1,274 @@
+/*  This file is part of Lyos.
+
+    Lyos is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Lyos is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Lyos.  If not, see <http://www.gnu.org/licenses/>. */
+
+#include <lyos/types.h>
+#include <lyos/ipc.h>
+#include "lyos/const.h"
+#include <string.h>
+#include <kernel/proc.h>
+#include <kernel/global.h>
+#include <kernel/proto.h>
+#include <asm/const.h>
+#include <asm/proto.h>
+#include <asm/page.h>
+#include <asm/smp.h>
+#include <lyos/cpufeature.h>
+#ifdef CONFIG_SMP
+#include <lyos/smp.h>
+#include "apic.h"
+#endif
+
+/* Address spaces each CPU keeps tagged in its TLB when PCIDs are in use.
+ * PCID 0 is left to the boot page table. */
+#define TLB_NR_PCIDS 6
+
+/* Ranges larger than this many pages are flushed as a whole. */
+#define TLB_INVLPG_CEILING 32
+
+struct tlb_pcid {
+    volatile phys_bytes cr3;
+    volatile int need_flush; /* stale, flush when it is loaded again */
+};
+
+struct tlb_cpu_state {
+    volatile phys_bytes active_cr3; /* address space loaded on this CPU */
+    int cur_pcid;                   /* slot of active_cr3, -1 if none */
+    int next_pcid;                  /* next slot to recycle */
+    struct tlb_pcid pcids[TLB_NR_PCIDS];
+
+#if CONFIG_SMP
+    volatile int req_pending; /* tlb_request is addressed to this CPU */
+#endif
+};
+
+static struct tlb_cpu_state tlb_states[CONFIG_SMP_MAX_CPUS];
+static int pcid_enabled = 0;
+
+/* Bumped by every shootdown so that cached temporary mappings of other
+ * address spaces can tell that they may be stale. */
+volatile unsigned int tlb_flush_gen = 0;
+
+#if CONFIG_SMP
+/* The shootdown in flight. Only the holder of tlb_lock posts requests. */
+static volatile int tlb_lock = 0;
+static struct {
+    phys_bytes cr3;
+    vir_bytes start, end;
+    volatile int acks;
+} tlb_request;
+#endif
+
+/**
+ * <Ring 0> Prepare the TLB state of the calling CPU. Must run before the CPU
+ * switches to its first process.
+ */
+void tlb_init_cpu(void)
+{
+    struct tlb_cpu_state* ts = &tlb_states[cpuid];
+
+    memset(ts, 0, sizeof(*ts));
+    ts->cur_pcid = -1;
+
+#ifdef CONFIG_X86_64
+    /* the BSP decides, APs come up after it */
+    if (cpuid == bsp_cpu_id) pcid_enabled = !!_cpufeature(_CPUF_I386_PCID);
+#endif
+
+    if (pcid_enabled) write_cr4(read_cr4() | I386_CR4_PCIDE);
+}
+
+static int tlb_find_pcid(struct tlb_cpu_state* ts, phys_bytes cr3)
+{
+    int i;
+
+    for (i = 0; i < TLB_NR_PCIDS; i++) {
+        if (ts->pcids[i].cr3 == cr3) return i;
+    }
+
+    return -1;
+}
+
+/**
+ * <Ring 0> Load the address space whose page directory is at cr3. With
+ * PCIDs the translations of the last few address spaces stay in the TLB and
+ * are only flushed if a shootdown marked them stale in the meantime.
+ */
+void tlb_switch_address_space(phys_bytes cr3)
+{
+    struct tlb_cpu_state* ts = &tlb_states[cpuid];
+    int slot, flush;
+
+    if (!pcid_enabled) {
+        ts->active_cr3 = cr3;
+        __sync_synchronize();
+        write_cr3(cr3);
+        return;
+    }
+
+    if ((slot = tlb_find_pcid(ts, cr3)) < 0) {
+        /* recycle a slot, whatever it caches is flushed on load */
+        slot = ts->next_pcid;
+        ts->next_pcid = (slot + 1) % TLB_NR_PCIDS;
+
+        ts->pcids[slot].cr3 = cr3;
+        ts->pcids[slot].need_flush = 0;
+        flush = TRUE;
+
+        ts->active_cr3 = cr3;
+        __sync_synchronize();
+    } else {
+        /* publish active_cr3 before checking need_flush; a shootdown sets
+         * need_flush before it reads active_cr3, so one of us sees the
+         * other */
+        ts->active_cr3 = cr3;
+        __sync_synchronize();
+
+        flush = __sync_lock_test_and_set(&ts->pcids[slot].need_flush, 0);
+        if (!flush && slot == ts->cur_pcid) return;
+    }
+
+    ts->cur_pcid = slot;
+
+#ifdef CONFIG_X86_64
+    write_cr3(cr3 | (slot + 1) | (flush ? 0 : X86_CR3_NOFLUSH));
+#endif
+}
+
+/* Invalidate [start, end) of the address space at cr3 on this CPU. */
+static void tlb_flush_local(phys_bytes cr3, vir_bytes start, vir_bytes end)
+{
+    struct tlb_cpu_state* ts = &tlb_states[cpuid];
+    vir_bytes addr;
+    int slot;
+
+    if (ts->active_cr3 == cr3) {
+        if ((end - start) >> ARCH_PG_SHIFT > TLB_INVLPG_CEILING) {
+            /* also flushes only the current PCID */
+            reload_cr3();
+        } else {
+            for (addr = start; addr < end; addr += ARCH_PG_SIZE)
+                x86_invlpg((void*)addr);
+        }
+    }
+
+    if (pcid_enabled) {
+        slot = tlb_find_pcid(ts, cr3);
+        if (slot >= 0 && slot != ts->cur_pcid) ts->pcids[slot].need_flush = 1;
+    }
+}
+
+#if CONFIG_SMP
+
+/* Serve the request posted to this CPU, if any. */
+static void tlb_serve_request(void)
+{
+    struct tlb_cpu_state* ts = &tlb_states[cpuid];
+
+    if (!ts->req_pending) return;
+
+    tlb_flush_local(tlb_request.cr3, tlb_request.start, tlb_request.end);
+
+    ts->req_pending = 0;
+    __sync_fetch_and_add(&tlb_request.acks, 1);
+}
+
+/**
+ * <Ring 0> TLB shootdown IPI handler.
+ */
+void tlb_shootdown_int_handler(void) { tlb_serve_request(); }
+
+/* Interrupts are off in the kernel, so a CPU waiting for the lock keeps
+ * serving requests to avoid deadlocking with the current holder. */
+static void tlb_acquire(void)
+{
+    while (__sync_lock_test_and_set(&tlb_lock, 1)) {
+        tlb_serve_request();
+        arch_pause();
+    }
+}
+
+static void tlb_release(void) { __sync_lock_release(&tlb_lock); }
+
+static void tlb_shootdown_remote(phys_bytes cr3, vir_bytes start,
+                                 vir_bytes end)
+{
+    struct tlb_cpu_state* ts;
+    int cpu, slot, targets = 0;
+
+    tlb_acquire();
+
+    tlb_request.cr3 = cr3;
+    tlb_request.start = start;
+    tlb_request.end = end;
+    tlb_request.acks = 0;
+
+    for (cpu = 0; cpu < ncpus; cpu++) {
+        if (cpu == cpuid || !test_cpu_flag(cpu, CPU_IS_READY)) continue;
+        ts = &tlb_states[cpu];
+
+        /* translations kept under a PCID are flushed on the next switch */
+        if (pcid_enabled && (slot = tlb_find_pcid(ts, cr3)) >= 0)
+            ts->pcids[slot].need_flush = 1;
+
+        __sync_synchronize();
+
+        /* idle CPUs do not touch user memory and flush when they leave idle
+         * through switch_address_space() */
+        if (ts->active_cr3 != cr3 || get_cpu_var(cpu, cpu_is_idle)) continue;
+
+        ts->req_pending = 1;
+        targets++;
+    }
+
+    if (targets) {
+        __sync_synchronize();
+
+        for (cpu = 0; cpu < ncpus; cpu++) {
+            if (cpu != cpuid && tlb_states[cpu].req_pending)
+                apic_send_ipi(cpu, APIC_TLB_SHOOTDOWN_VECTOR);
+        }
+
+        while (tlb_request.acks < targets)
+            arch_pause();
+    }
+
+    tlb_release();
+}
+
+#else
+
+void tlb_shootdown_int_handler(void) {}
+
+#endif
+
+/**
+ * <Ring 0> Invalidate [start, end) of the address space at cr3 on every CPU
+ * that may cache it. Only CPUs currently running it are interrupted; the
+ * others have their PCID marked stale and flush it when they switch back.
+ */
+void tlb_shootdown(phys_bytes cr3, vir_bytes start, vir_bytes end)
+{
+    if (end <= start) return;
+
+    start &= ~(ARCH_PG_SIZE - 1);
+
+#if CONFIG_SMP
+    if (ncpus > 1) tlb_shootdown_remote(cr3, start, end);
+#endif
+
+    tlb_flush_local(cr3, start, end);
+
+    __sync_fetch_and_add(&tlb_flush_gen, 1);
+}
@@ -40,16 +40,25 @@ struct tick_device {
 
 static DEFINE_CPULOCAL(struct tick_device, tick_cpu_device);
 static DEFINE_CPULOCAL(u64, ns_per_tick);
+static DEFINE_CPULOCAL(u64, tick_acct_ns);
 
-DEF_LIST(timer_list);
+/* Longest time CPU 0 halts without a clock interrupt when idle. */
+#define TICK_MAX_SLEEP_NS NSEC_PER_SEC
+
+/* jiffies are derived from this clocksource once the tick is dynamic */
+static spinlock_t jiffies_lock;
+static struct clocksource* jiffies_cs;
+static u64 jiffies_last_cycle;
+static u64 jiffies_ns_rem;
+static u64 uptime_ns;
+
+static struct timer_wheel timer_wheel;
+static struct hrtimer_queue hrtimer_queue;
 static spinlock_t timers_lock;
 static clock_t next_timeout = TIMER_UNSET;
 
 void sched_clock(struct proc* p);
 
-extern void timer_add(struct list_head* list, struct timer_list* timer);
-extern void timer_expire(struct list_head* list, clock_t timestamp);
-
 /*****************************************************************************
  *                                read_jiffies
  *****************************************************************************/
@@ -72,6 +81,103 @@ static struct clocksource jiffies_clocksource = {
     .shift = JIFFY_SHIFT,
 };
 
+/* The tick can only be stopped when there is a clocksource other than
+ * jiffies itself to tell how much time has passed. */
+static inline int tick_nohz_enabled(void)
+{
+    return curr_clocksource && curr_clocksource != &jiffies_clocksource;
+}
+
+static void advance_jiffies(clock_t ticks)
+{
+    kclockinfo.realtime += ticks;
+    kclockinfo.uptime += ticks;
+
+    jiffies += ticks;
+    if (jiffies >= MAX_TICKS) jiffies -= MAX_TICKS;
+}
+
+/*****************************************************************************
+ *                                update_jiffies
+ *****************************************************************************/
+/**
+ * <Ring 0> Bring jiffies up to date with the clocksource. Clock interrupts
+ * do not arrive once per jiffy when the tick is stopped, so the number of
+ * jiffies passed is computed from the clocksource on every kernel entry.
+ *
+ * @param cycle Current value of the clocksource.
+ *****************************************************************************/
+static void update_jiffies(u64 cycle)
+{
+    struct clocksource* cs = curr_clocksource;
+    u64 nsec;
+
+    /* somebody else is updating them right now */
+    if (spinlock_locked(&jiffies_lock)) return;
+
+    spinlock_lock(&jiffies_lock);
+
+    if (cs != jiffies_cs) {
+        /* start counting from the new clocksource */
+        jiffies_cs = cs;
+        jiffies_ns_rem = 0;
+        uptime_ns = (u64)kclockinfo.uptime * get_cpulocal_var(ns_per_tick);
+    } else {
+        nsec = clocksource_cyc2ns(cs, (cycle - jiffies_last_cycle) & cs->mask);
+        uptime_ns += nsec;
+
+        nsec += jiffies_ns_rem;
+        jiffies_ns_rem = do_div(nsec, get_cpulocal_var(ns_per_tick));
+        if (nsec) advance_jiffies((clock_t)nsec);
+    }
+
+    jiffies_last_cycle = cycle;
+
+    spinlock_unlock(&jiffies_lock);
+}
+
+/*****************************************************************************
+ *                                clock_get_ns
+ *****************************************************************************/
+/**
+ * <Ring 0> Get the uptime in ns. Without a clocksource other than jiffies it
+ * only has the resolution of a tick.
+ *
+ * @return The uptime in ns.
+ *****************************************************************************/
+u64 clock_get_ns(void)
+{
+    struct clocksource* cs = curr_clocksource;
+    u64 ns;
+
+    if (!tick_nohz_enabled() || cs != jiffies_cs)
+        return (u64)kclockinfo.uptime * get_cpulocal_var(ns_per_tick);
+
+    spinlock_lock(&jiffies_lock);
+    ns = uptime_ns +
+         clocksource_cyc2ns(cs, (cs->read(cs) - jiffies_last_cycle) & cs->mask);
+    spinlock_unlock(&jiffies_lock);
+
+    return ns;
+}
+
+/* Charge the time p has run in whole ticks, as the clock handler does when
+ * the tick is periodic. */
+static void account_ticks(struct proc* p, u64 nsec)
+{
+    u64* acct = get_cpulocal_var_ptr(tick_acct_ns);
+    u64 ticks;
+
+    *acct += nsec;
+    if (*acct < get_cpulocal_var(ns_per_tick)) return;
+
+    ticks = *acct;
+    *acct = do_div(ticks, get_cpulocal_var(ns_per_tick));
+
+    if (p == get_cpulocal_var_ptr(idle_proc)) idle_ticks += ticks;
+    p->user_time += ticks;
+}
+
 /*****************************************************************************
  *                                clock_handler
  *****************************************************************************/
@@ -83,39 +189,31 @@ static struct clocksource jiffies_clocksource = {
  *****************************************************************************/
 static void clock_handler(struct clock_event_device* evt)
 {
+    if (!tick_nohz_enabled()) {
 #if CONFIG_SMP
-    if (cpuid == bsp_cpu_id) {
+        if (cpuid == bsp_cpu_id)
 #endif
-        kclockinfo.realtime++;
-        kclockinfo.uptime++;
+            advance_jiffies(1);
 
-        if (++jiffies >= MAX_TICKS) jiffies = 0;
-#if CONFIG_SMP
+        if (get_cpulocal_var(proc_ptr) == get_cpulocal_var_ptr(idle_proc))
+            idle_ticks++;
+        get_cpulocal_var(proc_ptr)->user_time++;
     }
-#endif
 
-    if (get_cpulocal_var(proc_ptr) == get_cpulocal_var_ptr(idle_proc))
-        idle_ticks++;
-    get_cpulocal_var(proc_ptr)->user_time++;
+    /* timer expired; any CPU whose tick is running may handle it as CPU 0
+     * could be halted with its tick stopped */
+    if (jiffies >= next_timeout && next_timeout != TIMER_UNSET) {
+        spinlock_lock(&timers_lock);
+        timer_expire(&timer_wheel, jiffies);
+        next_timeout = timer_next_expiry(&timer_wheel);
+        spinlock_unlock(&timers_lock);
+    }
 
-#if CONFIG_SMP
-    if (cpuid == bsp_cpu_id) {
-#endif
-        /* timer expired */
-        if (jiffies >= next_timeout && next_timeout != TIMER_UNSET) {
-            spinlock_lock(&timers_lock);
-            timer_expire(&timer_list, jiffies);
-            if (list_empty(&timer_list))
-                next_timeout = TIMER_UNSET;
-            else
-                next_timeout =
-                    list_entry(timer_list.next, struct timer_list, list)
-                        ->expire_time;
-            spinlock_unlock(&timers_lock);
-        }
-#if CONFIG_SMP
+    if (hrtimer_queue.root) {
+        spinlock_lock(&timers_lock);
+        hrtimer_expire(&hrtimer_queue, clock_get_ns());
+        spinlock_unlock(&timers_lock);
     }
-#endif
 
     sched_clock(get_cpulocal_var(proc_ptr));
 }
@@ -134,6 +232,7 @@ int init_time()
     arch_init_time();
     clocksource_register(&jiffies_clocksource);
     spinlock_init(&timers_lock);
+    spinlock_init(&jiffies_lock);
 
     memset(&kclockinfo, 0, sizeof(kclockinfo));
     kclockinfo.hz = system_hz;
@@ -209,6 +308,82 @@ void stop_local_timer(void)
     clockevents_shutdown(td->evdev);
 }
 
+/* Time until the next kernel timer expires, or 0 if there is none. */
+static u64 next_timer_delta(void)
+{
+    clock_t timeout = next_timeout;
+    u64 delta = 0, expires, now;
+
+    if (timeout != TIMER_UNSET) {
+        if (timeout <= jiffies) return 1;
+
+        delta = (u64)(timeout - jiffies) * get_cpulocal_var(ns_per_tick);
+        delta -= jiffies_ns_rem;
+    }
+
+    expires = hrtimer_next_expiry(&hrtimer_queue);
+    if (expires != HRTIMER_UNSET) {
+        now = clock_get_ns();
+        if (expires <= now) return 1;
+
+        if (!delta || expires - now < delta) delta = expires - now;
+    }
+
+    return delta;
+}
+
+/*****************************************************************************
+ *                                program_local_timer
+ *****************************************************************************/
+/**
+ * <Ring 0> Program the local timer before returning to p, or before halting
+ * the CPU if p is NULL. The tick is only kept while other procs are waiting
+ * to run on this CPU. A proc running alone is interrupted when its quantum
+ * expires, an idle CPU when the next kernel timer expires. Without a
+ * clocksource to keep jiffies with, the tick stays periodic.
+ *
+ * @param p The proc about to run.
+ *****************************************************************************/
+void program_local_timer(struct proc* p)
+{
+    struct tick_device* td = get_cpulocal_var_ptr(tick_cpu_device);
+    u64 ns_tick = get_cpulocal_var(ns_per_tick);
+    u64 delta, timer_delta;
+    int is_bsp = TRUE;
+
+#if CONFIG_SMP
+    is_bsp = cpuid == bsp_cpu_id;
+#endif
+
+    if (!td->evdev) return;
+
+    if (!tick_nohz_enabled()) {
+        /* CPU 0 keeps jiffies with its tick */
+        delta = (p || is_bsp) ? ns_tick : 0;
+    } else {
+        if (p) {
+            delta = ns_tick;
+            if (sched_queue_empty() && p->counter_ns > delta)
+                delta = p->counter_ns;
+        } else {
+            delta = is_bsp ? TICK_MAX_SLEEP_NS : 0;
+        }
+
+        timer_delta = next_timer_delta();
+        if (timer_delta && (!delta || timer_delta < delta))
+            delta = timer_delta;
+    }
+
+    if (!delta) {
+        /* idle and nothing to wait for */
+        clockevents_shutdown(td->evdev);
+        return;
+    }
+
+    clockevents_switch_state(td->evdev, CLOCK_EVT_STATE_ONESHOT);
+    clockevents_program_delta(td->evdev, delta);
+}
+
 /*****************************************************************************
  *                                stop_context
  *****************************************************************************/
@@ -236,6 +411,11 @@ void stop_context(struct proc* p)
         }
     }
 
+    if (tick_nohz_enabled()) {
+        update_jiffies(cycle);
+        account_ticks(p, nsec);
+    }
+
     arch_stop_context(p, delta);
 
     *ctx_switch_clock = cycle;
@@ -247,9 +427,8 @@ void set_sys_timer(struct timer_list* timer)
 
     if (timer->expire_time != TIMER_UNSET) list_del(&timer->list);
 
-    timer_add(&timer_list, timer);
-    next_timeout =
-        list_entry(timer_list.next, struct timer_list, list)->expire_time;
+    timer_add(&timer_wheel, timer, jiffies);
+    next_timeout = timer_next_expiry(&timer_wheel);
 
     spinlock_unlock(&timers_lock);
 }
@@ -259,15 +438,31 @@ void reset_sys_timer(struct timer_list* timer)
     spinlock_lock(&timers_lock);
 
     cancel_timer(timer);
-    if (list_empty(&timer_list))
-        next_timeout = TIMER_UNSET;
-    else
-        next_timeout =
-            list_entry(timer_list.next, struct timer_list, list)->expire_time;
+    next_timeout = timer_next_expiry(&timer_wheel);
 
     spinlock_unlock(&timers_lock);
 }
 
+void set_sys_hrtimer(struct hrtimer* timer)
+{
+    u64 expires = timer->expires;
+
+    spinlock_lock(&timers_lock);
+
+    hrtimer_dequeue(&hrtimer_queue, timer);
+    timer->expires = expires;
+    hrtimer_enqueue(&hrtimer_queue, timer);
+
+    spinlock_unlock(&timers_lock);
+}
+
+void reset_sys_hrtimer(struct hrtimer* timer)
+{
+    spinlock_lock(&timers_lock);
+    hrtimer_dequeue(&hrtimer_queue, timer);
+    spinlock_unlock(&timers_lock);
+}
+
 void set_boottime(time_t time) { kclockinfo.boottime = time; }
 
 static void tick_setup_device(struct tick_device* td,
@@ -0,0 +1,211 @@
+/*  This file is part of Lyos.
+
+    Lyos is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Lyos is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Lyos.  If not, see <http://www.gnu.org/licenses/>. */
+
+#include <lyos/types.h>
+#include <lyos/ipc.h>
+#include <string.h>
+#include <lyos/const.h>
+#include <kernel/proc.h>
+#include <kernel/global.h>
+#include <kernel/proto.h>
+#include <lyos/clocksource.h>
+#ifdef CONFIG_SMP
+#include <asm/smp.h>
+#endif
+
+#if CONFIG_PROFILING
+
+/* Records per CPU, must be a power of two. */
+#define IPCTRACE_RECORDS 8192
+
+/* One ring per CPU. The CPU doing the IPC is the only producer and moves
+ * head; ipctrace_drain() is the only consumer and moves tail. */
+struct ipctrace_cpu_buf {
+    volatile unsigned int head;
+    volatile unsigned int tail;
+
+    int records;
+    int dropped;
+
+    struct kprof_ipc_record data[IPCTRACE_RECORDS];
+};
+
+int ipc_tracing = 0;
+
+static struct ipctrace_cpu_buf ipctrace_bufs[CONFIG_SMP_MAX_CPUS];
+static u64 ipctrace_start_cycles;
+
+static inline u64 ipctrace_cycles(void)
+{
+    if (!curr_clocksource) return 0;
+    return curr_clocksource->read(curr_clocksource);
+}
+
+static inline u64 ipctrace_ns(u64 since)
+{
+    if (!curr_clocksource || !since) return 0;
+    return clocksource_cyc2ns(curr_clocksource, (ipctrace_cycles() - since) &
+                                                    curr_clocksource->mask);
+}
+
+static void ipctrace_record(int event, int flags, endpoint_t src,
+                            endpoint_t dest, int type, u64 since)
+{
+    struct ipctrace_cpu_buf* buf = &ipctrace_bufs[cpuid];
+    struct kprof_ipc_record* rec;
+    unsigned int head = buf->head;
+
+    if (head - buf->tail >= IPCTRACE_RECORDS) {
+        buf->dropped++;
+        return;
+    }
+
+    rec = &buf->data[head & (IPCTRACE_RECORDS - 1)];
+    rec->timestamp = ipctrace_ns(ipctrace_start_cycles);
+    rec->wait = ipctrace_ns(since);
+    rec->src = src;
+    rec->dest = dest;
+    rec->type = type;
+    rec->cpu = cpuid;
+    rec->event = event;
+    rec->flags = flags;
+
+    /* make the record visible before publishing it */
+    __sync_synchronize();
+    buf->head = head + 1;
+    buf->records++;
+}
+
+/* A message from sender is about to be queued on the receiver. */
+void ipctrace_block(struct proc* sender)
+{
+    sender->ipc_send_ts = ipctrace_cycles();
+}
+
+/* sender entered sendrec(BOTH) with a request of the given type. */
+void ipctrace_call(struct proc* sender, endpoint_t dest, int type)
+{
+    sender->ipc_call_ts = ipctrace_cycles();
+    sender->ipc_call_dest = dest;
+    sender->ipc_call_type = type;
+}
+
+/* A message of type from sender has been handed to receiver. blocked is set
+ * if the sender sat in the receiver's queue first. */
+void ipctrace_deliver(struct proc* sender, struct proc* receiver, int type,
+                      int blocked)
+{
+    ipctrace_record(KPROF_IPC_SEND, blocked ? KPROF_IPC_BLOCKED : 0,
+                    sender->endpoint, receiver->endpoint, type,
+                    blocked ? sender->ipc_send_ts : 0);
+    sender->ipc_send_ts = 0;
+
+    /* is it the reply to a sendrec(BOTH) of the receiver? */
+    if (receiver->ipc_call_ts && receiver->ipc_call_dest == sender->endpoint) {
+        ipctrace_record(KPROF_IPC_CALL, 0, receiver->endpoint,
+                        sender->endpoint, receiver->ipc_call_type,
+                        receiver->ipc_call_ts);
+        receiver->ipc_call_ts = 0;
+    }
+}
+
+void ipctrace_notify(struct proc* sender, struct proc* receiver, int pending)
+{
+    ipctrace_record(KPROF_IPC_NOTIFY, pending ? KPROF_IPC_BLOCKED : 0,
+                    sender->endpoint, receiver->endpoint, NOTIFY_MSG, 0);
+}
+
+void ipctrace_async(struct proc* sender, struct proc* receiver, int type,
+                    int pending)
+{
+    ipctrace_record(KPROF_IPC_ASYNC, pending ? KPROF_IPC_BLOCKED : 0,
+                    sender->endpoint, receiver->endpoint, type, 0);
+}
+
+/* Must be called while tracing is stopped. */
+void ipctrace_reset(void)
+{
+    struct proc* p;
+    int cpu;
+
+    for (cpu = 0; cpu < CONFIG_SMP_MAX_CPUS; cpu++) {
+        struct ipctrace_cpu_buf* buf = &ipctrace_bufs[cpu];
+
+        buf->head = buf->tail = 0;
+        buf->records = buf->dropped = 0;
+    }
+
+    for (p = &FIRST_PROC; p <= &LAST_PROC; p++) {
+        p->ipc_send_ts = p->ipc_call_ts = 0;
+    }
+
+    ipctrace_start_cycles = ipctrace_cycles();
+}
+
+/**
+ * Move trace records from every CPU's ring into the buffer of endpt while
+ * tracing continues. On return info->mem_used holds the number of bytes
+ * copied and the counters hold the totals since tracing started.
+ */
+int ipctrace_drain(endpoint_t endpt, void* dest, size_t size,
+                   struct kprof_ipc_info* info)
+{
+    int cpu, retval;
+    size_t copied = 0;
+
+    memset(info, 0, sizeof(*info));
+
+    for (cpu = 0; cpu < CONFIG_SMP_MAX_CPUS; cpu++) {
+        struct ipctrace_cpu_buf* buf = &ipctrace_bufs[cpu];
+        unsigned int head, tail, count, pos, chunk;
+
+        head = buf->head;
+        __sync_synchronize();
+        tail = buf->tail;
+
+        count = min(head - tail,
+                    (size - copied) / sizeof(struct kprof_ipc_record));
+
+        pos = tail & (IPCTRACE_RECORDS - 1);
+        chunk = min(count, IPCTRACE_RECORDS - pos);
+
+        if (chunk > 0) {
+            retval =
+                data_vir_copy(endpt, dest + copied, KERNEL, &buf->data[pos],
+                              chunk * sizeof(buf->data[0]));
+            if (retval) return retval;
+        }
+        if (count > chunk) {
+            retval = data_vir_copy(
+                endpt, dest + copied + chunk * sizeof(buf->data[0]), KERNEL,
+                &buf->data[0], (count - chunk) * sizeof(buf->data[0]));
+            if (retval) return retval;
+        }
+
+        /* finish reading the records before handing the space back */
+        __sync_synchronize();
+        buf->tail = tail + count;
+        copied += count * sizeof(buf->data[0]);
+
+        info->records += buf->records;
+        info->dropped += buf->dropped;
+    }
+
+    info->mem_used = copied;
+
+    return 0;
+}
+
+#endif
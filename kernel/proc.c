@@ -40,10 +40,17 @@ DEFINE_CPULOCAL(struct proc*, fpu_owner) = NULL;
 
 DEFINE_CPULOCAL(volatile int, cpu_is_idle);
 
+/* process to run next without going through the run queue */
+static DEFINE_CPULOCAL(struct proc*, handoff_proc) = NULL;
+
 struct proc* pick_proc();
 void proc_no_time(struct proc* p);
 
 static void idle();
+static struct proc* pick_handoff_proc(void);
+#if CONFIG_SENDREC_FASTPATH
+static int msg_sendrec_fast(struct proc* caller, endpoint_t dest, MESSAGE* m);
+#endif
 static int msg_receive(struct proc* p_to_recv, int src, MESSAGE* m, int flags);
 static int receive_async(struct proc* p);
 static int receive_async_from(struct proc* p, struct proc* sender);
@@ -120,6 +127,7 @@ void init_proc()
         priv->id = id++;
         priv->timer.expire_time = TIMER_UNSET;
         INIT_LIST_HEAD(&priv->timer.list);
+        hrtimer_init(&priv->hrtimer);
 
         sigemptyset(&priv->sig_pending);
         priv->notify_pending = 0;
@@ -147,8 +155,10 @@ void switch_to_user()
     if (proc_is_runnable(p)) goto no_schedule;
 
 reschedule:
-    while (!(p = pick_proc()))
-        idle();
+    if (!(p = pick_handoff_proc())) {
+        while (!(p = pick_proc()))
+            idle();
+    }
 
     switch_address_space(p);
 
@@ -200,7 +210,7 @@ no_schedule:
         disable_fpu_exception();
     }
 
-    restart_local_timer();
+    program_local_timer(p);
     restore_user_context(p);
 }
 
@@ -219,27 +229,16 @@ static void idle()
     get_cpulocal_var(proc_ptr) = get_cpulocal_var_ptr(idle_proc);
     switch_address_space_idle();
 
-#if CONFIG_SMP
     get_cpulocal_var(cpu_is_idle) = 1;
 
-    if (cpuid == bsp_cpu_id)
-        restart_local_timer();
-    else
-        stop_local_timer();
-
-#else
-    restart_local_timer();
-#endif
-
+    /* bring jiffies up to date first, the next deadline is computed from
+     * them */
     stop_context(get_cpulocal_var_ptr(idle_proc));
 
-    halt_cpu();
+    /* sleep until the next kernel timer or interrupt */
+    program_local_timer(NULL);
 
-#if CONFIG_SMP
-    if (cpuid != bsp_cpu_id) {
-        setup_local_timer_one_shot();
-    }
-#endif
+    halt_cpu();
 }
 
 /*****************************************************************************
@@ -275,9 +274,13 @@ int sys_sendrec(MESSAGE* m, struct proc* p)
 
     switch (function) {
     case BOTH:
+#if CONFIG_SENDREC_FASTPATH
+        if (msg_sendrec_fast(p, src_dest, msg)) break;
+#endif
         /* fall through */
     case SEND:
-        ret = msg_send(p, src_dest, msg, flags);
+        ret = msg_send(p, src_dest, msg,
+                       function == BOTH ? flags | IPCF_CALL : flags);
         if (ret != 0 || function == SEND) break;
         /* fall through for BOTH */
     case RECEIVE:
@@ -406,6 +409,10 @@ int msg_send(struct proc* p_to_send, int dest, MESSAGE* m, int flags)
         p_dest->deliver_msg.source = p_to_send->endpoint;
         p_dest->flags |= PF_DELIVER_MSG;
 
+        if (flags & IPCF_CALL)
+            IPCTRACE(call(sender, dest, p_dest->deliver_msg.type));
+        IPCTRACE(deliver(sender, p_dest, p_dest->deliver_msg.type, FALSE));
+
         PST_UNSET_LOCKED(p_dest, PST_RECEIVING);
         p_dest->flags &= ~PF_RECV_ASYNC;
     } else { /* p_dest is not waiting for the msg */
@@ -426,6 +433,10 @@ int msg_send(struct proc* p_to_send, int dest, MESSAGE* m, int flags)
 
         sender->send_msg.source = p_to_send->endpoint;
 
+        if (flags & IPCF_CALL)
+            IPCTRACE(call(sender, dest, sender->send_msg.type));
+        IPCTRACE(block(sender));
+
         /* append to the sending queue */
         struct proc* p;
         if (p_dest->q_sending) {
@@ -446,6 +457,105 @@ out:
     return retval;
 }
 
+/**
+ * <Ring 0> Take the process that a sendrec fast path has switched to.
+ *
+ * @return The process to run, or NULL if the scheduler should pick one.
+ */
+static struct proc* pick_handoff_proc(void)
+{
+    struct proc* p = get_cpulocal_var(handoff_proc);
+    int runnable;
+
+    if (!p) return NULL;
+    get_cpulocal_var(handoff_proc) = NULL;
+
+    lock_proc(p);
+    /* it is normally not queued at all, but may have been requeued if it was
+     * blocked and woken up again in the meantime */
+    runnable = proc_is_runnable(p);
+    if (runnable) dequeue_proc(p);
+    unlock_proc(p);
+
+    return runnable ? p : NULL;
+}
+
+#if CONFIG_SENDREC_FASTPATH
+/*****************************************************************************
+ *                                msg_sendrec_fast
+ *****************************************************************************/
+/**
+ * <Ring 0> Fast path for sendrec(BOTH) when the dest proc is already waiting
+ * for the message on this CPU. The message is handed to dest and the caller
+ * is blocked receiving the reply in one step, then the CPU is switched to
+ * dest directly instead of queueing it and calling the scheduler. Dest runs
+ * on the remaining time slice of the caller, which is left with none.
+ *
+ * @param caller  The caller, who sends and then waits for the reply.
+ * @param dest    To whom the message is sent.
+ * @param m       The message.
+ *
+ * @return TRUE if the call is done, FALSE if the slow path should be taken.
+ *****************************************************************************/
+static int msg_sendrec_fast(struct proc* caller, endpoint_t dest, MESSAGE* m)
+{
+    struct proc* p_dest = endpt_proc(dest);
+    int done = FALSE;
+
+    if (p_dest == NULL) return FALSE;
+
+    lock_proc(caller);
+    lock_proc(p_dest);
+
+    /* dest must be blocked in nothing but receiving from us. It is not
+     * sending, so no deadlock is possible and it is not in our sending
+     * queue. */
+    if (p_dest->state != PST_RECEIVING ||
+        (p_dest->recvfrom != caller->endpoint && p_dest->recvfrom != ANY))
+        goto out;
+    if ((caller->flags | p_dest->flags) &
+        (PF_RESUME_SYSCALL | PF_TRACE_SYSCALL | PF_DELIVER_MSG))
+        goto out;
+#if CONFIG_SMP
+    if (p_dest->cpu != cpuid) goto out;
+#endif
+
+    /* the reply would not be the first message the caller receives */
+    if (has_pending_notify(caller, dest) != PRIV_ID_NULL) goto out;
+
+    if (copy_user_message(&p_dest->deliver_msg, m)) goto out;
+
+    p_dest->deliver_msg.source = caller->endpoint;
+    p_dest->flags |= PF_DELIVER_MSG;
+    p_dest->flags &= ~PF_RECV_ASYNC;
+
+    IPCTRACE(call(caller, dest, p_dest->deliver_msg.type));
+    IPCTRACE(deliver(caller, p_dest, p_dest->deliver_msg.type, FALSE));
+
+    PST_SET_LOCKED(caller, PST_RECEIVING);
+    caller->recv_msg = m;
+    caller->recvfrom = dest;
+
+    /* runnable but not queued, like a proc that pick_proc() has chosen */
+    p_dest->state &= ~PST_RECEIVING;
+
+    /* hand the rest of the slice over, the caller gets a new one when it is
+     * picked again after the reply */
+    p_dest->counter_ns = caller->counter_ns;
+    p_dest->deadline = caller->deadline;
+    caller->counter_ns = 0;
+
+    get_cpulocal_var(handoff_proc) = p_dest;
+    done = TRUE;
+
+out:
+    unlock_proc(caller);
+    unlock_proc(p_dest);
+
+    return done;
+}
+#endif
+
 /*****************************************************************************
  *                                msg_receive
  *****************************************************************************/
@@ -495,6 +605,8 @@ static int msg_receive(struct proc* p_to_recv, int src, MESSAGE* m, int flags)
         PST_UNSET_LOCKED(who_wanna_recv, PST_RECEIVING);
         who_wanna_recv->flags &= ~PF_RECV_ASYNC;
 
+        IPCTRACE(notify(notifier, who_wanna_recv, TRUE));
+
         goto out;
     }
 
@@ -586,6 +698,8 @@ static int msg_receive(struct proc* p_to_recv, int src, MESSAGE* m, int flags)
         who_wanna_recv->deliver_msg = from->send_msg;
         who_wanna_recv->flags |= PF_DELIVER_MSG;
 
+        IPCTRACE(deliver(from, who_wanna_recv, from->send_msg.type, TRUE));
+
         reset_msg(&from->send_msg);
         from->sendto = NO_TASK;
         PST_UNSET_LOCKED(from, PST_SENDING);
@@ -653,6 +767,8 @@ static int receive_async_from(struct proc* p, struct proc* sender)
         p->flags &= ~PF_RECV_ASYNC;
         PST_UNSET_LOCKED(p, PST_RECEIVING);
 
+        IPCTRACE(async(sender, p, amsg.msg.type, TRUE));
+
         amsg.result = retval;
         amsg.flags |= ASMF_DONE;
 
@@ -800,6 +916,8 @@ int msg_notify(struct proc* p_to_send, endpoint_t dest)
         p_dest->flags &= ~PF_RECV_ASYNC;
         PST_UNSET_LOCKED(p_dest, PST_RECEIVING);
 
+        IPCTRACE(notify(p_to_send, p_dest, FALSE));
+
         unlock_proc(p_dest);
         return retval;
     }
@@ -946,6 +1064,8 @@ static int msg_senda(struct proc* p_to_send, async_message_t* table, size_t len)
 
             p_dest->flags &= ~PF_RECV_ASYNC;
             PST_UNSET_LOCKED(p_dest, PST_RECEIVING);
+
+            IPCTRACE(async(p_to_send, p_dest, amsg.msg.type, FALSE));
         } else { /* tell dest that it has a pending async message */
             p_dest->priv->async_pending |= (1 << priv->id);
             done = FALSE;
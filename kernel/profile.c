@@ -27,81 +27,155 @@
 
 #if CONFIG_PROFILING
 
+/* Every CPU records into its own ring so that samples can be taken from the
+ * NMI handler without any locks. The NMI handler is the only producer and
+ * moves head; profile_drain() is the only consumer and moves tail. */
+#define KPROF_CPU_BUFSIZE (KPROF_SAMPLE_BUFSIZE / CONFIG_SMP_MAX_CPUS)
+
+struct kprof_cpu_buf {
+    volatile size_t head;
+    volatile size_t tail;
+
+    int idle_samples;
+    int system_samples;
+    int user_samples;
+    int total_samples;
+    int dropped_samples;
+
+    /* endpoint whose name has been recorded for each proc slot */
+    endpoint_t recorded[NR_TASKS + NR_PROCS];
+
+    char data[KPROF_CPU_BUFSIZE];
+};
+
+static struct kprof_cpu_buf kprof_bufs[CONFIG_SMP_MAX_CPUS];
+
 int arch_init_profile_clock(u32 freq);
 void arch_stop_profile_clock();
 void arch_ack_profile_clock();
 
 static irq_hook_t profile_clock_irq_hook;
 
-static void profile_record_sample(struct proc* p, void* pc)
+static inline size_t ring_used(struct kprof_cpu_buf* buf)
 {
-    struct kprof_sample* s =
-        (struct kprof_sample*)(profile_sample_buf + kprof_info.mem_used + 1);
+    return (buf->head + KPROF_CPU_BUFSIZE - buf->tail) % KPROF_CPU_BUFSIZE;
+}
 
-    profile_sample_buf[kprof_info.mem_used] = KPROF_TYPE_SAMPLE;
+static size_t ring_put(struct kprof_cpu_buf* buf, size_t pos,
+                       const void* data, size_t len)
+{
+    size_t chunk = min(len, KPROF_CPU_BUFSIZE - pos);
 
-    s->endpt = p->endpoint;
-    s->pc = pc;
+    memcpy(&buf->data[pos], data, chunk);
+    memcpy(&buf->data[0], (const char*)data + chunk, len - chunk);
 
-    kprof_info.mem_used += 1 + sizeof(struct kprof_sample);
+    return (pos + len) % KPROF_CPU_BUFSIZE;
 }
 
-static void profile_record_proc(struct proc* p)
+static void ring_peek(struct kprof_cpu_buf* buf, size_t off, void* data,
+                      size_t len)
 {
-    struct kprof_proc* s =
-        (struct kprof_proc*)(profile_sample_buf + kprof_info.mem_used + 1);
+    size_t pos = (buf->tail + off) % KPROF_CPU_BUFSIZE;
+    size_t chunk = min(len, KPROF_CPU_BUFSIZE - pos);
 
-    profile_sample_buf[kprof_info.mem_used] = KPROF_TYPE_PROC;
+    memcpy(data, &buf->data[pos], chunk);
+    memcpy((char*)data + chunk, &buf->data[0], len - chunk);
+}
 
-    s->endpt = p->endpoint;
-    strlcpy(s->name, p->name, sizeof(s->name));
-    s->name[sizeof(s->name) - 1] = '\0';
-    p->flags |= PF_PROFILE_RECORDED;
+/* Append a record made of the tag, a fixed header and an optional variable
+ * part. Returns FALSE and counts a drop if the ring is full. */
+static int profile_record(struct kprof_cpu_buf* buf, u8 tag, const void* hdr,
+                          size_t hdr_len, const void* extra, size_t extra_len)
+{
+    size_t len = 1 + hdr_len + extra_len;
+    size_t head = buf->head;
+
+    if (ring_used(buf) + len >= KPROF_CPU_BUFSIZE) {
+        buf->dropped_samples++;
+        return FALSE;
+    }
+
+    head = ring_put(buf, head, &tag, 1);
+    head = ring_put(buf, head, hdr, hdr_len);
+    head = ring_put(buf, head, extra, extra_len);
 
-    kprof_info.mem_used += 1 + sizeof(struct kprof_proc);
+    /* make the record visible before publishing it */
+    __sync_synchronize();
+    buf->head = head;
+
+    return TRUE;
 }
 
-static void profile_sample(struct proc* p, void* pc)
+static void profile_record_proc(struct kprof_cpu_buf* buf, struct proc* p)
 {
-    if (!kprofiling) return;
-    if (kprof_info.mem_used + sizeof(struct kprof_sample) +
-            sizeof(struct kprof_proc) + 2 >
-        KPROF_SAMPLE_BUFSIZE) {
-        return;
+    struct kprof_proc s;
+    int slot = p - proc_table;
+
+    if (buf->recorded[slot] == p->endpoint) return;
+
+    s.endpt = p->endpoint;
+    strlcpy(s.name, p->name, sizeof(s.name));
+    s.name[sizeof(s.name) - 1] = '\0';
+
+    if (profile_record(buf, KPROF_TYPE_PROC, &s, sizeof(s), NULL, 0)) {
+        buf->recorded[slot] = p->endpoint;
     }
+}
 
-    lock_proc(p);
-    if (p == get_cpulocal_var_ptr(idle_proc)) {
-        kprof_info.idle_samples++;
-    } else if (p->priv->flags & PRF_PRIV_PROC || p->endpoint == KERNEL) {
-        kprof_info.system_samples++;
+static void profile_record_sample(struct kprof_cpu_buf* buf, struct proc* p,
+                                  int in_kernel, void* pc, reg_t fp)
+{
+    struct kprof_sample s;
+    void* chain[KPROF_MAX_DEPTH];
+    int depth;
 
-        if (!(p->flags & PF_PROFILE_RECORDED)) {
-            profile_record_proc(p);
-        }
+    depth = arch_get_callchain(p, in_kernel, fp, chain, KPROF_MAX_DEPTH);
+
+    s.endpt = p->endpoint;
+    s.cpu = cpuid;
+    s.flags = in_kernel ? 0 : KPROF_SAMPLE_USER;
+    s.depth = depth;
+    s.pc = pc;
+
+    profile_record(buf, KPROF_TYPE_SAMPLE, &s, sizeof(s), chain,
+                   depth * sizeof(void*));
+}
 
-        profile_record_sample(p, pc);
+static void profile_sample(struct proc* p, int in_kernel, void* pc, reg_t fp)
+{
+    struct kprof_cpu_buf* buf = &kprof_bufs[cpuid];
+
+    if (!kprofiling) return;
+
+    /* no locks here, we may have interrupted a lock holder */
+    if (p == get_cpulocal_var_ptr(idle_proc)) {
+        buf->idle_samples++;
     } else {
-        kprof_info.user_samples++;
-    }
-    kprof_info.total_samples++;
+        if (p->priv->flags & PRF_PRIV_PROC || p->endpoint == KERNEL) {
+            buf->system_samples++;
+        } else {
+            buf->user_samples++;
+        }
 
-    unlock_proc(p);
+        profile_record_proc(buf, p);
+        profile_record_sample(buf, p, in_kernel, pc, fp);
+    }
+    buf->total_samples++;
 }
 
 static int profile_clock_handler(irq_hook_t* hook)
 {
     struct proc* p = get_cpulocal_var(proc_ptr);
 
-    profile_sample(p,
+    profile_sample(p, FALSE,
 #ifdef __i386__
-                   (void*)p->regs.ip
+                   (void*)p->regs.ip, p->regs.bp
 #elif defined(__x86_64)
-                   (void*)p->regs.ip
+                   (void*)p->regs.ip, p->regs.bp
 #elif defined(__riscv)
-                   (void*)p->regs.sepc
+                   (void*)p->regs.sepc, 0
 #elif defined(__aarch64__)
-                   (void*)0
+                   (void*)0, 0
 #endif
     );
 
@@ -126,26 +200,118 @@ void stop_profile_clock()
     rm_irq_handler(&profile_clock_irq_hook);
 }
 
-void nmi_profile_handler(int in_kernel, void* pc)
+void nmi_profile_handler(int in_kernel, void* pc, reg_t fp)
 {
     struct proc* p = get_cpulocal_var(proc_ptr);
 
     if (in_kernel) {
-        struct proc* kp;
         struct proc* idle = get_cpulocal_var_ptr(idle_proc);
 
         if (p == idle) {
-            kprof_info.idle_samples++;
-            kprof_info.total_samples++;
+            profile_sample(p, in_kernel, pc, fp);
             return;
         }
 
-        kp = endpt_proc(KERNEL);
-
-        profile_sample(kp, pc);
+        profile_sample(endpt_proc(KERNEL), in_kernel, pc, fp);
     } else {
-        profile_sample(p, pc);
+        profile_sample(p, in_kernel, pc, fp);
+    }
+}
+
+/* Must be called while sampling is stopped. */
+void profile_reset(void)
+{
+    int cpu, i;
+
+    for (cpu = 0; cpu < CONFIG_SMP_MAX_CPUS; cpu++) {
+        struct kprof_cpu_buf* buf = &kprof_bufs[cpu];
+
+        buf->head = buf->tail = 0;
+        buf->idle_samples = buf->system_samples = buf->user_samples = 0;
+        buf->total_samples = buf->dropped_samples = 0;
+
+        for (i = 0; i < NR_TASKS + NR_PROCS; i++) {
+            buf->recorded[i] = NO_TASK;
+        }
     }
 }
 
+/* Length of the record at offset off from the tail of buf. */
+static size_t record_length(struct kprof_cpu_buf* buf, size_t off)
+{
+    u8 tag;
+    struct kprof_sample s;
+
+    ring_peek(buf, off, &tag, 1);
+
+    switch (tag) {
+    case KPROF_TYPE_PROC:
+        return 1 + sizeof(struct kprof_proc);
+    case KPROF_TYPE_SAMPLE:
+        ring_peek(buf, off + 1, &s, sizeof(s));
+        return 1 + sizeof(s) + s.depth * sizeof(void*);
+    }
+
+    panic("profile: corrupted sample buffer on CPU %d",
+          (int)(buf - kprof_bufs));
+    return 0;
+}
+
+/**
+ * Move whole records from every CPU's ring into the buffer of endpt while
+ * sampling continues. On return info->mem_used holds the number of bytes
+ * copied and the counters hold the totals since profiling started.
+ */
+int profile_drain(endpoint_t endpt, void* dest, size_t size,
+                  struct kprof_info* info)
+{
+    int cpu, retval;
+    size_t copied = 0;
+
+    memset(info, 0, sizeof(*info));
+
+    for (cpu = 0; cpu < CONFIG_SMP_MAX_CPUS; cpu++) {
+        struct kprof_cpu_buf* buf = &kprof_bufs[cpu];
+        size_t avail, len = 0, rec, tail, chunk;
+
+        avail = ring_used(buf);
+        __sync_synchronize();
+
+        while (len < avail) {
+            rec = record_length(buf, len);
+            if (copied + len + rec > size) break;
+            len += rec;
+        }
+
+        tail = buf->tail;
+        chunk = min(len, KPROF_CPU_BUFSIZE - tail);
+
+        if (chunk > 0) {
+            retval = data_vir_copy(endpt, dest + copied, KERNEL,
+                                   &buf->data[tail], chunk);
+            if (retval) return retval;
+        }
+        if (len > chunk) {
+            retval = data_vir_copy(endpt, dest + copied + chunk, KERNEL,
+                                   &buf->data[0], len - chunk);
+            if (retval) return retval;
+        }
+
+        /* finish reading the records before handing the space back */
+        __sync_synchronize();
+        buf->tail = (tail + len) % KPROF_CPU_BUFSIZE;
+        copied += len;
+
+        info->idle_samples += buf->idle_samples;
+        info->system_samples += buf->system_samples;
+        info->user_samples += buf->user_samples;
+        info->total_samples += buf->total_samples;
+        info->dropped_samples += buf->dropped_samples;
+    }
+
+    info->mem_used = copied;
+
+    return 0;
+}
+
 #endif
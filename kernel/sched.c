@@ -132,6 +132,21 @@ void dequeue_proc(struct proc* p)
     if (list_empty(&runqs[queue])) UNSET_BIT(bitmap, queue);
 }
 
+/**
+ * <Ring 0> Check whether no proc is waiting to run on this CPU.
+ */
+int sched_queue_empty(void)
+{
+    bitchunk_t* bitmap = get_cpulocal_var(run_queue_bitmap);
+    int i;
+
+    for (i = 0; i < BITCHUNKS(SCHED_QUEUES); i++) {
+        if (bitmap[i]) return FALSE;
+    }
+
+    return TRUE;
+}
+
 /**
  * <Ring 0> Called when a process has run out its counter.
  */
@@ -28,13 +28,46 @@ static void sig_alarm(struct timer_list* timer)
     msg_notify(proc_addr(CLOCK), (endpoint_t)(unsigned long)timer->arg);
 }
 
+static void sig_hralarm(struct hrtimer* timer)
+{
+    msg_notify(proc_addr(CLOCK), (endpoint_t)(unsigned long)timer->arg);
+}
+
+static int sys_alarm_ns(MESSAGE* m, struct proc* p_proc)
+{
+    u64 expire_ns = m->EXP_TIME;
+    int absolute_time = m->ABS_TIME & ALARM_ABS;
+    u64 now = clock_get_ns();
+
+    struct hrtimer* tp;
+    tp = &(p_proc->priv->hrtimer);
+    tp->arg = (void*)(unsigned long)p_proc->endpoint;
+    tp->callback = sig_hralarm;
+
+    if ((tp->expires != HRTIMER_UNSET) && (tp->expires > now))
+        m->TIME_LEFT = tp->expires - now;
+    else
+        m->TIME_LEFT = 0;
+
+    if (expire_ns == 0) {
+        reset_sys_hrtimer(tp);
+    } else {
+        tp->expires = absolute_time ? expire_ns : now + expire_ns;
+        set_sys_hrtimer(tp);
+    }
+
+    return 0;
+}
+
 int sys_alarm(MESSAGE* m, struct proc* p_proc)
 {
     clock_t expire_time = m->EXP_TIME;
-    int absolute_time = m->ABS_TIME;
+    int absolute_time = m->ABS_TIME & ALARM_ABS;
 
     if (!(p_proc->priv->flags & PRF_PRIV_PROC)) return EPERM;
 
+    if (m->ABS_TIME & ALARM_NS) return sys_alarm_ns(m, p_proc);
+
     struct timer_list* tp;
     tp = &(p_proc->priv->timer);
     tp->arg = (void*)(unsigned long)p_proc->endpoint;
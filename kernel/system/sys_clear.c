@@ -17,6 +17,7 @@
 #include <lyos/ipc.h>
 #include "lyos/const.h"
 #include <kernel/proc.h>
+#include <kernel/global.h>
 #include <kernel/proto.h>
 #include <asm/page.h>
 #include <errno.h>
@@ -29,6 +30,7 @@ int sys_clear(MESSAGE* m, struct proc* p_proc)
 
     struct proc* p = proc_addr(slot);
     PST_SETFLAGS(p, PST_FREE_SLOT);
+    __sync_fetch_and_add(&proc_table_gen, 1);
 
     release_fpu(p);
     p->flags &= ~PF_FPU_INITIALIZED;
@@ -18,6 +18,7 @@
 #include "lyos/const.h"
 #include "string.h"
 #include <kernel/proc.h>
+#include <kernel/global.h>
 #include <kernel/proto.h>
 #include <asm/page.h>
 #include <errno.h>
@@ -47,6 +48,7 @@ int sys_exec(MESSAGE* m, struct proc* p_proc)
         goto out;
 
     arch_init_proc(p, m->KEXEC_SP, m->KEXEC_IP, &ps, name);
+    __sync_fetch_and_add(&proc_table_gen, 1);
 
     release_fpu(p);
     p->flags &= ~PF_FPU_INITIALIZED;
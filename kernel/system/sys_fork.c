@@ -87,7 +87,10 @@ int sys_fork(MESSAGE* m, struct proc* p_proc)
 
     retval = arch_fork_proc(child, parent, flags, newsp, tls);
 
-    if (retval == OK) kfi->child = child_ep;
+    if (retval == OK) {
+        kfi->child = child_ep;
+        __sync_fetch_and_add(&proc_table_gen, 1);
+    }
 
     unlock_proc(parent);
     unlock_proc(child);
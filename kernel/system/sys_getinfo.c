@@ -38,6 +38,7 @@ int sys_getinfo(MESSAGE* m, struct proc* p_proc)
     size_t size = 0;
     u64 ticks[CPU_STATES];
     unsigned int cpu;
+    int slot;
 
     switch (request) {
     case GETINFO_SYSINFO:
@@ -82,6 +83,19 @@ int sys_getinfo(MESSAGE* m, struct proc* p_proc)
         addr = (void*)ticks;
         size = sizeof(ticks);
         break;
+    case GETINFO_PROCTAB_GEN:
+        m->RETVAL = proc_table_gen;
+        return 0;
+    case GETINFO_PROC:
+        slot = m->u.m3.m3i1;
+
+        if (slot < -NR_TASKS || slot >= NR_PROCS) {
+            return EINVAL;
+        }
+
+        addr = (void*)proc_addr(slot);
+        size = sizeof(struct proc);
+        break;
     default:
         return EINVAL;
     }
@@ -27,12 +27,26 @@
 
 DEF_SPINLOCK(kprofile_lock);
 
-static void clear_recorded_flag()
+static int drain(MESSAGE* m)
 {
-    int i;
-    for (i = 0; i < NR_TASKS + NR_PROCS; i++) {
-        proc_table[i].flags &= ~PF_PROFILE_RECORDED;
-    }
+    struct kprof_info info;
+    int retval;
+
+    retval = profile_drain(m->KP_ENDPT, m->KP_BUF, m->KP_SIZE, &info);
+    if (retval) return retval;
+
+    return data_vir_copy(m->KP_ENDPT, m->KP_CTL, KERNEL, &info, sizeof(info));
+}
+
+static int ipc_drain(MESSAGE* m)
+{
+    struct kprof_ipc_info info;
+    int retval;
+
+    retval = ipctrace_drain(m->KP_ENDPT, m->KP_BUF, m->KP_SIZE, &info);
+    if (retval) return retval;
+
+    return data_vir_copy(m->KP_ENDPT, m->KP_CTL, KERNEL, &info, sizeof(info));
 }
 
 int sys_kprofile(MESSAGE* m, struct proc* p_proc)
@@ -50,31 +64,51 @@ int sys_kprofile(MESSAGE* m, struct proc* p_proc)
             goto out;
         }
 
-        memset(&kprof_info, 0, sizeof(kprof_info));
-
-        clear_recorded_flag();
+        profile_reset();
         init_profile_nmi(freq);
 
         kprofiling = 1;
         break;
     }
+    case KPROF_DRAIN:
+        if (!kprofiling) {
+            ret = EBUSY;
+            goto out;
+        }
+
+        ret = drain(m);
+        break;
     case KPROF_STOP: {
-        if (!kprofiling) return EBUSY;
+        if (!kprofiling) {
+            ret = EBUSY;
+            goto out;
+        }
         kprofiling = 0;
 
         stop_profile_nmi();
 
-        int memsize = m->KP_SIZE;
-        if (memsize > kprof_info.mem_used) {
-            memsize = kprof_info.mem_used;
+        ret = drain(m);
+        break;
+    }
+    case KPROF_IPC_START:
+        if (ipc_tracing) {
+            ret = EBUSY;
+            goto out;
         }
 
-        data_vir_copy(m->KP_ENDPT, m->KP_CTL, KERNEL, &kprof_info,
-                      sizeof(kprof_info));
-        data_vir_copy(m->KP_ENDPT, m->KP_BUF, KERNEL, profile_sample_buf,
-                      memsize);
+        ipctrace_reset();
+        ipc_tracing = 1;
+        break;
+    case KPROF_IPC_DRAIN:
+    case KPROF_IPC_STOP:
+        if (!ipc_tracing) {
+            ret = EBUSY;
+            goto out;
+        }
+        if (action == KPROF_IPC_STOP) ipc_tracing = 0;
+
+        ret = ipc_drain(m);
         break;
-    }
     default:
         ret = EINVAL;
         goto out;
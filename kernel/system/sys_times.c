@@ -26,7 +26,10 @@ extern clock_t idle_ticks;
 int sys_times(MESSAGE* m, struct proc* p_proc)
 {
     m->BOOT_TICKS = jiffies;
-    m->IDLE_TICKS = idle_ticks;
+    if (m->TIMES_FLAGS & TIMES_NS)
+        m->BOOT_NS = clock_get_ns();
+    else
+        m->IDLE_TICKS = idle_ticks;
 
     return 0;
 }
@@ -63,12 +63,12 @@ void stop_profile_nmi(void)
     }
 }
 
-void nmi_watchdog_handler(int in_kernel, void* pc)
+void nmi_watchdog_handler(int in_kernel, void* pc, reg_t fp)
 {
     /* no locks are allowed in NMI handler */
 #if CONFIG_PROFILING
     if (kprofiling) {
-        nmi_profile_handler(in_kernel, pc);
+        nmi_profile_handler(in_kernel, pc, fp);
     }
 
     if ((watchdog_enabled || kprofiling) && watchdog->reset) {
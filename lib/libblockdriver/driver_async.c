@@ -49,7 +49,7 @@ static struct blockdriver* bdr = NULL;
 static void enqueue(const MESSAGE* msg)
 {
     if (!mq_enqueue(msg)) {
-        panic("%s: message queue full", name);
+        panic("%s: failed to grow message queue", name);
     }
 
     if (coro_mutex_lock(&queue_event_mutex) != 0) {
@@ -241,6 +241,10 @@ static void yield_all(void)
     coro_yield_all();
 
     self = NULL;
+
+    /* every worker has either finished or blocked on I/O, so the requests
+     * queued during this round form one batch */
+    if (bdr->bdr_unplug) bdr->bdr_unplug();
 }
 
 void blockdriver_async_sleep(void)
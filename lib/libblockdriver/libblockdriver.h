@@ -6,6 +6,7 @@
 #include <lyos/partition.h>
 #include <lyos/driver.h>
 #include <sys/uio.h>
+#include <lyos/list.h>
 
 #include <libdevman/libdevman.h>
 
@@ -32,8 +33,26 @@ struct blockdriver {
     void (*bdr_intr)(unsigned mask);
     void (*bdr_alarm)(clock_t timestamp);
     void (*bdr_other)(MESSAGE* msg);
+    void (*bdr_unplug)(void);
 };
 
+/* A request held back in a plug list until the end of the batch. */
+struct blockdriver_req {
+    struct list_head list;
+    int do_write;
+    u64 sector;
+    size_t nr_sectors;
+    unsigned int nr_segs;
+};
+
+struct blockdriver_plug {
+    struct list_head list;
+    unsigned int nr_reqs;
+};
+
+typedef void (*blockdriver_submit_t)(struct blockdriver_req** reqs,
+                                     unsigned int count, void* arg);
+
 void blockdriver_process(struct blockdriver* bd, MESSAGE* msg);
 void blockdriver_task(struct blockdriver* bd);
 
@@ -44,6 +63,12 @@ void blockdriver_async_sleep(void);
 void blockdriver_async_wakeup(blockdriver_worker_id_t tid);
 void blockdriver_async_set_workers(size_t num_workers);
 
+void blockdriver_plug_init(struct blockdriver_plug* plug);
+void blockdriver_plug_add(struct blockdriver_plug* plug,
+                          struct blockdriver_req* req);
+void blockdriver_unplug(struct blockdriver_plug* plug, unsigned int max_segs,
+                        blockdriver_submit_t submit, void* arg);
+
 void partition(struct blockdriver* bd, int device, int style);
 
 int blockdriver_device_register(struct device_info* devinf, device_id_t* id);
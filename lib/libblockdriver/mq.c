@@ -1,9 +1,11 @@
 #include <lyos/ipc.h>
+#include <stdlib.h>
 #include <errno.h>
 #include <lyos/const.h>
 #include <lyos/list.h>
 
 #define MQ_SIZE 128
+#define MQ_GROW 32
 
 struct mq_entry {
     struct list_head list;
@@ -28,11 +30,29 @@ void mq_init(void)
     }
 }
 
+/* The static entries cover the usual load; bursts beyond that get more
+ * entries from the heap, which stay on the free list afterwards. */
+static int mq_grow(void)
+{
+    struct mq_entry* mqe;
+    int i;
+
+    mqe = calloc(MQ_GROW, sizeof(*mqe));
+    if (!mqe) return FALSE;
+
+    for (i = 0; i < MQ_GROW; i++) {
+        INIT_LIST_HEAD(&mqe[i].list);
+        list_add(&mqe[i].list, &free_list);
+    }
+
+    return TRUE;
+}
+
 int mq_enqueue(const MESSAGE* msg)
 {
     struct mq_entry* mqe;
 
-    if (list_empty(&free_list)) {
+    if (list_empty(&free_list) && !mq_grow()) {
         return FALSE;
     }
 
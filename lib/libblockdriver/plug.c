@@ -0,0 +1,86 @@
+/*  This file is part of Lyos.
+
+    Lyos is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Lyos is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Lyos.  If not, see <http://www.gnu.org/licenses/>. */
+
+#include <lyos/types.h>
+#include <lyos/ipc.h>
+#include <lyos/const.h>
+#include <lyos/list.h>
+
+#include <libblockdriver/libblockdriver.h>
+
+void blockdriver_plug_init(struct blockdriver_plug* plug)
+{
+    INIT_LIST_HEAD(&plug->list);
+    plug->nr_reqs = 0;
+}
+
+/* Queue a request until the next unplug. The list is kept sorted by sector so
+ * adjacent requests from different workers end up next to each other. */
+void blockdriver_plug_add(struct blockdriver_plug* plug,
+                          struct blockdriver_req* req)
+{
+    struct list_head* pos;
+    struct blockdriver_req* prev;
+
+    for (pos = plug->list.prev; pos != &plug->list; pos = pos->prev) {
+        prev = list_entry(pos, struct blockdriver_req, list);
+        if (prev->sector <= req->sector) break;
+    }
+
+    list_add(&req->list, pos);
+    plug->nr_reqs++;
+}
+
+static int can_merge(const struct blockdriver_req* prev,
+                     const struct blockdriver_req* next, unsigned int nr_segs,
+                     unsigned int max_segs)
+{
+    return prev->do_write == next->do_write &&
+           prev->sector + prev->nr_sectors == next->sector &&
+           nr_segs + next->nr_segs <= max_segs;
+}
+
+/* Hand the queued requests to the driver, merging runs of contiguous requests
+ * in the same direction into one submission of at most max_segs segments. */
+void blockdriver_unplug(struct blockdriver_plug* plug, unsigned int max_segs,
+                        blockdriver_submit_t submit, void* arg)
+{
+    struct blockdriver_req* reqs[NR_IOREQS];
+    struct blockdriver_req* req;
+    unsigned int count, nr_segs;
+
+    if (max_segs > NR_IOREQS) max_segs = NR_IOREQS;
+
+    while (!list_empty(&plug->list)) {
+        req = list_first_entry(&plug->list, struct blockdriver_req, list);
+        list_del(&req->list);
+
+        reqs[0] = req;
+        count = 1;
+        nr_segs = req->nr_segs;
+
+        while (!list_empty(&plug->list) && count < NR_IOREQS) {
+            req = list_first_entry(&plug->list, struct blockdriver_req, list);
+            if (!can_merge(reqs[count - 1], req, nr_segs, max_segs)) break;
+
+            list_del(&req->list);
+            reqs[count++] = req;
+            nr_segs += req->nr_segs;
+        }
+
+        plug->nr_reqs -= count;
+        submit(reqs, count, arg);
+    }
+}
@@ -318,6 +318,10 @@ static int drm_atomic_get_plane_state(struct drm_atomic_state* state,
     assert(plane->state);
     memcpy(plane_state, plane->state, sizeof(*plane_state));
 
+    /* damage does not carry over to the next commit */
+    plane_state->fb_damage_clips = NULL;
+    plane_state->num_fb_damage_clips = 0;
+
     state->planes[index].ptr = plane;
     state->planes[index].state = plane_state;
     state->planes[index].old_state = plane->state;
@@ -379,11 +383,15 @@ static int drm_atomic_swap_state(struct drm_atomic_state* state)
     int i;
 
     for (i = 0; i < dev->mode_config.num_crtc; i++) {
+        if (!state->crtcs[i].ptr) continue;
+
         state->crtcs[i].state = state->crtcs[i].old_state;
         state->crtcs[i].ptr->state = state->crtcs[i].new_state;
     }
 
     for (i = 0; i < dev->mode_config.num_total_plane; i++) {
+        if (!state->planes[i].ptr) continue;
+
         state->planes[i].state = state->planes[i].old_state;
         state->planes[i].ptr->state = state->planes[i].new_state;
     }
@@ -479,3 +487,42 @@ out:
 
     return retval;
 }
+
+/**
+ * Commit an update of every plane that scans out fb, with clips as the
+ * damaged areas. No clips means the whole framebuffer is damaged.
+ */
+int drm_atomic_helper_dirtyfb(struct drm_device* dev,
+                              struct drm_framebuffer* fb,
+                              const struct drm_mode_rect* clips,
+                              unsigned int num_clips)
+{
+    struct drm_atomic_state state;
+    struct drm_plane* plane;
+    struct drm_plane_state* plane_state;
+    int found = FALSE;
+    int retval;
+
+    retval = drm_atomic_state_init(dev, &state);
+    if (retval) return retval;
+
+    drm_for_each_plane(plane, dev)
+    {
+        if (!plane->state || plane->state->fb != fb) continue;
+
+        retval = drm_atomic_get_plane_state(&state, plane, &plane_state);
+        if (retval) goto out;
+
+        plane_state->fb_damage_clips = clips;
+        plane_state->num_fb_damage_clips = num_clips;
+        found = TRUE;
+    }
+
+    if (found) retval = drm_atomic_commit(&state);
+
+out:
+    drm_atomic_state_clear(&state);
+    drm_atomic_state_release(&state);
+
+    return retval;
+}
@@ -82,6 +82,21 @@ int drm_framebuffer_init(struct drm_device* dev, struct drm_framebuffer* fb)
     return 0;
 }
 
+void drm_helper_mode_fill_fb_struct(struct drm_framebuffer* fb,
+                                    const struct drm_mode_fb_cmd2* cmd)
+{
+    int i;
+
+    fb->format = cmd->pixel_format;
+    fb->width = cmd->width;
+    fb->height = cmd->height;
+
+    for (i = 0; i < 4; i++) {
+        fb->pitches[i] = cmd->pitches[i];
+        fb->offsets[i] = cmd->offsets[i];
+    }
+}
+
 static int drm_framebuffer_create(struct drm_device* dev,
                                   const struct drm_mode_fb_cmd2* r,
                                   struct drm_framebuffer** fbp)
@@ -146,3 +161,54 @@ int drm_mode_addfb2_ioctl(struct drm_device* dev, endpoint_t endpoint,
 {
     return drm_mode_addfb2(dev, endpoint, data);
 }
+
+int drm_mode_dirtyfb_ioctl(struct drm_device* dev, endpoint_t endpoint,
+                           void* data)
+{
+    struct drm_mode_fb_dirty_cmd* r = data;
+    struct drm_framebuffer* fb;
+    struct drm_clip_rect* clips = NULL;
+    struct drm_mode_rect* rects = NULL;
+    unsigned int num_clips = r->num_clips;
+    int i, retval;
+
+    fb = drm_framebuffer_lookup(dev, r->fb_id);
+    if (!fb) return ENOENT;
+
+    if (!num_clips != !r->clips_ptr) return EINVAL;
+    if (r->flags & ~DRM_MODE_FB_DIRTY_FLAGS) return EINVAL;
+    if (num_clips > DRM_MODE_FB_DIRTY_MAX_CLIPS) return EINVAL;
+
+    /* copy annotations come in src/dst pairs, both are treated as damage */
+    if ((r->flags & DRM_MODE_FB_DIRTY_ANNOTATE_COPY) && (num_clips % 2))
+        return EINVAL;
+
+    if (num_clips) {
+        clips = calloc(num_clips, sizeof(*clips));
+        rects = calloc(num_clips, sizeof(*rects));
+        if (!clips || !rects) {
+            retval = ENOMEM;
+            goto out;
+        }
+
+        retval = data_copy(SELF, clips, endpoint,
+                           (void*)(uintptr_t)r->clips_ptr,
+                           num_clips * sizeof(*clips));
+        if (retval) goto out;
+
+        for (i = 0; i < num_clips; i++) {
+            rects[i].x1 = clips[i].x1;
+            rects[i].y1 = clips[i].y1;
+            rects[i].x2 = clips[i].x2;
+            rects[i].y2 = clips[i].y2;
+        }
+    }
+
+    retval = drm_atomic_helper_dirtyfb(dev, fb, rects, num_clips);
+
+out:
+    if (clips) free(clips);
+    if (rects) free(rects);
+
+    return retval;
+}
@@ -46,12 +46,104 @@ void drm_helper_commit_planes(struct drm_device* dev,
         struct drm_plane_helper_funcs* funcs;
 
         plane = old_state->planes[i].ptr;
+        if (!plane) continue;
+
         funcs = plane->helper_funcs;
 
         funcs->update(plane, old_state->planes[i].old_state);
     }
 }
 
+static int drm_rect_intersect(struct drm_mode_rect* r,
+                              const struct drm_mode_rect* clip)
+{
+    r->x1 = max(r->x1, clip->x1);
+    r->y1 = max(r->y1, clip->y1);
+    r->x2 = min(r->x2, clip->x2);
+    r->y2 = min(r->y2, clip->y2);
+
+    return r->x1 < r->x2 && r->y1 < r->y2;
+}
+
+/**
+ * Iterate over the damaged areas of a plane update, clipped to the plane
+ * source. The whole source is damaged if no clips are given or the
+ * framebuffer or source changed. Nothing is damaged if the plane is off.
+ */
+void drm_atomic_helper_damage_iter_init(
+    struct drm_atomic_helper_damage_iter* iter,
+    const struct drm_plane_state* old_state,
+    const struct drm_plane_state* state)
+{
+    memset(iter, 0, sizeof(*iter));
+
+    if (!state || !state->crtc || !state->fb) return;
+
+    iter->plane_src.x1 = state->src_x >> 16;
+    iter->plane_src.y1 = state->src_y >> 16;
+    iter->plane_src.x2 = iter->plane_src.x1 + (state->src_w >> 16);
+    iter->plane_src.y2 = iter->plane_src.y1 + (state->src_h >> 16);
+
+    iter->clips = state->fb_damage_clips;
+    iter->num_clips = state->num_fb_damage_clips;
+
+    if (!iter->clips || !iter->num_clips || old_state->fb != state->fb ||
+        old_state->src_x != state->src_x || old_state->src_y != state->src_y ||
+        old_state->src_w != state->src_w || old_state->src_h != state->src_h) {
+        iter->clips = NULL;
+        iter->num_clips = 0;
+        iter->full_update = TRUE;
+    }
+}
+
+int drm_atomic_helper_damage_iter_next(
+    struct drm_atomic_helper_damage_iter* iter, struct drm_mode_rect* rect)
+{
+    if (iter->full_update) {
+        *rect = iter->plane_src;
+        iter->full_update = FALSE;
+        return TRUE;
+    }
+
+    while (iter->curr_clip < iter->num_clips) {
+        *rect = iter->clips[iter->curr_clip++];
+
+        if (drm_rect_intersect(rect, &iter->plane_src)) return TRUE;
+    }
+
+    return FALSE;
+}
+
+/**
+ * Get the bounding box of all damaged areas. Returns FALSE if there is
+ * nothing to update.
+ */
+int drm_atomic_helper_damage_merged(const struct drm_plane_state* old_state,
+                                    const struct drm_plane_state* state,
+                                    struct drm_mode_rect* rect)
+{
+    struct drm_atomic_helper_damage_iter iter;
+    struct drm_mode_rect clip;
+    int valid = FALSE;
+
+    drm_atomic_helper_damage_iter_init(&iter, old_state, state);
+
+    while (drm_atomic_helper_damage_iter_next(&iter, &clip)) {
+        if (!valid) {
+            *rect = clip;
+            valid = TRUE;
+            continue;
+        }
+
+        rect->x1 = min(rect->x1, clip.x1);
+        rect->y1 = min(rect->y1, clip.y1);
+        rect->x2 = max(rect->x2, clip.x2);
+        rect->y2 = max(rect->y2, clip.y2);
+    }
+
+    return valid;
+}
+
 int drm_mode_page_flip_ioctl(struct drm_device* dev, endpoint_t endpoint,
                              void* data)
 {
@@ -25,6 +25,7 @@ int fsdriver_is_clean(struct fsdriver_buffer* bp);
 void fsdriver_init_buffer_cache(size_t new_size);
 int fsdriver_get_block(struct fsdriver_buffer** bpp, dev_t dev, block_t block);
 void fsdriver_put_block(struct fsdriver_buffer* bp);
+void fsdriver_put_block_once(struct fsdriver_buffer* bp);
 void fsdriver_flush_dev(dev_t dev);
 void fsdriver_flush_all(void);
 
@@ -40,7 +40,7 @@ static inline void remove_lru(struct fsdriver_buffer* bp)
 
 static int get_block(struct fsdriver_buffer** bpp, dev_t dev, block_t block,
                      size_t block_size);
-static void put_block(struct fsdriver_buffer* bp);
+static void put_block(struct fsdriver_buffer* bp, int one_shot);
 static int read_block(struct fsdriver_buffer* bp, size_t block_size);
 
 static struct fsdriver_buffer* find_block(dev_t dev, block_t block)
@@ -133,7 +133,7 @@ static int get_block(struct fsdriver_buffer** bpp, dev_t dev, block_t block,
     retval = alloc_block(bp, block_size);
     if (retval) {
         bp->dev = NO_DEV;
-        put_block(bp);
+        put_block(bp, FALSE);
 
         return retval;
     }
@@ -141,7 +141,7 @@ static int get_block(struct fsdriver_buffer** bpp, dev_t dev, block_t block,
     retval = read_block(bp, block_size);
     if (retval) {
         bp->dev = NO_DEV;
-        put_block(bp);
+        put_block(bp, FALSE);
     }
 
     hash = block & BUFFER_HASH_MASK;
@@ -153,7 +153,7 @@ static int get_block(struct fsdriver_buffer** bpp, dev_t dev, block_t block,
     return 0;
 }
 
-static void put_block(struct fsdriver_buffer* bp)
+static void put_block(struct fsdriver_buffer* bp, int one_shot)
 {
     assert(bp->refcnt > 0);
     bp->refcnt--;
@@ -162,7 +162,8 @@ static void put_block(struct fsdriver_buffer* bp)
         return;
     }
 
-    if (bp->dev == NO_DEV) {
+    /* blocks that won't be used again soon are recycled first */
+    if (bp->dev == NO_DEV || (one_shot && fsdriver_is_clean(bp))) {
         list_add_tail(&bp->list, &lru_head);
     } else {
         list_add(&bp->list, &lru_head);
@@ -318,7 +319,15 @@ void fsdriver_put_block(struct fsdriver_buffer* bp)
 {
     if (!bp) return;
 
-    put_block(bp);
+    put_block(bp, FALSE);
+}
+
+/* Release a block holding file data, which the page cache keeps for us. */
+void fsdriver_put_block_once(struct fsdriver_buffer* bp)
+{
+    if (!bp) return;
+
+    put_block(bp, TRUE);
 }
 
 void fsdriver_flush_dev(dev_t dev)
@@ -98,6 +98,9 @@ int fsdriver_start(const struct fsdriver* fsd)
         case FS_UTIME:
             m.RETVAL = fsdriver_utime(fsd, &m);
             break;
+        case FS_MAP:
+            m.u.m_vfs_fs_map.status = fsdriver_map(fsd, &m);
+            break;
         default:
             if (fsd->fs_other) {
                 fsd->fs_other(&m);
@@ -88,6 +88,10 @@ struct fsdriver {
                     const struct timespec* mtime);
     int (*fs_driver)(dev_t dev);
     int (*fs_sync)();
+    /* map [offset, offset + length) of a regular file shared into endpoint;
+     * on ENOSYS MM maps it through its page cache instead */
+    int (*fs_map)(dev_t dev, ino_t num, endpoint_t endpoint, void** vaddr,
+                  loff_t offset, size_t length);
 
     void (*fs_other)(MESSAGE* m);
 } __attribute__((packed));
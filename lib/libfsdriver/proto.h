@@ -22,5 +22,6 @@ int fsdriver_unlink(const struct fsdriver* fsd, MESSAGE* m);
 int fsdriver_rmdir(const struct fsdriver* fsd, MESSAGE* m);
 int fsdriver_utime(const struct fsdriver* fsd, MESSAGE* m);
 int fsdriver_chown(const struct fsdriver* fsd, MESSAGE* m);
+int fsdriver_map(const struct fsdriver* fsd, MESSAGE* m);
 
 #endif
@@ -257,6 +257,25 @@ int fsdriver_chown(const struct fsdriver* fsd, MESSAGE* m)
     return 0;
 }
 
+int fsdriver_map(const struct fsdriver* fsd, MESSAGE* m)
+{
+    dev_t dev = m->u.m_vfs_fs_map.dev;
+    ino_t num = m->u.m_vfs_fs_map.num;
+    endpoint_t endpoint = m->u.m_vfs_fs_map.endpoint;
+    void* vaddr = m->u.m_vfs_fs_map.vaddr;
+    int retval;
+
+    if (fsd->fs_map == NULL) return ENOSYS;
+
+    retval = fsd->fs_map(dev, num, endpoint, &vaddr, m->u.m_vfs_fs_map.offset,
+                         m->u.m_vfs_fs_map.length);
+    if (retval) return retval;
+
+    m->u.m_vfs_fs_map.vaddr = vaddr;
+
+    return 0;
+}
+
 int fsdriver_getdents(const struct fsdriver* fsd, MESSAGE* m)
 {
     struct fsdriver_data data;
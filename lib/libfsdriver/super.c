@@ -95,6 +95,7 @@ int fsdriver_readsuper(const struct fsdriver* fsd, MESSAGE* m)
     m->u.m_fs_vfs_create_reply.size = fn.fn_size;
     m->u.m_fs_vfs_create_reply.uid = fn.fn_uid;
     m->u.m_fs_vfs_create_reply.gid = fn.fn_gid;
+    m->u.m_fs_vfs_create_reply.flags = ctx.sb_flags & RF_PAGECACHE;
 
 out:
     free(options);
@@ -29,3 +29,12 @@ int kernel_alarm2(clock_t expire_time, int abs_time, clock_t* time_left)
     if (time_left) *time_left = m.TIME_LEFT;
     return 0;
 }
+
+int kernel_alarm_ns(u64 expire_ns, int flags)
+{
+    MESSAGE m;
+    m.EXP_TIME = expire_ns;
+    m.ABS_TIME = flags | ALARM_NS;
+
+    return syscall_entry(NR_ALARM, &m);
+}
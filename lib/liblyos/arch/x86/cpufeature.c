@@ -98,6 +98,8 @@ int _cpufeature(int cpufeature)
         return ecx & CPUID1_ECX_X2APIC;
     case _CPUF_I386_XSAVE:
         return ecx & CPUID1_ECX_XSAVE;
+    case _CPUF_I386_PCID:
+        return ecx & CPUID1_ECX_PCID;
     case _CPUF_I386_HTT:
         return edx & CPUID1_EDX_HTT;
     case _CPUF_I386_HTT_MAX_NUM:
@@ -83,3 +83,24 @@ int get_cputicks(unsigned int cpu, u64* ticks)
 
     return syscall_entry(NR_GETINFO, &m);
 }
+
+unsigned int get_proctab_gen()
+{
+    MESSAGE m;
+    m.REQUEST = GETINFO_PROCTAB_GEN;
+
+    syscall_entry(NR_GETINFO, &m);
+
+    return m.RETVAL;
+}
+
+int get_proc(int proc_nr, struct proc* proc)
+{
+    MESSAGE m;
+    m.REQUEST = GETINFO_PROC;
+    m.u.m3.m3i1 = proc_nr;
+    m.BUF = proc;
+    m.BUF_LEN = 0;
+
+    return syscall_entry(NR_GETINFO, &m);
+}
@@ -39,3 +39,44 @@ int get_meminfo(struct mem_info* mem_info)
 
     return msg.RETVAL;
 }
+
+int mm_get_regioninfo(endpoint_t who, void* addr, struct mm_region_info* info)
+{
+    MESSAGE msg;
+    struct mm_region_info buf;
+
+    if (!info) return EINVAL;
+
+    msg.type = MM_GETINFO;
+    msg.REQUEST = MM_GET_REGIONINFO;
+    msg.MM_GETINFO_WHO = who;
+    msg.MM_GETINFO_ADDR = addr;
+    msg.BUF = &buf;
+    msg.BUF_LEN = sizeof(buf);
+
+    send_recv(BOTH, TASK_MM, &msg);
+
+    if (msg.RETVAL == 0) *info = buf;
+
+    return msg.RETVAL;
+}
+
+int mm_get_procinfo(endpoint_t who, struct mm_proc_info* info)
+{
+    MESSAGE msg;
+    struct mm_proc_info buf;
+
+    if (!info) return EINVAL;
+
+    msg.type = MM_GETINFO;
+    msg.REQUEST = MM_GET_PROCINFO;
+    msg.MM_GETINFO_WHO = who;
+    msg.BUF = &buf;
+    msg.BUF_LEN = sizeof(buf);
+
+    send_recv(BOTH, TASK_MM, &msg);
+
+    if (msg.RETVAL == 0) *info = buf;
+
+    return msg.RETVAL;
+}
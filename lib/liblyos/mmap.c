@@ -17,6 +17,7 @@
 #include <lyos/ipc.h>
 #include "lyos/const.h"
 #include <sys/mman.h>
+#include <lyos/vm.h>
 #include <string.h>
 
 void* mmap_for(endpoint_t forwhom, void* addr, size_t len, int prot, int flags,
@@ -41,6 +42,22 @@ void* mmap_for(endpoint_t forwhom, void* addr, size_t len, int prot, int flags,
     return m.u.m_mm_mmap_reply.retaddr;
 }
 
+int munmap_for(endpoint_t forwhom, void* addr, size_t len)
+{
+    MESSAGE m;
+
+    memset(&m, 0, sizeof(MESSAGE));
+
+    m.type = MUNMAP;
+    m.u.m_mm_mmap.who = forwhom;
+    m.u.m_mm_mmap.vaddr = addr;
+    m.u.m_mm_mmap.length = len;
+
+    send_recv(BOTH, TASK_MM, &m);
+
+    return m.RETVAL;
+}
+
 int vfs_mmap(endpoint_t who, off_t offset, size_t len, dev_t dev, ino_t ino,
              int fd, void* vaddr, int flags, int prot, size_t clearend)
 {
@@ -65,6 +82,27 @@ int vfs_mmap(endpoint_t who, off_t offset, size_t len, dev_t dev, ino_t ino,
     return m.u.m_mm_mmap_reply.retval;
 }
 
+int vfs_mmap_batch(endpoint_t who, dev_t dev, ino_t ino, int fd, int flags,
+                   const struct vfs_mmap_seg* segs, int nr_segs)
+{
+    MESSAGE m;
+
+    memset(&m, 0, sizeof(MESSAGE));
+
+    m.type = MM_MMAP_BATCH;
+    m.u.m_mm_mmap.who = who;
+    m.u.m_mm_mmap.dev = dev;
+    m.u.m_mm_mmap.ino = ino;
+    m.u.m_mm_mmap.fd = fd;
+    m.u.m_mm_mmap.flags = flags;
+    m.u.m_mm_mmap.vaddr = (void*)segs;
+    m.u.m_mm_mmap.length = nr_segs;
+
+    send_recv(BOTH, TASK_MM, &m);
+
+    return m.u.m_mm_mmap_reply.retval;
+}
+
 void* mm_remap(endpoint_t dest, endpoint_t src, void* dest_addr, void* src_addr,
                size_t size)
 {
@@ -80,5 +118,83 @@ void* mm_remap(endpoint_t dest, endpoint_t src, void* dest_addr, void* src_addr,
 
     send_recv(BOTH, TASK_MM, &m);
 
+    if (m.RETVAL) return MAP_FAILED;
     return m.u.m_mm_remap.ret_addr;
 }
+
+int mm_page_cache_read(dev_t dev, ino_t ino, u64 position, u64 size,
+                       endpoint_t endpoint, void* buf, size_t count,
+                       size_t* copied)
+{
+    MESSAGE m;
+
+    memset(&m, 0, sizeof(MESSAGE));
+
+    m.type = MM_PAGE_CACHE;
+    m.u.m_mm_page_cache.op = MMPC_READ;
+    m.u.m_mm_page_cache.dev = dev;
+    m.u.m_mm_page_cache.ino = ino;
+    m.u.m_mm_page_cache.position = position;
+    m.u.m_mm_page_cache.limit = size;
+    m.u.m_mm_page_cache.endpoint = endpoint;
+    m.u.m_mm_page_cache.buf = buf;
+    m.u.m_mm_page_cache.count = count;
+
+    send_recv(BOTH, TASK_MM, &m);
+
+    *copied = m.u.m_mm_page_cache.count;
+    return m.RETVAL;
+}
+
+int mm_page_cache_fill(dev_t dev, ino_t ino, u64 position, const void* buf,
+                       size_t count)
+{
+    MESSAGE m;
+
+    memset(&m, 0, sizeof(MESSAGE));
+
+    m.type = MM_PAGE_CACHE;
+    m.u.m_mm_page_cache.op = MMPC_FILL;
+    m.u.m_mm_page_cache.dev = dev;
+    m.u.m_mm_page_cache.ino = ino;
+    m.u.m_mm_page_cache.position = position;
+    m.u.m_mm_page_cache.buf = (void*)buf;
+    m.u.m_mm_page_cache.count = count;
+
+    send_recv(BOTH, TASK_MM, &m);
+
+    return m.RETVAL;
+}
+
+int mm_page_cache_drop(dev_t dev, ino_t ino, u64 start, u64 end)
+{
+    MESSAGE m;
+
+    memset(&m, 0, sizeof(MESSAGE));
+
+    m.type = MM_PAGE_CACHE;
+    m.u.m_mm_page_cache.op = MMPC_DROP;
+    m.u.m_mm_page_cache.dev = dev;
+    m.u.m_mm_page_cache.ino = ino;
+    m.u.m_mm_page_cache.position = start;
+    m.u.m_mm_page_cache.limit = end;
+
+    send_recv(BOTH, TASK_MM, &m);
+
+    return m.RETVAL;
+}
+
+int mm_page_cache_drop_dev(dev_t dev)
+{
+    MESSAGE m;
+
+    memset(&m, 0, sizeof(MESSAGE));
+
+    m.type = MM_PAGE_CACHE;
+    m.u.m_mm_page_cache.op = MMPC_DROP_DEV;
+    m.u.m_mm_page_cache.dev = dev;
+
+    send_recv(BOTH, TASK_MM, &m);
+
+    return m.RETVAL;
+}
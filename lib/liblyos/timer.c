@@ -20,41 +20,250 @@
 #include <lyos/timer.h>
 #include <lyos/sysutils.h>
 
-static DEF_LIST(_timer_list);
-static DEF_LIST(_timer_list_expiring);
+static struct timer_wheel _timer_wheel;
+static struct hrtimer_queue _hrtimer_queue;
+
+/* Armed kernel alarms, to avoid setting them again when nothing changed. */
+static clock_t alarm_ticks = TIMER_UNSET;
+static u64 alarm_ns = HRTIMER_UNSET;
 static int expiring = 0;
 
-void timer_add(struct list_head* list, struct timer_list* timer)
+#define LEVEL_SHIFT(n) (TVR_BITS + (n)*TVN_BITS)
+#define LEVEL_INDEX(wheel, n) \
+    (((wheel)->clk >> LEVEL_SHIFT(n)) & TVN_MASK)
+
+static void timer_wheel_init(struct timer_wheel* wheel, clock_t now)
 {
-    struct timer_list* tp;
-    struct list_head* target = list;
+    int i, j;
+
+    for (i = 0; i < TVR_SIZE; i++)
+        INIT_LIST_HEAD(&wheel->tv1[i]);
+    for (i = 0; i < TVN_LEVELS; i++)
+        for (j = 0; j < TVN_SIZE; j++)
+            INIT_LIST_HEAD(&wheel->tvn[i][j]);
+
+    wheel->clk = now;
+    wheel->inited = TRUE;
+}
+
+static int timer_wheel_empty(struct timer_wheel* wheel)
+{
+    int i, j;
+
+    for (i = 0; i < TVR_SIZE; i++)
+        if (!list_empty(&wheel->tv1[i])) return FALSE;
+    for (i = 0; i < TVN_LEVELS; i++)
+        for (j = 0; j < TVN_SIZE; j++)
+            if (!list_empty(&wheel->tvn[i][j])) return FALSE;
+
+    return TRUE;
+}
 
-    if (list_empty(list)) {
-        list_add(&timer->list, list);
-        return;
+static int tv1_empty(struct timer_wheel* wheel)
+{
+    int i;
+
+    for (i = 0; i < TVR_SIZE; i++)
+        if (!list_empty(&wheel->tv1[i])) return FALSE;
+
+    return TRUE;
+}
+
+static void wheel_add(struct timer_wheel* wheel, struct timer_list* timer)
+{
+    clock_t expires = timer->expire_time;
+    struct list_head* vec;
+    u64 idx;
+    int i;
+
+    /* already expired, run it with the next tick */
+    if (expires < wheel->clk) expires = wheel->clk;
+    idx = expires - wheel->clk;
+
+    if (idx < TVR_SIZE) {
+        vec = &wheel->tv1[expires & TVR_MASK];
+    } else {
+        for (i = 0; i < TVN_LEVELS - 1; i++) {
+            if (idx < (1ULL << LEVEL_SHIFT(i + 1))) break;
+        }
+
+        vec = &wheel->tvn[i][(expires >> LEVEL_SHIFT(i)) & TVN_MASK];
     }
 
-    list_for_each_entry(tp, list, list)
+    list_add_tail(&timer->list, vec);
+}
+
+/* Move the timers of one slot down to the lower levels. */
+static int cascade(struct timer_wheel* wheel, struct list_head* tv, int index)
+{
+    struct timer_list *tp, *n;
+    struct list_head list;
+
+    INIT_LIST_HEAD(&list);
+    list_splice_init(&tv[index], &list);
+
+    list_for_each_entry_safe(tp, n, &list, list)
     {
-        if (tp->expire_time >= timer->expire_time) break;
-        target = &tp->list;
+        list_del(&tp->list);
+        wheel_add(wheel, tp);
     }
 
-    list_add(&timer->list, target);
+    return index;
 }
 
-void timer_expire(struct list_head* list, clock_t timestamp)
+/* Move the wheel clock ahead to clk and put the timers of the upper levels
+ * back where they belong from there. tv1 must be empty. */
+static void wheel_rebase(struct timer_wheel* wheel, clock_t clk)
 {
     struct timer_list *tp, *n;
-    list_for_each_entry_safe(tp, n, list, list)
+    struct list_head list;
+    int i, j;
+
+    INIT_LIST_HEAD(&list);
+    for (i = 0; i < TVN_LEVELS; i++)
+        for (j = 0; j < TVN_SIZE; j++)
+            list_splice_init(&wheel->tvn[i][j], &list);
+
+    wheel->clk = clk;
+
+    list_for_each_entry_safe(tp, n, &list, list)
     {
-        if (tp->expire_time <= timestamp) {
+        list_del(&tp->list);
+        wheel_add(wheel, tp);
+    }
+}
+
+/**
+ * timer_add - Adds a timer to a wheel
+ * @wheel: the wheel
+ * @timer: the timer with its expire time set
+ * @now: current time in ticks
+ */
+void timer_add(struct timer_wheel* wheel, struct timer_list* timer,
+               clock_t now)
+{
+    if (!wheel->inited) timer_wheel_init(wheel, now);
+
+    /* nothing has expired the wheel for a while, skip the idle ticks */
+    if (now > wheel->clk + TVR_SIZE && timer_wheel_empty(wheel))
+        wheel->clk = now;
+
+    wheel_add(wheel, timer);
+}
+
+/**
+ * timer_expire - Runs the timers of a wheel expired by timestamp
+ * @wheel: the wheel
+ * @timestamp: current time in ticks
+ *
+ * Only the slots between the last call and timestamp are visited, and runs
+ * of empty slots longer than tv1 are skipped.
+ * Callbacks may add or cancel timers on the same wheel.
+ */
+void timer_expire(struct timer_wheel* wheel, clock_t timestamp)
+{
+    struct timer_list* tp;
+    struct list_head work;
+    clock_t next;
+    int index;
+
+    if (!wheel->inited) return;
+
+    INIT_LIST_HEAD(&work);
+
+    while (wheel->clk <= timestamp) {
+        /* nothing is due in the next TVR_SIZE ticks, jump straight to the
+         * earliest timer instead of walking every tick up to it */
+        if (timestamp - wheel->clk >= TVR_SIZE && tv1_empty(wheel)) {
+            next = timer_next_expiry(wheel);
+            if (next == TIMER_UNSET || next > timestamp) next = timestamp + 1;
+            if (next > wheel->clk) wheel_rebase(wheel, next);
+            if (wheel->clk > timestamp) break;
+        }
+
+        index = wheel->clk & TVR_MASK;
+
+        if (!index) {
+            if (timer_wheel_empty(wheel)) {
+                wheel->clk = timestamp + 1;
+                break;
+            }
+
+            if (!cascade(wheel, wheel->tvn[0], LEVEL_INDEX(wheel, 0)) &&
+                !cascade(wheel, wheel->tvn[1], LEVEL_INDEX(wheel, 1)) &&
+                !cascade(wheel, wheel->tvn[2], LEVEL_INDEX(wheel, 2)))
+                cascade(wheel, wheel->tvn[3], LEVEL_INDEX(wheel, 3));
+        }
+
+        list_splice_init(&wheel->tv1[index], &work);
+        wheel->clk++;
+
+        while (!list_empty(&work)) {
+            tp = list_first_entry(&work, struct timer_list, list);
             cancel_timer(tp);
             (*tp->callback)(tp);
         }
     }
 }
 
+static clock_t slot_min(struct list_head* slot)
+{
+    struct timer_list* tp;
+    clock_t min = TIMER_UNSET;
+
+    list_for_each_entry(tp, slot, list)
+    {
+        if (tp->expire_time < min) min = tp->expire_time;
+    }
+
+    return min;
+}
+
+/**
+ * timer_next_expiry - Gets the earliest expire time on a wheel
+ * @wheel: the wheel
+ *
+ * Returns TIMER_UNSET if the wheel is empty.
+ */
+clock_t timer_next_expiry(struct timer_wheel* wheel)
+{
+    clock_t next = TIMER_UNSET, expires;
+    struct list_head* slot;
+    int i, first, level, index;
+
+    if (!wheel->inited) return TIMER_UNSET;
+
+    /* the first busy slot of each level holds the earliest timer of that
+     * level, but a higher level may still hold an earlier one than a slot
+     * far ahead in a lower level */
+    for (i = 0; i < TVR_SIZE; i++) {
+        slot = &wheel->tv1[(wheel->clk + i) & TVR_MASK];
+        if (!list_empty(slot)) {
+            next = slot_min(slot);
+            break;
+        }
+    }
+
+    for (level = 0; level < TVN_LEVELS; level++) {
+        index = LEVEL_INDEX(wheel, level);
+
+        /* the current slot is cascaded only when clk reaches the start of
+         * its window, until then it holds the earliest timers of the level */
+        first = (wheel->clk & ((1ULL << LEVEL_SHIFT(level)) - 1)) ? 1 : 0;
+
+        for (i = first; i <= TVN_SIZE; i++) {
+            slot = &wheel->tvn[level][(index + i) & TVN_MASK];
+            if (!list_empty(slot)) {
+                expires = slot_min(slot);
+                if (expires < next) next = expires;
+                break;
+            }
+        }
+    }
+
+    return next;
+}
+
 void init_timer(struct timer_list* timer)
 {
     timer->expire_time = TIMER_UNSET;
@@ -82,6 +291,147 @@ int cancel_timer(struct timer_list* timer)
     return 0;
 }
 
+static struct hrtimer* hrtimer_meld(struct hrtimer* a, struct hrtimer* b)
+{
+    struct hrtimer* tmp;
+
+    if (!a) return b;
+    if (!b) return a;
+
+    if (b->expires < a->expires) {
+        tmp = a;
+        a = b;
+        b = tmp;
+    }
+
+    /* b becomes the first child of a */
+    b->sibling = a->child;
+    if (a->child) a->child->prev = b;
+    b->prev = a;
+    a->child = b;
+
+    return a;
+}
+
+/* Two-pass pairing of a list of siblings into one heap. */
+static struct hrtimer* hrtimer_merge_pairs(struct hrtimer* first)
+{
+    struct hrtimer *a, *b, *next, *pairs = NULL, *root = NULL;
+
+    while (first) {
+        a = first;
+        b = a->sibling;
+        next = b ? b->sibling : NULL;
+
+        a->sibling = a->prev = NULL;
+        if (b) {
+            b->sibling = b->prev = NULL;
+            a = hrtimer_meld(a, b);
+        }
+
+        a->sibling = pairs;
+        pairs = a;
+        first = next;
+    }
+
+    while (pairs) {
+        next = pairs->sibling;
+        pairs->sibling = NULL;
+        root = hrtimer_meld(root, pairs);
+        pairs = next;
+    }
+
+    if (root) root->prev = NULL;
+    return root;
+}
+
+void hrtimer_init(struct hrtimer* timer)
+{
+    timer->child = timer->sibling = timer->prev = NULL;
+    timer->expires = HRTIMER_UNSET;
+    timer->callback = NULL;
+    timer->arg = NULL;
+}
+
+/**
+ * hrtimer_enqueue - Adds a timer to a queue
+ * @queue: the queue
+ * @timer: the timer with its expire time set
+ */
+void hrtimer_enqueue(struct hrtimer_queue* queue, struct hrtimer* timer)
+{
+    timer->child = timer->sibling = timer->prev = NULL;
+    queue->root = hrtimer_meld(queue->root, timer);
+}
+
+/**
+ * hrtimer_dequeue - Removes a timer from a queue
+ * @queue: the queue
+ * @timer: the timer
+ *
+ * Returns 1 if the timer was queued or 0 if it was not.
+ */
+int hrtimer_dequeue(struct hrtimer_queue* queue, struct hrtimer* timer)
+{
+    struct hrtimer* sub;
+
+    /* only the root of a heap has no parent or previous sibling */
+    if (timer != queue->root && !timer->prev) return 0;
+
+    if (timer == queue->root) {
+        queue->root = hrtimer_merge_pairs(timer->child);
+    } else {
+        if (timer->prev->child == timer)
+            timer->prev->child = timer->sibling;
+        else
+            timer->prev->sibling = timer->sibling;
+        if (timer->sibling) timer->sibling->prev = timer->prev;
+
+        sub = hrtimer_merge_pairs(timer->child);
+        queue->root = hrtimer_meld(queue->root, sub);
+    }
+
+    timer->child = timer->sibling = timer->prev = NULL;
+    timer->expires = HRTIMER_UNSET;
+
+    return 1;
+}
+
+/**
+ * hrtimer_expire - Runs the timers of a queue expired by now
+ * @queue: the queue
+ * @now: current uptime in ns
+ */
+void hrtimer_expire(struct hrtimer_queue* queue, u64 now)
+{
+    struct hrtimer* tp;
+
+    while ((tp = queue->root) != NULL && tp->expires <= now) {
+        hrtimer_dequeue(queue, tp);
+        (*tp->callback)(tp);
+    }
+}
+
+/* Set the kernel alarms to the earliest timers. */
+static void arm_alarms(void)
+{
+    clock_t next_ticks = timer_next_expiry(&_timer_wheel);
+    u64 next_ns = hrtimer_next_expiry(&_hrtimer_queue);
+
+    if (next_ticks != alarm_ticks) {
+        if (kernel_alarm(next_ticks == TIMER_UNSET ? 0 : next_ticks, 1) != 0)
+            panic("can't set timer");
+        alarm_ticks = next_ticks;
+    }
+
+    if (next_ns != alarm_ns) {
+        if (kernel_alarm_ns(next_ns == HRTIMER_UNSET ? 0 : next_ns,
+                            ALARM_ABS) != 0)
+            panic("can't set timer");
+        alarm_ns = next_ns;
+    }
+}
+
 void set_timer(struct timer_list* timer, clock_t ticks, timer_callback_t cb,
                void* arg)
 {
@@ -93,53 +443,51 @@ void set_timer(struct timer_list* timer, clock_t ticks, timer_callback_t cb,
     timer->callback = cb;
     timer->arg = arg;
 
-    clock_t prev_timeout, next_timeout;
-    if (list_empty(&_timer_list))
-        prev_timeout = TIMER_UNSET;
-    else
-        prev_timeout =
-            list_entry(_timer_list.next, struct timer_list, list)->expire_time;
+    timer_add(&_timer_wheel, timer, uptime);
+    if (!expiring) arm_alarms();
+}
+
+void set_hrtimer(struct hrtimer* timer, u64 ns, hrtimer_callback_t cb,
+                 void* arg)
+{
+    u64 uptime;
 
-    if (expiring)
-        list_add(&timer->list, &_timer_list_expiring);
-    else
-        timer_add(&_timer_list, timer);
+    if (get_uptime_ns(&uptime) != 0) panic("can't get uptime\n");
 
-    if (list_empty(&_timer_list))
-        next_timeout = TIMER_UNSET;
-    else
-        next_timeout =
-            list_entry(_timer_list.next, struct timer_list, list)->expire_time;
+    timer->expires = uptime + ns;
+    timer->callback = cb;
+    timer->arg = arg;
 
-    if (!expiring &&
-        (prev_timeout == TIMER_UNSET || prev_timeout != next_timeout)) {
-        if (kernel_alarm(next_timeout, 1) != 0) panic("can't set timer");
-    }
+    hrtimer_enqueue(&_hrtimer_queue, timer);
+    if (!expiring) arm_alarms();
+}
+
+int cancel_hrtimer(struct hrtimer* timer)
+{
+    return hrtimer_dequeue(&_hrtimer_queue, timer);
 }
 
 void expire_timer(clock_t timestamp)
 {
+    u64 uptime;
+
     expiring = 1;
-    timer_expire(&_timer_list, timestamp);
-    expiring = 0;
 
-    struct timer_list *tp, *n;
-    list_for_each_entry_safe(tp, n, &_timer_list_expiring, list)
-    {
-        list_del(&tp->list);
-        timer_add(&_timer_list, tp);
-    }
+    timer_expire(&_timer_wheel, timestamp);
+    if (alarm_ticks != TIMER_UNSET && alarm_ticks <= timestamp)
+        alarm_ticks = TIMER_UNSET;
 
-    clock_t next_timeout;
-    if (list_empty(&_timer_list))
-        next_timeout = TIMER_UNSET;
-    else
-        next_timeout =
-            list_entry(_timer_list.next, struct timer_list, list)->expire_time;
+    if (_hrtimer_queue.root || alarm_ns != HRTIMER_UNSET) {
+        if (get_uptime_ns(&uptime) != 0) panic("can't get uptime\n");
 
-    if (next_timeout != TIMER_UNSET) {
-        if (kernel_alarm(next_timeout, 1) != 0) panic("can't set timer");
+        hrtimer_expire(&_hrtimer_queue, uptime);
+        if (alarm_ns != HRTIMER_UNSET && alarm_ns <= uptime)
+            alarm_ns = HRTIMER_UNSET;
     }
+
+    expiring = 0;
+
+    arm_alarms();
 }
 
 clock_t timer_expires_remaining(struct timer_list* tp)
@@ -156,3 +504,16 @@ clock_t timer_expires_remaining(struct timer_list* tp)
 
     return 0;
 }
+
+u64 hrtimer_expires_remaining(struct hrtimer* timer)
+{
+    u64 uptime;
+
+    if (timer->expires != HRTIMER_UNSET) {
+        if (get_uptime_ns(&uptime) != 0) panic("can't get uptime\n");
+
+        if (timer->expires > uptime) return timer->expires - uptime;
+    }
+
+    return 0;
+}
@@ -0,0 +1,33 @@
+/*  This file is part of Lyos.
+
+    Lyos is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Lyos is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Lyos.  If not, see <http://www.gnu.org/licenses/>. */
+
+#include <lyos/ipc.h>
+#include <lyos/const.h>
+#include <string.h>
+#include <lyos/sysutils.h>
+
+int get_uptime_ns(u64* ns)
+{
+    MESSAGE m;
+
+    memset(&m, 0, sizeof(MESSAGE));
+    m.TIMES_FLAGS = TIMES_NS;
+
+    int retval = syscall_entry(NR_TIMES, &m);
+    if (retval) return retval;
+
+    *ns = m.BOOT_NS;
+    return 0;
+}
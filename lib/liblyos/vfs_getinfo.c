@@ -0,0 +1,22 @@
+#include <lyos/types.h>
+#include <lyos/const.h>
+#include <lyos/ipc.h>
+#include <lyos/sysutils.h>
+#include <errno.h>
+#include <string.h>
+
+int vfs_getinfo(int request, endpoint_t who, void* dest, int size)
+{
+    MESSAGE m;
+
+    memset(&m, 0, sizeof(m));
+    m.type = VFS_GETINFO;
+    m.REQUEST = request;
+    m.ENDPOINT = who;
+    m.BUF = dest;
+    m.BUF_LEN = size;
+
+    send_recv(BOTH, TASK_FS, &m);
+
+    return m.RETVAL;
+}
@@ -96,6 +96,19 @@ int vmctl_flushtlb(endpoint_t who)
     return syscall_entry(NR_VMCTL, &m);
 }
 
+int vmctl_flushtlb_range(unsigned long pgd_phys, void* addr, size_t len)
+{
+    MESSAGE m;
+
+    m.VMCTL_REQUEST = VMCTL_FLUSHTLB_RANGE;
+    m.VMCTL_WHO = SELF;
+    m.VMCTL_PHYS_ADDR = pgd_phys;
+    m.VMCTL_FLUSH_ADDR = addr;
+    m.VMCTL_FLUSH_LEN = len;
+
+    return syscall_entry(NR_VMCTL, &m);
+}
+
 int vmctl_get_mmrequest(endpoint_t* target, void** start, size_t* len,
                         int* flags, endpoint_t* caller)
 {
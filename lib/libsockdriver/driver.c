@@ -58,6 +58,8 @@ static void sockdriver_reset(struct sock* sock, sockid_t id, int domain,
 
     sock->sndlowat = 1;
     sock->rcvlowat = 1;
+    sock->sndbuf = SOCK_DEF_SNDBUF;
+    sock->rcvbuf = SOCK_DEF_RCVBUF;
 
     sock->peercred.pid = -1;
     sock->peercred.uid = -1;
@@ -83,6 +85,8 @@ void sockdriver_clone(struct sock* sock, struct sock* newsock, sockid_t newid)
     newsock->flags = sock->flags & ~SFL_ACCEPTCONN;
     newsock->sndlowat = sock->sndlowat;
     newsock->rcvlowat = sock->rcvlowat;
+    newsock->sndbuf = sock->sndbuf;
+    newsock->rcvbuf = sock->rcvbuf;
     newsock->linger = sock->linger;
 }
 
@@ -111,6 +115,8 @@ void sock_free(struct sock* sock)
 
     sock_unhash(sock);
 
+    skb_queue_purge(&sock->recvq);
+
     ops = sock->ops;
     sock->ops = NULL;
 
@@ -931,6 +937,12 @@ static void do_getsockopt(MESSAGE* msg)
             len = sizeof(val);
             retval = sockdriver_copyout(&data, 0, &val, len);
             break;
+        case SO_SNDBUF:
+        case SO_RCVBUF:
+            val = (name == SO_SNDBUF) ? sock->sndbuf : sock->rcvbuf;
+            len = sizeof(val);
+            retval = sockdriver_copyout(&data, 0, &val, len);
+            break;
         case SO_PEERCRED: {
             struct ucred peercred;
             if (len > sizeof(peercred)) len = sizeof(peercred);
@@ -1002,13 +1014,19 @@ static void do_setsockopt(MESSAGE* msg)
             else
                 sock->flags &= ~flag;
             break;
-        /* case SO_SNDBUF: */
-        /*     if ((retval = sockdriver_copyin(&data, 0, &val, len)) != OK) */
-        /*         goto reply; */
-        /*     val = min(val, INT_MAX / 2); */
-        /*     sock->sndbuf = val * 2; */
-        /*     sockdriver_fire(sock, SEV_SEND); */
-        /*     break; */
+        case SO_SNDBUF:
+            if ((retval = sockdriver_copyin(&data, 0, &val, len)) != OK)
+                goto reply;
+            val = min(val, INT_MAX / 2);
+            sock->sndbuf = max(val * 2, SOCK_MIN_SNDBUF);
+            sockdriver_fire(sock, SEV_SEND);
+            break;
+        case SO_RCVBUF:
+            if ((retval = sockdriver_copyin(&data, 0, &val, len)) != OK)
+                goto reply;
+            val = min(val, INT_MAX / 2);
+            sock->rcvbuf = max(val * 2, SOCK_MIN_RCVBUF);
+            break;
         case SO_ACCEPTCONN:
         case SO_ERROR:
         case SO_TYPE:
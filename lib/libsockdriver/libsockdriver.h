@@ -92,6 +92,9 @@ int sockdriver_copyout(const struct sockdriver_data* data, size_t off,
 
 int skb_alloc(struct sock* sock, size_t data_len, struct sk_buff** skbp);
 void skb_free(struct sk_buff* skb);
+void skb_queue_purge(struct sk_buff_head* list);
+int sock_queue_rcv_skb(struct sock* sock, struct sk_buff* skb);
+void sock_unlink_rcv_skb(struct sock* sock, struct sk_buff* skb);
 int skb_copy_from(struct sk_buff* skb, size_t off,
                   const struct sockdriver_data* data, size_t data_off,
                   size_t len);
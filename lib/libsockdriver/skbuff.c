@@ -4,15 +4,109 @@
 
 #include "libsockdriver.h"
 
-int skb_alloc(struct sock* sock, size_t data_len, struct sk_buff** skbp)
+/* Free buffers kept for reuse in each pool. */
+#define SKB_POOL_MAX 64
+
+struct skb_pool {
+    size_t size;
+    struct list_head free_list;
+    unsigned int nr_free;
+};
+
+static struct skb_pool skb_pools[SKB_NR_POOLS] = {
+    {.size = 128}, {.size = 512}, {.size = 2048}, {.size = SKB_FRAG_SIZE}};
+static int skb_pools_inited = FALSE;
+
+static void skb_init_pools(void)
 {
+    int i;
+
+    for (i = 0; i < SKB_NR_POOLS; i++) {
+        INIT_LIST_HEAD(&skb_pools[i].free_list);
+        skb_pools[i].nr_free = 0;
+    }
+
+    skb_pools_inited = TRUE;
+}
+
+static struct sk_buff* skb_alloc_one(size_t len)
+{
+    struct skb_pool* pool;
     struct sk_buff* skb;
+    unsigned int i;
 
-    skb = malloc(sizeof(struct sk_buff) + data_len);
-    if (!skb) return ENOMEM;
+    if (!skb_pools_inited) skb_init_pools();
+
+    for (i = 0; i < SKB_NR_POOLS - 1; i++) {
+        if (len <= skb_pools[i].size) break;
+    }
+    pool = &skb_pools[i];
+
+    if (pool->nr_free > 0) {
+        skb = list_first_entry(&pool->free_list, struct sk_buff, list);
+        list_del(&skb->list);
+        pool->nr_free--;
+    } else {
+        skb = malloc(sizeof(struct sk_buff) + pool->size);
+        if (!skb) return NULL;
+    }
 
     memset(skb, 0, sizeof(struct sk_buff));
+    skb->pool = i;
+    skb->frag_len = len;
+    skb->truesize = sizeof(struct sk_buff) + pool->size;
+
+    return skb;
+}
+
+static void skb_free_one(struct sk_buff* skb)
+{
+    struct skb_pool* pool = &skb_pools[skb->pool];
+
+    if (pool->nr_free >= SKB_POOL_MAX) {
+        free(skb);
+        return;
+    }
+
+    list_add(&skb->list, &pool->free_list);
+    pool->nr_free++;
+}
+
+static void skb_free_chain(struct sk_buff* skb)
+{
+    struct sk_buff* next;
+
+    for (; skb; skb = next) {
+        next = skb->frag_next;
+        skb_free_one(skb);
+    }
+}
+
+int skb_alloc(struct sock* sock, size_t data_len, struct sk_buff** skbp)
+{
+    struct sk_buff *skb, *frag, **tail;
+    size_t chunk, left;
+
+    chunk = min(data_len, SKB_FRAG_SIZE);
+    if (!(skb = skb_alloc_one(chunk))) return ENOMEM;
+
+    /* chain fragments for the rest of the data */
+    tail = &skb->frag_next;
+    for (left = data_len - chunk; left > 0; left -= chunk) {
+        chunk = min(left, SKB_FRAG_SIZE);
+
+        if (!(frag = skb_alloc_one(chunk))) {
+            skb_free_chain(skb);
+            return ENOMEM;
+        }
+
+        skb->truesize += frag->truesize;
+        *tail = frag;
+        tail = &frag->frag_next;
+    }
+
     skb->sock = sock;
+    skb->sender = sock ? sock_sockid(sock) : -1;
     skb->data_len = data_len;
     skb->users = 1;
 
@@ -33,34 +127,127 @@ int skb_unref(struct sk_buff* skb)
 
 void skb_free(struct sk_buff* skb)
 {
-    if (skb_unref(skb)) free(skb);
+    if (!skb_unref(skb)) return;
+
+    skb_orphan(skb);
+    skb_free_chain(skb);
+}
+
+void skb_queue_purge(struct sk_buff_head* list)
+{
+    struct sk_buff* skb;
+
+    while ((skb = skb_peek(list)) != NULL) {
+        skb_unlink(skb, list);
+        skb_free(skb);
+    }
+}
+
+int sock_queue_rcv_skb(struct sock* sock, struct sk_buff* skb)
+{
+    if (sock_rcvbuf_full(sock, skb->truesize)) return ENOBUFS;
+
+    skb_queue_tail(&sock->recvq, skb);
+    sockdriver_fire(sock, SEV_RECV);
+
+    return 0;
+}
+
+void sock_unlink_rcv_skb(struct sock* sock, struct sk_buff* skb)
+{
+    struct sock* sender;
+
+    skb_unlink(skb, &sock->recvq);
+
+    /* the sender may be waiting for room in our receive buffer */
+    if (skb->sender >= 0 && (sender = sock_get(skb->sender)) != NULL)
+        sockdriver_fire(sender, SEV_SEND);
+}
+
+/* Call fn on each piece of [off, off + len) in the fragment chain. */
+static int skb_walk(struct sk_buff* skb, size_t off, size_t len,
+                    int (*fn)(char* buf, size_t len, void* arg), void* arg)
+{
+    size_t chunk;
+    int retval;
+
+    for (; skb && off >= skb->frag_len; skb = skb->frag_next)
+        off -= skb->frag_len;
+
+    for (; skb && len > 0; skb = skb->frag_next) {
+        chunk = min(skb->frag_len - off, len);
+
+        if ((retval = fn(&skb->data[off], chunk, arg)) != 0) return retval;
+
+        len -= chunk;
+        off = 0;
+    }
+
+    return len ? EFAULT : 0;
+}
+
+struct skb_copy_data {
+    const struct sockdriver_data* data;
+    size_t data_off;
+};
+
+static int copy_from_data(char* buf, size_t len, void* arg)
+{
+    struct skb_copy_data* cd = arg;
+    int retval;
+
+    retval = sockdriver_copyin(cd->data, cd->data_off, buf, len);
+    cd->data_off += len;
+    return retval;
+}
+
+static int copy_to_data(char* buf, size_t len, void* arg)
+{
+    struct skb_copy_data* cd = arg;
+    int retval;
+
+    retval = sockdriver_copyout(cd->data, cd->data_off, buf, len);
+    cd->data_off += len;
+    return retval;
+}
+
+static int copy_from_iter(char* buf, size_t len, void* arg)
+{
+    if (iov_grant_iter_copy_from(arg, buf, len) != len) return EFAULT;
+    return 0;
+}
+
+static int copy_to_iter(char* buf, size_t len, void* arg)
+{
+    if (iov_grant_iter_copy_to(arg, buf, len) != len) return EFAULT;
+    return 0;
 }
 
 int skb_copy_from(struct sk_buff* skb, size_t off,
                   const struct sockdriver_data* data, size_t data_off,
                   size_t len)
 {
-    return sockdriver_copyin(data, data_off, &skb->data[off], len);
+    struct skb_copy_data cd = {.data = data, .data_off = data_off};
+
+    return skb_walk(skb, off, len, copy_from_data, &cd);
 }
 
 int skb_copy_to(struct sk_buff* skb, size_t off,
                 const struct sockdriver_data* data, size_t data_off, size_t len)
 {
-    return sockdriver_copyout(data, data_off, &skb->data[off], len);
+    struct skb_copy_data cd = {.data = data, .data_off = data_off};
+
+    return skb_walk(skb, off, len, copy_to_data, &cd);
 }
 
 int skb_copy_from_iter(struct sk_buff* skb, size_t off,
                        struct iov_grant_iter* iter, size_t len)
 {
-    if (iov_grant_iter_copy_from(iter, &skb->data[off], len) != len)
-        return EFAULT;
-    return 0;
+    return skb_walk(skb, off, len, copy_from_iter, iter);
 }
 
 int skb_copy_to_iter(struct sk_buff* skb, size_t off,
                      struct iov_grant_iter* iter, size_t len)
 {
-    if (iov_grant_iter_copy_to(iter, &skb->data[off], len) != len)
-        return EFAULT;
-    return 0;
+    return skb_walk(skb, off, len, copy_to_iter, iter);
 }
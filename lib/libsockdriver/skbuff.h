@@ -2,25 +2,40 @@
 #define _LIBSOCKDRIVER_SKBUFF_H_
 
 #include <sys/types.h>
+#include <stdint.h>
 #include <lyos/list.h>
 
+typedef int32_t sockid_t;
+
 struct sock;
 
+/* Data buffer sizes of the skb pools. Larger messages are split into a chain
+ * of SKB_FRAG_SIZE fragments. */
+#define SKB_NR_POOLS  4
+#define SKB_FRAG_SIZE 8192
+
 struct sk_buff {
     struct list_head list;
     struct sock* sock;
+    sockid_t sender; /* for send space wakeups, sock may be gone by then */
     unsigned int users;
     void (*destructor)(struct sk_buff* skb);
 
     char cb[48] __attribute__((aligned(8)));
 
-    size_t data_len;
+    size_t data_len; /* bytes in the whole chain */
+    size_t truesize; /* memory charged to socket buffers for the chain */
+
+    struct sk_buff* frag_next;
+    size_t frag_len; /* bytes in this fragment */
+    unsigned int pool;
     char data[0];
 };
 
 struct sk_buff_head {
     struct list_head head;
     size_t qlen;
+    size_t mem; /* truesize of all queued skbs */
 };
 
 static inline struct sk_buff* skb_get(struct sk_buff* skb)
@@ -33,6 +48,7 @@ static inline void skb_queue_init(struct sk_buff_head* list)
 {
     INIT_LIST_HEAD(&list->head);
     list->qlen = 0;
+    list->mem = 0;
 }
 
 static inline int skb_queue_empty(struct sk_buff_head* list)
@@ -45,11 +61,14 @@ static inline void skb_queue_tail(struct sk_buff_head* list,
 {
     list_add_tail(&skb->list, &list->head);
     list->qlen++;
+    list->mem += skb->truesize;
 }
 
 static inline void skb_unlink(struct sk_buff* skb, struct sk_buff_head* head)
 {
     list_del(&skb->list);
+    head->qlen--;
+    head->mem -= skb->truesize;
 }
 
 static inline struct sk_buff* skb_peek(struct sk_buff_head* list)
@@ -6,8 +6,6 @@
 #include <lyos/list.h>
 #include <time.h>
 
-typedef int32_t sockid_t;
-
 /* Socket events. */
 #define SEV_BIND    0x01
 #define SEV_CONNECT 0x02
@@ -30,6 +28,12 @@ typedef int32_t sockid_t;
 #define SFL_BROADCAST  0x400
 #define SFL_CLOSING    0x800
 
+/* Default and minimum socket buffer sizes. */
+#define SOCK_DEF_SNDBUF (208 * 1024)
+#define SOCK_DEF_RCVBUF (208 * 1024)
+#define SOCK_MIN_SNDBUF 2048
+#define SOCK_MIN_RCVBUF 256
+
 struct sock_cred {
     pid_t pid;
     uid_t uid;
@@ -47,6 +51,8 @@ struct sock {
     int peek_off;
     size_t sndlowat;
     size_t rcvlowat;
+    size_t sndbuf;
+    size_t rcvbuf;
     clock_t linger;
 
     struct sock_cred peercred;
@@ -108,6 +114,13 @@ static inline int sock_rcvlowat(const struct sock* sock, int waitall,
     return v ?: 1;
 }
 
+/* Check if the receive buffer has no room for truesize more bytes. An empty
+ * queue always takes one skb so that a large message can't block forever. */
+static inline int sock_rcvbuf_full(const struct sock* sock, size_t truesize)
+{
+    return sock->recvq.qlen > 0 && sock->recvq.mem + truesize > sock->rcvbuf;
+}
+
 static inline int sock_peek_offset(struct sock* sock, int flags)
 {
     if (flags & MSG_PEEK) {
@@ -415,6 +415,11 @@ static ssize_t netlink_send(struct sock* sock, struct iov_grant_iter* iter,
         }
     }
 
+    if (len > sock->sndbuf) {
+        retval = -EMSGSIZE;
+        goto out;
+    }
+
     if ((retval = skb_alloc(sock, len, &skb)) != OK) {
         retval = -ENOBUFS;
         goto out;
@@ -477,7 +482,7 @@ static ssize_t netlink_recv(struct sock* sock, struct iov_grant_iter* iter,
             continue;
         }
 
-        skb_unlink(skb, &nls->sock.recvq);
+        sock_unlink_rcv_skb(&nls->sock, skb);
         break;
     }
 
@@ -564,9 +569,9 @@ static int netlink_close(struct sock* sock, int force)
 static int netlink_send_skb(struct sock* sock, struct sk_buff* skb)
 {
     int len = skb->data_len;
+    int retval;
 
-    skb_queue_tail(&sock_recvq(sock), skb);
-    sockdriver_fire(sock, SEV_RECV);
+    if ((retval = sock_queue_rcv_skb(sock, skb)) != OK) return -retval;
 
     return len;
 }
@@ -590,9 +595,18 @@ static int netlink_unicast(struct sock* sock, struct sk_buff* skb, u32 portid,
     int retval;
 
     retval = netlink_get_sock_by_portid(nls, portid, &nlsk);
-    if (retval) return -retval;
+    if (retval) {
+        skb_free(skb);
+        return -retval;
+    }
+
+    retval = netlink_send_skb(&nlsk->sock, skb);
+    if (retval < 0) {
+        skb_free(skb);
+        if (nonblock) retval = -EAGAIN;
+    }
 
-    return netlink_send_skb(&nlsk->sock, skb);
+    return retval;
 }
 
 static void netlink_broadcast_one(struct nlsock* nls, struct sk_buff* skb,
@@ -605,7 +619,14 @@ static void netlink_broadcast_one(struct nlsock* nls, struct sk_buff* skb,
     skb = skb_get(skb);
     skb_orphan(skb);
 
-    netlink_send_skb(&nls->sock, skb);
+    if (netlink_send_skb(&nls->sock, skb) < 0) {
+        /* the listener is not keeping up, tell it that it lost messages */
+        skb_free(skb);
+        sock_set_error(&nls->sock, ENOBUFS);
+        sockdriver_fire(&nls->sock, SEV_RECV);
+        return;
+    }
+
     *delivered = 1;
 }
 
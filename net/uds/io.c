@@ -150,9 +150,45 @@ ssize_t uds_send(struct sock* sock, struct iov_grant_iter* iter, size_t len,
                            FALSE)) != OK)
         return retval;
 
+    if (uds_get_type(uds) == SOCK_DGRAM && len > sock->sndbuf) {
+        retval = -EMSGSIZE;
+        goto out_err;
+    }
+
     while (sent < len) {
         size = len - sent;
 
+        /* split large writes on stream sockets so that the receiver can
+         * start consuming before everything is queued */
+        if (uds_get_type(uds) != SOCK_DGRAM)
+            size = min(size, max(sock->sndbuf / 2, SKB_FRAG_SIZE));
+
+        /* wait for room in the receive buffer of the peer */
+        while (sock_rcvbuf_full(&other->sock, size)) {
+            if (flags & MSG_DONTWAIT) {
+                retval = -EAGAIN;
+                goto out_err;
+            }
+
+            sockdriver_suspend(sock, SEV_SEND);
+
+            /* the peer may have gone away while we were waiting */
+            if (uds_is_shutdown(uds, SFL_SHUT_WR)) {
+                retval = -EPIPE;
+                goto out_err;
+            }
+
+            if ((retval = uds_send_peer(uds, addr, addr_len, user_endpt,
+                                        &other)) != OK) {
+                retval = -retval;
+                goto out_err;
+            }
+            if (!other) {
+                retval = -EPIPE;
+                goto out_err;
+            }
+        }
+
         if ((retval = skb_alloc(sock, size, &skb)) != OK) {
             retval = -retval;
             goto out_err;
@@ -267,7 +303,7 @@ ssize_t uds_recv(struct sock* sock, struct iov_grant_iter* iter, size_t len,
 
             if (uds_skb_len(skb)) break;
 
-            skb_unlink(skb, &uds->sock.recvq);
+            sock_unlink_rcv_skb(&uds->sock, skb);
             skb_free(skb);
 
             if (scm.fd_list) break;
@@ -289,7 +325,7 @@ ssize_t uds_recv(struct sock* sock, struct iov_grant_iter* iter, size_t len,
 
 __poll_t uds_poll(struct sock* sock)
 {
-    struct udssock* uds = to_udssock(sock);
+    struct udssock *uds = to_udssock(sock), *peer;
     __poll_t mask = 0;
 
     if (uds->sock.err) mask |= EPOLLERR;
@@ -306,7 +342,12 @@ __poll_t uds_poll(struct sock* sock)
 
     if (!skb_queue_empty(&uds->sock.recvq)) mask |= EPOLLIN | EPOLLRDNORM;
 
-    if (!uds_is_listening(uds)) mask |= EPOLLOUT | EPOLLWRNORM | EPOLLWRBAND;
+    if (!uds_is_listening(uds)) {
+        peer = (uds_get_type(uds) == SOCK_DGRAM) ? uds->link : uds->conn;
+
+        if (!peer || !sock_rcvbuf_full(&peer->sock, 1))
+            mask |= EPOLLOUT | EPOLLWRNORM | EPOLLWRBAND;
+    }
 
     return mask;
 }
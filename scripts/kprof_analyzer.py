@@ -1,5 +1,6 @@
 import struct
 import argparse
+import bisect
 import os
 import subprocess
 
@@ -14,39 +15,57 @@ def parse_args():
     parser.add_argument('kernel', type=str)
     parser.add_argument('sbin', type=str)
     parser.add_argument('toolchain', type=str)
+    parser.add_argument('--folded',
+                        action='store_true',
+                        help='print folded call stacks for flamegraph.pl')
 
     return parser.parse_args()
 
 
 def load_samples(fin):
-    header = fin.read(4 * 4)
-    magic, info_size, proc_size, sample_size = struct.unpack('iiii', header)
+    header = fin.read(5 * 4)
+    magic, info_size, proc_size, sample_size, ptr_size = struct.unpack(
+        'iiiii', header)
 
     if magic != MAGIC:
         print(f'Corrupted input file, magic: {hex(magic)}')
 
+    ptr_fmt = 'Q' if ptr_size == 8 else 'I'
+
     kprof_info = fin.read(info_size)
-    mem_used, idle_samples, system_samples, user_samples, total_samples = struct.unpack(
-        'iiiii', kprof_info)
+    mem_used, idle_samples, system_samples, user_samples, total_samples, dropped_samples = struct.unpack(
+        'iiiiii', kprof_info)
 
-    sample_counts = (idle_samples, system_samples, user_samples, total_samples)
+    sample_counts = (idle_samples, system_samples, user_samples, total_samples,
+                     dropped_samples)
     procs = dict()
     samples = []
 
     payload = fin.read(mem_used)
-    while len(payload) > 5:
-        tag, payload = payload[0], payload[1:]
-        endpoint = struct.unpack('i', payload[:4])[0]
-        payload = payload[4:]
+    pos = 0
+    while pos < len(payload):
+        tag = payload[pos]
+        pos += 1
 
         if tag == 1:  # proc
-            proc_name = payload[:16].split(b'\0', 1)[0].decode('ascii')
-            payload = payload[16:]
+            endpoint = struct.unpack_from('i', payload, pos)[0]
+            name = payload[pos + 4:pos + proc_size]
+            proc_name = name.split(b'\0', 1)[0].decode('ascii')
             procs[endpoint] = proc_name
+            pos += proc_size
         elif tag == 2:  # sample
-            pc = struct.unpack('I', payload[:4])[0]
-            payload = payload[4:]
-            samples.append(dict(pc=pc, endpoint=endpoint))
+            endpoint, cpu, flags, depth = struct.unpack_from(
+                'iHBB', payload, pos)
+            pc = struct.unpack_from(ptr_fmt, payload,
+                                    pos + sample_size - ptr_size)[0]
+            pos += sample_size
+            chain = list(struct.unpack_from(ptr_fmt * depth, payload, pos))
+            pos += depth * ptr_size
+            samples.append(
+                dict(pc=pc, endpoint=endpoint, cpu=cpu, chain=chain))
+        else:
+            print(f'Corrupted sample record at offset {pos - 1}')
+            break
 
     return sample_counts, procs, samples
 
@@ -80,32 +99,52 @@ def get_symbols(procs, kernel, sbin, toolchain):
     return symbol_map
 
 
+def lookup_symbol(symbols, addr):
+    i = bisect.bisect_right(symbols, (addr, chr(0x10ffff))) - 1
+    if i < 0:
+        return hex(addr)
+    return symbols[i][1]
+
+
 def get_sample_locs(samples, symbol_map):
     locs = dict()
 
     for s in samples:
         endpoint = s['endpoint']
-        pc = s['pc']
         symbols = symbol_map.get(endpoint)
 
         if symbols is None:
             continue
 
-        for (s, symbol), (e, _) in zip(symbols[:-1], symbols[1:]):
-            if s <= pc < e:
-                loc = symbol
-                break
-        else:
-            loc = symbols[-1][1]
-
-        if locs.get((endpoint, loc)) is None:
-            locs[(endpoint, loc)] = 1
-        else:
-            locs[(endpoint, loc)] += 1
+        loc = lookup_symbol(symbols, s['pc'])
+        locs[(endpoint, loc)] = locs.get((endpoint, loc), 0) + 1
 
     return locs
 
 
+def get_folded_stacks(samples, procs, symbol_map):
+    stacks = dict()
+
+    for s in samples:
+        endpoint = s['endpoint']
+        symbols = symbol_map.get(endpoint, [])
+
+        # return addresses point past the call instruction
+        frames = [lookup_symbol(symbols, s['pc'])]
+        frames += [lookup_symbol(symbols, ret - 1) for ret in s['chain']]
+
+        name = procs.get(endpoint, str(endpoint)).lower()
+        key = ';'.join([name] + frames[::-1])
+        stacks[key] = stacks.get(key, 0) + 1
+
+    return stacks
+
+
+def print_folded(stacks):
+    for stack, count in sorted(stacks.items()):
+        print(f'{stack} {count}')
+
+
 def get_progress_bar(percentage, length):
     bar_length = length - 2
     bar = '#' * int(round(bar_length * percentage / 100.0))
@@ -115,7 +154,7 @@ def get_progress_bar(percentage, length):
 
 
 def print_report(sample_counts, procs, locs):
-    idle_samples, system_samples, user_samples, total_samples = sample_counts
+    idle_samples, system_samples, user_samples, total_samples, dropped_samples = sample_counts
 
     slocs = sorted([(k, v) for k, v in locs.items()], key=lambda x: -x[1])
     total = sum([x[1] for x in slocs])
@@ -135,10 +174,14 @@ def print_report(sample_counts, procs, locs):
     print(('-' * 7 + '  ' + '-' * 4 + ' ').rjust(40))
     print('Total samples:'.rjust(25), end='')
     print(f'{total_samples} (100%)'.rjust(15))
+    if dropped_samples:
+        print('Dropped samples:'.rjust(25), end='')
+        print(f'{dropped_samples}'.rjust(15))
     print('')
 
     print('-' * 80)
-    print('Total system process time' + f'{system_samples} samples'.rjust(55))
+    print('Total sampled process time' +
+          f'{system_samples + user_samples} samples'.rjust(54))
     print('-' * 80)
 
     for (endpoint, func), count in slocs:
@@ -167,6 +210,8 @@ if __name__ == '__main__':
         sample_counts, procs, samples = load_samples(fin)
         symbol_map = get_symbols(procs, args.kernel, args.sbin, args.toolchain)
 
-        locs = get_sample_locs(samples, symbol_map)
-
-        print_report(sample_counts, procs, locs)
+        if args.folded:
+            print_folded(get_folded_stacks(samples, procs, symbol_map))
+        else:
+            locs = get_sample_locs(samples, symbol_map)
+            print_report(sample_counts, procs, locs)
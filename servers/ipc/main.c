@@ -21,6 +21,18 @@
 
 #include "proto.h"
 
+static int do_pm_exit(MESSAGE* msg)
+{
+    if (msg->source != TASK_PM) return SUSPEND;
+
+    sem_exit(msg->ENDPOINT);
+    msg_exit(msg->ENDPOINT);
+    shm_sweep();
+
+    /* PM does not wait for a reply */
+    return SUSPEND;
+}
+
 int main()
 {
     printl("ipc: IPC server is running.\n");
@@ -40,13 +52,45 @@ int main()
         case IPC_SHMAT:
             msg.RETVAL = do_shmat(&msg);
             break;
+        case IPC_SHMDT:
+            msg.RETVAL = do_shmdt(&msg);
+            break;
+        case IPC_SHMCTL:
+            msg.RETVAL = do_shmctl(&msg);
+            break;
+        case IPC_SEMGET:
+            msg.RETVAL = do_semget(&msg);
+            break;
+        case IPC_SEMCTL:
+            msg.RETVAL = do_semctl(&msg);
+            break;
+        case IPC_SEMOP:
+            msg.RETVAL = do_semop(&msg);
+            break;
+        case IPC_MSGGET:
+            msg.RETVAL = do_msgget(&msg);
+            break;
+        case IPC_MSGCTL:
+            msg.RETVAL = do_msgctl(&msg);
+            break;
+        case IPC_MSGSND:
+            msg.RETVAL = do_msgsnd(&msg);
+            break;
+        case IPC_MSGRCV:
+            msg.RETVAL = do_msgrcv(&msg);
+            break;
+        case IPC_PM_EXIT:
+            msg.RETVAL = do_pm_exit(&msg);
+            break;
         default:
             msg.RETVAL = ENOSYS;
             break;
         }
 
-        msg.type = SYSCALL_RET;
-        send_recv(SEND_NONBLOCK, src, &msg);
+        if (msg.RETVAL != SUSPEND) {
+            msg.type = SYSCALL_RET;
+            send_recv(SEND_NONBLOCK, src, &msg);
+        }
     }
 
     return 0;
@@ -0,0 +1,480 @@
+/*  This file is part of Lyos.
+
+    Lyos is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Lyos is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Lyos.  If not, see <http://www.gnu.org/licenses/>. */
+
+#include <lyos/types.h>
+#include <lyos/ipc.h>
+#include <sys/types.h>
+#include <lyos/sysutils.h>
+#include <errno.h>
+#include <lyos/const.h>
+#include <lyos/list.h>
+#include <string.h>
+#include <stdlib.h>
+#include <sys/msg.h>
+
+#include "const.h"
+#include "proto.h"
+
+#define MSG_INUSE 0x0800
+
+struct msg_msg {
+    struct list_head list;
+    long mtype;
+    size_t size;
+    char data[0];
+};
+
+/* A process suspended in msgsnd() or msgrcv(). */
+struct msg_waiter {
+    struct list_head list;
+    endpoint_t endpoint;
+    pid_t pid;
+    void* buf;
+    size_t size;
+    long mtype;
+    int flags;
+};
+
+struct msg_queue {
+    struct msqid_ds msqid;
+
+    struct list_head messages;
+    struct list_head senders;
+    struct list_head receivers;
+};
+
+static struct msg_queue msq_list[MSGMNI];
+static int msq_count = 0;
+
+static struct msg_queue* msq_find_key(key_t key)
+{
+    unsigned int i;
+
+    if (key == IPC_PRIVATE) return NULL;
+
+    for (i = 0; i < msq_count; i++) {
+        if (!(msq_list[i].msqid.msg_perm.mode & MSG_INUSE)) continue;
+        if (msq_list[i].msqid.msg_perm.key == key) return &msq_list[i];
+    }
+
+    return NULL;
+}
+
+static struct msg_queue* msq_find_id(int id)
+{
+    struct msg_queue* msq;
+    unsigned int i;
+
+    i = IPCID_TO_IX(id);
+    if (i >= msq_count) return NULL;
+
+    msq = &msq_list[i];
+    if (!(msq->msqid.msg_perm.mode & MSG_INUSE)) return NULL;
+    if (msq->msqid.msg_perm.seq != IPCID_TO_SEQ(id)) return NULL;
+
+    return msq;
+}
+
+static int msg_match(struct msg_msg* msg, long mtype, int flags)
+{
+    if (mtype == 0) return TRUE;
+    if (mtype < 0) return msg->mtype <= -mtype;
+    if (flags & MSG_EXCEPT) return msg->mtype != mtype;
+    return msg->mtype == mtype;
+}
+
+static struct msg_msg* msg_find(struct msg_queue* msq, long mtype, int flags)
+{
+    struct msg_msg *msg, *found = NULL;
+
+    list_for_each_entry(msg, &msq->messages, list)
+    {
+        if (!msg_match(msg, mtype, flags)) continue;
+
+        /* for a negative type take the lowest type less than or equal to
+         * the absolute value */
+        if (mtype >= 0) return msg;
+        if (!found || msg->mtype < found->mtype) found = msg;
+    }
+
+    return found;
+}
+
+/* Copy a message to a receiver and remove it from the queue. Returns the
+ * number of bytes copied or a negative error code. */
+static ssize_t msg_deliver(struct msg_queue* msq, struct msg_msg* msg,
+                           endpoint_t endpoint, pid_t pid, void* buf,
+                           size_t size, int flags)
+{
+    size_t len = msg->size;
+    int retval;
+
+    if (len > size) {
+        if (!(flags & MSG_NOERROR)) return -E2BIG;
+        len = size;
+    }
+
+    if ((retval = data_copy(endpoint, buf, SELF, &msg->mtype,
+                            sizeof(msg->mtype))) != 0)
+        return -retval;
+    if (len &&
+        (retval = data_copy(endpoint, buf + sizeof(long), SELF, msg->data,
+                            len)) != 0)
+        return -retval;
+
+    list_del(&msg->list);
+    msq->msqid.msg_qnum--;
+    msq->msqid.msg_cbytes -= msg->size;
+    msq->msqid.msg_lrpid = pid;
+    msq->msqid.msg_rtime = now();
+    free(msg);
+
+    return len;
+}
+
+/* Copy a message in from a sender and append it to the queue. */
+static int msg_enqueue(struct msg_queue* msq, endpoint_t endpoint, pid_t pid,
+                       void* buf, size_t size)
+{
+    struct msg_msg* msg;
+    int retval;
+
+    if (!(msg = malloc(sizeof(*msg) + size))) return ENOMEM;
+
+    if ((retval = data_copy(SELF, &msg->mtype, endpoint, buf,
+                            sizeof(msg->mtype))) != 0)
+        goto err;
+    if (msg->mtype < 1) {
+        retval = EINVAL;
+        goto err;
+    }
+    if (size && (retval = data_copy(SELF, msg->data, endpoint,
+                                    buf + sizeof(long), size)) != 0)
+        goto err;
+
+    msg->size = size;
+    list_add_tail(&msg->list, &msq->messages);
+    msq->msqid.msg_qnum++;
+    msq->msqid.msg_cbytes += size;
+    msq->msqid.msg_lspid = pid;
+    msq->msqid.msg_stime = now();
+
+    return 0;
+
+err:
+    free(msg);
+    return retval;
+}
+
+static int msq_has_room(struct msg_queue* msq, size_t size)
+{
+    return msq->msqid.msg_cbytes + size <= msq->msqid.msg_qbytes;
+}
+
+/* Hand queued messages to the receivers waiting for them and let blocked
+ * senders in while there is room. */
+static void msq_update(struct msg_queue* msq)
+{
+    struct msg_waiter *w, *tmp;
+    struct msg_msg* msg;
+    ssize_t count;
+    int progress;
+
+    do {
+        progress = FALSE;
+
+        list_for_each_entry_safe(w, tmp, &msq->receivers, list)
+        {
+            if (!(msg = msg_find(msq, w->mtype, w->flags))) continue;
+
+            count = msg_deliver(msq, msg, w->endpoint, w->pid, w->buf, w->size,
+                                w->flags);
+
+            list_del(&w->list);
+            ipc_reply(w->endpoint, count < 0 ? -count : 0,
+                      count < 0 ? 0 : count);
+            free(w);
+
+            if (count >= 0) progress = TRUE;
+        }
+
+        list_for_each_entry_safe(w, tmp, &msq->senders, list)
+        {
+            int retval;
+
+            if (!msq_has_room(msq, w->size)) break;
+
+            retval = msg_enqueue(msq, w->endpoint, w->pid, w->buf, w->size);
+
+            list_del(&w->list);
+            ipc_reply(w->endpoint, retval, 0);
+            free(w);
+
+            if (retval == 0) progress = TRUE;
+        }
+    } while (progress);
+}
+
+static int msq_sleep(struct list_head* head, MESSAGE* msg, pid_t pid,
+                     long mtype)
+{
+    struct msg_waiter* w;
+
+    if (!(w = malloc(sizeof(*w)))) return ENOMEM;
+
+    w->endpoint = msg->source;
+    w->pid = pid;
+    w->buf = msg->IPC_ADDR;
+    w->size = msg->IPC_SIZE;
+    w->mtype = mtype;
+    w->flags = msg->IPC_FLAGS;
+    list_add_tail(&w->list, head);
+
+    return SUSPEND;
+}
+
+static void msq_wake_all(struct list_head* head, int retval)
+{
+    struct msg_waiter *w, *tmp;
+
+    list_for_each_entry_safe(w, tmp, head, list)
+    {
+        list_del(&w->list);
+        ipc_reply(w->endpoint, retval, 0);
+        free(w);
+    }
+}
+
+static void msq_free(struct msg_queue* msq)
+{
+    struct msg_msg *msg, *tmp;
+
+    msq_wake_all(&msq->senders, EIDRM);
+    msq_wake_all(&msq->receivers, EIDRM);
+
+    list_for_each_entry_safe(msg, tmp, &msq->messages, list)
+    {
+        list_del(&msg->list);
+        free(msg);
+    }
+
+    msq->msqid.msg_perm.mode = 0;
+
+    while (msq_count > 0 &&
+           !(msq_list[msq_count - 1].msqid.msg_perm.mode & MSG_INUSE))
+        msq_count--;
+}
+
+int do_msgget(MESSAGE* msg)
+{
+    key_t key = msg->IPC_KEY;
+    int flags = msg->IPC_FLAGS;
+    endpoint_t endpoint = msg->source;
+    struct msg_queue* msq;
+    int i;
+
+    msq = msq_find_key(key);
+
+    if (msq) {
+        if (!check_perm(&msq->msqid.msg_perm, endpoint, flags & 0777)) {
+            return EACCES;
+        }
+        if ((flags & IPC_CREAT) && (flags & IPC_EXCL)) {
+            return EEXIST;
+        }
+
+        i = msq - msq_list;
+    } else {
+        if (!(flags & IPC_CREAT)) {
+            return ENOENT;
+        }
+
+        for (i = 0; i < MSGMNI; i++) {
+            if (!(msq_list[i].msqid.msg_perm.mode & MSG_INUSE)) break;
+        }
+        if (i == MSGMNI) {
+            return ENOSPC;
+        }
+
+        uid_t uid;
+        gid_t gid;
+        get_epinfo(endpoint, &uid, &gid);
+
+        msq = &msq_list[i];
+        int seq = msq->msqid.msg_perm.seq;
+        memset(msq, 0, sizeof(*msq));
+        msq->msqid.msg_perm.key = key;
+        msq->msqid.msg_perm.uid = uid;
+        msq->msqid.msg_perm.gid = gid;
+        msq->msqid.msg_perm.cuid = uid;
+        msq->msqid.msg_perm.cgid = gid;
+        msq->msqid.msg_perm.mode = MSG_INUSE | (flags & 0777);
+        msq->msqid.msg_perm.seq = (seq + 1) & 0x7fff;
+        msq->msqid.msg_qbytes = MSGMNB;
+        msq->msqid.msg_ctime = now();
+
+        INIT_LIST_HEAD(&msq->messages);
+        INIT_LIST_HEAD(&msq->senders);
+        INIT_LIST_HEAD(&msq->receivers);
+
+        if (i == msq_count) msq_count++;
+    }
+
+    msg->IPC_RETID = IXSEQ_TO_IPCID(i, msq->msqid.msg_perm.seq);
+    return 0;
+}
+
+int do_msgsnd(MESSAGE* msg)
+{
+    size_t size = msg->IPC_SIZE;
+    int flags = msg->IPC_FLAGS;
+    struct msg_queue* msq;
+    pid_t pid;
+    int retval;
+
+    if (!(msq = msq_find_id(msg->IPC_ID))) return EINVAL;
+    if (size > MSGMAX || size > msq->msqid.msg_qbytes) return EINVAL;
+
+    if (!check_perm(&msq->msqid.msg_perm, msg->source, IPC_W)) return EACCES;
+
+    pid = get_epinfo(msg->source, NULL, NULL);
+
+    if (!msq_has_room(msq, size) || !list_empty(&msq->senders)) {
+        if (flags & IPC_NOWAIT) return EAGAIN;
+
+        return msq_sleep(&msq->senders, msg, pid, 0);
+    }
+
+    if ((retval = msg_enqueue(msq, msg->source, pid, msg->IPC_ADDR, size)) != 0)
+        return retval;
+
+    msq_update(msq);
+
+    return 0;
+}
+
+int do_msgrcv(MESSAGE* msg)
+{
+    size_t size = msg->IPC_SIZE;
+    long mtype = (long)msg->IPC_MSGTYP;
+    int flags = msg->IPC_FLAGS;
+    struct msg_queue* msq;
+    struct msg_msg* m;
+    ssize_t count;
+    pid_t pid;
+
+    if (!(msq = msq_find_id(msg->IPC_ID))) return EINVAL;
+
+    if (!check_perm(&msq->msqid.msg_perm, msg->source, IPC_R)) return EACCES;
+
+    pid = get_epinfo(msg->source, NULL, NULL);
+
+    if (!(m = msg_find(msq, mtype, flags))) {
+        if (flags & IPC_NOWAIT) return ENOMSG;
+
+        return msq_sleep(&msq->receivers, msg, pid, mtype);
+    }
+
+    count = msg_deliver(msq, m, msg->source, pid, msg->IPC_ADDR, size, flags);
+    if (count < 0) return -count;
+
+    msq_update(msq);
+
+    msg->IPC_RETNUM = count;
+    return 0;
+}
+
+int do_msgctl(MESSAGE* msg)
+{
+    int id = msg->IPC_ID;
+    int cmd = msg->IPC_CMD;
+    void* buf = msg->IPC_ADDR;
+    struct msqid_ds ds;
+    struct msg_queue* msq;
+    int retval;
+
+    if (!(msq = msq_find_id(id))) return EINVAL;
+
+    switch (cmd) {
+    case IPC_STAT:
+        if (!check_perm(&msq->msqid.msg_perm, msg->source, IPC_R))
+            return EACCES;
+
+        ds = msq->msqid;
+        ds.msg_perm.mode &= 0777;
+        return data_copy(msg->source, buf, SELF, &ds, sizeof(ds));
+    case IPC_SET:
+        if (!check_owner(&msq->msqid.msg_perm, msg->source)) return EPERM;
+
+        if ((retval = data_copy(SELF, &ds, msg->source, buf, sizeof(ds))) != 0)
+            return retval;
+
+        /* only root may raise the limit beyond the default */
+        if (ds.msg_qbytes > MSGMNB) {
+            uid_t uid;
+
+            if (get_epinfo(msg->source, &uid, NULL) < 0 || uid != SU_UID)
+                return EPERM;
+        }
+
+        msq->msqid.msg_perm.uid = ds.msg_perm.uid;
+        msq->msqid.msg_perm.gid = ds.msg_perm.gid;
+        msq->msqid.msg_perm.mode &= ~0777;
+        msq->msqid.msg_perm.mode |= ds.msg_perm.mode & 0777;
+        msq->msqid.msg_qbytes = ds.msg_qbytes;
+        msq->msqid.msg_ctime = now();
+
+        /* the queue may have grown */
+        msq_update(msq);
+        return 0;
+    case IPC_RMID:
+        if (!check_owner(&msq->msqid.msg_perm, msg->source)) return EPERM;
+
+        msq_free(msq);
+        return 0;
+    default:
+        return EINVAL;
+    }
+
+    return 0;
+}
+
+void msg_exit(endpoint_t endpoint)
+{
+    struct msg_waiter *w, *tmp;
+    struct msg_queue* msq;
+    int i;
+
+    for (i = 0; i < msq_count; i++) {
+        msq = &msq_list[i];
+        if (!(msq->msqid.msg_perm.mode & MSG_INUSE)) continue;
+
+        list_for_each_entry_safe(w, tmp, &msq->senders, list)
+        {
+            if (w->endpoint != endpoint) continue;
+            list_del(&w->list);
+            free(w);
+        }
+        list_for_each_entry_safe(w, tmp, &msq->receivers, list)
+        {
+            if (w->endpoint != endpoint) continue;
+            list_del(&w->list);
+            free(w);
+        }
+
+        /* a departed sender may have been holding up the ones behind it */
+        msq_update(msq);
+    }
+}
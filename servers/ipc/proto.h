@@ -17,8 +17,24 @@
 #define _IPC_PROTO_H_
 
 int check_perm(struct ipc_perm* perm, endpoint_t source, mode_t mode);
+int check_owner(struct ipc_perm* perm, endpoint_t source);
+void ipc_reply(endpoint_t endpoint, int retval, int retnum);
 
 int do_shmget(MESSAGE* msg);
 int do_shmat(MESSAGE* msg);
+int do_shmdt(MESSAGE* msg);
+int do_shmctl(MESSAGE* msg);
+void shm_sweep(void);
+
+int do_semget(MESSAGE* msg);
+int do_semctl(MESSAGE* msg);
+int do_semop(MESSAGE* msg);
+void sem_exit(endpoint_t endpoint);
+
+int do_msgget(MESSAGE* msg);
+int do_msgctl(MESSAGE* msg);
+int do_msgsnd(MESSAGE* msg);
+int do_msgrcv(MESSAGE* msg);
+void msg_exit(endpoint_t endpoint);
 
 #endif
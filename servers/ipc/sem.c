@@ -0,0 +1,653 @@
+/*  This file is part of Lyos.
+
+    Lyos is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Lyos is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Lyos.  If not, see <http://www.gnu.org/licenses/>. */
+
+#include <lyos/types.h>
+#include <lyos/ipc.h>
+#include <sys/types.h>
+#include <lyos/sysutils.h>
+#include <errno.h>
+#include <lyos/const.h>
+#include <lyos/list.h>
+#include <lyos/bitmap.h>
+#include <string.h>
+#include <stdlib.h>
+#include <sys/sem.h>
+
+#include "const.h"
+#include "proto.h"
+
+#define SEM_INUSE 0x0800
+
+struct sem {
+    unsigned short semval;
+    pid_t sempid;
+
+    /* Sleepers are queued on the semaphore they wait for so that an update
+     * only retries the processes that may be able to proceed. */
+    struct list_head pending_alter; /* waiting for semval to increase */
+    struct list_head pending_const; /* waiting for semval to become zero */
+};
+
+/* A process suspended in semop(). */
+struct sem_queue {
+    struct list_head list;
+    endpoint_t endpoint;
+    pid_t pid;
+    int alter;
+    size_t nsops;
+    struct sembuf sops[SEMOPM];
+};
+
+/* Per-process adjustments applied on exit for SEM_UNDO operations. */
+struct sem_undo {
+    struct list_head list;
+    endpoint_t endpoint;
+    short semadj[0];
+};
+
+struct sem_array {
+    struct semid_ds semid;
+    struct sem* sems;
+
+    /* operations on more than one semaphore */
+    struct list_head pending_complex;
+    struct list_head undo_list;
+};
+
+static struct sem_array sem_list[SEMMNI];
+static int sem_count = 0;
+
+static struct sem_array* sem_find_key(key_t key)
+{
+    unsigned int i;
+
+    if (key == IPC_PRIVATE) return NULL;
+
+    for (i = 0; i < sem_count; i++) {
+        if (!(sem_list[i].semid.sem_perm.mode & SEM_INUSE)) continue;
+        if (sem_list[i].semid.sem_perm.key == key) return &sem_list[i];
+    }
+
+    return NULL;
+}
+
+static struct sem_array* sem_find_id(int id)
+{
+    struct sem_array* sma;
+    unsigned int i;
+
+    i = IPCID_TO_IX(id);
+    if (i >= sem_count) return NULL;
+
+    sma = &sem_list[i];
+    if (!(sma->semid.sem_perm.mode & SEM_INUSE)) return NULL;
+    if (sma->semid.sem_perm.seq != IPCID_TO_SEQ(id)) return NULL;
+
+    return sma;
+}
+
+static struct sem_undo* sem_find_undo(struct sem_array* sma,
+                                      endpoint_t endpoint, int create)
+{
+    struct sem_undo* un;
+
+    list_for_each_entry(un, &sma->undo_list, list)
+    {
+        if (un->endpoint == endpoint) return un;
+    }
+
+    if (!create) return NULL;
+
+    un = calloc(1, sizeof(*un) + sizeof(short) * sma->semid.sem_nsems);
+    if (!un) return NULL;
+
+    un->endpoint = endpoint;
+    list_add(&un->list, &sma->undo_list);
+
+    return un;
+}
+
+/* Try to perform all operations in sops atomically. Returns 0 if all
+ * operations were applied, 1 if the caller should sleep and an error code
+ * otherwise. */
+static int perform_atomic_semop(struct sem_array* sma, struct sembuf* sops,
+                                size_t nsops, pid_t pid, struct sem_undo* un)
+{
+    struct sembuf* sop;
+    struct sem* sem;
+    int result, i;
+
+    for (i = 0; i < nsops; i++) {
+        sop = &sops[i];
+        sem = &sma->sems[sop->sem_num];
+        result = sem->semval;
+
+        if (!sop->sem_op && result) goto would_block;
+
+        result += sop->sem_op;
+        if (result < 0) goto would_block;
+        if (result > SEMVMX) goto out_of_range;
+
+        if (sop->sem_flg & SEM_UNDO) {
+            int undo = un->semadj[sop->sem_num] - sop->sem_op;
+            if (undo < -SEMAEM - 1 || undo > SEMAEM) goto out_of_range;
+            un->semadj[sop->sem_num] = undo;
+        }
+
+        sem->semval = result;
+    }
+
+    for (i = 0; i < nsops; i++) {
+        sma->sems[sops[i].sem_num].sempid = pid;
+    }
+
+    return 0;
+
+out_of_range:
+    result = ERANGE;
+    goto undo;
+
+would_block:
+    result = 1;
+
+undo:
+    for (i--; i >= 0; i--) {
+        sop = &sops[i];
+        sma->sems[sop->sem_num].semval -= sop->sem_op;
+        if (sop->sem_flg & SEM_UNDO) un->semadj[sop->sem_num] += sop->sem_op;
+    }
+
+    return result;
+}
+
+static void sem_mark_dirty(struct sembuf* sops, size_t nsops, bitchunk_t* dirty)
+{
+    int i;
+
+    for (i = 0; i < nsops; i++) {
+        if (sops[i].sem_op) SET_BIT(dirty, sops[i].sem_num);
+    }
+}
+
+/* Retry the sleepers on one list. Returns TRUE if any operation that
+ * altered the array completed. */
+static int update_queue(struct sem_array* sma, struct list_head* head,
+                        bitchunk_t* dirty)
+{
+    struct sem_queue *q, *tmp;
+    struct sem_undo* un;
+    int retval, altered = FALSE;
+
+    list_for_each_entry_safe(q, tmp, head, list)
+    {
+        un = sem_find_undo(sma, q->endpoint, FALSE);
+        retval = perform_atomic_semop(sma, q->sops, q->nsops, q->pid, un);
+        if (retval == 1) continue;
+
+        list_del(&q->list);
+
+        if (retval == 0) sma->semid.sem_otime = now();
+        if (retval == 0 && q->alter) {
+            sem_mark_dirty(q->sops, q->nsops, dirty);
+            altered = TRUE;
+        }
+
+        ipc_reply(q->endpoint, retval, 0);
+        free(q);
+    }
+
+    return altered;
+}
+
+/* Wake up the sleepers that may be able to proceed after the semaphores in
+ * the dirty set are changed. */
+static void do_smart_update(struct sem_array* sma, bitchunk_t* dirty)
+{
+    bitchunk_t cur[BITCHUNKS(SEMMSL)];
+    int i, altered;
+
+    do {
+        memcpy(cur, dirty, sizeof(cur));
+        memset(dirty, 0, sizeof(cur));
+        altered = FALSE;
+
+        for (i = 0; i < sma->semid.sem_nsems; i++) {
+            if (!GET_BIT(cur, i)) continue;
+
+            if (sma->sems[i].semval == 0)
+                altered |= update_queue(sma, &sma->sems[i].pending_const, dirty);
+            else
+                altered |= update_queue(sma, &sma->sems[i].pending_alter, dirty);
+        }
+
+        altered |= update_queue(sma, &sma->pending_complex, dirty);
+    } while (altered);
+}
+
+static void sem_wake_all(struct list_head* head, int retval)
+{
+    struct sem_queue *q, *tmp;
+
+    list_for_each_entry_safe(q, tmp, head, list)
+    {
+        list_del(&q->list);
+        ipc_reply(q->endpoint, retval, 0);
+        free(q);
+    }
+}
+
+static void sem_free(struct sem_array* sma)
+{
+    struct sem_undo *un, *tmp;
+    int i;
+
+    for (i = 0; i < sma->semid.sem_nsems; i++) {
+        sem_wake_all(&sma->sems[i].pending_alter, EIDRM);
+        sem_wake_all(&sma->sems[i].pending_const, EIDRM);
+    }
+    sem_wake_all(&sma->pending_complex, EIDRM);
+
+    list_for_each_entry_safe(un, tmp, &sma->undo_list, list)
+    {
+        list_del(&un->list);
+        free(un);
+    }
+
+    free(sma->sems);
+    sma->sems = NULL;
+    sma->semid.sem_perm.mode = 0;
+
+    while (sem_count > 0 &&
+           !(sem_list[sem_count - 1].semid.sem_perm.mode & SEM_INUSE))
+        sem_count--;
+}
+
+int do_semget(MESSAGE* msg)
+{
+    key_t key = msg->IPC_KEY;
+    int nsems = msg->IPC_SIZE;
+    int flags = msg->IPC_FLAGS;
+    endpoint_t endpoint = msg->source;
+    struct sem_array* sma;
+    int i;
+
+    sma = sem_find_key(key);
+
+    if (sma) {
+        if (!check_perm(&sma->semid.sem_perm, endpoint, flags & 0777)) {
+            return EACCES;
+        }
+        if ((flags & IPC_CREAT) && (flags & IPC_EXCL)) {
+            return EEXIST;
+        }
+        if (nsems > sma->semid.sem_nsems) {
+            return EINVAL;
+        }
+
+        i = sma - sem_list;
+    } else {
+        if (!(flags & IPC_CREAT)) {
+            return ENOENT;
+        }
+        if (nsems <= 0 || nsems > SEMMSL) {
+            return EINVAL;
+        }
+
+        for (i = 0; i < SEMMNI; i++) {
+            if (!(sem_list[i].semid.sem_perm.mode & SEM_INUSE)) break;
+        }
+        if (i == SEMMNI) {
+            return ENOSPC;
+        }
+
+        struct sem* sems = calloc(nsems, sizeof(struct sem));
+        if (!sems) return ENOMEM;
+
+        uid_t uid;
+        gid_t gid;
+        get_epinfo(endpoint, &uid, &gid);
+
+        sma = &sem_list[i];
+        int seq = sma->semid.sem_perm.seq;
+        memset(sma, 0, sizeof(*sma));
+        sma->semid.sem_perm.key = key;
+        sma->semid.sem_perm.uid = uid;
+        sma->semid.sem_perm.gid = gid;
+        sma->semid.sem_perm.cuid = uid;
+        sma->semid.sem_perm.cgid = gid;
+        sma->semid.sem_perm.mode = SEM_INUSE | (flags & 0777);
+        sma->semid.sem_perm.seq = (seq + 1) & 0x7fff;
+        sma->semid.sem_nsems = nsems;
+        sma->semid.sem_ctime = now();
+        sma->sems = sems;
+
+        INIT_LIST_HEAD(&sma->pending_complex);
+        INIT_LIST_HEAD(&sma->undo_list);
+        for (i = 0; i < nsems; i++) {
+            INIT_LIST_HEAD(&sems[i].pending_alter);
+            INIT_LIST_HEAD(&sems[i].pending_const);
+        }
+
+        i = sma - sem_list;
+        if (i == sem_count) sem_count++;
+    }
+
+    msg->IPC_RETID = IXSEQ_TO_IPCID(i, sma->semid.sem_perm.seq);
+    return 0;
+}
+
+int do_semop(MESSAGE* msg)
+{
+    int id = msg->IPC_ID;
+    size_t nsops = msg->IPC_SIZE;
+    struct sembuf sops[SEMOPM];
+    bitchunk_t dirty[BITCHUNKS(SEMMSL)];
+    struct sem_array* sma;
+    struct sem_undo* un = NULL;
+    struct sem_queue* q;
+    int undo = FALSE, alter = FALSE;
+    int i, retval;
+    pid_t pid;
+
+    if (nsops < 1) return EINVAL;
+    if (nsops > SEMOPM) return E2BIG;
+
+    /* all operations of a batch are copied in with one request */
+    if ((retval = data_copy(SELF, sops, msg->source, msg->IPC_ADDR,
+                            sizeof(struct sembuf) * nsops)) != 0)
+        return retval;
+
+    if (!(sma = sem_find_id(id))) return EINVAL;
+
+    for (i = 0; i < nsops; i++) {
+        if (sops[i].sem_num >= sma->semid.sem_nsems) return EFBIG;
+        if (sops[i].sem_flg & SEM_UNDO) undo = TRUE;
+        if (sops[i].sem_op) alter = TRUE;
+    }
+
+    if (!check_perm(&sma->semid.sem_perm, msg->source,
+                    alter ? IPC_W : IPC_R))
+        return EACCES;
+
+    if (undo && !(un = sem_find_undo(sma, msg->source, TRUE))) return ENOMEM;
+
+    pid = get_epinfo(msg->source, NULL, NULL);
+
+    retval = perform_atomic_semop(sma, sops, nsops, pid, un);
+    if (retval == 0) {
+        sma->semid.sem_otime = now();
+
+        if (alter) {
+            memset(dirty, 0, sizeof(dirty));
+            sem_mark_dirty(sops, nsops, dirty);
+            do_smart_update(sma, dirty);
+        }
+
+        return 0;
+    }
+    if (retval != 1) return retval;
+
+    /* the operation would block */
+    for (i = 0; i < nsops; i++) {
+        if (sops[i].sem_flg & IPC_NOWAIT) return EAGAIN;
+    }
+
+    if (!(q = malloc(sizeof(*q)))) return ENOMEM;
+
+    q->endpoint = msg->source;
+    q->pid = pid;
+    q->alter = alter;
+    q->nsops = nsops;
+    memcpy(q->sops, sops, sizeof(struct sembuf) * nsops);
+
+    if (nsops == 1) {
+        struct sem* sem = &sma->sems[sops[0].sem_num];
+
+        if (sops[0].sem_op == 0)
+            list_add_tail(&q->list, &sem->pending_const);
+        else
+            list_add_tail(&q->list, &sem->pending_alter);
+    } else {
+        list_add_tail(&q->list, &sma->pending_complex);
+    }
+
+    return SUSPEND;
+}
+
+static int count_semcnt(struct sem_array* sma, int semnum, int count_zero)
+{
+    struct sem* sem = &sma->sems[semnum];
+    struct list_head* head;
+    struct sem_queue* q;
+    int i, count = 0;
+
+    head = count_zero ? &sem->pending_const : &sem->pending_alter;
+    list_for_each_entry(q, head, list)
+    {
+        count++;
+    }
+
+    /* a complex operation is counted on the first semaphore it blocks on */
+    list_for_each_entry(q, &sma->pending_complex, list)
+    {
+        for (i = 0; i < q->nsops; i++) {
+            struct sembuf* sop = &q->sops[i];
+            int semval = sma->sems[sop->sem_num].semval;
+
+            if (sop->sem_op == 0 && semval != 0) {
+                if (count_zero && sop->sem_num == semnum) count++;
+                break;
+            }
+            if (sop->sem_op < 0 && semval + sop->sem_op < 0) {
+                if (!count_zero && sop->sem_num == semnum) count++;
+                break;
+            }
+        }
+    }
+
+    return count;
+}
+
+int do_semctl(MESSAGE* msg)
+{
+    int id = msg->IPC_ID;
+    int semnum = msg->IPC_SEMNUM;
+    int cmd = msg->IPC_CMD;
+    void* buf = msg->IPC_ADDR;
+    unsigned short vals[SEMMSL];
+    bitchunk_t dirty[BITCHUNKS(SEMMSL)];
+    struct sem_array* sma;
+    struct sem_undo* un;
+    struct semid_ds ds;
+    int i, val, retval;
+
+    /* IPC_RETNUM shares its field with IPC_SEMNUM, only the GET* commands
+     * return a value */
+    msg->IPC_RETNUM = 0;
+
+    if (!(sma = sem_find_id(id))) return EINVAL;
+
+    switch (cmd) {
+    case IPC_STAT:
+    case GETPID:
+    case GETVAL:
+    case GETALL:
+    case GETNCNT:
+    case GETZCNT:
+        if (!check_perm(&sma->semid.sem_perm, msg->source, IPC_R))
+            return EACCES;
+        break;
+    case SETVAL:
+    case SETALL:
+        if (!check_perm(&sma->semid.sem_perm, msg->source, IPC_W))
+            return EACCES;
+        break;
+    case IPC_SET:
+    case IPC_RMID:
+        if (!check_owner(&sma->semid.sem_perm, msg->source)) return EPERM;
+        break;
+    default:
+        return EINVAL;
+    }
+
+    switch (cmd) {
+    case GETPID:
+    case GETVAL:
+    case GETNCNT:
+    case GETZCNT:
+    case SETVAL:
+        if (semnum < 0 || semnum >= sma->semid.sem_nsems) return EINVAL;
+        break;
+    }
+
+    switch (cmd) {
+    case IPC_STAT:
+        ds = sma->semid;
+        ds.sem_perm.mode &= 0777;
+        return data_copy(msg->source, buf, SELF, &ds, sizeof(ds));
+    case IPC_SET:
+        if ((retval = data_copy(SELF, &ds, msg->source, buf, sizeof(ds))) != 0)
+            return retval;
+
+        sma->semid.sem_perm.uid = ds.sem_perm.uid;
+        sma->semid.sem_perm.gid = ds.sem_perm.gid;
+        sma->semid.sem_perm.mode &= ~0777;
+        sma->semid.sem_perm.mode |= ds.sem_perm.mode & 0777;
+        sma->semid.sem_ctime = now();
+        return 0;
+    case IPC_RMID:
+        sem_free(sma);
+        return 0;
+    case GETPID:
+        msg->IPC_RETNUM = sma->sems[semnum].sempid;
+        return 0;
+    case GETVAL:
+        msg->IPC_RETNUM = sma->sems[semnum].semval;
+        return 0;
+    case GETNCNT:
+        msg->IPC_RETNUM = count_semcnt(sma, semnum, FALSE);
+        return 0;
+    case GETZCNT:
+        msg->IPC_RETNUM = count_semcnt(sma, semnum, TRUE);
+        return 0;
+    case GETALL:
+        for (i = 0; i < sma->semid.sem_nsems; i++)
+            vals[i] = sma->sems[i].semval;
+
+        return data_copy(msg->source, buf, SELF, vals,
+                         sizeof(vals[0]) * sma->semid.sem_nsems);
+    case SETVAL:
+        val = (int)msg->IPC_VAL;
+        if (val < 0 || val > SEMVMX) return ERANGE;
+
+        memset(dirty, 0, sizeof(dirty));
+        sma->sems[semnum].semval = val;
+        sma->sems[semnum].sempid = get_epinfo(msg->source, NULL, NULL);
+        SET_BIT(dirty, semnum);
+
+        list_for_each_entry(un, &sma->undo_list, list)
+        {
+            un->semadj[semnum] = 0;
+        }
+        break;
+    case SETALL:
+        if ((retval = data_copy(SELF, vals, msg->source, buf,
+                                sizeof(vals[0]) * sma->semid.sem_nsems)) != 0)
+            return retval;
+
+        for (i = 0; i < sma->semid.sem_nsems; i++) {
+            if (vals[i] > SEMVMX) return ERANGE;
+        }
+
+        memset(dirty, 0, sizeof(dirty));
+        for (i = 0; i < sma->semid.sem_nsems; i++) {
+            sma->sems[i].semval = vals[i];
+            SET_BIT(dirty, i);
+        }
+
+        list_for_each_entry(un, &sma->undo_list, list)
+        {
+            memset(un->semadj, 0, sizeof(short) * sma->semid.sem_nsems);
+        }
+        break;
+    }
+
+    sma->semid.sem_ctime = now();
+    do_smart_update(sma, dirty);
+
+    return 0;
+}
+
+void sem_exit(endpoint_t endpoint)
+{
+    bitchunk_t dirty[BITCHUNKS(SEMMSL)];
+    struct sem_array* sma;
+    struct sem_queue *q, *tmp;
+    struct sem_undo* un;
+    int i, j, changed;
+
+    for (i = 0; i < sem_count; i++) {
+        sma = &sem_list[i];
+        if (!(sma->semid.sem_perm.mode & SEM_INUSE)) continue;
+
+        /* drop the process from all wait queues */
+        for (j = 0; j < sma->semid.sem_nsems; j++) {
+            list_for_each_entry_safe(q, tmp, &sma->sems[j].pending_alter, list)
+            {
+                if (q->endpoint != endpoint) continue;
+                list_del(&q->list);
+                free(q);
+            }
+            list_for_each_entry_safe(q, tmp, &sma->sems[j].pending_const, list)
+            {
+                if (q->endpoint != endpoint) continue;
+                list_del(&q->list);
+                free(q);
+            }
+        }
+        list_for_each_entry_safe(q, tmp, &sma->pending_complex, list)
+        {
+            if (q->endpoint != endpoint) continue;
+            list_del(&q->list);
+            free(q);
+        }
+
+        if (!(un = sem_find_undo(sma, endpoint, FALSE))) continue;
+
+        memset(dirty, 0, sizeof(dirty));
+        changed = FALSE;
+
+        for (j = 0; j < sma->semid.sem_nsems; j++) {
+            int semval;
+
+            if (!un->semadj[j]) continue;
+
+            /* clamp the result like Linux does instead of failing */
+            semval = sma->sems[j].semval + un->semadj[j];
+            if (semval < 0) semval = 0;
+            if (semval > SEMVMX) semval = SEMVMX;
+
+            sma->sems[j].semval = semval;
+            sma->sems[j].sempid = 0;
+            SET_BIT(dirty, j);
+            changed = TRUE;
+        }
+
+        list_del(&un->list);
+        free(un);
+
+        if (changed) do_smart_update(sma, dirty);
+    }
+}
@@ -22,6 +22,7 @@
 #include <string.h>
 #include <sys/mman.h>
 #include <sys/shm.h>
+#include <lyos/vm.h>
 
 #include <asm/page.h>
 
@@ -34,6 +35,7 @@ struct shm {
 };
 
 #define SHM_INUSE 0x0800
+#define SHM_DEST  0x0400 /* destroy the segment once the last user detaches */
 
 static struct shm shm_list[SHMMNI];
 static int shm_count = 0;
@@ -67,6 +69,55 @@ static struct shm* shm_find_id(int id)
     return shm;
 }
 
+static struct shm* shm_find_page(void* page)
+{
+    unsigned int i;
+
+    for (i = 0; i < shm_count; i++) {
+        if (!(shm_list[i].shmid.shm_perm.mode & SHM_INUSE)) continue;
+        if (shm_list[i].page == page) return &shm_list[i];
+    }
+
+    return NULL;
+}
+
+/* The number of attaches is tracked by MM as the number of shared mappings
+ * of the segment's pages in our address space. This also accounts for
+ * mappings inherited by fork() and dropped by exec()/exit(). */
+static unsigned long shm_nattch(struct shm* shm)
+{
+    struct mm_region_info info;
+
+    if (mm_get_regioninfo(SELF, shm->page, &info) != 0) return 0;
+
+    return info.remaps;
+}
+
+static void shm_try_destroy(struct shm* shm)
+{
+    if (!(shm->shmid.shm_perm.mode & SHM_DEST)) return;
+    if (shm_nattch(shm) > 0) return;
+
+    munmap(shm->page, roundup(shm->shmid.shm_segsz, ARCH_PG_SIZE));
+
+    shm->shmid.shm_perm.mode = 0;
+    shm->page = NULL;
+
+    while (shm_count > 0 &&
+           !(shm_list[shm_count - 1].shmid.shm_perm.mode & SHM_INUSE))
+        shm_count--;
+}
+
+void shm_sweep(void)
+{
+    unsigned int i;
+
+    for (i = 0; i < shm_count; i++) {
+        if (!(shm_list[i].shmid.shm_perm.mode & SHM_INUSE)) continue;
+        shm_try_destroy(&shm_list[i]);
+    }
+}
+
 int do_shmget(MESSAGE* msg)
 {
     key_t key;
@@ -82,7 +133,7 @@ int do_shmget(MESSAGE* msg)
     shm = shm_find_key(key);
 
     if (shm) {
-        if (!check_perm(&shm->shmid.shm_perm, endpoint, flags)) {
+        if (!check_perm(&shm->shmid.shm_perm, endpoint, flags & 0777)) {
             return EACCES;
         }
         if ((flags & IPC_CREAT) && (flags & IPC_EXCL)) {
@@ -180,3 +231,75 @@ int do_shmat(MESSAGE* msg)
     msg->IPC_RETADDR = retaddr;
     return 0;
 }
+
+int do_shmdt(MESSAGE* msg)
+{
+    void* addr = msg->IPC_ADDR;
+    struct mm_region_info info;
+    struct shm* shm;
+    int retval;
+
+    if (mm_get_regioninfo(msg->source, addr, &info) != 0) return EINVAL;
+    if (info.shared_endpoint != TASK_IPC) return EINVAL;
+
+    if (!(shm = shm_find_page(info.shared_vaddr))) return EINVAL;
+
+    if ((retval = munmap_for(msg->source, addr, info.length)) != 0)
+        return retval;
+
+    shm->shmid.shm_dtime = now();
+    shm->shmid.shm_lpid = get_epinfo(msg->source, NULL, NULL);
+
+    shm_try_destroy(shm);
+
+    return 0;
+}
+
+int do_shmctl(MESSAGE* msg)
+{
+    int id = msg->IPC_ID;
+    int cmd = msg->IPC_CMD;
+    void* buf = msg->IPC_ADDR;
+    struct shmid_ds ds;
+    struct shm* shm;
+    int retval;
+
+    if (!(shm = shm_find_id(id))) return EINVAL;
+
+    switch (cmd) {
+    case IPC_STAT:
+        if (!check_perm(&shm->shmid.shm_perm, msg->source, IPC_R))
+            return EACCES;
+
+        ds = shm->shmid;
+        ds.shm_perm.mode &= 0777;
+        ds.shm_nattch = shm_nattch(shm);
+
+        return data_copy(msg->source, buf, SELF, &ds, sizeof(ds));
+    case IPC_SET:
+        if (!check_owner(&shm->shmid.shm_perm, msg->source)) return EPERM;
+
+        if ((retval = data_copy(SELF, &ds, msg->source, buf, sizeof(ds))) != 0)
+            return retval;
+
+        shm->shmid.shm_perm.uid = ds.shm_perm.uid;
+        shm->shmid.shm_perm.gid = ds.shm_perm.gid;
+        shm->shmid.shm_perm.mode &= ~0777;
+        shm->shmid.shm_perm.mode |= ds.shm_perm.mode & 0777;
+        shm->shmid.shm_ctime = now();
+        break;
+    case IPC_RMID:
+        if (!check_owner(&shm->shmid.shm_perm, msg->source)) return EPERM;
+
+        /* the key is released immediately but the segment lives on until
+         * the last process detaches from it */
+        shm->shmid.shm_perm.mode |= SHM_DEST;
+        shm->shmid.shm_perm.key = IPC_PRIVATE;
+        shm_try_destroy(shm);
+        break;
+    default:
+        return EINVAL;
+    }
+
+    return 0;
+}
@@ -20,6 +20,7 @@
 #include <errno.h>
 #include <lyos/const.h>
 #include <sys/ipc.h>
+#include <string.h>
 
 #include "proto.h"
 
@@ -27,18 +28,43 @@ int check_perm(struct ipc_perm* perm, endpoint_t source, mode_t mode)
 {
     uid_t uid;
     gid_t gid;
-    mode_t perm_mode;
-    get_epinfo(source, &uid, &gid);
+    mode_t granted;
+
+    if (get_epinfo(source, &uid, &gid) < 0) return FALSE;
+
+    if (uid == SU_UID) return TRUE;
+
+    /* fold the requested owner/group/other bits into one rwx triple */
+    mode = (mode | (mode >> 3) | (mode >> 6)) & 0007;
 
     if (uid == perm->uid || uid == perm->cuid) {
-        perm_mode = perm->mode & 0x0700;
+        granted = perm->mode >> 6;
     } else if (gid == perm->gid || gid == perm->cgid) {
-        perm_mode = perm->mode & 0x0070;
-        mode >>= 3;
+        granted = perm->mode >> 3;
     } else {
-        perm_mode = perm->mode & 0x0007;
-        mode >>= 6;
+        granted = perm->mode;
     }
 
-    return mode && ((mode & perm_mode) == mode);
+    return (mode & ~granted & 0007) == 0;
+}
+
+int check_owner(struct ipc_perm* perm, endpoint_t source)
+{
+    uid_t uid;
+
+    if (get_epinfo(source, &uid, NULL) < 0) return FALSE;
+
+    return uid == SU_UID || uid == perm->uid || uid == perm->cuid;
+}
+
+void ipc_reply(endpoint_t endpoint, int retval, int retnum)
+{
+    MESSAGE msg;
+
+    memset(&msg, 0, sizeof(msg));
+    msg.type = SYSCALL_RET;
+    msg.RETVAL = retval;
+    msg.IPC_RETNUM = retnum;
+
+    send_recv(SEND_NONBLOCK, endpoint, &msg);
 }
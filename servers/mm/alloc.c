@@ -102,13 +102,16 @@ phys_bytes alloc_mem(phys_bytes memsize)
 phys_bytes alloc_pages(int nr_pages, int memflags)
 {
     size_t memsize = nr_pages * ARCH_PG_SIZE;
-    struct phys_hole *hp, *prev_ptr;
+    struct phys_hole *hp, *prev_ptr, *tail;
     phys_bytes old_base;
     phys_bytes page_align = ARCH_PG_SIZE;
 
     if (memflags & APF_ALIGN16K) {
         page_align = 0x4000;
     }
+    if (memflags & APF_ALIGNBIG) {
+        page_align = ARCH_BIG_PAGE_SIZE;
+    }
 
     prev_ptr = NULL;
     hp = hole_head;
@@ -116,18 +119,40 @@ phys_bytes alloc_pages(int nr_pages, int memflags)
         size_t alignment = 0;
         if (hp->h_base % page_align != 0)
             alignment = page_align - (hp->h_base % page_align);
+        /* A block cut from the middle of a hole leaves the part skipped to
+         * align it in the hole and the part after it in a new slot, so it
+         * can only be taken while a slot is left. */
+        if (hp->h_len > memsize + alignment && alignment && !free_slots) {
+            prev_ptr = hp;
+            hp = hp->h_next;
+            continue;
+        }
+
         if (hp->h_len >= memsize + alignment) {
             /* We found a hole that is big enough.  Use it. */
             old_base = hp->h_base + alignment;
-            hp->h_base += memsize + alignment;
-            hp->h_len -= (memsize + alignment);
-            if (prev_ptr && prev_ptr->h_base + prev_ptr->h_len == old_base)
-                prev_ptr->h_len += alignment;
 
-            mem_info.mem_free -= memsize;
+            if (!alignment) {
+                hp->h_base += memsize;
+                hp->h_len -= memsize;
 
-            /* Delete the hole if used up completely. */
-            if (hp->h_len == 0) delete_slot(prev_ptr, hp);
+                /* Delete the hole if used up completely. */
+                if (hp->h_len == 0) delete_slot(prev_ptr, hp);
+            } else {
+                if (hp->h_len > memsize + alignment) {
+                    tail = free_slots;
+                    free_slots = tail->h_next;
+
+                    tail->h_base = old_base + memsize;
+                    tail->h_len = hp->h_len - memsize - alignment;
+                    tail->h_next = hp->h_next;
+                    hp->h_next = tail;
+                }
+
+                hp->h_len = alignment;
+            }
+
+            mem_info.mem_free -= memsize;
 
             /* Return the start address of the acquired block. */
             return (old_base);
@@ -136,7 +161,9 @@ phys_bytes alloc_pages(int nr_pages, int memflags)
         prev_ptr = hp;
         hp = hp->h_next;
     }
-    printl("MM: alloc_pages() failed.(Out of memory)\n");
+    /* big-page allocations fall back to small pages quietly */
+    if (!(memflags & APF_ALIGNBIG))
+        printl("MM: alloc_pages() failed.(Out of memory)\n");
     return 0;
 }
 
@@ -10,6 +10,7 @@
 #include "region.h"
 #include "global.h"
 #include "proto.h"
+#include "const.h"
 
 static int anon_contig_pt_flags(const struct vir_region* vr) { return 0; }
 
@@ -48,7 +49,9 @@ static int anon_contig_new(struct vir_region* vr)
         }
     }
 
-    new_paddr = alloc_pages(pages, 0);
+    new_paddr = 0;
+    if (vr->flags & RF_HUGE) new_paddr = alloc_pages(pages, APF_ALIGNBIG);
+    if (!new_paddr) new_paddr = alloc_pages(pages, 0);
     if (!new_paddr) {
         region_free(vr);
         return ENOMEM;
@@ -10,6 +10,9 @@
 #include "region.h"
 #include "global.h"
 #include "proto.h"
+#include "const.h"
+
+static char zero_page[ARCH_PG_SIZE];
 
 static int anon_pt_flags(const struct vir_region* vr) { return 0; }
 
@@ -35,17 +38,10 @@ static int anon_page_fault(struct mmproc* mmp, struct vir_region* vr,
                            struct phys_region* pr, int write, vfs_callback_t cb,
                            void* state, size_t state_len)
 {
-    static char zero_page[ARCH_PG_SIZE];
-    static int first = 1;
     phys_bytes new_paddr;
     int retval;
     assert(pr->page->refcount > 0);
 
-    if (first) {
-        memset((char*)zero_page, 0, ARCH_PG_SIZE);
-        first = 0;
-    }
-
     new_paddr = alloc_pages(1, 0);
     if (!new_paddr) return ENOMEM;
 
@@ -71,6 +67,62 @@ static int anon_page_fault(struct mmproc* mmp, struct vir_region* vr,
     return page_cow(vr, pr, new_paddr);
 }
 
+/* Clear len bytes of physical memory. Only the first page is copied from
+ * zero_page, the rest is filled from what has been cleared already. */
+static int anon_zero_range(phys_bytes paddr, size_t len)
+{
+    size_t done, chunk;
+    int retval;
+
+    if ((retval = data_copy(NO_TASK, (void*)(vir_bytes)paddr, SELF, zero_page,
+                            ARCH_PG_SIZE)) != OK)
+        return retval;
+
+    for (done = ARCH_PG_SIZE; done < len; done += chunk) {
+        chunk = min(done, len - done);
+
+        if ((retval = data_copy(NO_TASK, (void*)(vir_bytes)(paddr + done),
+                                NO_TASK, (void*)(vir_bytes)paddr, chunk)) !=
+            OK)
+            return retval;
+    }
+
+    return 0;
+}
+
+static int anon_huge_fault(struct mmproc* mmp, struct vir_region* vr,
+                           vir_bytes offset)
+{
+    phys_bytes paddr;
+    vir_bytes off;
+    int retval;
+
+    paddr = alloc_pages(ARCH_BIG_PAGE_SIZE >> ARCH_PG_SHIFT, APF_ALIGNBIG);
+    if (!paddr) return ENOMEM;
+
+    if (!(vr->flags & RF_UNINITIALIZED) &&
+        (retval = anon_zero_range(paddr, ARCH_BIG_PAGE_SIZE)) != OK) {
+        free_mem(paddr, ARCH_BIG_PAGE_SIZE);
+        return retval;
+    }
+
+    for (off = 0; off < ARCH_BIG_PAGE_SIZE; off += ARCH_PG_SIZE) {
+        struct page* page = page_new(PHYS_NONE);
+
+        if (!page || !page_reference(page, offset + off, vr, vr->rops)) {
+            if (page) page_free(page);
+
+            /* the pages set up so far keep their memory */
+            free_mem(paddr + off, ARCH_BIG_PAGE_SIZE - off);
+            return ENOMEM;
+        }
+
+        page->phys_addr = paddr + off;
+    }
+
+    return 0;
+}
+
 static int anon_writable(const struct phys_region* pr)
 {
     assert(pr->page->refcount > 0);
@@ -84,7 +136,7 @@ static int anon_unreference(struct phys_region* pr)
 {
     assert(pr->page->refcount == 0);
     if (pr->page->phys_addr != PHYS_NONE)
-        free_mem(pr->page->phys_addr, ARCH_PG_SIZE);
+        pt_free_mem(pr->page->phys_addr, ARCH_PG_SIZE);
     return 0;
 }
 
@@ -93,7 +145,7 @@ static int anon_copy(struct vir_region* vr, struct vir_region* new_vr)
     if (!(vr->flags & RF_MAP_SHARED)) return 0;
 
     new_vr->rops = &shared_map_ops;
-    shared_set_source(new_vr, vr->parent->endpoint, vr);
+    shared_set_source(new_vr, vr->parent->endpoint, vr, 0);
 
     return 0;
 }
@@ -104,6 +156,7 @@ const struct region_operations anon_map_ops = {
     .rop_resize = anon_resize,
     .rop_split = anon_split,
     .rop_page_fault = anon_page_fault,
+    .rop_huge_fault = anon_huge_fault,
     .rop_copy = anon_copy,
 
     .rop_writable = anon_writable,
@@ -14,6 +14,7 @@
     along with Lyos.  If not, see <http://www.gnu.org/licenses/>. */
 
 #include <lyos/ipc.h>
+#include <lyos/sysutils.h>
 #include "errno.h"
 #include "assert.h"
 #include "lyos/const.h"
@@ -25,24 +26,95 @@
 
 #define HASHSIZE 1024
 
+/* Pages nobody has mapped are reclaimed once the cache holds more than
+ * 1/CACHE_SHARE of memory. */
+#define CACHE_SHARE 4
+
+/* Most LRU entries looked at to make room for one page. */
+#define SHRINK_BATCH 32
+
+/* Most pages copied by one read request. */
+#define READ_BATCH 32
+
+/* Drops of up to this many pages look the pages up one by one instead of
+ * walking every cached page of the file. */
+#define DROP_LOOKUP_MAX 16
+
 static struct list_head cache_hash_ino[HASHSIZE];
+static struct list_head cache_hash_file[HASHSIZE];
+static struct list_head cache_lru;
 
 void page_cache_init()
 {
     int i;
-    for (i = 0; i < HASHSIZE; i++)
+    for (i = 0; i < HASHSIZE; i++) {
         INIT_LIST_HEAD(&cache_hash_ino[i]);
+        INIT_LIST_HEAD(&cache_hash_file[i]);
+    }
+
+    INIT_LIST_HEAD(&cache_lru);
 
     mem_info.cached = 0;
 }
 
-static int _hash(int ino) { return ino % HASHSIZE; }
+static unsigned int hash_file(dev_t dev, ino_t ino)
+{
+    return (dev * 31 + ino) % HASHSIZE;
+}
+
+/* Spread the pages of one file over the table so that a lookup does not
+ * walk all of them. */
+static unsigned int hash_page(dev_t dev, ino_t ino, off_t ino_off)
+{
+    return (hash_file(dev, ino) * 61 + (ino_off >> ARCH_PG_SHIFT)) % HASHSIZE;
+}
 
 static void cache_add_hash_ino(struct page_cache* cp)
 {
     INIT_LIST_HEAD(&cp->hash_ino);
-    int hash = _hash(cp->ino);
-    list_add(&cp->hash_ino, &cache_hash_ino[hash]);
+    list_add(&cp->hash_ino,
+             &cache_hash_ino[hash_page(cp->dev, cp->ino, cp->ino_offset)]);
+
+    INIT_LIST_HEAD(&cp->hash_file);
+    list_add(&cp->hash_file, &cache_hash_file[hash_file(cp->dev, cp->ino)]);
+}
+
+static void cache_remove(struct page_cache* cp)
+{
+    struct page* page = cp->page;
+
+    list_del(&cp->hash_ino);
+    list_del(&cp->hash_file);
+    list_del(&cp->lru);
+
+    mem_info.cached -= ARCH_PG_SIZE;
+
+    /* mappings still using the page free it when they go away */
+    page->flags &= ~PFF_INCACHE;
+    if (--page->refcount == 0) page_free(page);
+
+    SLABFREE(cp);
+}
+
+static void cache_shrink(void)
+{
+    struct page_cache* cp;
+    int scanned = 0;
+
+    while (mem_info.cached > mem_info.mem_total / CACHE_SHARE &&
+           !list_empty(&cache_lru) && scanned++ < SHRINK_BATCH) {
+        cp = list_entry(cache_lru.prev, struct page_cache, lru);
+
+        if (cp->page->refcount == 1) {
+            cache_remove(cp);
+            break;
+        }
+
+        /* mapped pages can't go, move them out of the way so the next
+         * shrink doesn't look at them again */
+        list_del(&cp->lru);
+        list_add(&cp->lru, &cache_lru);
+    }
 }
 
 int page_cache_add(dev_t dev, off_t dev_offset, ino_t ino, off_t ino_offset,
@@ -52,6 +124,8 @@ int page_cache_add(dev_t dev, off_t dev_offset, ino_t ino, off_t ino_offset,
 
     if (page->flags & PFF_INCACHE) return EINVAL;
 
+    cache_shrink();
+
     SLABALLOC(cache);
     if (!cache) return ENOMEM;
 
@@ -68,6 +142,7 @@ int page_cache_add(dev_t dev, off_t dev_offset, ino_t ino, off_t ino_offset,
     mem_info.cached += ARCH_PG_SIZE;
 
     cache_add_hash_ino(cache);
+    list_add(&cache->lru, &cache_lru);
 
     return 0;
 }
@@ -75,12 +150,203 @@ int page_cache_add(dev_t dev, off_t dev_offset, ino_t ino, off_t ino_offset,
 struct page_cache* find_cache_by_ino(dev_t dev, ino_t ino, off_t ino_off)
 {
     struct page_cache* cp;
-    int hash = _hash(ino);
+    unsigned int hash = hash_page(dev, ino, ino_off);
+
     list_for_each_entry(cp, &cache_hash_ino[hash], hash_ino)
     {
-        if (cp->dev == dev && cp->ino == ino && cp->ino_offset == ino_off)
+        if (cp->dev == dev && cp->ino == ino && cp->ino_offset == ino_off) {
+            list_del(&cp->lru);
+            list_add(&cp->lru, &cache_lru);
             return cp;
+        }
     }
 
     return NULL;
 }
+
+/* Make sure the pages under [addr, addr + len) are present and writable so
+ * that copying to them can't fault back into us. */
+static int prefault_range(struct mmproc* mmp, vir_bytes addr, size_t len)
+{
+    vir_bytes start = rounddown(addr, ARCH_PG_SIZE);
+    vir_bytes end = roundup(addr + len, ARCH_PG_SIZE);
+    struct vir_region* vr;
+    vir_bytes offset;
+    size_t sublen;
+    int retval;
+
+    while (start < end) {
+        if (!(vr = region_lookup(mmp, start)) || !(vr->flags & RF_WRITE))
+            return EFAULT;
+
+        offset = start - vr->vir_addr;
+        sublen = min(end - start, vr->length - offset);
+
+        /* pages of file mappings that need VFS are left to the caller */
+        if ((retval = region_handle_memory(mmp, vr, offset, sublen, TRUE, NULL,
+                                           NULL, 0)) != OK)
+            return retval;
+
+        start += sublen;
+    }
+
+    pt_flush_tlb();
+
+    return 0;
+}
+
+/* Copy the cached data of a file from position on to endpoint, stopping at
+ * the first page that is not cached. */
+static int page_cache_read(dev_t dev, ino_t ino, u64 position, u64 size,
+                           endpoint_t endpoint, char* buf, size_t count,
+                           size_t* copied)
+{
+    struct mmproc* mmp;
+    struct page_cache *cp, *hits[READ_BATCH];
+    size_t done, chunk, hit;
+    off_t pos, off;
+    int i, nr_hits, retval = 0;
+
+    *copied = 0;
+
+    if (!(mmp = endpt_mmproc(endpoint))) return ESRCH;
+    if (position >= size) return 0;
+    count = min(count, size - position);
+
+    for (hit = 0, nr_hits = 0; hit < count && nr_hits < READ_BATCH;
+         hit += chunk) {
+        pos = position + hit;
+        off = pos % ARCH_PG_SIZE;
+
+        if (!(hits[nr_hits] = find_cache_by_ino(dev, ino, pos - off))) break;
+        nr_hits++;
+        chunk = min(ARCH_PG_SIZE - off, count - hit);
+    }
+
+    if (!hit) return 0;
+
+    if ((retval = prefault_range(mmp, (vir_bytes)buf, hit)) != OK)
+        return retval;
+
+    for (done = 0, i = 0; done < hit; done += chunk, i++) {
+        cp = hits[i];
+        pos = position + done;
+        off = pos % ARCH_PG_SIZE;
+        chunk = min(ARCH_PG_SIZE - off, hit - done);
+
+        if ((retval = data_copy(endpoint, buf + done, NO_TASK,
+                                (void*)(vir_bytes)(cp->page->phys_addr + off),
+                                chunk)) != OK)
+            break;
+    }
+
+    *copied = done;
+    return done ? 0 : retval;
+}
+
+/* Add whole pages of file data that VFS has read into its buf to the cache. */
+static int page_cache_fill(dev_t dev, ino_t ino, u64 position, char* buf,
+                           size_t count)
+{
+    struct page* page;
+    phys_bytes phys;
+    size_t off;
+    int retval;
+
+    if ((position % ARCH_PG_SIZE) || (count % ARCH_PG_SIZE)) return EINVAL;
+
+    for (off = 0; off < count; off += ARCH_PG_SIZE) {
+        if (find_cache_by_ino(dev, ino, position + off)) continue;
+
+        if (!(phys = alloc_pages(1, 0))) return ENOMEM;
+
+        if ((retval = data_copy(NO_TASK, (void*)(vir_bytes)phys, TASK_FS,
+                                buf + off, ARCH_PG_SIZE)) != OK) {
+            free_mem(phys, ARCH_PG_SIZE);
+            return retval;
+        }
+
+        if (!(page = page_new(phys))) {
+            free_mem(phys, ARCH_PG_SIZE);
+            return ENOMEM;
+        }
+
+        if ((retval = page_cache_add(dev, 0, ino, position + off, page)) !=
+            OK) {
+            page_free(page);
+            return retval;
+        }
+    }
+
+    return 0;
+}
+
+static void page_cache_drop(dev_t dev, ino_t ino, u64 start, u64 end)
+{
+    struct page_cache *cp, *tmp;
+    u64 pos;
+
+    if (start >= end) return;
+
+    start = rounddown(start, ARCH_PG_SIZE);
+    if (end - start <= DROP_LOOKUP_MAX * ARCH_PG_SIZE) {
+        for (pos = start; pos < end; pos += ARCH_PG_SIZE) {
+            if ((cp = find_cache_by_ino(dev, ino, pos))) cache_remove(cp);
+        }
+        return;
+    }
+
+    list_for_each_entry_safe(cp, tmp, &cache_hash_file[hash_file(dev, ino)],
+                             hash_file)
+    {
+        if (cp->dev != dev || cp->ino != ino) continue;
+
+        if (cp->ino_offset + ARCH_PG_SIZE > start && cp->ino_offset < end)
+            cache_remove(cp);
+    }
+}
+
+/* Forget everything cached for a device, e.g. when a file system is mounted
+ * on it and the inode numbers no longer mean what they did. */
+static void page_cache_drop_dev(dev_t dev)
+{
+    struct page_cache *cp, *tmp;
+
+    list_for_each_entry_safe(cp, tmp, &cache_lru, lru)
+    {
+        if (cp->dev == dev) cache_remove(cp);
+    }
+}
+
+int do_page_cache(void)
+{
+    int op = mm_msg.u.m_mm_page_cache.op;
+    dev_t dev = mm_msg.u.m_mm_page_cache.dev;
+    ino_t ino = mm_msg.u.m_mm_page_cache.ino;
+    u64 position = mm_msg.u.m_mm_page_cache.position;
+    size_t copied;
+    int retval;
+
+    if (mm_msg.source != TASK_FS) return EPERM;
+
+    switch (op) {
+    case MMPC_READ:
+        retval = page_cache_read(
+            dev, ino, position, mm_msg.u.m_mm_page_cache.limit,
+            mm_msg.u.m_mm_page_cache.endpoint, mm_msg.u.m_mm_page_cache.buf,
+            mm_msg.u.m_mm_page_cache.count, &copied);
+        mm_msg.u.m_mm_page_cache.count = copied;
+        return retval;
+    case MMPC_FILL:
+        return page_cache_fill(dev, ino, position, mm_msg.u.m_mm_page_cache.buf,
+                               mm_msg.u.m_mm_page_cache.count);
+    case MMPC_DROP:
+        page_cache_drop(dev, ino, position, mm_msg.u.m_mm_page_cache.limit);
+        return 0;
+    case MMPC_DROP_DEV:
+        page_cache_drop_dev(dev);
+        return 0;
+    }
+
+    return EINVAL;
+}
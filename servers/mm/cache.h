@@ -29,7 +29,9 @@ struct page_cache {
     struct page* page;
 
     struct list_head hash_dev;
-    struct list_head hash_ino;
+    struct list_head hash_ino;  /* by (dev, ino, page) */
+    struct list_head hash_file; /* by (dev, ino) */
+    struct list_head lru;
 };
 
 struct page_cache* find_cache_by_ino(dev_t dev, ino_t ino, off_t ino_off);
@@ -38,6 +38,7 @@
 #define APF_NORMAL   0x0
 #define APF_ALIGN4K  0x1
 #define APF_ALIGN16K 0x2
+#define APF_ALIGNBIG 0x4 /* aligned to ARCH_BIG_PAGE_SIZE */
 
 #define MAX_PAGEDIR_PDES 5
 
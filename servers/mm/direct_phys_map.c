@@ -31,6 +31,32 @@ static int direct_phys_page_fault(struct mmproc* mmp, struct vir_region* vr,
     return 0;
 }
 
+static int direct_phys_huge_fault(struct mmproc* mmp, struct vir_region* vr,
+                                  vir_bytes offset)
+{
+    phys_bytes paddr = vr->param.phys + offset;
+    vir_bytes off;
+
+    assert(vr->param.phys != PHYS_NONE);
+
+    /* the virtual big page has to line up with a physical one */
+    if (paddr % ARCH_BIG_PAGE_SIZE) return EINVAL;
+
+    for (off = 0; off < ARCH_BIG_PAGE_SIZE; off += ARCH_PG_SIZE) {
+        struct page* page = page_new(PHYS_NONE);
+
+        if (!page) return ENOMEM;
+        if (!page_reference(page, offset + off, vr, vr->rops)) {
+            page_free(page);
+            return ENOMEM;
+        }
+
+        page->phys_addr = paddr + off;
+    }
+
+    return 0;
+}
+
 static int direct_phys_writable(const struct phys_region* pr)
 {
     assert(pr->page->refcount > 0);
@@ -47,6 +73,7 @@ const struct region_operations direct_phys_map_ops = {
     .rop_pt_flags = direct_phys_pt_flags,
     .rop_copy = direct_phys_copy,
     .rop_page_fault = direct_phys_page_fault,
+    .rop_huge_fault = direct_phys_huge_fault,
 
     .rop_writable = direct_phys_writable,
     .rop_unreference = direct_phys_unreference,
@@ -63,6 +63,7 @@ int do_fork()
 
     *mmp = mmproc_table[parent_slot];
     mmp->flags |= MMPF_INUSE;
+    mmp->flags &= ~MMPF_VFORK;
 
     kfork_flags = KF_MMINHIBIT;
     if (flags & CLONE_SETTLS) kfork_flags |= KF_SETTLS;
@@ -77,6 +78,7 @@ int do_fork()
     if (clone_vm) { /* share address space */
         mmp->mm = mmparent->mm;
         mmget(mmp->mm);
+        if (flags & CLONE_VFORK) mmp->flags |= MMPF_VFORK;
         if (pgd_bind(mmp, &mmp->mm->pgd))
             panic("MM: fork: cannot bind new pgdir");
     } else {
@@ -120,10 +122,36 @@ int proc_free(struct mmproc* mmp, int clear_proc)
 {
     /* free memory */
     if (clear_proc) {
+        if (mmp->flags & MMPF_VFORK) list_del(&mmp->group_list);
+
         mmput(mmp->mm);
         mmp->mm = NULL;
 
-        mmp->flags &= ~MMPF_INUSE;
+        mmp->flags &= ~(MMPF_INUSE | MMPF_VFORK);
+    } else if (mmp->flags & MMPF_VFORK) {
+        /* a vfork child is about to exec, give it an address space of its
+         * own and leave the parent's alone */
+        struct mm_struct* mm;
+
+        if ((mm = mm_allocate()) == NULL) return ENOMEM;
+        mm_init(mm);
+        mm->slot = mmp - mmproc_table;
+
+        if (pgd_new(&mm->pgd) != OK) {
+            mm_free(mm);
+            return ENOMEM;
+        }
+
+        mmput(mmp->mm);
+        mmp->mm = mm;
+        mmp->flags &= ~MMPF_VFORK;
+
+        list_del(&mmp->group_list);
+        mmp->group_leader = mmp;
+        INIT_LIST_HEAD(&mmp->group_list);
+
+        if (pgd_bind(mmp, &mmp->mm->pgd))
+            panic("mm: proc_free failed to bind new page table");
     } else { /* clear mem regions only */
         if (atomic_get(&mmp->mm->refcnt) != 1) return EPERM;
 
@@ -82,6 +82,12 @@ int main()
         case FS_MMAP:
             mm_msg.u.m_mm_mmap_reply.retval = do_vfs_mmap();
             break;
+        case MM_MMAP_BATCH:
+            mm_msg.u.m_mm_mmap_reply.retval = do_vfs_mmap_batch();
+            break;
+        case MM_PAGE_CACHE:
+            mm_msg.RETVAL = do_page_cache();
+            break;
         case MM_REMAP:
             mm_msg.RETVAL = do_mm_remap();
             break;
@@ -107,6 +113,8 @@ int main()
             break;
         }
 
+        pt_flush_tlb();
+
         if (reply && mm_msg.RETVAL != SUSPEND) {
             mm_msg.type = SYSCALL_RET;
             send_recv(SEND_NONBLOCK, src, &mm_msg);
@@ -17,7 +17,10 @@
 #include <lyos/ipc.h>
 #include "errno.h"
 #include "lyos/const.h"
+#include <string.h>
 #include <lyos/sysutils.h>
+#include <lyos/endpoint.h>
+#include <asm/page.h>
 #include "proto.h"
 #include "lyos/vm.h"
 #include "global.h"
@@ -46,18 +49,88 @@ int do_procctl()
     return retval;
 }
 
+static void get_procinfo(struct mmproc* mmp, struct mm_proc_info* info)
+{
+    struct vir_region* vr;
+    struct phys_region* pr;
+
+    memset(info, 0, sizeof(*info));
+
+    list_for_each_entry(vr, &mmp->mm->mem_regions, list)
+    {
+        info->vm_size += vr->length;
+
+        if (vr->flags & RF_EXEC)
+            info->text += vr->length;
+        else if (vr->flags & RF_WRITE)
+            info->data += vr->length;
+
+        info->huge += region_huge_resident(vr);
+
+        for (pr = phys_region_next(vr, 0); pr;
+             pr = phys_region_next(vr, pr->offset + ARCH_PG_SIZE)) {
+            info->resident += ARCH_PG_SIZE;
+            if ((vr->flags & RF_MAP_SHARED) || pr->page->refcount > 1)
+                info->shared += ARCH_PG_SIZE;
+        }
+    }
+}
+
 int do_mm_getinfo()
 {
     int request = mm_msg.REQUEST;
     endpoint_t src = mm_msg.source;
     size_t len = mm_msg.BUF_LEN;
     void* addr = mm_msg.BUF;
+    endpoint_t who;
+    struct mmproc* mmp;
+    struct vir_region* vr;
+    struct mm_region_info region_info;
+    struct mm_proc_info proc_info;
 
     switch (request) {
     case MM_GET_MEMINFO:
         if (len < sizeof(mem_info)) return EINVAL;
 
         return data_copy(src, addr, SELF, &mem_info, sizeof(mem_info));
+    case MM_GET_REGIONINFO:
+        if (len < sizeof(region_info)) return EINVAL;
+
+        who = mm_msg.MM_GETINFO_WHO;
+        if (who == SELF) who = src;
+        /* only boot servers (e.g. IPC) may look at another process's
+         * regions */
+        if (who != src && ENDPOINT_P(src) >= INIT) return EPERM;
+        if (!(mmp = endpt_mmproc(who))) return EINVAL;
+
+        vr = region_lookup(mmp, (vir_bytes)mm_msg.MM_GETINFO_ADDR);
+        if (!vr || vr->vir_addr != (vir_bytes)mm_msg.MM_GETINFO_ADDR)
+            return EINVAL;
+
+        memset(&region_info, 0, sizeof(region_info));
+        region_info.vaddr = (void*)vr->vir_addr;
+        region_info.length = vr->length;
+        region_info.remaps = vr->remaps;
+        region_info.huge = region_huge_resident(vr);
+        region_info.shared_endpoint = NO_TASK;
+
+        if (vr->rops == &shared_map_ops) {
+            region_info.shared_endpoint = vr->param.shared.endpoint;
+            region_info.shared_vaddr =
+                (void*)(vr->param.shared.vaddr + vr->param.shared.offset);
+        }
+
+        return data_copy(src, addr, SELF, &region_info, sizeof(region_info));
+    case MM_GET_PROCINFO:
+        if (len < sizeof(proc_info)) return EINVAL;
+
+        who = mm_msg.MM_GETINFO_WHO;
+        if (who == SELF) who = src;
+        if (!(mmp = endpt_mmproc(who))) return EINVAL;
+
+        get_procinfo(mmp, &proc_info);
+
+        return data_copy(src, addr, SELF, &proc_info, sizeof(proc_info));
     default:
         return EINVAL;
     }
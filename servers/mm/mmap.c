@@ -20,6 +20,7 @@
 #include "lyos/const.h"
 #include "string.h"
 #include <lyos/fs.h>
+#include <lyos/sysutils.h>
 #include <sys/stat.h>
 
 #include "region.h"
@@ -108,6 +109,72 @@ static void mmap_device_callback(struct mmproc* mmp, MESSAGE* msg, void* arg)
     send_recv(SEND_NONBLOCK, msg->MMRENDPOINT, &reply_msg);
 }
 
+static void mmap_shared_file_callback(struct mmproc* mmp, MESSAGE* msg,
+                                      void* arg)
+{
+    MESSAGE* mmap_msg = (MESSAGE*)arg;
+    vir_bytes ret_addr = (vir_bytes)MAP_FAILED;
+    size_t len = roundup(mmap_msg->u.m_mm_mmap.length, ARCH_PG_SIZE);
+    struct mm_file_desc* filp = NULL;
+    struct vir_region* vr;
+    vir_bytes addr;
+    MESSAGE user_reply;
+    int result = msg->MMRRESULT;
+
+    if (result == ENOSYS) {
+        /* the file system has no pages to share, copy through the page
+         * cache instead */
+        result = mmap_file(mmp, (vir_bytes)mmap_msg->u.m_mm_mmap.vaddr,
+                           mmap_msg->u.m_mm_mmap.length,
+                           mmap_msg->u.m_mm_mmap.flags,
+                           mmap_msg->u.m_mm_mmap.prot, msg->MMRFD,
+                           mmap_msg->u.m_mm_mmap.offset, msg->MMRDEV,
+                           msg->MMRINO, 0, TRUE, &ret_addr);
+    } else {
+        /* the mapping keeps the file open, otherwise the file system could
+         * free the pages once it is unlinked or truncated */
+        if (result == OK &&
+            !(filp = get_mm_file_desc(msg->MMRFD, msg->MMRDEV, msg->MMRINO))) {
+            region_unmap_range(mmp, (vir_bytes)msg->MMRBUF, len);
+            result = ENOMEM;
+        }
+
+        if (!filp)
+            enqueue_vfs_request(&mmproc_table[TASK_MM], MMR_FDCLOSE,
+                                msg->MMRFD, 0, 0, 0, NULL, NULL, 0);
+
+        if (result == OK) {
+            ret_addr = (vir_bytes)msg->MMRBUF;
+
+            /* hold the file while the regions take their references so it is
+             * closed if none does */
+            filp->refcnt++;
+
+            /* the file system may have mapped the range in several pieces;
+             * nothing is faulted in yet so the protection can still be
+             * narrowed */
+            for (addr = ret_addr; addr < ret_addr + len;
+                 addr = vr->vir_addr + vr->length) {
+                if (!(vr = region_lookup(mmp, addr))) break;
+
+                vr->flags &= ~(RF_READ | RF_WRITE | RF_EXEC);
+                vr->flags |= region_get_prot_bits(mmap_msg->u.m_mm_mmap.prot) |
+                             RF_MAP_SHARED;
+                if (vr->rops == &shared_map_ops) shared_set_file(vr, filp);
+            }
+
+            file_unreferenced(filp);
+        }
+    }
+
+    memset(&user_reply, 0, sizeof(MESSAGE));
+    user_reply.type = SYSCALL_RET;
+    user_reply.u.m_mm_mmap_reply.retval = result;
+    user_reply.u.m_mm_mmap_reply.retaddr = (void*)ret_addr;
+
+    send_recv(SEND_NONBLOCK, mmap_msg->source, &user_reply);
+}
+
 static void mmap_file_callback(struct mmproc* mmp, MESSAGE* reply_msg,
                                void* arg)
 {
@@ -130,6 +197,28 @@ static void mmap_file_callback(struct mmproc* mmp, MESSAGE* reply_msg,
             } else {
                 return;
             }
+        } else if (S_ISREG(file_mode) &&
+                   (mmap_msg->u.m_mm_mmap.flags & MAP_SHARED) &&
+                   !(mmap_msg->u.m_mm_mmap.offset % ARCH_PG_SIZE)) {
+            /* let the file system share its pages if it keeps them in memory
+             * anyway */
+            vir_bytes addr = (vir_bytes)mmap_msg->u.m_mm_mmap.vaddr;
+            size_t len =
+                roundup(mmap_msg->u.m_mm_mmap.length, ARCH_PG_SIZE);
+
+            if (addr && (mmap_msg->u.m_mm_mmap.flags & MAP_FIXED) &&
+                region_unmap_range(mmp, addr, len)) {
+                result = ENOMEM;
+            } else if (enqueue_vfs_request(
+                           mmp, MMR_FDMMAP, reply_msg->MMRFD,
+                           mmap_msg->u.m_mm_mmap.vaddr,
+                           mmap_msg->u.m_mm_mmap.offset, len,
+                           mmap_shared_file_callback, mmap_msg,
+                           sizeof(MESSAGE)) != 0) {
+                result = ENOMEM;
+            } else {
+                return;
+            }
         } else {
             result = mmap_file(mmp, (vir_bytes)mmap_msg->u.m_mm_mmap.vaddr,
                                mmap_msg->u.m_mm_mmap.length,
@@ -166,6 +255,44 @@ int do_vfs_mmap()
                      &ret_addr);
 }
 
+/* Map all file-backed segments of an executable in one request. Either every
+ * segment is mapped or none is, so VFS can fall back to copying the file. */
+int do_vfs_mmap_batch()
+{
+    endpoint_t who = mm_msg.u.m_mm_mmap.who;
+    int nr_segs = mm_msg.u.m_mm_mmap.length;
+    struct vfs_mmap_seg segs[VFS_MMAP_BATCH_MAX];
+    struct mmproc* mmp = endpt_mmproc(who);
+    vir_bytes ret_addr;
+    int i, retval;
+
+    if (mm_msg.source != TASK_FS) return EPERM;
+
+    if (!mmp) return ESRCH;
+    if (nr_segs <= 0 || nr_segs > VFS_MMAP_BATCH_MAX) return EINVAL;
+
+    if ((retval = data_copy(SELF, segs, TASK_FS, mm_msg.u.m_mm_mmap.vaddr,
+                            nr_segs * sizeof(segs[0]))) != 0)
+        return retval;
+
+    for (i = 0; i < nr_segs; i++) {
+        retval = mmap_file(mmp, (vir_bytes)segs[i].vaddr, segs[i].len,
+                           mm_msg.u.m_mm_mmap.flags, segs[i].prot,
+                           mm_msg.u.m_mm_mmap.fd, segs[i].offset,
+                           mm_msg.u.m_mm_mmap.dev, mm_msg.u.m_mm_mmap.ino,
+                           segs[i].clearend, FALSE, &ret_addr);
+        if (retval) break;
+    }
+
+    if (retval) {
+        while (--i >= 0)
+            region_unmap_range(mmp, (vir_bytes)segs[i].vaddr,
+                               roundup(segs[i].len, ARCH_PG_SIZE));
+    }
+
+    return retval;
+}
+
 int do_mmap()
 {
     endpoint_t who =
@@ -196,6 +323,16 @@ int do_mmap()
 
         vr_flags |= RF_ANON;
 
+        if (flags & MAP_HUGETLB) {
+            len = roundup(len, ARCH_BIG_PAGE_SIZE);
+            vr_flags |= RF_HUGE;
+        }
+#if CONFIG_MM_AUTO_HUGE
+        /* large private mappings get big pages even if not asked for */
+        if (!(flags & MAP_SHARED) && len >= ARCH_BIG_PAGE_SIZE)
+            vr_flags |= RF_HUGE;
+#endif
+
         if (flags & MAP_CONTIG)
             rops = &anon_contig_map_ops;
         else
@@ -204,7 +341,11 @@ int do_mmap()
         if (!(vr = mmap_region(mmp, addr, flags, len, vr_flags, rops)))
             return ENOMEM;
     } else { /* mapping file */
-        if (enqueue_vfs_request(mmp, MMR_FDLOOKUP, fd, 0, 0, 0,
+        /* a writable shared mapping needs a file opened for writing */
+        int access = R_BIT;
+        if ((flags & MAP_SHARED) && (prot & PROT_WRITE)) access |= W_BIT;
+
+        if (enqueue_vfs_request(mmp, MMR_FDLOOKUP, fd, 0, 0, access,
                                 mmap_file_callback, &mm_msg,
                                 sizeof(MESSAGE)) != 0)
             return ENOMEM;
@@ -252,6 +393,7 @@ int do_map_phys()
 
     vrflags = RF_READ | RF_WRITE | RF_DIRECT;
     if (flags & MMP_IO) vrflags |= RF_IO;
+    if (len >= ARCH_BIG_PAGE_SIZE) vrflags |= RF_HUGE;
 
     vr = region_map(mmp, ARCH_BIG_PAGE_SIZE, VM_STACK_TOP, len, vrflags, 0,
                     &direct_phys_map_ops);
@@ -285,7 +427,7 @@ int do_mm_remap()
     endpoint_t src = mm_msg.u.m_mm_remap.src;
     if (src == SELF) src = mm_msg.source;
     endpoint_t dest = mm_msg.u.m_mm_remap.dest;
-    if (src == SELF) dest = mm_msg.source;
+    if (dest == SELF) dest = mm_msg.source;
     vir_bytes src_addr = (vir_bytes)mm_msg.u.m_mm_remap.src_addr;
     vir_bytes dest_addr = (vir_bytes)mm_msg.u.m_mm_remap.dest_addr;
     size_t size = mm_msg.u.m_mm_remap.size;
@@ -296,14 +438,18 @@ int do_mm_remap()
     struct mmproc* dmmp = endpt_mmproc(dest);
     if (!dmmp) return EINVAL;
 
+    /* the source may be any page-aligned part of a region */
+    if (src_addr % ARCH_PG_SIZE) return EINVAL;
     struct vir_region* src_region = region_lookup(smmp, src_addr);
-    if (src_region->vir_addr != src_addr) return EFAULT;
+    if (!src_region) return EFAULT;
+    if (src_region->rops != &anon_map_ops) return EINVAL;
+    vir_bytes src_offset = src_addr - src_region->vir_addr;
 
     if (size % ARCH_PG_SIZE) {
         size = size - (size % ARCH_PG_SIZE) + ARCH_PG_SIZE;
     }
 
-    if (size != src_region->length) return EFAULT;
+    if (size > src_region->length - src_offset) return EFAULT;
 
     int vrflags = RF_READ | RF_WRITE | RF_SHARED;
     struct vir_region* new_region = NULL;
@@ -316,7 +462,7 @@ int do_mm_remap()
     }
     if (!new_region) return ENOMEM;
 
-    shared_set_source(new_region, smmp->endpoint, src_region);
+    shared_set_source(new_region, smmp->endpoint, src_region, src_offset);
 
     mm_msg.u.m_mm_remap.ret_addr = (void*)new_region->vir_addr;
     return 0;
@@ -45,6 +45,7 @@ struct mmproc {
 };
 
 #define MMPF_INUSE 0x01
+#define MMPF_VFORK 0x02 /* borrowing the parent's address space */
 
 #define mmproc2ep(mmp) ((mmp)-mmproc_table)
 
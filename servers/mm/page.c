@@ -31,7 +31,8 @@ struct page* page_new(phys_bytes phys)
 
 void page_free(struct page* page)
 {
-    if (page->phys_addr != PHYS_NONE) free_mem(page->phys_addr, ARCH_PG_SIZE);
+    if (page->phys_addr != PHYS_NONE)
+        pt_free_mem(page->phys_addr, ARCH_PG_SIZE);
     SLABFREE(page);
 }
 
@@ -57,7 +58,12 @@ struct phys_region* page_reference(struct page* page, vir_bytes offset,
     pr->rops = rops;
     page_link(pr, page, offset, vr);
 
-    phys_region_set(vr, offset, pr);
+    if (phys_region_set(vr, offset, pr) != OK) {
+        list_del(&pr->page_link);
+        page->refcount--;
+        SLABFREE(pr);
+        return NULL;
+    }
 
     return pr;
 }
@@ -135,6 +135,7 @@ void handle_page_fault(endpoint_t ep, vir_bytes pfla, int err, vir_bytes pc,
     }
 
     vmctl(VMCTL_CLEAR_MEMCACHE, SELF);
+    pt_flush_tlb();
 
     if (vmctl(VMCTL_PAGEFAULT_CLEAR, ep) != 0) panic("pagefault: vmctl failed");
 }
@@ -239,6 +240,8 @@ static void handle_memory_reply(struct hm_state* state, int result)
     int retval;
     assert(state);
 
+    pt_flush_tlb();
+
     if (state->caller == KERNEL) {
         if ((retval = vmctl_reply_mmreq(state->requestor, result)) != OK)
             panic("mm: handle_memory_reply vmctl failed");
@@ -40,6 +40,40 @@ static int nr_kern_mappings = 0;
 static struct mmproc* mmprocess = &mmproc_table[TASK_MM];
 static struct mm_struct self_mm;
 
+/* Page tables shared between address spaces by fork(). An address space that
+ * changes an entry of a shared table gets its own copy first. Tables that are
+ * not in the hash have a single user. */
+#define PT_SHARE_HASH_LOG2 7
+#define PT_SHARE_HASH_SIZE (1 << PT_SHARE_HASH_LOG2)
+#define PT_SHARE_HASH_MASK (PT_SHARE_HASH_SIZE - 1)
+
+struct pt_share {
+    struct list_head hash;
+    phys_bytes phys_addr;
+    unsigned int count;
+};
+
+static struct list_head pt_share_table[PT_SHARE_HASH_SIZE];
+
+/* Walk state for pt_walk_range(). */
+struct pt_walk {
+    pgdir_t* pgd;
+    int create;
+    pt_fill_t fill;
+    pt_fill_huge_t fill_huge; /* big page for an aligned range, may be NULL */
+    void* arg;
+};
+
+#ifndef ARCH_HAS_HUGE_PMD
+static inline int pmde_large(pmd_t pmde) { return 0; }
+static inline pmd_t pfn_pmd_large(unsigned long pfn, pgprot_t prot)
+{
+    return __pmd(0);
+}
+static inline unsigned long pmde_pfn(pmd_t pmde) { return 0; }
+static inline pgprot_t pmde_pgprot(pmd_t pmde) { return __pgprot(0); }
+#endif
+
 /* before MM has set up page table for its own, we use these pages in page
  * allocation */
 static char static_bootstrap_pages[ARCH_PG_SIZE * STATIC_BOOTSTRAP_PAGES]
@@ -77,6 +111,10 @@ void pt_init()
         bootstrap_pages[i].used = 0;
     }
 
+    for (i = 0; i < PT_SHARE_HASH_SIZE; i++) {
+        INIT_LIST_HEAD(&pt_share_table[i]);
+    }
+
     /* init mm structure */
     mmprocess->mm = &self_mm;
     mm_init(mmprocess->mm);
@@ -254,6 +292,453 @@ static void pt_free(pte_t* pt)
     free_mem(virt_to_phys(pt), sizeof(pte_t) * ARCH_VM_PT_ENTRIES);
 }
 
+static inline phys_bytes pt_phys(pmd_t* pmde)
+{
+    return virt_to_phys(pte_offset(pmde, 0));
+}
+
+static struct pt_share* pt_share_find(phys_bytes phys_addr)
+{
+    struct pt_share* ps;
+    unsigned int hash = (phys_addr >> ARCH_PG_SHIFT) & PT_SHARE_HASH_MASK;
+
+    list_for_each_entry(ps, &pt_share_table[hash], hash)
+    {
+        if (ps->phys_addr == phys_addr) return ps;
+    }
+
+    return NULL;
+}
+
+static int pt_share_get(phys_bytes phys_addr)
+{
+    struct pt_share* ps;
+    unsigned int hash;
+
+    if ((ps = pt_share_find(phys_addr)) != NULL) {
+        ps->count++;
+        return 0;
+    }
+
+    SLABALLOC(ps);
+    if (!ps) return ENOMEM;
+
+    hash = (phys_addr >> ARCH_PG_SHIFT) & PT_SHARE_HASH_MASK;
+    ps->phys_addr = phys_addr;
+    ps->count = 2;
+    list_add(&ps->hash, &pt_share_table[hash]);
+
+    return 0;
+}
+
+/* Drop one user of a page table. Returns TRUE if it was the last one. */
+static int pt_share_put(struct pt_share* ps)
+{
+    if (!ps) return TRUE;
+
+    if (--ps->count == 1) {
+        list_del(&ps->hash);
+        SLABFREE(ps);
+    }
+
+    return FALSE;
+}
+
+/* Give the page table under pmde a private copy of a shared table. */
+static int pt_unshare(pmd_t* pmde, struct pt_share* ps)
+{
+    phys_bytes new_phys;
+    pte_t* new_pt = (pte_t*)alloc_vmem(
+        &new_phys, sizeof(pte_t) * ARCH_VM_PT_ENTRIES, PGT_PAGETABLE);
+    if (new_pt == NULL) {
+        printl("MM: pt_unshare: failed to allocate memory for page table\n");
+        return ENOMEM;
+    }
+
+    memcpy(new_pt, pte_offset(pmde, 0), sizeof(pte_t) * ARCH_VM_PT_ENTRIES);
+    free_vmpages(new_pt, 1);
+
+    pmde_populate(pmde, new_phys);
+    pt_share_put(ps);
+
+    return 0;
+}
+
+/* Pending TLB invalidations. Changes to live mappings are collected here and
+ * handed to the kernel in one call per address space by pt_flush_tlb(),
+ * which merges the pages of an address space into a single range. */
+#define TLB_GATHER_SLOTS 8
+
+static struct tlb_gather {
+    phys_bytes pgd_phys;
+    vir_bytes start, end;
+} tlb_gathers[TLB_GATHER_SLOTS];
+static int nr_tlb_gathers = 0;
+
+static void tlb_gather_flush(struct tlb_gather* tg)
+{
+    vmctl_flushtlb_range(tg->pgd_phys, (void*)tg->start, tg->end - tg->start);
+}
+
+static void pt_tlb_gather(pgdir_t* pgd, vir_bytes start, vir_bytes end)
+{
+    struct tlb_gather* tg;
+    int i;
+
+    for (i = 0; i < nr_tlb_gathers; i++) {
+        tg = &tlb_gathers[i];
+
+        if (tg->pgd_phys == pgd->phys_addr) {
+            tg->start = min(tg->start, start);
+            tg->end = max(tg->end, end);
+            return;
+        }
+    }
+
+    if (nr_tlb_gathers == TLB_GATHER_SLOTS) {
+        /* make room by flushing the oldest address space */
+        tlb_gather_flush(&tlb_gathers[0]);
+        memmove(&tlb_gathers[0], &tlb_gathers[1],
+                sizeof(tlb_gathers[0]) * (TLB_GATHER_SLOTS - 1));
+        nr_tlb_gathers--;
+    }
+
+    tg = &tlb_gathers[nr_tlb_gathers++];
+    tg->pgd_phys = pgd->phys_addr;
+    tg->start = start;
+    tg->end = end;
+}
+
+/* Frames that were mapped when they were let go. Another CPU may still reach
+ * them through a stale TLB entry, so they are only handed back to the
+ * allocator by pt_flush_tlb(). */
+#define TLB_FREE_SLOTS 64
+
+static struct tlb_free {
+    phys_bytes base, len;
+} tlb_frees[TLB_FREE_SLOTS];
+static int nr_tlb_frees = 0;
+
+/**
+ * <Ring 1> Invalidate the stale TLB entries of every mapping that has been
+ * changed or removed since the last call, on all CPUs, then free the frames
+ * that were waiting for it. Must be called before the affected processes
+ * are resumed.
+ */
+void pt_flush_tlb(void)
+{
+    int i;
+
+    for (i = 0; i < nr_tlb_gathers; i++) {
+        tlb_gather_flush(&tlb_gathers[i]);
+    }
+
+    nr_tlb_gathers = 0;
+
+    for (i = 0; i < nr_tlb_frees; i++) {
+        free_mem(tlb_frees[i].base, tlb_frees[i].len);
+    }
+
+    nr_tlb_frees = 0;
+}
+
+/**
+ * <Ring 1> Free frames that may still be mapped somewhere. The caller must
+ * have removed or replaced the mappings first; the frames are reused only
+ * after the TLB entries for them are gone.
+ */
+void pt_free_mem(phys_bytes base, phys_bytes len)
+{
+    struct tlb_free* tf;
+
+    if (nr_tlb_frees > 0) {
+        tf = &tlb_frees[nr_tlb_frees - 1];
+
+        if (tf->base + tf->len == base) {
+            tf->len += len;
+            return;
+        }
+    }
+
+    if (nr_tlb_frees == TLB_FREE_SLOTS) pt_flush_tlb();
+
+    if (nr_tlb_gathers == 0) {
+        free_mem(base, len);
+        return;
+    }
+
+    tf = &tlb_frees[nr_tlb_frees++];
+    tf->base = base;
+    tf->len = len;
+}
+
+/* Drop the pending invalidations of a page directory that is going away. The
+ * kernel flushes an address space when it is bound again. */
+static void pt_tlb_discard(pgdir_t* pgd)
+{
+    int i, j;
+
+    for (i = j = 0; i < nr_tlb_gathers; i++) {
+        if (tlb_gathers[i].pgd_phys != pgd->phys_addr)
+            tlb_gathers[j++] = tlb_gathers[i];
+    }
+
+    nr_tlb_gathers = j;
+}
+
+static pte_t pt_fill_none(vir_bytes addr, void* arg)
+{
+    return pfn_pte(0, __pgprot(0));
+}
+
+/* Replace the big page mapped by pmde with a page table that maps the same
+ * memory with small pages, so that part of it can be changed. */
+static int pt_split_huge(struct pt_walk* walk, pmd_t* pmde, vir_bytes addr)
+{
+    unsigned long pfn = pmde_pfn(*pmde);
+    pgprot_t prot = pmde_pgprot(*pmde);
+    phys_bytes new_phys;
+    pte_t* new_pt;
+    int i;
+
+    new_pt = (pte_t*)alloc_vmem(&new_phys, sizeof(pte_t) * ARCH_VM_PT_ENTRIES,
+                                PGT_PAGETABLE);
+    if (new_pt == NULL) {
+        printl("MM: pt_split_huge: failed to allocate memory for page table\n");
+        return ENOMEM;
+    }
+
+    for (i = 0; i < ARCH_VM_PT_ENTRIES; i++)
+        new_pt[i] = pfn_pte(pfn + i, prot);
+    free_vmpages(new_pt, 1);
+
+    pmde_populate(pmde, new_phys);
+
+    addr = rounddown(addr, ARCH_BIG_PAGE_SIZE);
+    pt_tlb_gather(walk->pgd, addr, addr + ARCH_BIG_PAGE_SIZE);
+
+    return 0;
+}
+
+static int pt_walk_pte(struct pt_walk* walk, pmd_t* pmde, vir_bytes addr,
+                       vir_bytes end)
+{
+    struct pt_share* ps;
+    pte_t *pte, old_pte, new_pte;
+    int retval;
+
+    if (pmde_large(*pmde)) {
+        if ((retval = pt_split_huge(walk, pmde, addr)) != OK) return retval;
+    }
+
+    if (pmde_none(*pmde)) {
+        if (!walk->create) return 0;
+        if ((retval = __pt_create(pmde)) != OK) return retval;
+    }
+
+    ps = pt_share_find(pt_phys(pmde));
+    pte = pte_offset(pmde, addr);
+
+    do {
+        old_pte = *pte;
+        new_pte = walk->fill(addr, walk->arg);
+        if (pte_val(old_pte) == pte_val(new_pte)) continue;
+
+        if (ps) {
+            if ((retval = pt_unshare(pmde, ps)) != OK) return retval;
+            ps = NULL;
+            pte = pte_offset(pmde, addr);
+        }
+
+        set_pte(pte, new_pte);
+
+        /* other CPUs may still cache the old translation */
+        if (pte_present(old_pte))
+            pt_tlb_gather(walk->pgd, addr, addr + ARCH_PG_SIZE);
+    } while (pte++, addr += ARCH_PG_SIZE, addr != end);
+
+    return 0;
+}
+
+/* Try to map the big page at addr with a single PMD entry. Returns EAGAIN if
+ * the range has to be mapped with small pages instead. */
+static int pt_walk_huge(struct pt_walk* walk, pmd_t* pmde, vir_bytes addr)
+{
+    pmd_t old_pmde = *pmde, new_pmde;
+
+    if (walk->fill_huge) {
+        new_pmde = walk->fill_huge(addr, walk->arg);
+        if (pmd_val(new_pmde) == 0) return EAGAIN;
+    } else if (walk->fill == pt_fill_none && pmde_large(old_pmde)) {
+        new_pmde = __pmd(0);
+    } else {
+        return EAGAIN;
+    }
+
+    if (pmd_val(old_pmde) == pmd_val(new_pmde)) return 0;
+
+    /* the small pages of the old table are replaced as a whole */
+    if (!pmde_none(old_pmde) && !pmde_large(old_pmde)) pt_free_range(pmde);
+
+    *pmde = new_pmde;
+
+    if (pmde_present(old_pmde))
+        pt_tlb_gather(walk->pgd, addr, addr + ARCH_BIG_PAGE_SIZE);
+
+    return 0;
+}
+
+static inline int pt_huge_range(vir_bytes addr, vir_bytes end)
+{
+    return !(addr % ARCH_BIG_PAGE_SIZE) && end - addr == ARCH_BIG_PAGE_SIZE;
+}
+
+static int pt_walk_pmd(struct pt_walk* walk, pud_t* pude, vir_bytes addr,
+                       vir_bytes end)
+{
+    pmd_t* pmde;
+    vir_bytes next;
+    int retval;
+
+    if (walk->create) {
+        if ((pmde = pmd_create(pude, addr)) == NULL) return ENOMEM;
+    } else {
+        if (pude_none(*pude)) return 0;
+        pmde = pmd_offset(pude, addr);
+    }
+
+    do {
+        next = pmd_addr_end(addr, end);
+
+        if (pt_huge_range(addr, next) &&
+            (retval = pt_walk_huge(walk, pmde, addr)) != EAGAIN) {
+            if (retval != OK) return retval;
+            continue;
+        }
+
+        if ((retval = pt_walk_pte(walk, pmde, addr, next)) != OK)
+            return retval;
+    } while (pmde++, addr = next, addr != end);
+
+    return 0;
+}
+
+static int pt_walk_pud(struct pt_walk* walk, pde_t* pde, vir_bytes addr,
+                       vir_bytes end)
+{
+    pud_t* pude;
+    vir_bytes next;
+    int retval;
+
+    if (walk->create) {
+        if ((pude = pud_create(pde, addr)) == NULL) return ENOMEM;
+    } else {
+        if (pde_none(*pde)) return 0;
+        pude = pud_offset(pde, addr);
+    }
+
+    do {
+        next = pud_addr_end(addr, end);
+
+        if ((retval = pt_walk_pmd(walk, pude, addr, next)) != OK)
+            return retval;
+    } while (pude++, addr = next, addr != end);
+
+    return 0;
+}
+
+/* Set the PTEs of [addr, end) to what walk->fill returns, descending each
+ * level once per table instead of once per page. */
+static int pt_walk_range(struct pt_walk* walk, vir_bytes addr, vir_bytes end)
+{
+    pde_t* pde = pgd_offset(walk->pgd->vir_addr, addr);
+    vir_bytes next;
+    int retval;
+
+    do {
+        next = pgd_addr_end(addr, end);
+
+        if ((retval = pt_walk_pud(walk, pde, addr, next)) != OK)
+            return retval;
+    } while (pde++, addr = next, addr != end);
+
+    return 0;
+}
+
+/**
+ * <Ring 1> Map the pages of [start, end), creating page tables if necessary.
+ * @param  fill  Returns the PTE for each page address.
+ * @return       Zero on success.
+ */
+int pt_map_range(pgdir_t* pgd, vir_bytes start, vir_bytes end, pt_fill_t fill,
+                 void* arg)
+{
+    return pt_map_range_huge(pgd, start, end, fill, NULL, arg);
+}
+
+/**
+ * <Ring 1> Like pt_map_range(), but each aligned big page of [start, end) is
+ * mapped with a single PMD entry if fill_huge returns one for it.
+ * @param  fill_huge  Returns the big page entry for an aligned address, or
+ *                    an empty entry to fall back to small pages.
+ * @return            Zero on success.
+ */
+int pt_map_range_huge(pgdir_t* pgd, vir_bytes start, vir_bytes end,
+                      pt_fill_t fill, pt_fill_huge_t fill_huge, void* arg)
+{
+    struct pt_walk walk = {.pgd = pgd,
+                           .create = TRUE,
+                           .fill = fill,
+                           .fill_huge = fill_huge,
+                           .arg = arg};
+
+    if (start == end) return 0;
+
+#ifndef ARCH_HAS_HUGE_PMD
+    walk.fill_huge = NULL;
+#endif
+
+    return pt_walk_range(&walk, start, end);
+}
+
+/**
+ * <Ring 1> Whether big pages can be mapped in user address spaces.
+ */
+int pt_has_huge(void)
+{
+#ifdef ARCH_HAS_HUGE_PMD
+    return TRUE;
+#else
+    return FALSE;
+#endif
+}
+
+/**
+ * <Ring 1> Make the entry that maps the big page at phys_addr with prot, for
+ * use by a pt_fill_huge_t.
+ */
+pmd_t pt_huge_entry(phys_bytes phys_addr, pgprot_t prot)
+{
+    /* inaccessible pages are left to the small page tables */
+    if (!pgprot_val(prot) || (phys_addr % ARCH_BIG_PAGE_SIZE)) return __pmd(0);
+
+    return pfn_pmd_large(phys_addr >> ARCH_PG_SHIFT, prot);
+}
+
+struct pt_linear_map {
+    phys_bytes phys_addr;
+    vir_bytes vir_addr;
+    pgprot_t prot;
+};
+
+static pte_t pt_fill_linear(vir_bytes addr, void* arg)
+{
+    struct pt_linear_map* map = arg;
+
+    return pfn_pte((map->phys_addr + (addr - map->vir_addr)) >> ARCH_PG_SHIFT,
+                   map->prot);
+}
+
 /**
  * <Ring 1> Map a physical page, create page table if necessary.
  * @param  phys_addr Physical address.
@@ -263,22 +748,10 @@ static void pt_free(pte_t* pt)
 int pt_mappage(pgdir_t* pgd, phys_bytes phys_addr, vir_bytes vir_addr,
                pgprot_t prot)
 {
-    pde_t* pde;
-    pud_t* pude;
-    pmd_t* pmde;
-    pte_t* pte;
-
-    pde = pgd_offset(pgd->vir_addr, vir_addr);
-    pude = pud_create(pde, vir_addr);
-    pmde = pmd_create(pude, vir_addr);
-    pte = pt_create_map(pmde, vir_addr);
-
-    set_pte(pte, pfn_pte(phys_addr >> ARCH_PG_SHIFT, prot));
-
-    return 0;
+    return pt_writemap(pgd, phys_addr, vir_addr, ARCH_PG_SIZE, prot);
 }
 
-static int pt_follow(pgdir_t* pgd, vir_bytes addr, pte_t** ptepp)
+static int pt_follow(pgdir_t* pgd, vir_bytes addr, phys_bytes* physp)
 {
     pde_t* pde;
     pud_t* pude;
@@ -300,29 +773,88 @@ static int pt_follow(pgdir_t* pgd, vir_bytes addr, pte_t** ptepp)
         return EINVAL;
     }
 
+    if (pmde_large(*pmde)) {
+        *physp = (pmde_pfn(*pmde) << ARCH_PG_SHIFT) +
+                 (addr % ARCH_BIG_PAGE_SIZE);
+        return 0;
+    }
+
     pte = pte_offset(pmde, addr);
     if (!pte_present(*pte)) {
         return EINVAL;
     }
 
-    *ptepp = pte;
+    *physp = (pte_pfn(*pte) << ARCH_PG_SHIFT) + (addr % ARCH_PG_SIZE);
     return 0;
 }
 
 int pt_writemap(pgdir_t* pgd, phys_bytes phys_addr, vir_bytes vir_addr,
                 size_t length, pgprot_t prot)
 {
+    struct pt_linear_map map = {
+        .phys_addr = phys_addr, .vir_addr = vir_addr, .prot = prot};
+
     /* sanity check */
     if (phys_addr % ARCH_PG_SIZE != 0) return EINVAL;
     if ((uintptr_t)vir_addr % ARCH_PG_SIZE != 0) return EINVAL;
     if (length % ARCH_PG_SIZE != 0) return EINVAL;
 
-    while (length > 0) {
-        pt_mappage(pgd, phys_addr, vir_addr, prot);
+    return pt_map_range(pgd, vir_addr, vir_addr + length, pt_fill_linear,
+                        &map);
+}
+
+/**
+ * <Ring 1> Make dst use the page tables of src for [start, end). The tables
+ * are shared until either side changes one of their entries, so the caller
+ * must make sure that src already holds the PTEs dst should have.
+ */
+int pt_share_range(pgdir_t* dst, pgdir_t* src, vir_bytes start,
+                   vir_bytes end)
+{
+    vir_bytes addr, next;
+    pde_t *pde, *dst_pde;
+    pud_t *pude, *dst_pude;
+    pmd_t *pmde, *dst_pmde;
+    phys_bytes phys;
+    int retval;
+
+    for (addr = start; addr != end; addr = next) {
+        next = pmd_addr_end(addr, end);
 
-        length -= ARCH_PG_SIZE;
-        phys_addr = phys_addr + ARCH_PG_SIZE;
-        vir_addr = vir_addr + ARCH_PG_SIZE;
+        pde = pgd_offset(src->vir_addr, addr);
+        if (pde_none(*pde)) continue;
+        pude = pud_offset(pde, addr);
+        if (pude_none(*pude)) continue;
+        pmde = pmd_offset(pude, addr);
+        if (pmde_none(*pmde)) continue;
+
+        dst_pde = pgd_offset(dst->vir_addr, addr);
+        if ((dst_pude = pud_create(dst_pde, addr)) == NULL) return ENOMEM;
+        if ((dst_pmde = pmd_create(dst_pude, addr)) == NULL) return ENOMEM;
+
+        if (pmde_large(*pmde)) {
+            /* a big page has no table to share, copy the entry itself */
+            if (!pmde_none(*dst_pmde) && !pmde_large(*dst_pmde))
+                pt_free_range(dst_pmde);
+            *dst_pmde = *pmde;
+            continue;
+        }
+
+        if (pmde_large(*dst_pmde)) pmde_clear(dst_pmde);
+
+        phys = pt_phys(pmde);
+
+        if (pmde_none(*dst_pmde)) {
+            if ((retval = pt_share_get(phys)) != OK) return retval;
+            pmde_populate(dst_pmde, phys);
+        } else if (pt_phys(dst_pmde) != phys) {
+            /* dst already has a table of its own here, copy the entries */
+            pte_t* pte = pte_offset(pmde, addr);
+            pte_t* dst_pte = pte_offset(dst_pmde, addr);
+
+            for (; addr != next; addr += ARCH_PG_SIZE)
+                set_pte(dst_pte++, *pte++);
+        }
     }
 
     return 0;
@@ -392,6 +924,7 @@ int pgd_new(pgdir_t* pgd)
 /* <Ring 1> */
 int pgd_free(pgdir_t* pgd)
 {
+    pt_tlb_discard(pgd);
     free_vmem(pgd->vir_addr, sizeof(pde_t) * ARCH_VM_DIR_ENTRIES);
     return 0;
 }
@@ -399,8 +932,10 @@ int pgd_free(pgdir_t* pgd)
 void pt_free_range(pmd_t* pt)
 {
     pte_t* pte = pte_offset(pt, 0);
+    struct pt_share* ps = pt_share_find(virt_to_phys(pte));
+
     pmde_clear(pt);
-    pt_free(pte);
+    if (pt_share_put(ps)) pt_free(pte);
 }
 
 void pmd_free_range(pud_t* pmd, vir_bytes addr, vir_bytes end, vir_bytes floor,
@@ -413,6 +948,14 @@ void pmd_free_range(pud_t* pmd, vir_bytes addr, vir_bytes end, vir_bytes floor,
     do {
         next = pmd_addr_end(addr, end);
 
+        if (pmde_large(*pmde)) {
+            /* the pages themselves belong to the regions */
+            pmde_clear(pmde);
+            pmde++;
+            addr = next;
+            continue;
+        }
+
         if (pmde_none(*pmde) || pmde_bad(*pmde)) {
             pmde++;
             addr = next;
@@ -502,32 +1045,23 @@ int pgd_bind(struct mmproc* who, pgdir_t* pgd)
 
 int pgd_va2pa(pgdir_t* pgd, vir_bytes vir_addr, phys_bytes* phys_addr)
 {
-    pte_t* pte;
-    int retval;
-
-    if ((retval = pt_follow(pgd, (unsigned long)vir_addr, &pte)) != 0) {
-        return retval;
-    }
-
-    phys_bytes phys = pte_pfn(*pte) << ARCH_PG_SHIFT;
-    *phys_addr = phys + ((unsigned long)vir_addr % ARCH_PG_SIZE);
-    return 0;
+    return pt_follow(pgd, vir_addr, phys_addr);
 }
 
 int unmap_memory(pgdir_t* pgd, vir_bytes vir_addr, size_t length)
 {
+    struct pt_walk walk = {
+        .pgd = pgd, .create = FALSE, .fill = pt_fill_none, .arg = NULL};
+
     /* sanity check */
     if ((uintptr_t)vir_addr % ARCH_PG_SIZE != 0)
         printl("MM: map_memory: vir_addr is not page-aligned!\n");
     if (length % ARCH_PG_SIZE != 0)
         printl("MM: map_memory: length is not page-aligned!\n");
 
-    while (length > 0) {
-        pt_mappage(pgd, 0, vir_addr, __pgprot(0));
+    length = roundup(length, ARCH_PG_SIZE);
+    if (!length) return 0;
 
-        length -= ARCH_PG_SIZE;
-        vir_addr += ARCH_PG_SIZE;
-    }
-
-    return 0;
+    /* tables that do not exist have nothing to clear */
+    return pt_walk_range(&walk, vir_addr, vir_addr + length);
 }
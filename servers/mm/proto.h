@@ -17,6 +17,7 @@
 #define _MM_PROTO_H_
 
 #include <lyos/list.h>
+#include <asm/pagetable.h>
 
 #include "region.h"
 #include "mmproc.h"
@@ -51,6 +52,8 @@ void slabfree(void* mem, int bytes);
     } while (0)
 
 /* mm/pagetable.c */
+typedef pte_t (*pt_fill_t)(vir_bytes addr, void* arg);
+typedef pmd_t (*pt_fill_huge_t)(vir_bytes addr, void* arg);
 void pt_init();
 int pt_mappage(pgdir_t* pgd, phys_bytes phys_addr, vir_bytes vir_addr,
                pgprot_t prot);
@@ -58,13 +61,24 @@ int pt_wppage(pgdir_t* pgd, vir_bytes vir_addr);
 int pt_unwppage(pgdir_t* pgd, vir_bytes vir_addr);
 int pt_writemap(pgdir_t* pgd, phys_bytes phys_addr, vir_bytes vir_addr,
                 size_t length, pgprot_t prot);
+int pt_map_range(pgdir_t* pgd, vir_bytes start, vir_bytes end, pt_fill_t fill,
+                 void* arg);
+int pt_map_range_huge(pgdir_t* pgd, vir_bytes start, vir_bytes end,
+                      pt_fill_t fill, pt_fill_huge_t fill_huge, void* arg);
+int pt_has_huge(void);
+pmd_t pt_huge_entry(phys_bytes phys_addr, pgprot_t prot);
+int pt_share_range(pgdir_t* dst, pgdir_t* src, vir_bytes start,
+                   vir_bytes end);
 int pt_wp_memory(pgdir_t* pgd, vir_bytes vir_addr, size_t length);
 int pt_unwp_memory(pgdir_t* pgd, vir_bytes vir_addr, size_t length);
 void pt_kern_mapping_init();
 int unmap_memory(pgdir_t* pgd, vir_bytes vir_addr, size_t length);
+void pt_flush_tlb(void);
+void pt_free_mem(phys_bytes base, phys_bytes len);
 int pgd_new(pgdir_t* pgd);
 int pgd_bind(struct mmproc* who, pgdir_t* pgd);
 int pgd_clear(pgdir_t* pgd);
+void pt_free_range(pmd_t* pt);
 void pgd_free_range(pgdir_t* pgd, vir_bytes addr, vir_bytes end,
                     vir_bytes floor, vir_bytes ceiling);
 int pgd_free(pgdir_t* pgd);
@@ -82,8 +96,9 @@ void mm_free(struct mm_struct* mm);
 
 /* mm/region.c */
 struct phys_region* phys_region_get(struct vir_region* vr, vir_bytes offset);
-void phys_region_set(struct vir_region* vr, vir_bytes offset,
-                     struct phys_region* pr);
+struct phys_region* phys_region_next(struct vir_region* vr, vir_bytes offset);
+int phys_region_set(struct vir_region* vr, vir_bytes offset,
+                    struct phys_region* pr);
 struct vir_region* region_new(struct mmproc* mmp, vir_bytes base, size_t length,
                               int flags, const struct region_operations* rops);
 struct vir_region* region_map(struct mmproc* mmp, vir_bytes minv,
@@ -92,6 +107,9 @@ struct vir_region* region_map(struct mmproc* mmp, vir_bytes minv,
                               const struct region_operations* rops);
 vir_bytes region_find_free_region(struct mmproc* mmp, vir_bytes minv,
                                   vir_bytes maxv, size_t len);
+vir_bytes region_find_free_region_align(struct mmproc* mmp, vir_bytes minv,
+                                        vir_bytes maxv, size_t len,
+                                        vir_bytes align);
 int region_extend_up_to(struct mmproc* mmp, vir_bytes addr);
 struct vir_region* region_lookup(struct mmproc* mmp, vir_bytes addr);
 int region_handle_memory(struct mmproc* mmp, struct vir_region* vr,
@@ -101,6 +119,7 @@ int region_handle_pf(struct mmproc* mmp, struct vir_region* vr,
                      vir_bytes offset, int write, vfs_callback_t cb,
                      void* state, size_t state_len);
 int region_unmap_range(struct mmproc* mmp, vir_bytes start, size_t len);
+size_t region_huge_resident(struct vir_region* vr);
 int region_remap(struct mmproc* mmp, struct vir_region* vr, vir_bytes offset,
                  size_t len, struct vir_region* new_vr);
 int region_free(struct vir_region* rp);
@@ -138,6 +157,7 @@ struct vir_region* mmap_region(struct mmproc* mmp, vir_bytes addr,
 int do_mmap();
 int do_munmap();
 int do_vfs_mmap();
+int do_vfs_mmap_batch();
 int do_map_phys();
 int do_mm_remap();
 int do_mremap(void);
@@ -154,6 +174,7 @@ void file_unreferenced(struct mm_file_desc* filp);
 void page_cache_init();
 int page_cache_add(dev_t dev, off_t dev_offset, ino_t ino, off_t ino_offset,
                    struct page* frame);
+int do_page_cache(void);
 
 /* mm/page.c */
 struct page* page_new(phys_bytes phys);
@@ -178,6 +199,7 @@ void direct_phys_set_phys(struct vir_region* vr, phys_bytes paddr);
 
 /* mm/shared_map.c */
 void shared_set_source(struct vir_region* vr, endpoint_t ep,
-                       struct vir_region* src);
+                       struct vir_region* src, vir_bytes offset);
+void shared_set_file(struct vir_region* vr, struct mm_file_desc* filp);
 
 #endif
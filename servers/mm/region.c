@@ -36,18 +36,15 @@
 
 #define FREE_REGION_FAILED ((vir_bytes)-1)
 
+#define PHYS_TREE_MAX_HEIGHT \
+    ((sizeof(size_t) * 8 + PHYS_NODE_SHIFT - 1) / PHYS_NODE_SHIFT)
+
 static inline size_t phys_slot(vir_bytes offset)
 {
     assert(!(offset % ARCH_PG_SIZE));
     return offset >> ARCH_PG_SHIFT;
 }
 
-static inline size_t phys_regions_size(struct vir_region* vr)
-{
-    assert(!(vr->length % ARCH_PG_SIZE));
-    return phys_slot(vr->length) * sizeof(struct phys_region*);
-}
-
 static inline int phys_region_writable(struct vir_region* vr,
                                        struct phys_region* pr)
 {
@@ -76,69 +73,226 @@ static inline pgprot_t phys_region_page_prot(struct vir_region* vr,
     return prot;
 }
 
+static inline unsigned int phys_node_shift(unsigned int height)
+{
+    return (height - 1) * PHYS_NODE_SHIFT;
+}
+
+/* Number of indices a tree of the given height can hold. */
+static inline size_t phys_tree_capacity(unsigned int height)
+{
+    if (!height) return 0;
+    if (height * PHYS_NODE_SHIFT >= sizeof(size_t) * 8) return (size_t)-1;
+    return (size_t)1 << (height * PHYS_NODE_SHIFT);
+}
+
+static struct phys_node* phys_node_alloc(void)
+{
+    struct phys_node* node;
+
+    SLABALLOC(node);
+    if (!node) return NULL;
+
+    memset(node, 0, sizeof(*node));
+    return node;
+}
+
+static void phys_node_free(struct phys_node* node, unsigned int height)
+{
+    int i;
+
+    if (height > 1) {
+        for (i = 0; i < PHYS_NODE_SLOTS; i++) {
+            if (node->slots[i]) phys_node_free(node->slots[i], height - 1);
+        }
+    }
+
+    SLABFREE(node);
+}
+
+static void* phys_tree_lookup(struct phys_tree* tree, size_t index)
+{
+    struct phys_node* node = tree->root;
+    unsigned int height;
+
+    if (index >= phys_tree_capacity(tree->height)) return NULL;
+
+    for (height = tree->height; node && height > 1; height--)
+        node = node->slots[(index >> phys_node_shift(height)) & PHYS_NODE_MASK];
+
+    return node ? node->slots[index & PHYS_NODE_MASK] : NULL;
+}
+
+static int phys_tree_insert(struct phys_tree* tree, size_t index, void* entry)
+{
+    struct phys_node *node, *child;
+    unsigned int height, i;
+
+    /* grow the tree upwards until the index fits */
+    while (index >= phys_tree_capacity(tree->height)) {
+        if (tree->root) {
+            if (!(node = phys_node_alloc())) return ENOMEM;
+            node->slots[0] = tree->root;
+            node->count = 1;
+            tree->root = node;
+        }
+        tree->height++;
+    }
+
+    if (!tree->root && !(tree->root = phys_node_alloc())) return ENOMEM;
+
+    node = tree->root;
+    for (height = tree->height; height > 1; height--) {
+        i = (index >> phys_node_shift(height)) & PHYS_NODE_MASK;
+
+        if (!node->slots[i]) {
+            if (!(child = phys_node_alloc())) return ENOMEM;
+            node->slots[i] = child;
+            node->count++;
+        }
+
+        node = node->slots[i];
+    }
+
+    i = index & PHYS_NODE_MASK;
+    assert(!node->slots[i]);
+    node->slots[i] = entry;
+    node->count++;
+
+    return 0;
+}
+
+static void phys_tree_delete(struct phys_tree* tree, size_t index)
+{
+    struct phys_node* path[PHYS_TREE_MAX_HEIGHT];
+    struct phys_node* node = tree->root;
+    unsigned int height, level = 0, i;
+
+    assert(index < phys_tree_capacity(tree->height));
+
+    for (height = tree->height; height > 1; height--) {
+        assert(node);
+        path[level++] = node;
+        node = node->slots[(index >> phys_node_shift(height)) & PHYS_NODE_MASK];
+    }
+
+    assert(node && node->slots[index & PHYS_NODE_MASK]);
+    node->slots[index & PHYS_NODE_MASK] = NULL;
+    node->count--;
+
+    /* release the nodes that became empty on the way back up */
+    for (height = 1; !node->count; height++) {
+        SLABFREE(node);
+
+        if (!level) {
+            tree->root = NULL;
+            tree->height = 0;
+            return;
+        }
+
+        node = path[--level];
+        i = (index >> phys_node_shift(height + 1)) & PHYS_NODE_MASK;
+        node->slots[i] = NULL;
+        node->count--;
+    }
+}
+
+/* Find the first entry at or after index in the subtree of node, which covers
+ * the indices from prefix on. */
+static void* phys_node_next(struct phys_node* node, unsigned int height,
+                            size_t prefix, size_t index, size_t* foundp)
+{
+    unsigned int shift = phys_node_shift(height);
+    size_t i, first;
+    void* entry;
+
+    for (i = (index - prefix) >> shift; i < PHYS_NODE_SLOTS; i++) {
+        if (!(entry = node->slots[i])) continue;
+
+        first = prefix + (i << shift);
+        if (height == 1) {
+            *foundp = first;
+            return entry;
+        }
+
+        entry = phys_node_next(entry, height - 1, first, max(index, first),
+                               foundp);
+        if (entry) return entry;
+    }
+
+    return NULL;
+}
+
+static void phys_tree_destroy(struct phys_tree* tree)
+{
+    if (tree->root) phys_node_free(tree->root, tree->height);
+
+    tree->root = NULL;
+    tree->height = 0;
+    tree->base = 0;
+}
+
 struct phys_region* phys_region_get(struct vir_region* vr, vir_bytes offset)
 {
-    size_t i;
     struct phys_region* pr;
 
     assert(offset < vr->length);
-    assert(vr->phys_regions);
     assert(!(offset % ARCH_PG_SIZE));
 
-    i = phys_slot(offset);
-    if ((pr = vr->phys_regions[i]) != NULL) assert(pr->offset == offset);
+    pr = phys_tree_lookup(&vr->phys_regions,
+                          vr->phys_regions.base + phys_slot(offset));
+    if (pr) assert(pr->offset == offset);
     return pr;
 }
 
-void phys_region_set(struct vir_region* vr, vir_bytes offset,
-                     struct phys_region* pr)
+/**
+ * <Ring 1> Get the first resident page of the region at or after offset.
+ */
+struct phys_region* phys_region_next(struct vir_region* vr, vir_bytes offset)
 {
-    size_t i;
+    struct phys_tree* tree = &vr->phys_regions;
+    struct phys_region* pr;
+    size_t index, found;
+
+    if (offset >= vr->length || !tree->root) return NULL;
+
+    index = tree->base + phys_slot(offset);
+    if (index >= phys_tree_capacity(tree->height)) return NULL;
+
+    pr = phys_node_next(tree->root, tree->height, 0, index, &found);
+    if (!pr) return NULL;
+
+    assert(pr->offset == (found - tree->base) << ARCH_PG_SHIFT);
+    assert(pr->offset < vr->length);
+    return pr;
+}
+
+int phys_region_set(struct vir_region* vr, vir_bytes offset,
+                    struct phys_region* pr)
+{
+    struct phys_tree* tree = &vr->phys_regions;
+    size_t index;
     struct mm_struct* mm;
+    int retval;
 
     assert(offset < vr->length);
-    assert(vr->phys_regions);
     assert(!(offset % ARCH_PG_SIZE));
 
-    i = phys_slot(offset);
+    index = tree->base + phys_slot(offset);
 
     mm = vr->mm;
     assert(mm);
 
     if (pr) {
-        assert(!vr->phys_regions[i]);
         assert(pr->offset == offset);
+        if ((retval = phys_tree_insert(tree, index, pr)) != OK) return retval;
         mm->vm_total += ARCH_PG_SIZE;
     } else {
-        assert(vr->phys_regions[i]);
+        phys_tree_delete(tree, index);
         mm->vm_total -= ARCH_PG_SIZE;
-    }
-
-    vr->phys_regions[i] = pr;
-}
-
-int phys_region_resize(struct vir_region* vr, vir_bytes new_length)
-{
-    size_t cur_slots, new_slots;
-    struct phys_region** new_prs;
 
-    assert(vr->length);
-    assert(new_length);
-
-    cur_slots = phys_slot(vr->length);
-    new_slots = phys_slot(new_length);
-
-    new_prs = alloc_vmem(NULL, new_slots * sizeof(struct phys_region*), 0);
-    if (!new_prs) return ENOMEM;
-
-    memcpy(new_prs, vr->phys_regions,
-           min(cur_slots, new_slots) * sizeof(struct phys_region*));
-    if (new_slots > cur_slots)
-        memset(new_prs + cur_slots, 0,
-               (new_slots - cur_slots) * sizeof(struct phys_region*));
-
-    free_vmem(vr->phys_regions, cur_slots * sizeof(struct phys_region*));
-    vr->phys_regions = new_prs;
+        if (!tree->root) tree->base = 0;
+    }
 
     return 0;
 }
@@ -154,7 +308,6 @@ struct vir_region* region_new(struct mmproc* mmp, vir_bytes base, size_t length,
                               int flags, const struct region_operations* rops)
 {
     struct vir_region* region;
-    struct phys_region** prs;
     static unsigned int seq;
 
     SLABALLOC(region);
@@ -163,6 +316,7 @@ struct vir_region* region_new(struct mmproc* mmp, vir_bytes base, size_t length,
     DBG(printl("MM: region_new: allocated memory for virtual region at %p\n",
                region));
 
+    /* the page tree is populated lazily as pages are touched */
     memset(region, 0, sizeof(*region));
     region->vir_addr = base;
     region->length = length;
@@ -172,14 +326,6 @@ struct vir_region* region_new(struct mmproc* mmp, vir_bytes base, size_t length,
     region->mm = mmp->mm;
     region->seq = seq++;
 
-    if ((prs = alloc_vmem(NULL, phys_regions_size(region), 0)) == NULL) {
-        SLABFREE(region);
-        return NULL;
-    }
-
-    memset(prs, 0, phys_regions_size(region));
-    region->phys_regions = prs;
-
     return region;
 }
 
@@ -188,12 +334,17 @@ struct vir_region* region_map(struct mmproc* mmp, vir_bytes minv,
                               int map_flags,
                               const struct region_operations* rops)
 {
-    vir_bytes startv;
+    vir_bytes startv = FREE_REGION_FAILED;
     struct vir_region* vr;
 
     assert(mmp->mm);
 
-    startv = region_find_free_region(mmp, minv, maxv, length);
+    /* line the region up with big pages so that all of it can use them */
+    if ((flags & RF_HUGE) && length >= ARCH_BIG_PAGE_SIZE)
+        startv = region_find_free_region_align(mmp, minv, maxv, length,
+                                               ARCH_BIG_PAGE_SIZE);
+    if (startv == FREE_REGION_FAILED)
+        startv = region_find_free_region(mmp, minv, maxv, length);
     if (startv == FREE_REGION_FAILED) return NULL;
 
     if ((vr = region_new(mmp, startv, length, flags, rops)) == NULL)
@@ -243,24 +394,128 @@ int region_write_map_page(struct mmproc* mmp, struct vir_region* vr,
     return 0;
 }
 
+static pte_t region_fill_pte(vir_bytes addr, void* arg)
+{
+    struct vir_region* vr = arg;
+    struct phys_region* pr = phys_region_get(vr, addr - vr->vir_addr);
+
+    assert(pr && pr->page->refcount);
+
+    return pfn_pte(pr->page->phys_addr >> ARCH_PG_SHIFT,
+                   phys_region_page_prot(vr, pr));
+}
+
+/* Find the big page that contains offset. Returns FALSE if the region does
+ * not cover all of it. */
+static int region_huge_block(struct vir_region* vr, vir_bytes offset,
+                             vir_bytes* boffp)
+{
+    vir_bytes start = rounddown(vr->vir_addr + offset, ARCH_BIG_PAGE_SIZE);
+
+    if (start < vr->vir_addr ||
+        start + ARCH_BIG_PAGE_SIZE > vr->vir_addr + vr->length)
+        return FALSE;
+
+    *boffp = start - vr->vir_addr;
+    return TRUE;
+}
+
+/* Check whether the big page at boff is one aligned run of physical memory
+ * with the same protection everywhere, i.e. whether a single PMD entry can
+ * map it. */
+static int region_block_contig(struct vir_region* vr, vir_bytes boff,
+                               phys_bytes* physp, pgprot_t* protp)
+{
+    struct phys_region* pr;
+    phys_bytes base;
+    pgprot_t prot;
+    vir_bytes off;
+
+    if (!(pr = phys_region_get(vr, boff))) return FALSE;
+
+    base = pr->page->phys_addr;
+    if (base == PHYS_NONE || (base % ARCH_BIG_PAGE_SIZE)) return FALSE;
+    prot = phys_region_page_prot(vr, pr);
+
+    for (off = ARCH_PG_SIZE; off < ARCH_BIG_PAGE_SIZE; off += ARCH_PG_SIZE) {
+        if (!(pr = phys_region_get(vr, boff + off))) return FALSE;
+        if (pr->page->phys_addr != base + off) return FALSE;
+        if (pgprot_val(phys_region_page_prot(vr, pr)) != pgprot_val(prot))
+            return FALSE;
+    }
+
+    *physp = base;
+    *protp = prot;
+    return TRUE;
+}
+
+static pmd_t region_fill_pmd(vir_bytes addr, void* arg)
+{
+    struct vir_region* vr = arg;
+    phys_bytes phys;
+    pgprot_t prot;
+
+    if (!(vr->flags & RF_HUGE) ||
+        !region_block_contig(vr, addr - vr->vir_addr, &phys, &prot))
+        return __pmd(0);
+
+    return pt_huge_entry(phys, prot);
+}
+
+/**
+ * <Ring 1> Bytes of the region that are backed by whole big pages.
+ */
+size_t region_huge_resident(struct vir_region* vr)
+{
+    vir_bytes addr, end = vr->vir_addr + vr->length;
+    phys_bytes phys;
+    pgprot_t prot;
+    size_t total = 0;
+
+    if (!(vr->flags & RF_HUGE)) return 0;
+
+    for (addr = roundup(vr->vir_addr, ARCH_BIG_PAGE_SIZE);
+         addr + ARCH_BIG_PAGE_SIZE <= end; addr += ARCH_BIG_PAGE_SIZE) {
+        if (region_block_contig(vr, addr - vr->vir_addr, &phys, &prot))
+            total += ARCH_BIG_PAGE_SIZE;
+    }
+
+    return total;
+}
+
+/* Map each run of populated pages of a region with a single page table
+ * walk. */
+static int region_write_map_region(struct mmproc* mmp, struct vir_region* vr)
+{
+    struct phys_region* pr;
+    vir_bytes off, start;
+    int retval;
+
+    for (pr = phys_region_next(vr, 0); pr; pr = phys_region_next(vr, off)) {
+        start = pr->offset;
+        off = start + ARCH_PG_SIZE;
+        while (off < vr->length && phys_region_get(vr, off))
+            off += ARCH_PG_SIZE;
+
+        if ((retval = pt_map_range_huge(&mmp->mm->pgd, vr->vir_addr + start,
+                                        vr->vir_addr + off, region_fill_pte,
+                                        region_fill_pmd, vr)) != OK)
+            return ENOMEM;
+    }
+
+    return 0;
+}
+
 int region_write_map(struct mmproc* mmp)
 {
     struct vir_region* vr;
-    struct phys_region* pr;
     int retval;
 
     assert(mmp->mm);
 
     list_for_each_entry(vr, &mmp->mm->mem_regions, list)
     {
-        vir_bytes off;
-
-        for (off = 0; off < vr->length; off += ARCH_PG_SIZE) {
-            if (!(pr = phys_region_get(vr, off))) continue;
-
-            if ((retval = region_write_map_page(mmp, vr, pr)) != OK)
-                return retval;
-        }
+        if ((retval = region_write_map_region(mmp, vr)) != OK) return retval;
     }
 
     return 0;
@@ -268,6 +523,13 @@ int region_write_map(struct mmproc* mmp)
 
 vir_bytes region_find_free_region(struct mmproc* mmp, vir_bytes minv,
                                   vir_bytes maxv, size_t len)
+{
+    return region_find_free_region_align(mmp, minv, maxv, len, ARCH_PG_SIZE);
+}
+
+vir_bytes region_find_free_region_align(struct mmproc* mmp, vir_bytes minv,
+                                        vir_bytes maxv, size_t len,
+                                        vir_bytes align)
 {
     int found = 0;
     vir_bytes vaddr;
@@ -281,14 +543,15 @@ vir_bytes region_find_free_region(struct mmproc* mmp, vir_bytes minv,
     region_avl_start_iter(&mmp->mm->mem_avl, &iter, &vr_max, AVL_GREATER_EQUAL);
     struct vir_region* last = region_avl_get_iter(&iter);
 
-#define TRY_ALLOC_REGION(start, end)                          \
-    do {                                                      \
-        vir_bytes rstart = ((start) > minv) ? (start) : minv; \
-        vir_bytes rend = ((end) < maxv) ? (end) : maxv;       \
-        if (rend > rstart && (rend - rstart >= len)) {        \
-            vaddr = rend - len;                               \
-            found = 1;                                        \
-        }                                                     \
+#define TRY_ALLOC_REGION(start, end)                               \
+    do {                                                           \
+        vir_bytes rstart = ((start) > minv) ? (start) : minv;      \
+        vir_bytes rend = ((end) < maxv) ? (end) : maxv;            \
+        if (rend > rstart && (rend - rstart >= len) &&             \
+            rounddown(rend - len, align) >= rstart) {              \
+            vaddr = rounddown(rend - len, align);                  \
+            found = 1;                                             \
+        }                                                          \
     } while (0)
 
 #define ALLOC_REGION(start, end)                                      \
@@ -328,7 +591,6 @@ int region_extend_up_to(struct mmproc* mmp, vir_bytes addr)
     unsigned offset = ~0;
     struct vir_region *vr, *rb = NULL;
     vir_bytes limit, extra;
-    int retval;
 
     addr = roundup(addr, ARCH_PG_SIZE);
 
@@ -359,26 +621,78 @@ int region_extend_up_to(struct mmproc* mmp, vir_bytes addr)
         return 0;
     }
 
-    if ((retval = phys_region_resize(rb, addr - rb->vir_addr)) != OK)
+    return rb->rops->rop_resize(mmp, rb, addr - rb->vir_addr);
+}
+
+/* Map the big page around offset with a single entry if the region allows
+ * it, populating it first if it is empty. Returns EAGAIN if the page has to
+ * be handled with small pages instead. */
+static int region_handle_huge(struct mmproc* mmp, struct vir_region* vr,
+                              vir_bytes offset, int write)
+{
+    vir_bytes boff, off;
+    phys_bytes phys;
+    pgprot_t prot;
+    int populated = 0;
+    int retval;
+
+    if (!(vr->flags & RF_HUGE) || !pt_has_huge()) return EAGAIN;
+    if (!region_huge_block(vr, offset, &boff)) return EAGAIN;
+
+    for (off = 0; off < ARCH_BIG_PAGE_SIZE; off += ARCH_PG_SIZE) {
+        if (phys_region_get(vr, boff + off)) populated++;
+    }
+
+    if (!populated) {
+        if (!vr->rops->rop_huge_fault) return EAGAIN;
+        if (vr->rops->rop_huge_fault(mmp, vr, boff) != OK) return EAGAIN;
+    } else if (populated != ARCH_BIG_PAGE_SIZE >> ARCH_PG_SHIFT) {
+        return EAGAIN;
+    }
+
+    if (!region_block_contig(vr, boff, &phys, &prot)) return EAGAIN;
+
+    /* copy-on-write pages are broken up one at a time */
+    if (write && !phys_region_writable(vr, phys_region_get(vr, boff)))
+        return EAGAIN;
+
+    if ((retval = pt_map_range_huge(
+             &mmp->mm->pgd, vr->vir_addr + boff,
+             vr->vir_addr + boff + ARCH_BIG_PAGE_SIZE, region_fill_pte,
+             region_fill_pmd, vr)) != OK)
         return retval;
 
-    return rb->rops->rop_resize(mmp, rb, addr - rb->vir_addr);
+    return 0;
 }
 
+static int region_handle_small_pf(struct mmproc* mmp, struct vir_region* vr,
+                                  vir_bytes offset, int write,
+                                  vfs_callback_t cb, void* state,
+                                  size_t state_len);
+
 int region_handle_memory(struct mmproc* mmp, struct vir_region* vr,
                          off_t offset, size_t len, int write, vfs_callback_t cb,
                          void* state, size_t state_len)
 {
     off_t end = offset + len;
-    off_t off;
+    off_t off, next;
     int retval;
 
     assert(len > 0);
     assert(end > offset);
 
-    for (off = offset; off < end; off += ARCH_PG_SIZE) {
-        if ((retval = region_handle_pf(mmp, vr, off, write, cb, state,
-                                       state_len)) != OK)
+    for (off = offset; off < end; off = next) {
+        next = off + ARCH_PG_SIZE;
+
+        if (region_handle_huge(mmp, vr, off, write) == OK) {
+            /* the rest of the big page is mapped too */
+            next = rounddown(vr->vir_addr + off, ARCH_BIG_PAGE_SIZE) +
+                   ARCH_BIG_PAGE_SIZE - vr->vir_addr;
+            continue;
+        }
+
+        if ((retval = region_handle_small_pf(mmp, vr, off, write, cb, state,
+                                             state_len)) != OK)
             return retval;
     }
 
@@ -389,7 +703,21 @@ int region_handle_pf(struct mmproc* mmp, struct vir_region* vr,
                      vir_bytes offset, int write, vfs_callback_t cb,
                      void* state, size_t state_len)
 {
+    offset = rounddown(offset, ARCH_PG_SIZE);
 
+    assert(offset < vr->length);
+
+    if (region_handle_huge(mmp, vr, offset, write) == OK) return 0;
+
+    return region_handle_small_pf(mmp, vr, offset, write, cb, state,
+                                  state_len);
+}
+
+static int region_handle_small_pf(struct mmproc* mmp, struct vir_region* vr,
+                                  vir_bytes offset, int write,
+                                  vfs_callback_t cb, void* state,
+                                  size_t state_len)
+{
     struct phys_region* pr;
     int retval = 0;
 
@@ -444,8 +772,7 @@ static int region_split(struct mmproc* mmp, struct vir_region* vr, size_t len,
 {
     struct vir_region *vr1 = NULL, *vr2 = NULL;
     size_t rem_len = vr->length - len;
-    size_t slot1, slot2;
-    off_t off;
+    struct phys_region* pr;
 
     if (!vr->rops->rop_split) return EINVAL;
 
@@ -454,26 +781,19 @@ static int region_split(struct mmproc* mmp, struct vir_region* vr, size_t len,
     assert(!(vr->vir_addr % ARCH_PG_SIZE));
     assert(!(vr->length % ARCH_PG_SIZE));
 
-    slot1 = phys_slot(len);
-    slot2 = phys_slot(rem_len);
-    assert(slot1 + slot2 == phys_slot(vr->length));
-
     if (!(vr1 = region_new(mmp, vr->vir_addr, len, vr->flags, vr->rops)))
         goto failed;
     if (!(vr2 = region_new(mmp, vr->vir_addr + len, rem_len, vr->flags,
                            vr->rops)))
         goto failed;
 
-    for (off = 0; off < vr1->length; off += ARCH_PG_SIZE) {
-        struct phys_region* pr;
-        if (!(pr = phys_region_get(vr, off))) continue;
-        if (!page_reference(pr->page, off, vr1, pr->rops)) goto failed;
-    }
-
-    for (off = 0; off < vr2->length; off += ARCH_PG_SIZE) {
-        struct phys_region* pr;
-        if (!(pr = phys_region_get(vr, len + off))) continue;
-        if (!page_reference(pr->page, off, vr2, pr->rops)) goto failed;
+    for (pr = phys_region_next(vr, 0); pr;
+         pr = phys_region_next(vr, pr->offset + ARCH_PG_SIZE)) {
+        if (pr->offset < len) {
+            if (!page_reference(pr->page, pr->offset, vr1, pr->rops))
+                goto failed;
+        } else if (!page_reference(pr->page, pr->offset - len, vr2, pr->rops))
+            goto failed;
     }
 
     vr->rops->rop_split(mmp, vr, vr1, vr2);
@@ -503,7 +823,6 @@ struct vir_region* region_copy_region(struct mmproc* mmp, struct vir_region* vr)
 {
     struct vir_region* new_vr;
     struct phys_region *pr, *new_pr;
-    size_t i;
     int retval;
 
     if ((new_vr = region_new(vr->parent, vr->vir_addr, vr->length, vr->flags,
@@ -517,9 +836,8 @@ struct vir_region* region_copy_region(struct mmproc* mmp, struct vir_region* vr)
         return NULL;
     }
 
-    for (i = 0; i < phys_slot(vr->length); i++) {
-        if (!(pr = phys_region_get(vr, i << ARCH_PG_SHIFT))) continue;
-
+    for (pr = phys_region_next(vr, 0); pr;
+         pr = phys_region_next(vr, pr->offset + ARCH_PG_SIZE)) {
         if (!(new_pr =
                   page_reference(pr->page, pr->offset, new_vr, vr->rops))) {
             region_free(new_vr);
@@ -551,8 +869,19 @@ int region_copy_proc(struct mmproc* mmp_dest, struct mmproc* mmp_src)
         avl_insert(&new_vr->avl, &mmp_dest->mm->mem_avl);
     }
 
+    /* write-protect the pages that are now copy-on-write in the parent, after
+     * which the child would get exactly the same PTEs: let it use the
+     * parent's page tables until either of them changes an entry */
     region_write_map(mmp_src);
-    region_write_map(mmp_dest);
+
+    list_for_each_entry(vr, &mmp_src->mm->mem_regions, list)
+    {
+        if (pt_share_range(&mmp_dest->mm->pgd, &mmp_src->mm->pgd, vr->vir_addr,
+                           vr->vir_addr + vr->length) != OK) {
+            region_free_mm(mmp_dest->mm);
+            return ENOMEM;
+        }
+    }
 
     return 0;
 }
@@ -565,8 +894,9 @@ static int region_subfree(struct vir_region* rp, off_t start, size_t len)
 
     assert(!(start % ARCH_PG_SIZE));
 
-    for (offset = start; offset < end; offset += ARCH_PG_SIZE) {
-        if ((pr = phys_region_get(rp, offset)) == NULL) continue;
+    offset = start;
+    while ((pr = phys_region_next(rp, offset)) != NULL && pr->offset < end) {
+        offset = pr->offset + ARCH_PG_SIZE;
 
         assert(pr->offset >= start);
         assert(pr->offset < end);
@@ -581,20 +911,21 @@ static int region_unmap(struct mmproc* mmp, struct vir_region* vr, off_t offset,
                         size_t len)
 {
     int retval;
-    size_t new_slots;
     struct phys_region* pr;
-    struct phys_region** new_prs;
-    size_t free_slots = phys_slot(len);
     vir_bytes unmap_start;
-    off_t voff;
+    vir_bytes voff;
 
     assert(offset + len <= vr->length);
     assert(!(len % ARCH_PG_SIZE));
 
-    region_subfree(vr, offset, len);
-
     unmap_start = vr->vir_addr + offset;
 
+    /* clear the PTEs before the pages go, the frames are freed only once the
+     * TLB entries are flushed */
+    unmap_memory(&mmp->mm->pgd, unmap_start, len);
+
+    region_subfree(vr, offset, len);
+
     if (len == vr->length) {
         list_del(&vr->list);
         avl_erase(&vr->avl, &mmp->mm->mem_avl);
@@ -610,35 +941,25 @@ static int region_unmap(struct mmproc* mmp, struct vir_region* vr, off_t offset,
         vr->vir_addr += len;
 
         assert(vr->length > len);
-        new_slots = phys_slot(vr->length - len);
-        assert(new_slots);
 
         list_add(&vr->list, &mmp->mm->mem_regions);
         avl_insert(&vr->avl, &mmp->mm->mem_avl);
 
-        for (voff = len; voff < vr->length; voff += ARCH_PG_SIZE) {
-            if (!(pr = phys_region_get(vr, voff))) continue;
-            assert(pr->offset >= offset);
+        voff = len;
+        while ((pr = phys_region_next(vr, voff)) != NULL) {
+            voff = pr->offset + ARCH_PG_SIZE;
             assert(pr->offset >= len);
             pr->offset -= len;
         }
 
-        new_prs = alloc_vmem(NULL, new_slots * sizeof(struct phys_region*), 0);
-        memcpy(new_prs, vr->phys_regions + free_slots,
-               new_slots * sizeof(struct phys_region*));
-        free_vmem(vr->phys_regions, phys_regions_size(vr));
-        vr->phys_regions = new_prs;
+        /* move the start of the tree instead of reindexing the pages */
+        if (vr->phys_regions.root) vr->phys_regions.base += phys_slot(len);
 
         vr->length -= len;
     } else if (offset + len == vr->length) {
-        if ((retval = phys_region_resize(vr, vr->length - len)) != OK)
-            return retval;
-
         vr->length -= len;
     }
 
-    unmap_memory(&mmp->mm->pgd, unmap_start, len);
-
     return 0;
 }
 
@@ -646,19 +967,16 @@ int region_remap(struct mmproc* mmp, struct vir_region* vr, vir_bytes offset,
                  size_t len, struct vir_region* new_vr)
 {
     struct phys_region *pr, *new_pr;
-    int i, retval;
+    int retval;
 
     if (vr->rops->rop_remap &&
         (retval = vr->rops->rop_remap(vr, offset, len, new_vr)) != OK)
         return retval;
 
-    for (i = 0;
-         i < phys_slot(vr->length - offset) && i < phys_slot(new_vr->length);
-         i++) {
-        if (!(pr = phys_region_get(vr, offset + (i << ARCH_PG_SHIFT))))
-            continue;
-
-        if (!(new_pr = page_reference(pr->page, i << ARCH_PG_SHIFT, new_vr,
+    for (pr = phys_region_next(vr, offset);
+         pr && pr->offset - offset < new_vr->length;
+         pr = phys_region_next(vr, pr->offset + ARCH_PG_SIZE)) {
+        if (!(new_pr = page_reference(pr->page, pr->offset - offset, new_vr,
                                       vr->rops)))
             return ENOMEM;
 
@@ -737,13 +1055,11 @@ int region_free(struct vir_region* rp)
 {
     int retval;
 
-    assert(rp->phys_regions);
-
     if ((retval = region_subfree(rp, 0, rp->length)) != OK) return retval;
 
     if (rp->rops->rop_delete) rp->rops->rop_delete(rp);
-    free_vmem(rp->phys_regions, phys_regions_size(rp));
-    rp->phys_regions = NULL;
+    /* drops any nodes left behind by a failed insertion */
+    phys_tree_destroy(&rp->phys_regions);
 
     SLABFREE(rp);
 
@@ -56,6 +56,9 @@ struct region_operations {
                           struct phys_region* pr, int write,
                           void (*cb)(struct mmproc*, MESSAGE*, void*),
                           void* state, size_t state_len);
+    /* populate the empty big page at offset with contiguous memory */
+    int (*rop_huge_fault)(struct mmproc* mmp, struct vir_region* vr,
+                          vir_bytes offset);
 
     int (*rop_writable)(const struct phys_region* pr);
     int (*rop_reference)(struct phys_region* pr, struct phys_region* new_pr);
@@ -74,6 +77,23 @@ struct phys_region {
     const struct region_operations* rops;
 };
 
+/* Resident pages of a region are kept in a radix tree indexed by page
+ * number, so that sparse regions only pay for the pages they touch. */
+#define PHYS_NODE_SHIFT 6
+#define PHYS_NODE_SLOTS (1 << PHYS_NODE_SHIFT)
+#define PHYS_NODE_MASK  (PHYS_NODE_SLOTS - 1)
+
+struct phys_node {
+    void* slots[PHYS_NODE_SLOTS];
+    unsigned int count;
+};
+
+struct phys_tree {
+    struct phys_node* root;
+    unsigned int height;
+    size_t base; /* index of the first page of the region */
+};
+
 /**
  * Virtual memory region
  */
@@ -90,7 +110,7 @@ struct vir_region {
     int remaps;
     int seq;
 
-    struct phys_region** phys_regions;
+    struct phys_tree phys_regions;
     const struct region_operations* rops;
 
     union {
@@ -104,7 +124,9 @@ struct vir_region {
         struct {
             endpoint_t endpoint;
             vir_bytes vaddr;
+            vir_bytes offset; /* where this region starts in the source */
             int seq;
+            struct mm_file_desc* filp; /* file owning the source, if any */
         } shared;
 
         phys_bytes phys;
@@ -121,6 +143,7 @@ struct vir_region {
 #define RF_ANON          0x0100
 #define RF_DIRECT        0x0200
 #define RF_IO            0x0400
+#define RF_HUGE          0x0800 /* map with big pages where possible */
 
 /* Map region flags */
 #define MRF_PREALLOC 0x01
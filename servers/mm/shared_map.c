@@ -42,11 +42,26 @@ static int shared_unreference(struct phys_region* pr)
     return anon_map_ops.rop_unreference(pr);
 }
 
+/* Keep the file that owns the source pages open while vr maps them so the
+ * file system does not release the pages under us. */
+void shared_set_file(struct vir_region* vr, struct mm_file_desc* filp)
+{
+    if (!filp) return;
+
+    vr->param.shared.filp = filp;
+    filp->refcnt++;
+}
+
 static void shared_delete(struct vir_region* vr)
 {
     struct vir_region* src;
     struct mmproc* mmp;
 
+    if (vr->param.shared.filp) {
+        file_unreferenced(vr->param.shared.filp);
+        vr->param.shared.filp = NULL;
+    }
+
     if (get_src(vr, &mmp, &src) != OK) return;
 
     assert(src->remaps);
@@ -61,20 +76,24 @@ static int shared_page_fault(struct mmproc* mmp, struct vir_region* vr,
     struct vir_region* src;
     struct mmproc* src_mmp;
     struct phys_region* src_pr;
+    vir_bytes src_offset;
     int retval;
 
     if (get_src(vr, &src_mmp, &src) != OK) return EINVAL;
 
     if (pr->page->phys_addr != PHYS_NONE) return 0;
 
+    src_offset = vr->param.shared.offset + pr->offset;
+    if (src_offset >= src->length) return EFAULT;
+
     page_free(pr->page);
 
-    if (!(src_pr = phys_region_get(src, pr->offset))) {
-        if ((retval = region_handle_pf(src_mmp, src, pr->offset, write, NULL,
+    if (!(src_pr = phys_region_get(src, src_offset))) {
+        if ((retval = region_handle_pf(src_mmp, src, src_offset, write, NULL,
                                        NULL, 0)) != OK)
             return retval;
 
-        if (!(src_pr = phys_region_get(src, pr->offset)))
+        if (!(src_pr = phys_region_get(src, src_offset)))
             panic("mm: shared_map_page_fault physical region missing after "
                   "source pf");
     }
@@ -97,14 +116,41 @@ static int shared_copy(struct vir_region* vr, struct vir_region* new_vr)
 
     if (get_src(vr, &src_mmp, &src) != OK) return EINVAL;
 
-    shared_set_source(new_vr, src_mmp->endpoint, src);
+    shared_set_source(new_vr, src_mmp->endpoint, src,
+                      vr->param.shared.offset);
+    shared_set_file(new_vr, vr->param.shared.filp);
+
+    return 0;
+}
 
+static void shared_split(struct mmproc* mmp, struct vir_region* vr,
+                         struct vir_region* r1, struct vir_region* r2)
+{
+    struct vir_region* src;
+    struct mmproc* src_mmp;
+
+    shared_set_file(r1, vr->param.shared.filp);
+    shared_set_file(r2, vr->param.shared.filp);
+
+    if (get_src(vr, &src_mmp, &src) != OK) return;
+
+    /* vr drops its reference to the source when it is freed */
+    shared_set_source(r1, src_mmp->endpoint, src, vr->param.shared.offset);
+    shared_set_source(r2, src_mmp->endpoint, src,
+                      vr->param.shared.offset + r1->length);
+}
+
+static int shared_shrink_low(struct vir_region* vr, vir_bytes len)
+{
+    vr->param.shared.offset += len;
     return 0;
 }
 
 const struct region_operations shared_map_ops = {
     .rop_delete = shared_delete,
     .rop_pt_flags = shared_pt_flags,
+    .rop_shrink_low = shared_shrink_low,
+    .rop_split = shared_split,
     .rop_copy = shared_copy,
     .rop_page_fault = shared_page_fault,
 
@@ -113,7 +159,7 @@ const struct region_operations shared_map_ops = {
 };
 
 void shared_set_source(struct vir_region* vr, endpoint_t ep,
-                       struct vir_region* src)
+                       struct vir_region* src, vir_bytes offset)
 {
     struct mmproc* mmp;
     struct vir_region* src_region;
@@ -124,6 +170,7 @@ void shared_set_source(struct vir_region* vr, endpoint_t ep,
 
     vr->param.shared.endpoint = ep;
     vr->param.shared.vaddr = src->vir_addr;
+    vr->param.shared.offset = offset;
     vr->param.shared.seq = src->seq;
 
     if (get_src(vr, &mmp, &src_region) != OK)
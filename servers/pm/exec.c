@@ -25,6 +25,7 @@
 #include <signal.h>
 
 #include "pmproc.h"
+#include "global.h"
 #include "proto.h"
 
 int do_exec(MESSAGE* m)
@@ -90,5 +91,10 @@ int do_exec(MESSAGE* m)
         }
     }
 
+    pmproc_table_gen++;
+
+    /* the child has its own address space now */
+    vfork_release(pmp);
+
     return 0;
 }
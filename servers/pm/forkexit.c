@@ -91,7 +91,9 @@ int do_fork(MESSAGE* p)
     struct pmproc* pmp = &pmproc_table[child_slot];
     *pmp = *pm_parent;
     pmp->flags = PMPF_INUSE;
+    if (flags & CLONE_VFORK) pmp->flags |= PMPF_VFORK;
     procs_in_use++;
+    pmproc_table_gen++;
 
     pmp->parent = parent_ep;
     pmp->endpoint = child_ep;
@@ -137,9 +139,36 @@ int do_fork(MESSAGE* p)
     msg2child.PID = 0;
     send_recv(SEND, child_ep, &msg2child);
 
+    /* the parent sleeps until the child is done with its address space, see
+     * vfork_release() */
+    if (flags & CLONE_VFORK) return SUSPEND;
+
     return 0;
 }
 
+/**
+ * @brief Wake up the parent of a vfork child.
+ *
+ * The child has either exec'd into an address space of its own or exited, so
+ * the parent can run on its stack again.
+ *
+ * @param pmp The child.
+ */
+void vfork_release(struct pmproc* pmp)
+{
+    MESSAGE msg;
+
+    if (!(pmp->flags & PMPF_VFORK)) return;
+    pmp->flags &= ~PMPF_VFORK;
+
+    memset(&msg, 0, sizeof(msg));
+    msg.type = SYSCALL_RET;
+    msg.RETVAL = 0;
+    msg.PID = pmp->pid;
+
+    send_recv(SEND_NONBLOCK, pmp->parent, &msg);
+}
+
 /*****************************************************************************
  *                                do_exit
  *****************************************************************************/
@@ -220,6 +249,16 @@ void exit_proc(struct pmproc* pmp, int status)
     /* tell MM, see proc_free() */
     procctl(ep, PCTL_CLEARPROC);
 
+    vfork_release(pmp);
+
+    /* tell IPC to apply SEM_UNDO adjustments and drop the waiters, see
+     * do_pm_exit() */
+    MESSAGE msg2ipc;
+    memset(&msg2ipc, 0, sizeof(msg2ipc));
+    msg2ipc.type = IPC_PM_EXIT;
+    msg2ipc.ENDPOINT = ep;
+    asyncsend3(TASK_IPC, &msg2ipc, 0);
+
     pmp->exit_status = status;
 
     check_parent(pmp, 1);
@@ -229,6 +268,7 @@ void exit_proc(struct pmproc* pmp, int status)
     for (i = 0; i < NR_PROCS; i++, pi++) {
         if (pi->parent == ep) { /* is a child */
             pi->parent = INIT;
+            pi->flags &= ~PMPF_VFORK;
             if ((pmproc_table[INIT].flags & PMPF_WAITING) &&
                 (pi->flags & PMPF_HANGING)) {
                 check_parent(pi, 1);
@@ -251,6 +291,7 @@ static void cleanup(struct pmproc* pmp)
 {
     /* release the proc */
     procs_in_use--;
+    pmproc_table_gen++;
     pmp->pid = 0;
     pmp->flags = 0;
 }
@@ -28,6 +28,8 @@
 extern struct pmproc pmproc_table[];
 
 EXTERN int procs_in_use;
+/* bumped whenever a slot is taken or freed, or its ids change */
+EXTERN unsigned int pmproc_table_gen;
 
 EXTERN sigset_t core_set, ign_set, noign_set;
 
@@ -176,6 +176,7 @@ int do_getsetid(MESSAGE* p)
     }
 
     if (tell_vfs) {
+        pmproc_table_gen++;
         send_recv(SEND, TASK_FS, &msg2fs);
         return SUSPEND;
     }
@@ -211,6 +212,10 @@ int do_pm_getinfo(MESSAGE* p)
         src_addr = pmproc_table;
         len = sizeof(struct pmproc) * NR_PROCS;
         break;
+    case PM_INFO_PROCTAB_GEN:
+        src_addr = &pmproc_table_gen;
+        len = sizeof(pmproc_table_gen);
+        break;
     default:
         return EINVAL;
     }
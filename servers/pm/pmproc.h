@@ -70,5 +70,6 @@ struct pmproc {
 #define PMPF_HANGING      0x04
 #define PMPF_SIGSUSPENDED 0x08
 #define PMPF_TRACED       0x10
+#define PMPF_VFORK        0x20 /* parent waits for exec or exit */
 
 #endif
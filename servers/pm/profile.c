@@ -26,6 +26,10 @@ int do_pm_kprofile(MESSAGE* msg)
     switch (msg->KP_ACTION) {
     case KPROF_START:
     case KPROF_STOP:
+    case KPROF_DRAIN:
+    case KPROF_IPC_START:
+    case KPROF_IPC_STOP:
+    case KPROF_IPC_DRAIN:
         return kernel_kprofile(msg->KP_ACTION, msg->KP_SIZE, msg->KP_FREQ,
                                msg->source, msg->KP_CTL, msg->KP_BUF);
     }
@@ -22,6 +22,7 @@ struct pmproc* pm_endpt_proc(endpoint_t ep);
 struct pmproc* pm_pid_proc(pid_t pid);
 
 int do_fork(MESSAGE* p);
+void vfork_release(struct pmproc* pmp);
 int do_wait(MESSAGE* p);
 int do_exit(MESSAGE* p);
 int do_sigaction(MESSAGE* p);
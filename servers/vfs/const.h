@@ -25,7 +25,8 @@
  */
 #define INODE_SIZE 32
 
-#define VMNT_READONLY 0x001
+#define VMNT_READONLY  0x001
+#define VMNT_PAGECACHE 0x002 /* reads of regular files go through MM */
 
 #define NR_WORKER_THREADS 32
 
@@ -33,4 +34,6 @@
 
 #define NR_LOCKS 32
 
+#define NR_VFS_RINGS 32
+
 #endif
@@ -382,7 +382,7 @@ static int ep_insert(struct eventpoll* ep, struct epoll_event* event,
     return 0;
 }
 
-static void ep_timeout_check(struct timer_list* tp)
+static void ep_timeout_check(struct hrtimer* tp)
 {
     struct ep_timer_cb_data* timer_cb = tp->arg;
 
@@ -395,7 +395,7 @@ static int ep_poll(struct eventpoll* ep, void* events, int maxevents,
 {
     int eavail, timed_out = 0;
     struct wait_queue_entry wait;
-    struct timer_list timer;
+    struct hrtimer timer;
     struct ep_timer_cb_data timer_cb;
     struct file_desc* filp = ep->file;
     int retval = 0;
@@ -426,9 +426,8 @@ fetch_events:
             timer_cb.expired = FALSE;
             timer_cb.worker = self;
 
-            clock_t ticks;
-            ticks = (timeout * system_hz + 1000L - 1) / 1000L;
-            set_timer(&timer, ticks, ep_timeout_check, &timer_cb);
+            set_hrtimer(&timer, (u64)timeout * 1000000ULL, ep_timeout_check,
+                        &timer_cb);
         }
 
         unlock_filp(filp);
@@ -438,7 +437,7 @@ fetch_events:
         if (timeout > 0) {
             timed_out = timer_cb.expired;
             if (!timed_out) {
-                cancel_timer(&timer);
+                cancel_hrtimer(&timer);
             }
 
             if (timed_out) break;
@@ -46,6 +46,13 @@ struct vfs_exec_info {
     struct stat sbuf;
     int mmfd;
     int exec_fd;
+    struct exec_cache_entry* cache;
+    /* file mappings of the main executable, sent to MM in one batch */
+    struct vfs_mmap_seg maps[VFS_MMAP_BATCH_MAX];
+    int nr_maps;
+    /* latency breakdown */
+    u64 lookup_ns;
+    u64 header_ns;
     /* dynamic linking */
     int is_dyn;
     int dyn_phnum;
@@ -82,13 +89,25 @@ static int read_header(struct vfs_exec_info* execi);
 static int is_script(struct vfs_exec_info* execi);
 static int request_vfs_mmap(struct exec_info* execi, void* vaddr, size_t len,
                             off_t foffset, int protflags, size_t clearend);
+static int flush_vfs_mmap(struct vfs_exec_info* execi);
+
+static u64 exec_clock(void)
+{
+    u64 now;
+
+    if (get_uptime_ns(&now) != 0) return 0;
+    return now;
+}
 
 /* open the executable and fill in exec info */
 static int get_exec_inode(struct vfs_exec_info* execi, struct lookup* lookup,
                           int sugid, struct fproc* fp)
 {
+    u64 start, now;
     int retval;
 
+    start = exec_clock();
+
     if (execi->pin) {
         unlock_inode(execi->pin);
         put_inode(execi->pin);
@@ -120,25 +139,30 @@ static int get_exec_inode(struct vfs_exec_info* execi, struct lookup* lookup,
         }
     }
 
+    now = exec_clock();
+    execi->lookup_ns += now - start;
+    start = now;
+
     if ((retval = read_header(execi)) != 0) return retval;
 
+    execi->header_ns += exec_clock() - start;
+
     return 0;
 }
 
-/* read in the executable header */
+/* read in the executable header, or take it from the exec cache */
 static int read_header(struct vfs_exec_info* execi)
 {
-    u64 newpos;
-    size_t bytes_rdwt;
-    static char buf[ARCH_PG_SIZE];
+    int retval;
 
-    execi->args.header_len = min(sizeof(buf), execi->pin->i_size);
-    execi->args.header = buf;
+    retval = exec_cache_get(execi->pin, execi->sbuf.st_mtime,
+                            execi->sbuf.st_size, &execi->cache);
+    if (retval) return retval;
 
-    /* read the file */
-    return request_readwrite(execi->pin->i_fs_ep, execi->pin->i_dev,
-                             execi->pin->i_num, 0, READ, TASK_FS, buf,
-                             execi->args.header_len, &newpos, &bytes_rdwt);
+    execi->args.header = execi->cache->header;
+    execi->args.header_len = execi->cache->header_len;
+
+    return 0;
 }
 
 /* read segment */
@@ -167,18 +191,63 @@ static int is_script(struct vfs_exec_info* execi)
     return ((execi->args.header[0] == '#') && (execi->args.header[1] == '!'));
 }
 
-/* issue a vfs_mmap request */
+/* queue a file mapping for flush_vfs_mmap() */
 static int request_vfs_mmap(struct exec_info* execi, void* vaddr, size_t len,
                             off_t foffset, int protflags, size_t clearend)
 {
     struct vfs_exec_info* vexeci =
         (struct vfs_exec_info*)(execi->callback_data);
-    struct inode* pin = vexeci->pin;
+    struct vfs_mmap_seg* seg;
 
-    int flags = MAP_PRIVATE | MAP_FIXED;
+    /* let libexec copy the segment if the batch is full */
+    if (vexeci->nr_maps >= VFS_MMAP_BATCH_MAX) return ENOMEM;
 
-    return vfs_mmap(execi->proc_e, foffset, len, pin->i_dev, pin->i_num,
-                    vexeci->mmfd, vaddr, flags, protflags, clearend);
+    seg = &vexeci->maps[vexeci->nr_maps++];
+    seg->vaddr = vaddr;
+    seg->len = len;
+    seg->offset = foffset;
+    seg->prot = protflags;
+    seg->clearend = clearend;
+
+    return 0;
+}
+
+/* map the queued segments with one MM request */
+static int flush_vfs_mmap(struct vfs_exec_info* execi)
+{
+    struct inode* pin = execi->pin;
+    struct vfs_mmap_seg* seg;
+    int retval;
+
+    if (!execi->nr_maps) return 0;
+
+    exec_stat.map_batches++;
+    retval = vfs_mmap_batch(execi->args.proc_e, pin->i_dev, pin->i_num,
+                            execi->mmfd, MAP_PRIVATE | MAP_FIXED, execi->maps,
+                            execi->nr_maps);
+
+    if (retval) {
+        /* MM mapped none of them, copy the file instead */
+        exec_stat.map_fallbacks++;
+
+        for (seg = execi->maps; seg < &execi->maps[execi->nr_maps]; seg++) {
+            if ((retval = libexec_allocmem(&execi->args, seg->vaddr, seg->len,
+                                           seg->prot)) != 0)
+                break;
+
+            if ((retval = read_segment(&execi->args, seg->offset, seg->vaddr,
+                                       seg->len)) != 0)
+                break;
+
+            if (seg->clearend)
+                libexec_clearmem(&execi->args,
+                                 seg->vaddr + seg->len - seg->clearend,
+                                 seg->clearend);
+        }
+    }
+
+    execi->nr_maps = 0;
+    return retval;
 }
 
 /*****************************************************************************
@@ -207,8 +276,11 @@ int fs_exec(void)
         (struct vfs_exec_response*)self->msg_out.MSG_PAYLOAD;
 
     struct fproc* mm_task = vfs_endpt_proc(TASK_MM);
+    u64 exec_start, load_start, stack_start = 0, lookup_before, now;
     int i;
 
+    exec_start = exec_clock();
+
     memset(&execi, 0, sizeof(execi));
     lock_fproc(mm_task);
 
@@ -305,9 +377,13 @@ int fs_exec(void)
     execi.args.proc_e = src;
     execi.args.filesize = execi.pin->i_size;
 
+    load_start = exec_clock();
+    lookup_before = execi.lookup_ns + execi.header_ns;
+
     char interp[PATH_MAX + 1];
-    if (elf_is_dynamic(execi.args.header, execi.args.header_len, interp,
-                       PATH_MAX) > 0) {
+    if (execi.cache->is_dyn) {
+        strlcpy(interp, execi.cache->interp, sizeof(interp));
+
         unlock_inode(execi.pin);
         execi.exec_fd = common_openat(AT_FDCWD, pathname, O_RDONLY, 0);
         lock_inode(execi.pin, RWL_READ);
@@ -323,6 +399,10 @@ int fs_exec(void)
         }
         if (retval) goto exec_finalize;
 
+        /* map the executable before the interpreter goes in */
+        retval = flush_vfs_mmap(&execi);
+        if (retval) goto exec_finalize;
+
         execi.is_dyn = 1;
         execi.dyn_entry = execi.args.entry_point;
         execi.dyn_phdr = execi.args.phdr;
@@ -348,7 +428,13 @@ int fs_exec(void)
 
     for (i = 0; exec_loaders[i].loader != NULL; i++) {
         retval = (*exec_loaders[i].loader)(&execi.args);
+        if (!retval) retval = flush_vfs_mmap(&execi);
         if (!retval) {
+            stack_start = exec_clock();
+            exec_stat.load_ns += stack_start - load_start -
+                                 (execi.lookup_ns + execi.header_ns -
+                                  lookup_before);
+
             if (exec_loaders[i].setup_stack)
                 retval = (*exec_loaders[i].setup_stack)(
                     &execi, stackcopy, stackcopy + sizeof(stackcopy),
@@ -397,6 +483,13 @@ int fs_exec(void)
     resp->new_uid = execi.args.new_uid;
     resp->new_gid = execi.args.new_gid;
 
+    exec_stat.execs++;
+    exec_stat.lookup_ns += execi.lookup_ns;
+    exec_stat.header_ns += execi.header_ns;
+    now = exec_clock();
+    exec_stat.stack_ns += now - stack_start;
+    exec_stat.total_ns += now - exec_start;
+
 exec_finalize:
     if (filp) {
         unlock_filp(filp);
@@ -410,6 +503,9 @@ exec_finalize:
     unlock_fproc(mm_task);
 
     if (!retval) {
+        /* the rings go away with the old address space */
+        vfs_ring_exit(fproc);
+
         return kernel_exec(src, orig_stack, pathname,
                            (void*)execi.args.entry_point, &ps);
     }
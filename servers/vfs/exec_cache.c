@@ -0,0 +1,137 @@
+/*  This file is part of Lyos.
+
+    Lyos is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Lyos is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Lyos.  If not, see <http://www.gnu.org/licenses/>. */
+
+#include <lyos/types.h>
+#include <lyos/ipc.h>
+#include <sys/types.h>
+#include <lyos/const.h>
+#include <lyos/sysutils.h>
+#include <string.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <sys/syslimits.h>
+#include <lyos/fs.h>
+#include <asm/page.h>
+#include <libexec/libexec.h>
+
+#include "types.h"
+#include "proto.h"
+#include "global.h"
+
+/* Executables we have seen recently, keyed by (dev, ino, mtime, size). Job
+ * runners exec the same few binaries over and over, so keeping the header page
+ * and the interpreter path saves a read from the file system on every exec. */
+#define EXEC_CACHE_SIZE 16
+
+static struct exec_cache_entry exec_cache[EXEC_CACHE_SIZE];
+static unsigned int exec_cache_clock;
+
+struct vfs_exec_stat exec_stat;
+
+static int match_entry(struct exec_cache_entry* entry, struct inode* pin,
+                       time_t mtime, off_t size)
+{
+    return entry->valid && entry->dev == pin->i_dev &&
+           entry->ino == pin->i_num && entry->mtime == mtime &&
+           entry->size == size;
+}
+
+static struct exec_cache_entry* find_victim(void)
+{
+    struct exec_cache_entry *entry, *victim = NULL;
+
+    for (entry = exec_cache; entry < &exec_cache[EXEC_CACHE_SIZE]; entry++) {
+        if (!entry->valid) return entry;
+        if (!victim || entry->last_used < victim->last_used) victim = entry;
+    }
+
+    return victim;
+}
+
+static int fill_entry(struct exec_cache_entry* entry, struct inode* pin,
+                      time_t mtime, off_t size)
+{
+    char interp[PATH_MAX + 1];
+    loff_t newpos;
+    size_t bytes_rdwt;
+    int retval;
+
+    entry->valid = FALSE;
+    if (entry->interp) {
+        free(entry->interp);
+        entry->interp = NULL;
+    }
+
+    if (!entry->header && !(entry->header = malloc(ARCH_PG_SIZE)))
+        return ENOMEM;
+
+    entry->header_len = min(ARCH_PG_SIZE, pin->i_size);
+    retval = request_readwrite(pin->i_fs_ep, pin->i_dev, pin->i_num, 0, READ,
+                               TASK_FS, entry->header, entry->header_len,
+                               &newpos, &bytes_rdwt);
+    if (retval) return retval;
+
+    entry->is_dyn = elf_is_dynamic(entry->header, entry->header_len, interp,
+                                   PATH_MAX) > 0;
+    if (entry->is_dyn && !(entry->interp = strdup(interp))) return ENOMEM;
+
+    entry->dev = pin->i_dev;
+    entry->ino = pin->i_num;
+    entry->mtime = mtime;
+    entry->size = size;
+    entry->valid = TRUE;
+
+    return 0;
+}
+
+/* Get the cache entry of an executable, reading its header on a miss. The
+ * entry stays usable until the next call as execs are serialized on the MM
+ * fproc lock. */
+int exec_cache_get(struct inode* pin, time_t mtime, off_t size,
+                   struct exec_cache_entry** entryp)
+{
+    struct exec_cache_entry* entry;
+    int retval;
+
+    for (entry = exec_cache; entry < &exec_cache[EXEC_CACHE_SIZE]; entry++) {
+        if (match_entry(entry, pin, mtime, size)) {
+            exec_stat.cache_hits++;
+            goto found;
+        }
+    }
+
+    exec_stat.cache_misses++;
+
+    entry = find_victim();
+    if ((retval = fill_entry(entry, pin, mtime, size)) != 0) return retval;
+
+found:
+    entry->last_used = ++exec_cache_clock;
+    *entryp = entry;
+    return 0;
+}
+
+/* The file has been written to. The mtime may not have moved if that happened
+ * within the same second so drop the entry now. */
+void exec_cache_invalidate(struct inode* pin)
+{
+    struct exec_cache_entry* entry;
+
+    for (entry = exec_cache; entry < &exec_cache[EXEC_CACHE_SIZE]; entry++) {
+        if (entry->valid && entry->dev == pin->i_dev &&
+            entry->ino == pin->i_num)
+            entry->valid = FALSE;
+    }
+}
@@ -35,6 +35,10 @@ static ssize_t vfs_read(struct file_desc* filp, char* buf, size_t count,
     int retval;
     struct inode* pin = filp->fd_inode;
 
+    /* MM reads for its own page cache */
+    if (fp->endpoint != TASK_MM && page_cache_usable(pin))
+        return page_cache_read(pin, fp->endpoint, buf, count, ppos);
+
     retval = request_readwrite(pin->i_fs_ep, pin->i_dev, pin->i_num, *ppos,
                                READ /* rw_flag */, fp->endpoint, buf, count,
                                ppos, &bytes);
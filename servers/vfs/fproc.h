@@ -18,6 +18,7 @@
 
 #include <sys/types.h>
 #include <sys/syslimits.h>
+#include <lyos/sysutils.h>
 
 EXTERN struct fproc {
     int flags;
@@ -43,6 +44,8 @@ EXTERN struct fproc {
 
     struct wait_queue_head signalfd_wq;
 
+    struct vfs_proc_io io; /* read/write accounting for procfs */
+
     MESSAGE msg;
     void (*func)(void);
     struct worker_thread* worker;
@@ -23,6 +23,7 @@
 #endif
 
 #include <lyos/param.h>
+#include <lyos/sysutils.h>
 
 #include "const.h"
 #include "fproc.h"
@@ -59,6 +60,8 @@ EXTERN struct sysinfo* sysinfo;
 
 extern struct cdmap cdmap[];
 
+extern struct vfs_exec_stat exec_stat;
+
 extern const struct file_operations vfs_fops;
 extern const struct file_operations cdev_fops;
 
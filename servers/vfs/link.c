@@ -25,6 +25,7 @@
 #include <lyos/sysutils.h>
 #include <sys/stat.h>
 #include <fcntl.h>
+#include <limits.h>
 #include <sys/syslimits.h>
 #include <lyos/mgrant.h>
 
@@ -154,6 +155,9 @@ static int common_unlink(int dirfd, char* pathname, int flags)
         retval = request_unlink(pin_dir->i_fs_ep, pin_dir->i_dev,
                                 pin_dir->i_num, pathname);
 
+    /* the inode number may be reused once the file is gone */
+    if (!retval && S_ISREG(pin->i_mode)) page_cache_disable(pin);
+
     fsnotify_unlink(pin_dir, pin, pathname);
 
 out_put_pin:
@@ -311,6 +315,8 @@ int truncate_node(struct inode* pin, int newsize)
         request_ftrunc(pin->i_fs_ep, pin->i_dev, pin->i_num, newsize, 0);
     if (retval == 0) {
         pin->i_size = newsize;
+        exec_cache_invalidate(pin);
+        page_cache_invalidate(pin, newsize, ULLONG_MAX);
     }
 
     return retval;
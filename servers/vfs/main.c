@@ -343,12 +343,24 @@ static void do_work(void)
     case VFS_COPYFD:
         self->msg_out.RETVAL = do_copyfd();
         break;
+    case VFS_GETINFO:
+        self->msg_out.RETVAL = do_vfs_getinfo();
+        break;
     case INOTIFY_INIT1:
         self->msg_out.FD = do_inotify_init1();
         break;
     case INOTIFY_ADD_WATCH:
         self->msg_out.RETVAL = do_inotify_add_watch();
         break;
+    case RING_SETUP:
+        self->msg_out.RETVAL = do_ring_setup();
+        break;
+    case RING_ENTER:
+        self->msg_out.RETVAL = do_ring_enter();
+        break;
+    case RING_REGISTER:
+        self->msg_out.RETVAL = do_ring_register();
+        break;
     default:
         self->msg_out.RETVAL = ENOSYS;
         break;
@@ -20,6 +20,7 @@
 #include <lyos/sysutils.h>
 #include "lyos/fs.h"
 #include "errno.h"
+#include <string.h>
 #include <fcntl.h>
 #include <sys/syslimits.h>
 #include <sys/stat.h>
@@ -253,6 +254,28 @@ static int change_node(struct fproc* fp, struct inode** ppin, struct inode* pin)
     return retval;
 }
 
+static int request_map(endpoint_t fs_ep, dev_t dev, ino_t num,
+                       endpoint_t endpoint, void* vaddr, loff_t offset,
+                       size_t len, void** retaddr)
+{
+    MESSAGE m;
+
+    memset(&m, 0, sizeof(m));
+    m.type = FS_MAP;
+    m.u.m_vfs_fs_map.dev = dev;
+    m.u.m_vfs_fs_map.num = num;
+    m.u.m_vfs_fs_map.endpoint = endpoint;
+    m.u.m_vfs_fs_map.offset = offset;
+    m.u.m_vfs_fs_map.length = len;
+    m.u.m_vfs_fs_map.vaddr = vaddr;
+
+    fs_sendrec(fs_ep, &m);
+
+    if (m.u.m_vfs_fs_map.status == 0) *retaddr = m.u.m_vfs_fs_map.vaddr;
+
+    return m.u.m_vfs_fs_map.status;
+}
+
 int do_mm_request(void)
 {
     int req_type = self->msg_in.MMRTYPE;
@@ -277,12 +300,19 @@ int do_mm_request(void)
         }
 
         struct file_desc* filp = get_filp(fp, fd, RWL_WRITE);
+        int access = self->msg_in.MMRACCESS;
 
         if (!filp || !filp->fd_inode) {
             result = EBADF;
             goto reply;
         }
 
+        if ((filp->fd_mode & access) != access) {
+            unlock_filp(filp);
+            result = EACCES;
+            goto reply;
+        }
+
         int mmfd;
         result = get_fd(mm_task, 0, 0, &mmfd, NULL);
         if (result) {
@@ -356,6 +386,23 @@ int do_mm_request(void)
                 goto reply;
             }
 
+            self->msg_out.MMRBUF = retaddr;
+        } else if (S_ISREG(pin->i_mode)) {
+            /* MM maps the file through its page cache if the FS can't share
+             * its pages */
+            self->msg_out.MMRDEV = pin->i_dev;
+            self->msg_out.MMRINO = pin->i_num;
+
+            result = request_map(pin->i_fs_ep, pin->i_dev, pin->i_num, ep,
+                                 vaddr, offset, len, &retaddr);
+            if (result) {
+                unlock_filp(filp);
+                goto reply;
+            }
+
+            /* stores through the mapping bypass us */
+            page_cache_disable(pin);
+
             self->msg_out.MMRBUF = retaddr;
         } else { /* error if MM is trying to map a non-device file */
             unlock_filp(filp);
@@ -420,6 +467,7 @@ int fs_fork(void)
     }
 
     init_waitqueue_head(&child->signalfd_wq);
+    memset(&child->io, 0, sizeof(child->io));
 
     child->pid = self->msg_in.PID;
     child->endpoint = self->msg_in.ENDPOINT;
@@ -439,6 +487,7 @@ int fs_exit()
 
     p->flags &= ~FPF_INUSE;
 
+    vfs_ring_exit(p);
     exit_files(p);
 
     if (p->pwd) {
@@ -453,6 +502,33 @@ int fs_exit()
     return 0;
 }
 
+int do_vfs_getinfo(void)
+{
+    struct fproc* fp = vfs_endpt_proc(self->msg_in.ENDPOINT);
+    void* src_addr;
+    size_t len;
+
+    switch (self->msg_in.REQUEST) {
+    case VFS_INFO_PROCIO:
+        if (!fp || !(fp->flags & FPF_INUSE)) return ESRCH;
+
+        src_addr = &fp->io;
+        len = sizeof(fp->io);
+        break;
+    case VFS_INFO_EXECSTAT:
+        src_addr = &exec_stat;
+        len = sizeof(exec_stat);
+        break;
+    default:
+        return EINVAL;
+    }
+
+    if (self->msg_in.BUF_LEN < len) return EINVAL;
+
+    return data_copy(self->msg_in.source, self->msg_in.BUF, SELF, src_addr,
+                     len);
+}
+
 int request_sync(endpoint_t fs_ep)
 {
     MESSAGE m;
@@ -236,6 +236,14 @@ int mount_fs(dev_t dev, char* mountpoint, endpoint_t fs_ep, int readonly,
         return retval;
     }
 
+    /* pages cached for the device belong to an earlier file system on it */
+    page_cache_invalidate_dev(dev);
+
+    if (res.flags & RF_PAGECACHE)
+        new_pvm->m_flags |= VMNT_PAGECACHE;
+    else
+        new_pvm->m_flags &= ~VMNT_PAGECACHE;
+
     struct inode* root_inode = new_inode(dev, res.inode_nr, res.mode);
 
     if (!root_inode) {
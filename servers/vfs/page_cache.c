@@ -0,0 +1,169 @@
+/*  This file is part of Lyos.
+
+    Lyos is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Lyos is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Lyos.  If not, see <http://www.gnu.org/licenses/>. */
+
+#include <lyos/types.h>
+#include <lyos/ipc.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <lyos/const.h>
+#include <lyos/sysutils.h>
+#include <lyos/vm.h>
+#include <string.h>
+#include <stdlib.h>
+#include <limits.h>
+#include <errno.h>
+#include <lyos/fs.h>
+#include <asm/page.h>
+
+#include "const.h"
+#include "types.h"
+#include "proto.h"
+#include "global.h"
+
+/* Regular file data lives in the MM page cache, which also backs private
+ * file mappings. Reads copy from there straight into the caller and only go
+ * to the FS server for the pages that are missing, which are then added to
+ * the cache. Any change to the file drops the pages it covers. */
+
+/* Pages read from the FS on a single miss. */
+#define FILL_MAX (16 * ARCH_PG_SIZE)
+
+int page_cache_usable(struct inode* pin)
+{
+    return S_ISREG(pin->i_mode) && !pin->i_nocache && pin->i_vmnt &&
+           (pin->i_vmnt->m_flags & VMNT_PAGECACHE);
+}
+
+/* Read whole pages around pos from the FS, cache them and copy what the
+ * caller asked for. */
+static int fill_and_copy(struct inode* pin, endpoint_t endpoint, char* buf,
+                         size_t count, loff_t pos, size_t* copied)
+{
+    loff_t start = rounddown(pos, ARCH_PG_SIZE);
+    size_t len, bytes, chunk;
+    unsigned int gen;
+    int retval;
+
+    *copied = 0;
+
+    if (!self->fill_buf && !(self->fill_buf = malloc(FILL_MAX))) {
+        /* no room to cache anything, read straight into the caller */
+        return request_readwrite(pin->i_fs_ep, pin->i_dev, pin->i_num, pos,
+                                 READ, endpoint, buf, count, NULL, copied);
+    }
+
+    len = roundup(min(pos + count, (loff_t)pin->i_size), ARCH_PG_SIZE) - start;
+    len = min(len, FILL_MAX);
+
+    /* the FS copies nothing out for holes, they must not show what this
+     * worker read last; this also zero-fills the last page past the end */
+    memset(self->fill_buf, 0, len);
+
+    gen = pin->i_cache_gen;
+    if ((retval = request_readwrite(pin->i_fs_ep, pin->i_dev, pin->i_num, start,
+                                    READ, SELF, self->fill_buf, len, NULL,
+                                    &bytes)) != OK)
+        return retval;
+
+    if (bytes <= pos - start) return 0;
+
+    /* skip the fill if the file changed while we were reading it */
+    len = roundup(bytes, ARCH_PG_SIZE);
+    if (gen == pin->i_cache_gen)
+        mm_page_cache_fill(pin->i_dev, pin->i_num, start, self->fill_buf, len);
+
+    chunk = min(bytes - (size_t)(pos - start), count);
+    if ((retval = data_copy(endpoint, buf, SELF, self->fill_buf + (pos - start),
+                            chunk)) != OK)
+        return retval;
+
+    *copied = chunk;
+    return 0;
+}
+
+/**
+ * <Ring 1> Read from a regular file through the page cache.
+ * @param  pin      The file.
+ * @param  endpoint Who wants the data.
+ * @param  buf      Buffer in endpoint.
+ * @param  count    How many bytes to read.
+ * @param  ppos     [IN/OUT] File position.
+ * @return          The number of bytes read or a negative error code.
+ */
+ssize_t page_cache_read(struct inode* pin, endpoint_t endpoint, char* buf,
+                        size_t count, loff_t* ppos)
+{
+    loff_t pos = *ppos;
+    size_t done = 0, copied;
+    int retval = 0;
+
+    if (pos >= pin->i_size) return 0;
+    count = min(count, pin->i_size - pos);
+
+    while (done < count) {
+        /* anything MM can't copy for us is read from the FS below; MM copies
+         * a bounded number of pages per call, so ask again after a hit */
+        if (mm_page_cache_read(pin->i_dev, pin->i_num, pos, pin->i_size,
+                               endpoint, buf + done, count - done,
+                               &copied) == OK &&
+            copied) {
+            done += copied;
+            pos += copied;
+            continue;
+        }
+
+        retval =
+            fill_and_copy(pin, endpoint, buf + done, count - done, pos, &copied);
+        if (retval || !copied) break;
+
+        done += copied;
+        pos += copied;
+    }
+
+    *ppos = pos;
+
+    if (done) return done;
+    return -retval;
+}
+
+/**
+ * <Ring 1> Drop the cached pages of a file that overlap [start, end).
+ */
+void page_cache_invalidate(struct inode* pin, loff_t start, loff_t end)
+{
+    if (!S_ISREG(pin->i_mode) || start >= end) return;
+
+    /* fills that raced with the change must not make it into the cache */
+    pin->i_cache_gen++;
+
+    mm_page_cache_drop(pin->i_dev, pin->i_num, rounddown(start, ARCH_PG_SIZE),
+                       end);
+}
+
+/**
+ * <Ring 1> Stop caching a file whose data can change behind our back, e.g.
+ * through a shared mapping of the FS's pages.
+ */
+void page_cache_disable(struct inode* pin)
+{
+    pin->i_nocache = TRUE;
+    page_cache_invalidate(pin, 0, ULLONG_MAX);
+}
+
+/**
+ * <Ring 1> Drop every cached page of a device, whose inode numbers are about
+ * to be reused by another mount.
+ */
+void page_cache_invalidate_dev(dev_t dev) { mm_page_cache_drop_dev(dev); }
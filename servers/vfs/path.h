@@ -38,6 +38,7 @@ struct lookup_result {
     dev_t dev;
     dev_t spec_dev;
     int offsetp;
+    unsigned int flags; /* RF_* flags of a superblock */
 };
 
 #endif
@@ -109,6 +109,13 @@ int request_stat(endpoint_t fs_ep, dev_t dev, ino_t num, endpoint_t src,
 int request_readwrite(endpoint_t fs_ep, dev_t dev, ino_t num, loff_t pos,
                       int rw_flag, endpoint_t src, const void* buf,
                       size_t nbytes, loff_t* newpos, size_t* bytes_rdwt);
+ssize_t read_write(struct fproc* fp, int fd, int rw_flag, char* buf,
+                   size_t len, loff_t* ppos);
+void grant_cache_init(struct grant_cache* cache,
+                      struct grant_cache_entry* entries, int size, int grow);
+int grant_cache_add(struct grant_cache* cache, endpoint_t from,
+                    vir_bytes addr, size_t len);
+void grant_cache_release(struct grant_cache* cache);
 
 int do_stat(void);
 int do_lstat(void);
@@ -130,6 +137,7 @@ int do_sync(void);
 
 int fs_fork(void);
 int fs_exit(void);
+int do_vfs_getinfo(void);
 
 /* vfs/worker.c */
 int rwlock_lock(rwlock_t* rwlock, rwlock_type_t lock_type);
@@ -138,6 +146,7 @@ void worker_yield(void);
 void worker_wait(int why);
 void worker_wake(struct worker_thread* worker);
 void worker_dispatch(struct fproc* fp, void (*func)(void), MESSAGE* msg);
+int worker_dispatch_ring(struct fproc* fp, struct vfs_ring* ring);
 void worker_allow(int allow);
 struct worker_thread* worker_suspend(int why);
 void worker_resume(struct worker_thread* worker);
@@ -267,4 +276,25 @@ void fsnotify_unlink(struct inode* dir, struct inode* child, const char* name);
 int do_inotify_init1(void);
 int do_inotify_add_watch(void);
 
+/* vfs/ring.c */
+int do_ring_setup(void);
+int do_ring_enter(void);
+int do_ring_register(void);
+void vfs_ring_work(struct vfs_ring* ring);
+struct vfs_ring* vfs_ring_next_pending(struct fproc** fpp);
+void vfs_ring_exit(struct fproc* fp);
+
+/* vfs/exec_cache.c */
+int exec_cache_get(struct inode* pin, time_t mtime, off_t size,
+                   struct exec_cache_entry** entryp);
+void exec_cache_invalidate(struct inode* pin);
+
+/* vfs/page_cache.c */
+int page_cache_usable(struct inode* pin);
+ssize_t page_cache_read(struct inode* pin, endpoint_t endpoint, char* buf,
+                        size_t count, loff_t* ppos);
+void page_cache_invalidate(struct inode* pin, loff_t start, loff_t end);
+void page_cache_disable(struct inode* pin);
+void page_cache_invalidate_dev(dev_t dev);
+
 #endif
@@ -26,6 +26,86 @@
 #include "proto.h"
 #include "global.h"
 
+void grant_cache_init(struct grant_cache* cache,
+                      struct grant_cache_entry* entries, int size, int grow)
+{
+    cache->entries = entries;
+    cache->nr = 0;
+    cache->size = size;
+    cache->grow = grow;
+}
+
+/**
+ * <Ring 1> Add a buffer to the cache. Its grant is set up on first use.
+ */
+int grant_cache_add(struct grant_cache* cache, endpoint_t from,
+                    vir_bytes addr, size_t len)
+{
+    struct grant_cache_entry* entry;
+
+    if (cache->nr >= cache->size) return ENOSPC;
+
+    entry = &cache->entries[cache->nr++];
+    entry->from = from;
+    entry->addr = addr;
+    entry->len = len;
+    entry->to = NO_TASK;
+    entry->grant = GRANT_INVALID;
+
+    return 0;
+}
+
+/**
+ * <Ring 1> Revoke all grants and forget all buffers in the cache.
+ */
+void grant_cache_release(struct grant_cache* cache)
+{
+    int i;
+
+    for (i = 0; i < cache->nr; i++) {
+        if (cache->entries[i].grant != GRANT_INVALID)
+            mgrant_revoke(cache->entries[i].grant);
+    }
+
+    cache->nr = 0;
+}
+
+/* Get a grant to the buffer at addr for driver to, which covers at least
+ * len bytes. Only grants that start at addr can be reused because FS_RDWT
+ * has no offset into the grant. */
+static mgrant_id_t grant_cache_get(struct grant_cache* cache, endpoint_t to,
+                                   endpoint_t from, vir_bytes addr,
+                                   size_t len)
+{
+    struct grant_cache_entry* entry;
+    int i;
+
+    for (i = 0; i < cache->nr; i++) {
+        entry = &cache->entries[i];
+        if (entry->from == from && entry->addr == addr && entry->len >= len)
+            break;
+    }
+
+    if (i == cache->nr) {
+        if (!cache->grow || grant_cache_add(cache, from, addr, len) != OK)
+            return GRANT_INVALID;
+        entry = &cache->entries[i];
+    }
+
+    if (entry->grant != GRANT_INVALID && entry->to != to) {
+        mgrant_revoke(entry->grant);
+        entry->grant = GRANT_INVALID;
+    }
+
+    if (entry->grant == GRANT_INVALID) {
+        entry->grant =
+            mgrant_set_proxy(to, from, entry->addr, entry->len, MGF_ACCMODES);
+        entry->to = to;
+    }
+
+    return entry->grant;
+}
+
 /**
  * <Ring 1> Send read/write request.
  * @param  fs_ep      Endpoint of FS driver.
@@ -45,13 +125,22 @@ int request_readwrite(endpoint_t fs_ep, dev_t dev, ino_t num, loff_t pos,
                       size_t nbytes, loff_t* newpos, size_t* bytes_rdwt)
 {
     MESSAGE m;
-    mgrant_id_t grant;
+    mgrant_id_t grant = GRANT_INVALID;
+    int cached = FALSE;
     int retval;
 
-    grant = mgrant_set_proxy(fs_ep, src, (vir_bytes)buf, nbytes,
-                             (rw_flag == READ) ? MGF_WRITE : MGF_READ);
-    if (grant == GRANT_INVALID)
-        panic("vfs: request_getdents failed to create proxy grant");
+    if (self->grant_cache) {
+        grant = grant_cache_get(self->grant_cache, fs_ep, src, (vir_bytes)buf,
+                                nbytes);
+        cached = grant != GRANT_INVALID;
+    }
+
+    if (!cached) {
+        grant = mgrant_set_proxy(fs_ep, src, (vir_bytes)buf, nbytes,
+                                 (rw_flag == READ) ? MGF_WRITE : MGF_READ);
+        if (grant == GRANT_INVALID)
+            panic("vfs: request_readwrite failed to create proxy grant");
+    }
 
     m.type = FS_RDWT;
     m.u.m_vfs_fs_readwrite.dev = dev;
@@ -64,7 +153,7 @@ int request_readwrite(endpoint_t fs_ep, dev_t dev, ino_t num, loff_t pos,
     fs_sendrec(fs_ep, &m);
     retval = m.u.m_vfs_fs_readwrite.status;
 
-    mgrant_revoke(grant);
+    if (!cached) mgrant_revoke(grant);
 
     if (retval == 0) {
         if (newpos) *newpos = m.u.m_vfs_fs_readwrite.position;
@@ -75,25 +164,27 @@ int request_readwrite(endpoint_t fs_ep, dev_t dev, ino_t num, loff_t pos,
 }
 
 /**
- * <Ring 1> Perform read/wrte syscall.
- * @param  p Ptr to message.
- * @return   On success, the number of bytes read is returned. Otherwise a
- *           negative error code is returned.
+ * <Ring 1> Read from or write to a file of fp.
+ * @param  fd      The file descriptor.
+ * @param  rw_flag Read or write.
+ * @param  buf     Buffer in fp.
+ * @param  len     How many bytes to read/write.
+ * @param  ppos    Where to start, or NULL to use and advance the file
+ *                 position.
+ * @return         On success, the number of bytes read/written. Otherwise a
+ *                 negative error code.
  */
-int do_rdwt(void)
+ssize_t read_write(struct fproc* fp, int fd, int rw_flag, char* buf,
+                   size_t len, loff_t* ppos)
 {
-    int fd = self->msg_in.FD;
-    int rw_flag = self->msg_in.type;
     rwlock_type_t lock_type = (rw_flag == WRITE) ? RWL_WRITE : RWL_READ;
-    struct file_desc* filp = get_filp(fproc, fd, lock_type);
-    char* buf = self->msg_in.BUF;
-    int len = self->msg_in.CNT;
+    struct file_desc* filp = get_filp(fp, fd, lock_type);
 
     ssize_t retval = 0;
 
     if (!filp) return -EBADF;
 
-    loff_t position = filp->fd_pos;
+    loff_t position = ppos ? *ppos : filp->fd_pos;
     struct inode* pin = filp->fd_inode;
 
     if (pin == NULL) {
@@ -110,11 +201,11 @@ int do_rdwt(void)
 
         if (rw_flag == READ) {
             if (filp->fd_fops->read) {
-                retval = filp->fd_fops->read(filp, buf, len, &position, fproc);
+                retval = filp->fd_fops->read(filp, buf, len, &position, fp);
             }
         } else {
             if (filp->fd_fops->write) {
-                retval = filp->fd_fops->write(filp, buf, len, &position, fproc);
+                retval = filp->fd_fops->write(filp, buf, len, &position, fp);
             }
         }
 
@@ -122,18 +213,41 @@ int do_rdwt(void)
             goto err;
         }
 
-        if (rw_flag == WRITE) {
+        if (rw_flag == READ) {
+            fp->io.rchar += retval;
+            fp->io.syscr++;
+        } else {
+            fp->io.wchar += retval;
+            fp->io.syscw++;
             if (position > pin->i_size) pin->i_size = position;
+            if (S_ISREG(pin->i_mode)) {
+                exec_cache_invalidate(pin);
+                page_cache_invalidate(pin, position - retval, position);
+            }
         }
     }
 
-    filp->fd_pos = position;
+    if (ppos)
+        *ppos = position;
+    else
+        filp->fd_pos = position;
 
 err:
     unlock_filp(filp);
     return retval;
 }
 
+/**
+ * <Ring 1> Perform read/wrte syscall.
+ * @return   On success, the number of bytes read is returned. Otherwise a
+ *           negative error code is returned.
+ */
+int do_rdwt(void)
+{
+    return read_write(fproc, self->msg_in.FD, self->msg_in.type,
+                      self->msg_in.BUF, self->msg_in.CNT, NULL);
+}
+
 static int request_getdents(endpoint_t fs_ep, dev_t dev, ino_t num,
                             u64 position, endpoint_t src, void* buf,
                             size_t nbytes, u64* newpos)
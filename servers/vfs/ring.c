@@ -0,0 +1,596 @@
+/*  This file is part of Lyos.
+
+    Lyos is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Lyos is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Lyos.  If not, see <http://www.gnu.org/licenses/>. */
+
+#include <lyos/types.h>
+#include <lyos/ipc.h>
+#include <sys/types.h>
+#include <stddef.h>
+#include <lyos/const.h>
+#include <lyos/sysutils.h>
+#include <string.h>
+#include <errno.h>
+#include <sys/mman.h>
+#include <sys/uio.h>
+#include <lyos/fs.h>
+#include <lyos/timer.h>
+#include <lyos/mgrant.h>
+#include <lyos/vfs_ring.h>
+#include <asm/page.h>
+
+#include "types.h"
+#include "proto.h"
+#include "global.h"
+
+#define RING_INUSE   0x01
+#define RING_RUNNING 0x02 /* a worker is serving the ring */
+#define RING_PENDING 0x04 /* waiting for a free worker */
+#define RING_DYING   0x08 /* free when the worker is done */
+
+/* Grants kept for the buffers of one request chain. */
+#define RING_CHAIN_GRANTS 4
+
+struct vfs_ring {
+    int flags;
+    int setup_flags;
+    endpoint_t owner;
+
+    /* VFS's view of the shared area */
+    struct vfs_ring_hdr* hdr;
+    struct vfs_ring_sqe* sqes;
+    struct vfs_ring_cqe* cqes;
+    unsigned int sq_entries;
+    unsigned int cq_entries;
+    size_t size;
+    void* user_addr;
+
+    clock_t sq_idle;
+    struct worker_thread* worker;
+
+    /* process blocked in vfs_ring_enter() until wait_nr completions */
+    endpoint_t waiter;
+    unsigned int wait_nr;
+
+    struct grant_cache fixed_bufs;
+    struct grant_cache_entry fixed_entries[VRING_MAX_FIXED_BUFS];
+};
+
+static struct vfs_ring vfs_rings[NR_VFS_RINGS];
+
+static struct vfs_ring* ring_get(int id, struct fproc* fp)
+{
+    struct vfs_ring* ring;
+
+    if (id < 0 || id >= NR_VFS_RINGS) return NULL;
+
+    ring = &vfs_rings[id];
+    if (!(ring->flags & RING_INUSE) || (ring->flags & RING_DYING) ||
+        ring->owner != fp->endpoint)
+        return NULL;
+
+    return ring;
+}
+
+/* Number of submissions VFS has not consumed yet. A process that corrupts
+ * the indices only stalls its own ring. */
+static unsigned int ring_sq_pending(struct vfs_ring* ring)
+{
+    unsigned int pending = ring->hdr->sq_tail - ring->hdr->sq_head;
+
+    return (pending <= ring->sq_entries) ? pending : 0;
+}
+
+static unsigned int ring_cq_ready(struct vfs_ring* ring)
+{
+    unsigned int ready = ring->hdr->cq_tail - ring->hdr->cq_head;
+
+    return (ready <= ring->cq_entries) ? ready : ring->cq_entries;
+}
+
+static void ring_reply(endpoint_t endpoint, int result)
+{
+    MESSAGE msg;
+
+    memset(&msg, 0, sizeof(msg));
+    msg.type = SYSCALL_RET;
+    msg.RETVAL = result;
+
+    revive_proc(endpoint, &msg);
+}
+
+/* Release the waiter once enough completions are there, or unconditionally
+ * if the ring has stopped and no more are coming. */
+static void ring_wake_waiter(struct vfs_ring* ring, int stopped)
+{
+    unsigned int ready;
+
+    if (ring->waiter == NO_TASK) return;
+
+    ready = ring_cq_ready(ring);
+    if (ready < ring->wait_nr && !stopped) return;
+
+    ring_reply(ring->waiter, ready);
+    ring->waiter = NO_TASK;
+}
+
+static void ring_post_cqe(struct vfs_ring* ring, u64 user_data, int res)
+{
+    struct vfs_ring_hdr* hdr = ring->hdr;
+    struct vfs_ring_cqe* cqe;
+    unsigned int tail = hdr->cq_tail;
+
+    if (tail - hdr->cq_head >= ring->cq_entries) {
+        hdr->cq_overflow++;
+        return;
+    }
+
+    cqe = &ring->cqes[tail & (ring->cq_entries - 1)];
+    cqe->user_data = user_data;
+    cqe->res = res;
+    cqe->flags = 0;
+
+    /* publish the entry before the new tail */
+    __sync_synchronize();
+    hdr->cq_tail = tail + 1;
+
+    ring_wake_waiter(ring, FALSE);
+}
+
+static void ring_free(struct vfs_ring* ring)
+{
+    grant_cache_release(&ring->fixed_bufs);
+
+    munmap(ring->hdr, ring->size);
+
+    ring->hdr = NULL;
+    ring->waiter = NO_TASK;
+    ring->flags = 0;
+}
+
+static ssize_t ring_rdwt(struct fproc* fp, const struct vfs_ring_sqe* sqe,
+                         int rw_flag, struct grant_cache* grants)
+{
+    loff_t pos = sqe->off;
+    ssize_t retval;
+
+    self->grant_cache = grants;
+    retval = read_write(fp, sqe->fd, rw_flag, (char*)(vir_bytes)sqe->addr,
+                        sqe->len, sqe->off == VRING_OFF_CURRENT ? NULL : &pos);
+    self->grant_cache = NULL;
+
+    return retval;
+}
+
+static ssize_t ring_rdwt_fixed(struct vfs_ring* ring, struct fproc* fp,
+                               const struct vfs_ring_sqe* sqe, int rw_flag)
+{
+    struct grant_cache_entry* buf;
+
+    if (sqe->buf_index >= ring->fixed_bufs.nr) return -EINVAL;
+    buf = &ring->fixed_bufs.entries[sqe->buf_index];
+
+    if (sqe->addr < buf->addr || sqe->addr - buf->addr > buf->len ||
+        sqe->len > buf->len - (sqe->addr - buf->addr))
+        return -EFAULT;
+
+    return ring_rdwt(fp, sqe, rw_flag, &ring->fixed_bufs);
+}
+
+/* The remaining operations go through the regular syscall handlers with a
+ * message made up from the entry. */
+static int ring_pathat(struct fproc* fp, const struct vfs_ring_sqe* sqe,
+                       int type)
+{
+    memset(&self->msg_in, 0, sizeof(self->msg_in));
+    self->msg_in.type = type;
+    self->msg_in.source = fp->endpoint;
+    self->msg_in.u.m_vfs_pathat.dirfd = sqe->fd;
+    self->msg_in.u.m_vfs_pathat.pathname = (void*)(vir_bytes)sqe->addr;
+    self->msg_in.u.m_vfs_pathat.name_len = sqe->len;
+    self->msg_in.u.m_vfs_pathat.flags = sqe->op_flags;
+    self->msg_in.u.m_vfs_pathat.mode = (mode_t)sqe->off;
+    self->msg_in.u.m_vfs_pathat.buf = (void*)(vir_bytes)sqe->addr2;
+
+    if (type == OPENAT) return do_openat();
+    return -do_fstatat();
+}
+
+static int ring_fstat(struct fproc* fp, const struct vfs_ring_sqe* sqe)
+{
+    memset(&self->msg_in, 0, sizeof(self->msg_in));
+    self->msg_in.type = FSTAT;
+    self->msg_in.source = fp->endpoint;
+    self->msg_in.FD = sqe->fd;
+    self->msg_in.BUF = (void*)(vir_bytes)sqe->addr2;
+
+    return -do_fstat();
+}
+
+static int ring_do_op(struct vfs_ring* ring, struct fproc* fp,
+                      const struct vfs_ring_sqe* sqe,
+                      struct grant_cache* chain_grants)
+{
+    switch (sqe->opcode) {
+    case VRING_OP_NOP:
+        return 0;
+    case VRING_OP_READ:
+        return ring_rdwt(fp, sqe, READ, chain_grants);
+    case VRING_OP_WRITE:
+        return ring_rdwt(fp, sqe, WRITE, chain_grants);
+    case VRING_OP_READ_FIXED:
+        return ring_rdwt_fixed(ring, fp, sqe, READ);
+    case VRING_OP_WRITE_FIXED:
+        return ring_rdwt_fixed(ring, fp, sqe, WRITE);
+    case VRING_OP_OPENAT:
+        return ring_pathat(fp, sqe, OPENAT);
+    case VRING_OP_CLOSE:
+        return -close_fd(fp, sqe->fd, TRUE);
+    case VRING_OP_FSTAT:
+        return ring_fstat(fp, sqe);
+    case VRING_OP_FSTATAT:
+        return ring_pathat(fp, sqe, FSTATAT);
+    }
+
+    return -EINVAL;
+}
+
+/* Consume one request and everything linked to it. The process is locked
+ * once for the whole chain, and buffers passed to more than one request of
+ * the chain are granted to the FS only once. */
+static void ring_submit_chain(struct vfs_ring* ring, struct fproc* fp)
+{
+    struct grant_cache chain_grants;
+    struct grant_cache_entry entries[RING_CHAIN_GRANTS];
+    struct worker_thread* owner_worker;
+    struct vfs_ring_sqe sqe;
+    struct vfs_ring_hdr* hdr;
+    int failed = FALSE, link, res;
+
+    grant_cache_init(&chain_grants, entries, RING_CHAIN_GRANTS, TRUE);
+
+    lock_fproc(fp);
+
+    /* driver replies are routed through fp->worker */
+    owner_worker = fp->worker;
+    fp->worker = self;
+
+    do {
+        if ((ring->flags & RING_DYING) || !ring_sq_pending(ring)) break;
+
+        hdr = ring->hdr;
+        sqe = ring->sqes[hdr->sq_head & (ring->sq_entries - 1)];
+        __sync_synchronize();
+        hdr->sq_head++;
+
+        link = sqe.flags & VRSQE_LINK;
+
+        if (failed)
+            res = -ECANCELED;
+        else
+            res = ring_do_op(ring, fp, &sqe, &chain_grants);
+
+        if (res < 0) failed = TRUE;
+
+        ring_post_cqe(ring, sqe.user_data, res);
+    } while (link);
+
+    fp->worker = owner_worker;
+    unlock_fproc(fp);
+
+    grant_cache_release(&chain_grants);
+}
+
+static void ring_timeout(struct timer_list* tp)
+{
+    struct worker_thread* worker = tp->arg;
+
+    if (worker->blocked_on == WT_BLOCKED_ON_RING) worker_wake(worker);
+}
+
+/* Wait a tick for new submissions or for vfs_ring_enter() to kick us. */
+static void ring_poll_wait(void)
+{
+    struct timer_list timer;
+
+    init_timer(&timer);
+    set_timer(&timer, 1, ring_timeout, self);
+
+    worker_wait(WT_BLOCKED_ON_RING);
+
+    cancel_timer(&timer);
+}
+
+/**
+ * <Ring 1> Serve a ring until its submission queue runs dry. Called by the
+ * worker that the ring was dispatched to, with fproc set to its owner.
+ */
+void vfs_ring_work(struct vfs_ring* ring)
+{
+    struct fproc* fp = fproc;
+    clock_t idle = 0;
+
+    ring->worker = self;
+    ring->hdr->flags &= ~VRING_SQ_NEED_WAKEUP;
+
+    while (!(ring->flags & RING_DYING)) {
+        if (ring_sq_pending(ring) &&
+            ring_cq_ready(ring) < ring->cq_entries) {
+            ring_submit_chain(ring, fp);
+            idle = 0;
+            continue;
+        }
+
+        if ((ring->setup_flags & VRING_SETUP_SQPOLL) && idle < ring->sq_idle) {
+            ring_poll_wait();
+            idle++;
+            continue;
+        }
+
+        /* tell the process to kick us, then look again in case it queued
+         * more before it saw the flag */
+        ring->hdr->flags |= VRING_SQ_NEED_WAKEUP;
+        __sync_synchronize();
+
+        if (!ring_sq_pending(ring) || ring_cq_ready(ring) >= ring->cq_entries)
+            break;
+
+        ring->hdr->flags &= ~VRING_SQ_NEED_WAKEUP;
+    }
+
+    ring->worker = NULL;
+    ring->flags &= ~RING_RUNNING;
+
+    if (ring->flags & RING_DYING)
+        ring_free(ring);
+    else
+        ring_wake_waiter(ring, TRUE);
+}
+
+/**
+ * <Ring 1> Take a ring that is waiting for a worker.
+ */
+struct vfs_ring* vfs_ring_next_pending(struct fproc** fpp)
+{
+    struct vfs_ring* ring;
+
+    for (ring = vfs_rings; ring < vfs_rings + NR_VFS_RINGS; ring++) {
+        if (!(ring->flags & RING_PENDING)) continue;
+
+        ring->flags &= ~RING_PENDING;
+        ring->flags |= RING_RUNNING;
+
+        *fpp = vfs_endpt_proc(ring->owner);
+        return ring;
+    }
+
+    return NULL;
+}
+
+static void ring_kick(struct vfs_ring* ring)
+{
+    struct worker_thread* worker = ring->worker;
+
+    if (ring->flags & (RING_RUNNING | RING_PENDING)) {
+        if (worker && worker->blocked_on == WT_BLOCKED_ON_RING)
+            worker_wake(worker);
+        return;
+    }
+
+    ring->flags |= RING_RUNNING;
+
+    if (!worker_dispatch_ring(vfs_endpt_proc(ring->owner), ring)) {
+        ring->flags &= ~RING_RUNNING;
+        ring->flags |= RING_PENDING;
+    }
+}
+
+static void ring_destroy(struct vfs_ring* ring)
+{
+    struct worker_thread* worker = ring->worker;
+
+    ring->waiter = NO_TASK;
+
+    if (ring->flags & RING_RUNNING) {
+        /* the worker frees it when it is back */
+        ring->flags |= RING_DYING;
+
+        if (worker && worker->blocked_on == WT_BLOCKED_ON_RING)
+            worker_wake(worker);
+        return;
+    }
+
+    ring_free(ring);
+}
+
+static unsigned int ring_roundup_entries(unsigned int entries)
+{
+    unsigned int n = 1;
+
+    while (n < entries)
+        n <<= 1;
+
+    return n;
+}
+
+/**
+ * <Ring 1> Create a ring for the caller and map it into its address space.
+ * @return The ring id, or a negative error code.
+ */
+int do_ring_setup(void)
+{
+    unsigned int entries = self->msg_in.u.m_vfs_ring.entries;
+    int flags = self->msg_in.u.m_vfs_ring.flags;
+    unsigned int sq_idle = self->msg_in.u.m_vfs_ring.sq_idle;
+    struct vfs_ring* ring;
+    struct vfs_ring_hdr* hdr;
+    size_t sqes_off, cqes_off, size;
+    void *addr, *user_addr;
+
+    if (entries == 0 || entries > VRING_MAX_ENTRIES) return -EINVAL;
+    if (flags & ~VRING_SETUP_SQPOLL) return -EINVAL;
+
+    for (ring = vfs_rings; ring < vfs_rings + NR_VFS_RINGS; ring++) {
+        if (!(ring->flags & RING_INUSE)) break;
+    }
+    if (ring == vfs_rings + NR_VFS_RINGS) return -ENFILE;
+
+    entries = ring_roundup_entries(entries);
+
+    /* the CQ is twice as large so that it is not the bottleneck */
+    sqes_off = roundup(sizeof(struct vfs_ring_hdr), sizeof(u64));
+    cqes_off = sqes_off + entries * sizeof(struct vfs_ring_sqe);
+    size = roundup(cqes_off + 2 * entries * sizeof(struct vfs_ring_cqe),
+                   ARCH_PG_SIZE);
+
+    addr = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANON, -1,
+                0);
+    if (addr == MAP_FAILED) return -ENOMEM;
+    memset(addr, 0, size);
+
+    user_addr = mm_remap(fproc->endpoint, SELF, NULL, addr, size);
+    if (user_addr == MAP_FAILED) {
+        munmap(addr, size);
+        return -ENOMEM;
+    }
+
+    hdr = addr;
+    hdr->sq_entries = entries;
+    hdr->sqes_off = sqes_off;
+    hdr->cq_entries = 2 * entries;
+    hdr->cqes_off = cqes_off;
+    hdr->flags = VRING_SQ_NEED_WAKEUP;
+
+    memset(ring, 0, sizeof(*ring));
+    ring->flags = RING_INUSE;
+    ring->setup_flags = flags;
+    ring->owner = fproc->endpoint;
+    ring->hdr = hdr;
+    ring->sqes = addr + sqes_off;
+    ring->cqes = addr + cqes_off;
+    ring->sq_entries = hdr->sq_entries;
+    ring->cq_entries = hdr->cq_entries;
+    ring->size = size;
+    ring->user_addr = user_addr;
+    ring->sq_idle = ((clock_t)sq_idle * system_hz + 999) / 1000;
+    ring->waiter = NO_TASK;
+
+    grant_cache_init(&ring->fixed_bufs, ring->fixed_entries,
+                     VRING_MAX_FIXED_BUFS, FALSE);
+
+    self->msg_out.u.m_vfs_ring.addr = user_addr;
+    self->msg_out.u.m_vfs_ring.size = size;
+
+    return ring - vfs_rings;
+}
+
+/**
+ * <Ring 1> Start consuming new submissions and optionally wait for
+ * completions.
+ * @return The number of completions ready, or a negative error code.
+ */
+int do_ring_enter(void)
+{
+    int flags = self->msg_in.u.m_vfs_ring.flags;
+    unsigned int min_complete = self->msg_in.u.m_vfs_ring.min_complete;
+    struct vfs_ring* ring;
+    unsigned int ready;
+
+    if (!(ring = ring_get(self->msg_in.u.m_vfs_ring.ring, fproc)))
+        return -EBADF;
+    if (flags & ~VRING_ENTER_GETEVENTS) return -EINVAL;
+
+    if (ring_sq_pending(ring)) ring_kick(ring);
+
+    ready = ring_cq_ready(ring);
+    if (!(flags & VRING_ENTER_GETEVENTS)) return ready;
+
+    if (min_complete > ring->cq_entries) min_complete = ring->cq_entries;
+
+    if (ready >= min_complete || !(ring->flags & (RING_RUNNING | RING_PENDING)))
+        return ready;
+
+    if (ring->waiter != NO_TASK) return -EBUSY;
+
+    ring->waiter = fproc->endpoint;
+    ring->wait_nr = min_complete;
+
+    return SUSPEND;
+}
+
+static int ring_register_buffers(struct vfs_ring* ring, void* uiov,
+                                 unsigned int nr)
+{
+    struct iovec iov[VRING_MAX_FIXED_BUFS];
+    unsigned int i;
+    int retval;
+
+    if (nr == 0 || nr > VRING_MAX_FIXED_BUFS) return EINVAL;
+    if (ring->fixed_bufs.nr) return EBUSY;
+
+    if ((retval = data_copy(SELF, iov, fproc->endpoint, uiov,
+                            nr * sizeof(iov[0]))) != OK)
+        return retval;
+
+    for (i = 0; i < nr; i++) {
+        if (iov[i].iov_len == 0) {
+            grant_cache_release(&ring->fixed_bufs);
+            return EINVAL;
+        }
+
+        grant_cache_add(&ring->fixed_bufs, fproc->endpoint,
+                        (vir_bytes)iov[i].iov_base, iov[i].iov_len);
+    }
+
+    return 0;
+}
+
+/**
+ * <Ring 1> Register or unregister fixed buffers, or release a ring.
+ */
+int do_ring_register(void)
+{
+    struct vfs_ring* ring;
+
+    if (!(ring = ring_get(self->msg_in.u.m_vfs_ring.ring, fproc)))
+        return -EBADF;
+
+    switch (self->msg_in.u.m_vfs_ring.opcode) {
+    case VRING_REGISTER_BUFFERS:
+        return -ring_register_buffers(ring, self->msg_in.u.m_vfs_ring.addr,
+                                      self->msg_in.u.m_vfs_ring.nr_args);
+    case VRING_UNREGISTER_BUFFERS:
+        grant_cache_release(&ring->fixed_bufs);
+        return 0;
+    case VRING_RELEASE:
+        munmap_for(fproc->endpoint, ring->user_addr, ring->size);
+        ring_destroy(ring);
+        return 0;
+    }
+
+    return -EINVAL;
+}
+
+/**
+ * <Ring 1> Tear down the rings of a process that exits or execs.
+ */
+void vfs_ring_exit(struct fproc* fp)
+{
+    struct vfs_ring* ring;
+
+    for (ring = vfs_rings; ring < vfs_rings + NR_VFS_RINGS; ring++) {
+        if ((ring->flags & RING_INUSE) && !(ring->flags & RING_DYING) &&
+            ring->owner == fp->endpoint)
+            ring_destroy(ring);
+    }
+}
@@ -69,7 +69,7 @@ static void __pollwait(struct file_desc*, struct wait_queue_head*,
 static int copy_fdset(struct select_fdset* fdset, int nfds, int direction);
 static int fd_getops(struct select_fdset* fdset, int fd);
 static void fd_setfromops(struct select_fdset* fdset, int fd, int ops);
-static void select_timeout_check(struct timer_list* tp);
+static void select_timeout_check(struct hrtimer* tp);
 
 #define SEL_READ   0x01
 #define SEL_WRITE  0x02
@@ -128,7 +128,7 @@ int do_select(void)
     struct poll_table* wait = &pwq.pt;
     void* vtimeout = self->msg_in.u.m_vfs_select.timeout;
     struct timeval timeout;
-    struct timer_list timer;
+    struct hrtimer timer;
     struct select_timer_cb_data timer_cb;
     int timed_out = 0;
 
@@ -228,10 +228,10 @@ int do_select(void)
                 timer_cb.expired = FALSE;
                 timer_cb.worker = self;
 
-                clock_t ticks;
-                ticks = timeout.tv_sec * system_hz +
-                        (timeout.tv_usec * system_hz + 1000000L - 1) / 1000000L;
-                set_timer(&timer, ticks, select_timeout_check, &timer_cb);
+                set_hrtimer(&timer,
+                            (u64)timeout.tv_sec * 1000000000ULL +
+                                (u64)timeout.tv_usec * 1000ULL,
+                            select_timeout_check, &timer_cb);
             }
 
             worker_wait(WT_BLOCKED_ON_POLL);
@@ -239,7 +239,7 @@ int do_select(void)
             if (has_timeout) {
                 timed_out = timer_cb.expired;
                 if (!timed_out) {
-                    cancel_timer(&timer);
+                    cancel_hrtimer(&timer);
                 }
             }
         }
@@ -259,7 +259,7 @@ int do_select(void)
     return retval;
 }
 
-static void select_timeout_check(struct timer_list* tp)
+static void select_timeout_check(struct hrtimer* tp)
 {
     struct select_timer_cb_data* timer_cb = tp->arg;
     struct worker_thread* worker = timer_cb->worker;
@@ -386,7 +386,7 @@ int do_poll(void)
     struct poll_wqueues pwq;
     struct poll_table* wait = &pwq.pt;
     int timeout_msecs = self->msg_in.u.m_vfs_poll.timeout_msecs;
-    struct timer_list timer;
+    struct hrtimer timer;
     struct select_timer_cb_data timer_cb;
     int timed_out = 0;
     struct pollfd* ufds = self->msg_in.u.m_vfs_poll.fds;
@@ -466,9 +466,8 @@ int do_poll(void)
                 timer_cb.expired = FALSE;
                 timer_cb.worker = self;
 
-                clock_t ticks;
-                ticks = (timeout_msecs * system_hz + 1000L - 1) / 1000L;
-                set_timer(&timer, ticks, select_timeout_check, &timer_cb);
+                set_hrtimer(&timer, (u64)timeout_msecs * 1000000ULL,
+                            select_timeout_check, &timer_cb);
             }
 
             worker_wait(WT_BLOCKED_ON_POLL);
@@ -476,7 +475,7 @@ int do_poll(void)
             if (timeout_msecs > 0) {
                 timed_out = timer_cb.expired;
                 if (!timed_out) {
-                    cancel_timer(&timer);
+                    cancel_hrtimer(&timer);
                 }
             }
 
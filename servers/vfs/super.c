@@ -125,6 +125,7 @@ int request_readsuper(endpoint_t fs_ep, dev_t dev, int readonly, int is_root,
         res->uid = m.u.m_fs_vfs_create_reply.uid;
         res->gid = m.u.m_fs_vfs_create_reply.gid;
         res->size = m.u.m_fs_vfs_create_reply.size;
+        res->flags = m.u.m_fs_vfs_create_reply.flags;
     }
 
     return retval;
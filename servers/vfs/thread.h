@@ -44,6 +44,8 @@ typedef enum {
 } rwlock_type_t;
 
 struct fproc;
+struct vfs_ring;
+struct grant_cache;
 
 struct worker_thread {
     thread_t tid;
@@ -60,6 +62,10 @@ struct worker_thread {
     MESSAGE* msg_recv;
     MESSAGE* msg_driver;
     endpoint_t recv_from;
+
+    struct vfs_ring* ring;            /* ring being served, if any */
+    struct grant_cache* grant_cache; /* grants request_readwrite may reuse */
+    char* fill_buf;                  /* page cache fills, see page_cache.c */
 };
 
 /* In certain cases, a worker thread could be put in more than one wait queue
@@ -80,5 +86,6 @@ struct worker_thread {
 #define WT_BLOCKED_ON_TFD     8
 #define WT_BLOCKED_ON_FLOCK   9
 #define WT_BLOCKED_ON_INOTIFY 10
+#define WT_BLOCKED_ON_RING    11
 
 #endif
@@ -43,28 +43,25 @@
 
 #define NSEC_PER_SEC (1000000000ULL)
 
-static void timerfd_tmrproc(struct timer_list* tp);
+static void timerfd_tmrproc(struct hrtimer* tp);
 
 struct timerfd_ctx {
     struct wait_queue_head wq;
     int clock_id;
-    struct timer_list timer;
+    struct hrtimer timer;
     u64 ticks;
-    clock_t tintv;
+    u64 tintv;
 };
 
-static clock_t timespec_to_ticks(const struct timespec* ts)
+static u64 timespec_to_ns(const struct timespec* ts)
 {
-    return (clock_t)ts->tv_sec * system_hz +
-           (clock_t)(((u64)ts->tv_nsec * system_hz + NSEC_PER_SEC - 1) /
-                     NSEC_PER_SEC);
+    return (u64)ts->tv_sec * NSEC_PER_SEC + (u64)ts->tv_nsec;
 }
 
-static void ticks_to_timespec(clock_t ticks, struct timespec* ts)
+static void ns_to_timespec(u64 ns, struct timespec* ts)
 {
-    ts->tv_sec = ticks / system_hz;
-    ts->tv_nsec =
-        (unsigned long)((u64)(ticks % system_hz) * NSEC_PER_SEC / system_hz);
+    ts->tv_sec = ns / NSEC_PER_SEC;
+    ts->tv_nsec = (unsigned long)(ns % NSEC_PER_SEC);
 }
 
 static void timerfd_triggered(struct timerfd_ctx* ctx)
@@ -73,11 +70,11 @@ static void timerfd_triggered(struct timerfd_ctx* ctx)
     waitqueue_wakeup_all(&ctx->wq, (void*)EPOLLIN);
 
     if (ctx->tintv) {
-        set_timer(&ctx->timer, ctx->tintv, timerfd_tmrproc, NULL);
+        set_hrtimer(&ctx->timer, ctx->tintv, timerfd_tmrproc, NULL);
     }
 }
 
-static void timerfd_tmrproc(struct timer_list* tp)
+static void timerfd_tmrproc(struct hrtimer* tp)
 {
     struct timerfd_ctx* ctx = list_entry(tp, struct timerfd_ctx, timer);
     timerfd_triggered(ctx);
@@ -87,30 +84,30 @@ static int timerfd_setup(struct timerfd_ctx* ctx, int flags,
                          const struct itimerspec* ktmr)
 {
     struct timespec now;
-    clock_t texp, ticks_now;
+    u64 texp, ns_now;
     int retval;
 
-    texp = timespec_to_ticks(&ktmr->it_value);
+    texp = timespec_to_ns(&ktmr->it_value);
 
     ctx->ticks = 0;
-    ctx->tintv = timespec_to_ticks(&ktmr->it_interval);
+    ctx->tintv = timespec_to_ns(&ktmr->it_interval);
 
     if (texp > 0) {
         if (flags & TFD_TIMER_ABSTIME) {
             retval = clock_gettime(ctx->clock_id, &now);
             if (retval < 0) return errno;
 
-            ticks_now = timespec_to_ticks(&now);
+            ns_now = timespec_to_ns(&now);
 
-            if (texp > ticks_now) {
-                texp -= ticks_now;
+            if (texp > ns_now) {
+                texp -= ns_now;
             } else {
                 texp = 0;
             }
         }
 
         if (texp > 0) {
-            set_timer(&ctx->timer, texp, timerfd_tmrproc, NULL);
+            set_hrtimer(&ctx->timer, texp, timerfd_tmrproc, NULL);
         } else {
             timerfd_triggered(ctx);
         }
@@ -182,7 +179,7 @@ static int timerfd_release(struct inode* pin, struct file_desc* filp,
 {
     struct timerfd_ctx* ctx = filp->fd_private_data;
 
-    cancel_timer(&ctx->timer);
+    cancel_hrtimer(&ctx->timer);
     free(ctx);
 
     return 0;
@@ -223,7 +220,7 @@ int do_timerfd_create(void)
 
     memset(ctx, 0, sizeof(*ctx));
     init_waitqueue_head(&ctx->wq);
-    init_timer(&ctx->timer);
+    hrtimer_init(&ctx->timer);
     ctx->clock_id = clock_id;
 
     fd = anon_inode_get_fd(fproc, 0, &timerfd_fops, ctx,
@@ -261,11 +258,11 @@ int do_timerfd_settime(void)
 
     ctx = filp->fd_private_data;
 
-    ticks_to_timespec(timer_expires_remaining(&ctx->timer),
-                      &old_value.it_value);
-    ticks_to_timespec(ctx->tintv, &old_value.it_interval);
+    ns_to_timespec(hrtimer_expires_remaining(&ctx->timer),
+                   &old_value.it_value);
+    ns_to_timespec(ctx->tintv, &old_value.it_interval);
 
-    cancel_timer(&ctx->timer);
+    cancel_hrtimer(&ctx->timer);
 
     retval = timerfd_setup(ctx, flags, &new_value);
     if (retval) goto err;
@@ -300,9 +297,9 @@ int do_timerfd_gettime(void)
 
     ctx = filp->fd_private_data;
 
-    ticks_to_timespec(timer_expires_remaining(&ctx->timer),
-                      &old_value.it_value);
-    ticks_to_timespec(ctx->tintv, &old_value.it_interval);
+    ns_to_timespec(hrtimer_expires_remaining(&ctx->timer),
+                   &old_value.it_value);
+    ns_to_timespec(ctx->tintv, &old_value.it_interval);
 
     retval = data_copy(src, old_value_ptr, SELF, &old_value, sizeof(old_value));
 
@@ -74,6 +74,9 @@ struct inode {
     u32 i_fsnotify_mask;
     struct fsnotify_mark_connector* i_fsnotify_marks;
 
+    unsigned int i_cache_gen; /**< Bumped when cached data goes stale */
+    int i_nocache;            /**< Never read through the page cache */
+
     void* i_private;
 };
 
@@ -127,6 +130,41 @@ struct file_system {
     int fs_ep;
 };
 
+/* Proxy grants of user buffers kept across requests instead of being set up
+ * and revoked around every FS_RDWT, see request_readwrite(). */
+struct grant_cache_entry {
+    endpoint_t from;
+    vir_bytes addr;
+    size_t len;
+
+    endpoint_t to;
+    mgrant_id_t grant;
+};
+
+struct grant_cache {
+    struct grant_cache_entry* entries;
+    int nr;
+    int size;
+    int grow; /* may buffers be added on use */
+};
+
+/* Header page and program interpreter of an executable kept across execs,
+ * see exec_cache.c. */
+struct exec_cache_entry {
+    dev_t dev;
+    ino_t ino;
+    time_t mtime;
+    off_t size;
+    int valid;
+    unsigned int last_used;
+
+    char* header;
+    size_t header_len;
+
+    int is_dyn;
+    char* interp;
+};
+
 typedef int32_t sockid_t;
 
 #endif
@@ -37,6 +37,7 @@ static void worker_sleep(void);
 static int worker_get_work(void);
 static void worker_assign(struct fproc* fp);
 static void worker_try_assign(struct fproc* fp);
+static struct worker_thread* worker_find_free(void);
 
 int rwlock_lock(rwlock_t* rwlock, rwlock_type_t lock_type)
 {
@@ -83,6 +84,9 @@ void worker_init(void)
         wp->fproc = NULL;
         wp->recv_from = NO_TASK;
         wp->next = NULL;
+        wp->ring = NULL;
+        wp->grant_cache = NULL;
+        wp->fill_buf = NULL;
 
         if (mutex_init(&wp->event_mutex, NULL) != 0) {
             panic("failed to initialize mutex");
@@ -129,6 +133,14 @@ void worker_yield(void)
 static int worker_get_work(void)
 {
     struct fproc* fp;
+    struct vfs_ring* ring;
+
+    if (!block_all && (ring = vfs_ring_next_pending(&fp)) != NULL) {
+        self->fproc = fp;
+        self->ring = ring;
+
+        return TRUE;
+    }
 
     if (has_pending_tasks()) {
         for (fp = fproc_table; fp < fproc_table + NR_PROCS; fp++) {
@@ -156,15 +168,22 @@ void worker_dispatch(struct fproc* fp, void (*func)(void), MESSAGE* msg)
     worker_try_assign(fp);
 }
 
-static void worker_assign(struct fproc* fp)
+static struct worker_thread* worker_find_free(void)
 {
     struct worker_thread* wp;
 
     for (wp = workers; wp < workers + NR_WORKER_THREADS; wp++) {
-        if (wp->fproc == NULL) break;
+        if (wp->fproc == NULL) return wp;
     }
 
-    if (wp == workers + NR_WORKER_THREADS) {
+    return NULL;
+}
+
+static void worker_assign(struct fproc* fp)
+{
+    struct worker_thread* wp = worker_find_free();
+
+    if (wp == NULL) {
         panic("no worker for new task");
     }
 
@@ -174,6 +193,24 @@ static void worker_assign(struct fproc* fp)
     worker_wake(wp);
 }
 
+/**
+ * <Ring 1> Hand a ring of fp to an idle worker. Rings are not worth a
+ * panic when all workers are busy, so return FALSE and let the caller queue
+ * the ring for vfs_ring_next_pending() instead.
+ */
+int worker_dispatch_ring(struct fproc* fp, struct vfs_ring* ring)
+{
+    struct worker_thread* wp;
+
+    if (block_all || (wp = worker_find_free()) == NULL) return FALSE;
+
+    wp->fproc = fp;
+    wp->ring = ring;
+
+    worker_wake(wp);
+    return TRUE;
+}
+
 static void worker_try_assign(struct fproc* fp)
 {
     if (!block_all) {
@@ -227,9 +264,18 @@ void worker_wait(int why)
 void worker_allow(int allow)
 {
     struct fproc* fp;
+    struct vfs_ring* ring;
+    struct worker_thread* wp;
 
     block_all = !allow;
 
+    while (!block_all && (wp = worker_find_free()) != NULL &&
+           (ring = vfs_ring_next_pending(&fp)) != NULL) {
+        wp->fproc = fp;
+        wp->ring = ring;
+        worker_wake(wp);
+    }
+
     if (!has_pending_tasks()) {
         return;
     }
@@ -272,7 +318,17 @@ static void* worker_main(void* arg)
     while (worker_get_work()) {
         fproc = self->fproc;
 
+        if (self->ring) {
+            /* rings lock the process themselves, per request chain */
+            vfs_ring_work(self->ring);
+
+            self->ring = NULL;
+            self->fproc = NULL;
+            continue;
+        }
+
         lock_fproc(fproc);
+        fproc->worker = self;
 
         if (fproc->func != NULL) {
             self->msg_in = fproc->msg;
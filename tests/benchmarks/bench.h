@@ -0,0 +1,33 @@
+#ifndef _BENCHMARKS_BENCH_H_
+#define _BENCHMARKS_BENCH_H_
+
+#include <stddef.h>
+#include <lyos/types.h>
+
+/* Run n iterations of the operation under test. */
+typedef void (*bench_op_t)(void* arg, long n);
+
+struct benchmark {
+    const char* name;
+    void (*run)(const char* name);
+};
+
+extern const char* bench_prog;
+extern u64 bench_min_ns;
+extern int bench_max_cpus;
+
+u64 bench_now_ns(void);
+
+void bench_run(const char* name, const char* param, size_t bytes_per_op,
+               bench_op_t op, void* arg);
+void bench_report(const char* name, const char* param, long iters,
+                  u64 elapsed_ns, size_t bytes_per_op);
+void bench_skip(const char* name, const char* param, int error);
+
+extern struct benchmark ipc_benchmarks[];
+extern struct benchmark syscall_benchmarks[];
+extern struct benchmark proc_benchmarks[];
+extern struct benchmark io_benchmarks[];
+extern struct benchmark sched_benchmarks[];
+
+#endif
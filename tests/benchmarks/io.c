@@ -0,0 +1,131 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+
+#include "bench.h"
+
+static const size_t stream_sizes[] = {64, 512, 4096, 65536};
+static const size_t copy_sizes[] = {64, 512, 4096, 65536, 1048576};
+
+#define ARRAY_SIZE(a) (sizeof(a) / sizeof((a)[0]))
+
+struct stream {
+    int fd;
+    size_t size;
+    char* buf;
+};
+
+static void op_write(void* arg, long n)
+{
+    struct stream* s = arg;
+    size_t off;
+    ssize_t len;
+
+    while (n--) {
+        for (off = 0; off < s->size; off += len) {
+            len = write(s->fd, s->buf + off, s->size - off);
+            if (len <= 0) return;
+        }
+    }
+}
+
+static void op_read(void* arg, long n)
+{
+    struct stream* s = arg;
+
+    while (n--) {
+        if (read(s->fd, s->buf, s->size) <= 0) return;
+    }
+}
+
+/* The child drains the stream so the parent measures sustained throughput;
+ * the amount in flight is bounded by the pipe or socket buffer. */
+static void bench_stream(const char* name, int unix_socket)
+{
+    char param[32];
+    struct stream s;
+    int i, fds[2];
+    pid_t pid;
+
+    for (i = 0; i < ARRAY_SIZE(stream_sizes); i++) {
+        s.size = stream_sizes[i];
+        snprintf(param, sizeof(param), "%zu", s.size);
+
+        if ((unix_socket ? socketpair(AF_UNIX, SOCK_STREAM, 0, fds)
+                         : pipe(fds)) != 0) {
+            bench_skip(name, param, errno);
+            return;
+        }
+
+        s.buf = calloc(1, s.size);
+        if (!s.buf) {
+            bench_skip(name, param, ENOMEM);
+            return;
+        }
+
+        pid = fork();
+        if (pid == 0) {
+            close(fds[1]);
+            while (read(fds[0], s.buf, s.size) > 0)
+                ;
+            _exit(0);
+        }
+
+        close(fds[0]);
+        s.fd = fds[1];
+
+        bench_run(name, param, s.size, op_write, &s);
+
+        close(fds[1]);
+        waitpid(pid, NULL, 0);
+        free(s.buf);
+    }
+}
+
+static void bench_pipe(const char* name) { bench_stream(name, 0); }
+
+static void bench_uds(const char* name) { bench_stream(name, 1); }
+
+/* Reading /dev/zero is a grant-based copy from the memory driver through
+ * VFS into our buffer, which makes it a proxy for safecopy bandwidth. */
+static void bench_copy(const char* name)
+{
+    char param[32];
+    struct stream s;
+    int i;
+
+    s.fd = open("/dev/zero", O_RDONLY);
+    if (s.fd < 0) {
+        bench_skip(name, NULL, errno);
+        return;
+    }
+
+    for (i = 0; i < ARRAY_SIZE(copy_sizes); i++) {
+        s.size = copy_sizes[i];
+        snprintf(param, sizeof(param), "%zu", s.size);
+
+        s.buf = malloc(s.size);
+        if (!s.buf) {
+            bench_skip(name, param, ENOMEM);
+            break;
+        }
+
+        bench_run(name, param, s.size, op_read, &s);
+        free(s.buf);
+    }
+
+    close(s.fd);
+}
+
+struct benchmark io_benchmarks[] = {
+    {"io.pipe", bench_pipe},
+    {"io.uds", bench_uds},
+    {"io.copy", bench_copy},
+    {NULL, NULL},
+};
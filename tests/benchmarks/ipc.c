@@ -0,0 +1,256 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include <lyos/ipc.h>
+#include <lyos/const.h>
+#include <lyos/sysutils.h>
+
+#include "bench.h"
+
+#define BENCH_PING 1
+#define BENCH_STOP 2
+
+endpoint_t get_endpoint(void);
+
+struct peer {
+    pid_t pid;
+    endpoint_t endpoint;
+};
+
+/* Echo every message back to its sender. */
+static void echo_loop(endpoint_t arg)
+{
+    MESSAGE m;
+
+    for (;;) {
+        send_recv(RECEIVE, ANY, &m);
+        if (m.type == BENCH_STOP) break;
+
+        send_recv(SEND, m.source, &m);
+    }
+}
+
+/* Reply and wait for the next request in one sendrec, like an L4 server. */
+static void replywait_loop(endpoint_t arg)
+{
+    MESSAGE m;
+
+    send_recv(RECEIVE, ANY, &m);
+    while (m.type != BENCH_STOP)
+        send_recv(BOTH, m.source, &m);
+}
+
+/* Answer every notification with one. */
+static void notify_loop(endpoint_t parent)
+{
+    MESSAGE m;
+
+    for (;;) {
+        send_recv(RECEIVE, ANY, &m);
+        if (m.type == BENCH_STOP) break;
+
+        send_recv(NOTIFY, parent, NULL);
+    }
+}
+
+/* Count asynchronous messages until told to stop. */
+static void sink_loop(endpoint_t arg)
+{
+    MESSAGE m;
+
+    for (;;) {
+        send_recv(RECEIVE_ASYNC, ANY, &m);
+        if (m.type == BENCH_STOP) break;
+    }
+}
+
+static int start_peer(struct peer* peer, void (*loop)(endpoint_t),
+                      endpoint_t arg)
+{
+    int fds[2];
+    endpoint_t ep;
+
+    if (pipe(fds) != 0) return errno;
+
+    peer->pid = fork();
+    if (peer->pid < 0) return errno;
+
+    if (peer->pid == 0) {
+        close(fds[0]);
+        ep = get_endpoint();
+        write(fds[1], &ep, sizeof(ep));
+        close(fds[1]);
+
+        loop(arg);
+        _exit(0);
+    }
+
+    close(fds[1]);
+    if (read(fds[0], &peer->endpoint, sizeof(peer->endpoint)) !=
+        sizeof(peer->endpoint)) {
+        close(fds[0]);
+        return EIO;
+    }
+    close(fds[0]);
+
+    return 0;
+}
+
+static void stop_peer(struct peer* peer)
+{
+    MESSAGE m;
+
+    memset(&m, 0, sizeof(m));
+    m.type = BENCH_STOP;
+
+    if (send_recv(SEND_NONBLOCK, peer->endpoint, &m) != 0)
+        kill(peer->pid, SIGKILL);
+
+    waitpid(peer->pid, NULL, 0);
+}
+
+static void op_sendrec(void* arg, long n)
+{
+    struct peer* peer = arg;
+    MESSAGE m;
+
+    while (n--) {
+        memset(&m, 0, sizeof(m));
+        m.type = BENCH_PING;
+        send_recv(BOTH, peer->endpoint, &m);
+    }
+}
+
+static void op_notify(void* arg, long n)
+{
+    struct peer* peer = arg;
+    MESSAGE m;
+
+    while (n--) {
+        send_recv(NOTIFY, peer->endpoint, NULL);
+        send_recv(RECEIVE, ANY, &m);
+    }
+}
+
+static async_message_t async_table[1];
+
+static int async_send(endpoint_t dest, MESSAGE* msg)
+{
+    MESSAGE m;
+
+    async_table[0].dest = dest;
+    async_table[0].msg = *msg;
+    async_table[0].flags = ASMF_USED;
+
+    memset(&m, 0, sizeof(m));
+    m.SR_FUNCTION = SEND_ASYNC;
+    m.SR_TABLE = async_table;
+    m.SR_LEN = 1;
+
+    return syscall_entry(NR_SENDREC, &m);
+}
+
+/* Unprivileged processes share one priv structure, which makes notification
+ * sources ambiguous and rules out asynchronous sends, so the benchmarks
+ * that need them are skipped. */
+static int check_privileged(void)
+{
+    MESSAGE m;
+
+    memset(&m, 0, sizeof(m));
+    m.SR_FUNCTION = SEND_ASYNC;
+    m.SR_TABLE = NULL;
+    m.SR_LEN = 0;
+
+    return syscall_entry(NR_SENDREC, &m);
+}
+
+static void op_async(void* arg, long n)
+{
+    struct peer* peer = arg;
+    MESSAGE m;
+
+    memset(&m, 0, sizeof(m));
+    m.type = BENCH_PING;
+
+    while (n--) {
+        async_send(peer->endpoint, &m);
+
+        /* wait for the kernel to deliver it before reusing the slot */
+        while (!(*(volatile int*)&async_table[0].flags & ASMF_DONE))
+            ;
+    }
+}
+
+static void bench_null_sendrec(const char* name)
+{
+    struct peer peer;
+    int retval;
+
+    if ((retval = start_peer(&peer, echo_loop, 0)) != 0) {
+        bench_skip(name, NULL, retval);
+        return;
+    }
+
+    bench_run(name, NULL, 0, op_sendrec, &peer);
+    stop_peer(&peer);
+}
+
+/* Same round trip as null_sendrec, but the server replies with sendrec too,
+ * so both directions can be handed off directly when the peers share a
+ * CPU. */
+static void bench_replywait_sendrec(const char* name)
+{
+    struct peer peer;
+    int retval;
+
+    if ((retval = start_peer(&peer, replywait_loop, 0)) != 0) {
+        bench_skip(name, NULL, retval);
+        return;
+    }
+
+    bench_run(name, NULL, 0, op_sendrec, &peer);
+    stop_peer(&peer);
+}
+
+static void bench_notify(const char* name)
+{
+    struct peer peer;
+    int retval;
+
+    if ((retval = check_privileged()) != 0 ||
+        (retval = start_peer(&peer, notify_loop, get_endpoint())) != 0) {
+        bench_skip(name, NULL, retval);
+        return;
+    }
+
+    bench_run(name, NULL, 0, op_notify, &peer);
+    stop_peer(&peer);
+}
+
+static void bench_async_send(const char* name)
+{
+    struct peer peer;
+    int retval;
+
+    if ((retval = check_privileged()) != 0 ||
+        (retval = start_peer(&peer, sink_loop, 0)) != 0) {
+        bench_skip(name, NULL, retval);
+        return;
+    }
+
+    bench_run(name, NULL, 0, op_async, &peer);
+    stop_peer(&peer);
+}
+
+struct benchmark ipc_benchmarks[] = {
+    {"ipc.null_sendrec", bench_null_sendrec},
+    {"ipc.replywait_sendrec", bench_replywait_sendrec},
+    {"ipc.notify_roundtrip", bench_notify},
+    {"ipc.async_send", bench_async_send},
+    {NULL, NULL},
+};
@@ -0,0 +1,161 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "bench.h"
+
+#define DEF_MIN_TIME 1 /* seconds per measurement */
+
+const char* bench_prog;
+u64 bench_min_ns = DEF_MIN_TIME * 1000000000ULL;
+int bench_max_cpus = 0;
+
+static const char* filter = NULL;
+static int list_only = 0;
+
+static struct benchmark* all_benchmarks[] = {
+    ipc_benchmarks, syscall_benchmarks, proc_benchmarks,
+    io_benchmarks,  sched_benchmarks,   NULL,
+};
+
+u64 bench_now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (u64)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/* Results are printed as one JSON object per line so that runs of different
+ * commits can be diffed or loaded by a script. */
+void bench_report(const char* name, const char* param, long iters,
+                  u64 elapsed_ns, size_t bytes_per_op)
+{
+    double secs = (double)elapsed_ns / 1e9;
+
+    printf("{\"bench\":\"%s\",\"param\":\"%s\",\"status\":\"ok\","
+           "\"iters\":%ld,\"elapsed_ns\":%llu,\"ns_per_op\":%.1f,"
+           "\"ops_per_sec\":%.1f",
+           name, param ? param : "", iters, (unsigned long long)elapsed_ns,
+           (double)elapsed_ns / iters, iters / secs);
+
+    if (bytes_per_op) {
+        printf(",\"mb_per_sec\":%.2f",
+               (double)bytes_per_op * iters / secs / (1024 * 1024));
+    }
+
+    printf("}\n");
+    fflush(stdout);
+}
+
+void bench_skip(const char* name, const char* param, int error)
+{
+    printf("{\"bench\":\"%s\",\"param\":\"%s\",\"status\":\"skipped\","
+           "\"error\":%d}\n",
+           name, param ? param : "", error);
+    fflush(stdout);
+}
+
+/* Run op in growing batches until one batch takes at least bench_min_ns.
+ * The clock only has tick resolution, so short batches are not trusted. */
+void bench_run(const char* name, const char* param, size_t bytes_per_op,
+               bench_op_t op, void* arg)
+{
+    long n = 1;
+    u64 start, elapsed;
+
+    /* warm up */
+    op(arg, 1);
+
+    for (;;) {
+        start = bench_now_ns();
+        op(arg, n);
+        elapsed = bench_now_ns() - start;
+
+        if (elapsed >= bench_min_ns) break;
+
+        if (elapsed < bench_min_ns / 16)
+            n *= 8;
+        else
+            n = (u64)n * bench_min_ns / elapsed * 11 / 10 + 1;
+    }
+
+    bench_report(name, param, n, elapsed, bytes_per_op);
+}
+
+static int count_cpus(void)
+{
+    FILE* fp = fopen("/proc/cpuinfo", "r");
+    char line[128];
+    int cpus = 0;
+
+    if (!fp) return 1;
+
+    while (fgets(line, sizeof(line), fp)) {
+        if (strncmp(line, "processor", 9) == 0) cpus++;
+    }
+
+    fclose(fp);
+    return cpus ? cpus : 1;
+}
+
+static void usage(void)
+{
+    fprintf(stderr, "usage: %s [-l] [-t seconds] [-c cpus] [filter]\n",
+            bench_prog);
+    exit(EXIT_FAILURE);
+}
+
+int main(int argc, char* argv[])
+{
+    struct benchmark** group;
+    struct benchmark* b;
+    int secs;
+
+    bench_prog = argv[0];
+
+    while (--argc) {
+        ++argv;
+
+        if (strcmp(*argv, "-x") == 0) {
+            /* exec target of proc.fork_exec_wait */
+            return 0;
+        } else if (strcmp(*argv, "-l") == 0) {
+            list_only = 1;
+        } else if (strcmp(*argv, "-t") == 0) {
+            if (--argc == 0) usage();
+            if (sscanf(*++argv, "%d", &secs) != 1 || secs <= 0) usage();
+            bench_min_ns = secs * 1000000000ULL;
+        } else if (strcmp(*argv, "-c") == 0) {
+            if (--argc == 0) usage();
+            if (sscanf(*++argv, "%d", &bench_max_cpus) != 1) usage();
+        } else if (**argv == '-') {
+            usage();
+        } else {
+            filter = *argv;
+        }
+    }
+
+    if (bench_max_cpus <= 0) bench_max_cpus = count_cpus();
+
+    if (!list_only) {
+        printf("{\"suite\":\"benchmarks\",\"version\":1,\"cpus\":%d,"
+               "\"min_time_ns\":%llu}\n",
+               bench_max_cpus, (unsigned long long)bench_min_ns);
+    }
+
+    for (group = all_benchmarks; *group; group++) {
+        for (b = *group; b->name; b++) {
+            if (filter && !strstr(b->name, filter)) continue;
+
+            if (list_only)
+                printf("%s\n", b->name);
+            else
+                b->run(b->name);
+        }
+    }
+
+    return EXIT_SUCCESS;
+}
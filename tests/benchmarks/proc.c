@@ -0,0 +1,80 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+
+#include "bench.h"
+
+#define FAULT_PAGES 256
+#define PAGE_SIZE   4096
+
+static void op_fork_wait(void* arg, long n)
+{
+    pid_t pid;
+
+    while (n--) {
+        pid = fork();
+        if (pid == 0) _exit(0);
+        if (pid > 0) waitpid(pid, NULL, 0);
+    }
+}
+
+static void op_fork_exec_wait(void* arg, long n)
+{
+    char* const argv[] = {(char*)bench_prog, "-x", NULL};
+    pid_t pid;
+
+    while (n--) {
+        pid = fork();
+        if (pid == 0) {
+            execvp(bench_prog, argv);
+            _exit(1);
+        }
+        if (pid > 0) waitpid(pid, NULL, 0);
+    }
+}
+
+/* Each operation is one demand-zero fault on a fresh anonymous page. */
+static void op_page_fault(void* arg, long n)
+{
+    char* buf;
+    long i, pages;
+
+    while (n > 0) {
+        pages = n < FAULT_PAGES ? n : FAULT_PAGES;
+
+        buf = mmap(NULL, pages * PAGE_SIZE, PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (buf == MAP_FAILED) return;
+
+        for (i = 0; i < pages; i++)
+            buf[i * PAGE_SIZE] = 1;
+
+        munmap(buf, pages * PAGE_SIZE);
+        n -= pages;
+    }
+}
+
+static void bench_fork_wait(const char* name)
+{
+    bench_run(name, NULL, 0, op_fork_wait, NULL);
+}
+
+static void bench_fork_exec_wait(const char* name)
+{
+    bench_run(name, NULL, 0, op_fork_exec_wait, NULL);
+}
+
+static void bench_page_fault(const char* name)
+{
+    bench_run(name, NULL, 0, op_page_fault, NULL);
+}
+
+struct benchmark proc_benchmarks[] = {
+    {"proc.fork_wait", bench_fork_wait},
+    {"proc.fork_exec_wait", bench_fork_exec_wait},
+    {"proc.page_fault", bench_page_fault},
+    {NULL, NULL},
+};
@@ -0,0 +1,74 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+#include "bench.h"
+
+/* One pair of processes bouncing a byte over two pipes n times. Every round
+ * trip costs two context switches when both sides share a CPU. */
+static void pingpong(long n)
+{
+    int ping[2], pong[2];
+    char c = 0;
+    pid_t pid;
+
+    if (pipe(ping) != 0 || pipe(pong) != 0) return;
+
+    pid = fork();
+    if (pid == 0) {
+        /* drop our copy of the write end so the parent's close is seen */
+        close(ping[1]);
+        close(pong[0]);
+
+        while (read(ping[0], &c, 1) == 1)
+            write(pong[1], &c, 1);
+        _exit(0);
+    }
+
+    close(ping[0]);
+    close(pong[1]);
+
+    while (n--) {
+        write(ping[1], &c, 1);
+        read(pong[0], &c, 1);
+    }
+
+    close(ping[1]);
+    close(pong[0]);
+    waitpid(pid, NULL, 0);
+}
+
+/* Run the ping-pong in several pairs at once, so ns_per_op is the round
+ * trip time of one pair while the others keep the remaining CPUs busy. */
+static void op_pingpong(void* arg, long n)
+{
+    int pairs = *(int*)arg;
+    int i;
+
+    for (i = 0; i < pairs; i++) {
+        if (fork() == 0) {
+            pingpong(n);
+            _exit(0);
+        }
+    }
+
+    for (i = 0; i < pairs; i++)
+        wait(NULL);
+}
+
+static void bench_ctxsw(const char* name)
+{
+    char param[32];
+    int pairs;
+
+    for (pairs = 1; pairs <= bench_max_cpus; pairs++) {
+        snprintf(param, sizeof(param), "pairs=%d", pairs);
+        bench_run(name, param, 0, op_pingpong, &pairs);
+    }
+}
+
+struct benchmark sched_benchmarks[] = {
+    {"sched.ctxsw_pingpong", bench_ctxsw},
+    {NULL, NULL},
+};
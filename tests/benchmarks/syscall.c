@@ -0,0 +1,59 @@
+#include <stdio.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "bench.h"
+
+static void op_getpid(void* arg, long n)
+{
+    while (n--)
+        getpid();
+}
+
+/* umask() is answered by VFS without touching any file system. */
+static void op_vfs_null(void* arg, long n)
+{
+    while (n--)
+        umask(022);
+}
+
+static void op_fstat(void* arg, long n)
+{
+    int fd = *(int*)arg;
+    struct stat sbuf;
+
+    while (n--)
+        fstat(fd, &sbuf);
+}
+
+static void bench_getpid(const char* name)
+{
+    bench_run(name, NULL, 0, op_getpid, NULL);
+}
+
+static void bench_vfs_null(const char* name)
+{
+    bench_run(name, NULL, 0, op_vfs_null, NULL);
+}
+
+static void bench_fstat(const char* name)
+{
+    int fd = open("/dev/null", O_RDONLY);
+
+    if (fd < 0) {
+        bench_skip(name, NULL, errno);
+        return;
+    }
+
+    bench_run(name, NULL, 0, op_fstat, &fd);
+    close(fd);
+}
+
+struct benchmark syscall_benchmarks[] = {
+    {"sys.getpid", bench_getpid},
+    {"sys.vfs_null", bench_vfs_null},
+    {"sys.fstat", bench_fstat},
+    {NULL, NULL},
+};
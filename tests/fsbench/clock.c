@@ -0,0 +1,74 @@
+#include <time.h>
+
+#include "fsbench.h"
+
+/* clock_gettime() only advances once per tick, which is far too coarse for
+ * per-operation latencies. On x86 the TSC is calibrated against it once at
+ * startup and used instead. */
+
+#define CALIBRATE_NS 250000000ULL
+
+static u64 clock_gettime_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (u64)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+#if defined(__i386__) || defined(__x86_64__)
+
+static u64 tsc_start;
+static u64 ns_start;
+static u64 tsc_per_ms;
+
+static inline u64 rdtsc(void)
+{
+    u32 lo, hi;
+
+    __asm__ __volatile__("rdtsc" : "=a"(lo), "=d"(hi));
+    return ((u64)hi << 32) | lo;
+}
+
+/* Wait for the next tick so that both clocks are read on an edge. */
+static u64 tick_edge(u64* tsc)
+{
+    u64 now, start = clock_gettime_ns();
+
+    while ((now = clock_gettime_ns()) == start)
+        ;
+
+    *tsc = rdtsc();
+    return now;
+}
+
+void clock_init(void)
+{
+    u64 tsc_end, ns_end;
+
+    ns_start = tick_edge(&tsc_start);
+
+    do {
+        ns_end = tick_edge(&tsc_end);
+    } while (ns_end - ns_start < CALIBRATE_NS);
+
+    tsc_per_ms = (tsc_end - tsc_start) * 1000000ULL / (ns_end - ns_start);
+    if (!tsc_per_ms) tsc_per_ms = 1;
+}
+
+u64 clock_now_ns(void)
+{
+    u64 delta = rdtsc() - tsc_start;
+
+    /* split to avoid overflowing on long runs */
+    return ns_start + delta / tsc_per_ms * 1000000ULL +
+           delta % tsc_per_ms * 1000000ULL / tsc_per_ms;
+}
+
+#else
+
+void clock_init(void) {}
+
+u64 clock_now_ns(void) { return clock_gettime_ns(); }
+
+#endif
@@ -0,0 +1,66 @@
+#ifndef _FSBENCH_H_
+#define _FSBENCH_H_
+
+#include <sys/types.h>
+#include <lyos/types.h>
+
+/* Latency histogram: values below 2^(HIST_SUB_BITS+1) get a bucket each,
+ * larger ones are split into 2^HIST_SUB_BITS linear steps per power of two,
+ * which keeps the percentile error below 12.5%. */
+#define HIST_SUB_BITS    3
+#define HIST_SUB_BUCKETS (1 << HIST_SUB_BITS)
+#define HIST_BUCKETS     ((64 - HIST_SUB_BITS + 1) * HIST_SUB_BUCKETS)
+
+struct hist {
+    u64 count;
+    u64 total;
+    u64 min;
+    u64 max;
+    u64 buckets[HIST_BUCKETS];
+};
+
+/* Parameters shared by all workloads. */
+struct fsbench_opts {
+    const char* target;  /* directory, or block device with -r */
+    int raw;             /* bypass VFS and talk to the block driver */
+    int force;           /* allow raw writes */
+    size_t block_size;   /* bytes per I/O */
+    u64 file_size;       /* bytes covered by data workloads */
+    u64 duration_ns;     /* run time of time-based workloads */
+    int nr_files;        /* files per metadata phase */
+    int sync_every;      /* sync after that many writes, 0 = never */
+    int keep;            /* keep the data file after the run */
+    unsigned int seed;
+};
+
+struct workload {
+    const char* name;
+    int (*run)(const struct workload* w, const struct fsbench_opts* opts);
+    int raw;    /* can run against a raw block device */
+    int write;
+    int random;
+    int sync_every; /* default for opts->sync_every */
+};
+
+extern const char* fsbench_prog;
+
+/* clock.c */
+void clock_init(void);
+u64 clock_now_ns(void);
+
+/* main.c */
+void hist_init(struct hist* h);
+void hist_add(struct hist* h, u64 value);
+void fsbench_report(const char* workload, const struct fsbench_opts* opts,
+                    size_t bytes_per_op, u64 elapsed_ns,
+                    const struct hist* lat);
+void fsbench_error(const char* workload, const char* what, int error);
+unsigned int fsbench_rand(void);
+
+/* io.c */
+int run_io(const struct workload* w, const struct fsbench_opts* opts);
+
+/* meta.c */
+int run_meta(const struct workload* w, const struct fsbench_opts* opts);
+
+#endif
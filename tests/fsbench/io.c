@@ -0,0 +1,186 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <limits.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <lyos/const.h>
+#include <libbdev/libbdev.h>
+
+#include "fsbench.h"
+
+#define DATA_FILE "fsbench.dat"
+
+struct io_target {
+    int fd;    /* file mode */
+    dev_t dev; /* raw mode */
+    int raw;
+};
+
+static char data_path[PATH_MAX];
+
+static int open_raw(struct io_target* t, const struct fsbench_opts* opts)
+{
+    struct stat sbuf;
+    int retval;
+
+    if (stat(opts->target, &sbuf) != 0) return errno;
+    if (!S_ISBLK(sbuf.st_mode)) return ENOTBLK;
+
+    t->raw = 1;
+    t->dev = sbuf.st_rdev;
+
+    /* talk to the driver directly, VFS and the FS cache are not involved */
+    bdev_driver(t->dev);
+    if ((retval = bdev_open(t->dev)) != 0) return retval;
+
+    return 0;
+}
+
+/* Lay the data file out before measuring so that reads hit real blocks and
+ * writes do not measure file growth. */
+static int prefill(int fd, const struct fsbench_opts* opts, char* buf)
+{
+    struct stat sbuf;
+    u64 pos;
+    ssize_t n;
+
+    if (fstat(fd, &sbuf) != 0) return errno;
+    if (sbuf.st_size >= opts->file_size) return 0;
+
+    if (lseek(fd, 0, SEEK_SET) < 0) return errno;
+
+    for (pos = 0; pos < opts->file_size; pos += n) {
+        n = write(fd, buf, min((u64)opts->block_size, opts->file_size - pos));
+        if (n <= 0) return n < 0 ? errno : EIO;
+    }
+
+    sync();
+    return 0;
+}
+
+static int open_file(struct io_target* t, const struct fsbench_opts* opts,
+                     char* buf)
+{
+    int retval;
+
+    snprintf(data_path, sizeof(data_path), "%s/%s", opts->target, DATA_FILE);
+
+    t->raw = 0;
+    t->fd = open(data_path, O_RDWR | O_CREAT, 0644);
+    if (t->fd < 0) return errno;
+
+    if ((retval = prefill(t->fd, opts, buf)) != 0) {
+        close(t->fd);
+        return retval;
+    }
+
+    return 0;
+}
+
+static void close_target(struct io_target* t, const struct fsbench_opts* opts)
+{
+    if (t->raw) {
+        bdev_close(t->dev);
+        return;
+    }
+
+    close(t->fd);
+    if (!opts->keep) unlink(data_path);
+}
+
+static int do_io(struct io_target* t, int write_op, u64 pos, char* buf,
+                 size_t count)
+{
+    ssize_t n;
+
+    if (t->raw) {
+        n = write_op ? bdev_write(t->dev, pos, buf, count)
+                     : bdev_read(t->dev, pos, buf, count);
+        if (n < 0) return -n;
+    } else {
+        if (lseek(t->fd, pos, SEEK_SET) < 0) return errno;
+
+        n = write_op ? write(t->fd, buf, count) : read(t->fd, buf, count);
+        if (n < 0) return errno;
+    }
+
+    return n == count ? 0 : EIO;
+}
+
+static u64 random_block(u64 nr_blocks)
+{
+    u64 r = fsbench_rand();
+
+    if (nr_blocks > 0xffffffffULL) r = (r << 32) | fsbench_rand();
+    return r % nr_blocks;
+}
+
+/* Sequential and random reads and writes of block_size bytes over the
+ * first file_size bytes of the target, for duration_ns. */
+int run_io(const struct workload* w, const struct fsbench_opts* opts)
+{
+    struct io_target target;
+    struct hist* lat;
+    u64 nr_blocks, block = 0, start, now, op_start, writes = 0;
+    int sync_every, retval;
+    char* buf;
+
+    sync_every = opts->sync_every >= 0 ? opts->sync_every : w->sync_every;
+    nr_blocks = opts->file_size / opts->block_size;
+
+    lat = malloc(sizeof(*lat));
+    buf = malloc(opts->block_size);
+    if (!lat || !buf) {
+        free(lat);
+        free(buf);
+        return ENOMEM;
+    }
+
+    hist_init(lat);
+    memset(buf, 0x5a, opts->block_size);
+
+    if (opts->raw)
+        retval = open_raw(&target, opts);
+    else
+        retval = open_file(&target, opts, buf);
+    if (retval) goto out;
+
+    start = now = clock_now_ns();
+
+    while (now - start < opts->duration_ns) {
+        u64 pos;
+
+        if (w->random) {
+            pos = random_block(nr_blocks) * opts->block_size;
+        } else {
+            pos = block * opts->block_size;
+            if (++block == nr_blocks) block = 0;
+        }
+
+        op_start = now;
+
+        if ((retval = do_io(&target, w->write, pos, buf, opts->block_size)) !=
+            0)
+            break;
+
+        /* fsync() is a no-op in the C library for now, so flush everything
+         * with sync() instead. */
+        if (w->write && sync_every && ++writes % sync_every == 0) sync();
+
+        now = clock_now_ns();
+        hist_add(lat, now - op_start);
+    }
+
+    close_target(&target, opts);
+
+    if (!retval)
+        fsbench_report(w->name, opts, opts->block_size, now - start, lat);
+
+out:
+    free(lat);
+    free(buf);
+    return retval;
+}
@@ -0,0 +1,275 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <lyos/const.h>
+
+#include "fsbench.h"
+
+#define DEF_BLOCK_SIZE 4096
+#define DEF_FILE_SIZE  (16ULL << 20)
+#define DEF_DURATION   5 /* seconds */
+#define DEF_NR_FILES   10000
+
+const char* fsbench_prog;
+
+static unsigned int rand_state;
+
+static struct workload workloads[] = {
+    {"seqread", run_io, 1, 0, 0, 0},  {"seqwrite", run_io, 1, 1, 0, 0},
+    {"randread", run_io, 1, 0, 1, 0}, {"randwrite", run_io, 1, 1, 1, 0},
+    {"fsync", run_io, 0, 1, 0, 1},    {"meta", run_meta, 0, 0, 0, 0},
+    {NULL, NULL, 0, 0, 0, 0},
+};
+
+static void usage(void)
+{
+    struct workload* w;
+
+    fprintf(stderr,
+            "usage: %s [-w workload|all] [-b bs] [-s size] [-t seconds]\n"
+            "       [-n files] [-f sync_every] [-S seed] [-k] [-r [-F]] "
+            "target\n"
+            "workloads:",
+            fsbench_prog);
+
+    for (w = workloads; w->name; w++)
+        fprintf(stderr, " %s", w->name);
+    fprintf(stderr, "\n");
+
+    exit(EXIT_FAILURE);
+}
+
+static int parse_size(const char* str, u64* size)
+{
+    unsigned long long val;
+    char* end;
+
+    val = strtoull(str, &end, 0);
+    if (end == str) return EINVAL;
+
+    switch (*end) {
+    case 'k':
+    case 'K':
+        val <<= 10;
+        end++;
+        break;
+    case 'm':
+    case 'M':
+        val <<= 20;
+        end++;
+        break;
+    case 'g':
+    case 'G':
+        val <<= 30;
+        end++;
+        break;
+    }
+
+    if (*end != '\0' || val == 0) return EINVAL;
+
+    *size = val;
+    return 0;
+}
+
+void hist_init(struct hist* h)
+{
+    memset(h, 0, sizeof(*h));
+    h->min = ~0ULL;
+}
+
+static int hist_bucket(u64 value)
+{
+    int msb;
+
+    if (value < 2 * HIST_SUB_BUCKETS) return value;
+
+    msb = 63 - __builtin_clzll(value);
+    return (msb - HIST_SUB_BITS + 1) * HIST_SUB_BUCKETS +
+           ((value >> (msb - HIST_SUB_BITS)) & (HIST_SUB_BUCKETS - 1));
+}
+
+/* Largest value that falls into bucket b. */
+static u64 hist_bucket_max(int b)
+{
+    int shift;
+
+    if (b < 2 * HIST_SUB_BUCKETS) return b;
+
+    shift = b / HIST_SUB_BUCKETS - 1;
+    return ((u64)(HIST_SUB_BUCKETS + b % HIST_SUB_BUCKETS + 1) << shift) - 1;
+}
+
+void hist_add(struct hist* h, u64 value)
+{
+    h->count++;
+    h->total += value;
+    if (value < h->min) h->min = value;
+    if (value > h->max) h->max = value;
+    h->buckets[hist_bucket(value)]++;
+}
+
+/* pct is in tenths of a percent. */
+static u64 hist_percentile(const struct hist* h, int pct)
+{
+    u64 seen = 0, target = (h->count * pct + 999) / 1000;
+    int b;
+
+    for (b = 0; b < HIST_BUCKETS; b++) {
+        seen += h->buckets[b];
+        if (seen >= target) break;
+    }
+
+    if (b == HIST_BUCKETS) return h->max;
+    return min(hist_bucket_max(b), h->max);
+}
+
+/* One JSON object per line, like tests/benchmarks, so that runs can be
+ * compared by a script. */
+void fsbench_report(const char* workload, const struct fsbench_opts* opts,
+                    size_t bytes_per_op, u64 elapsed_ns, const struct hist* lat)
+{
+    double secs = (double)elapsed_ns / 1e9;
+
+    printf("{\"tool\":\"fsbench\",\"workload\":\"%s\",\"target\":\"%s\","
+           "\"raw\":%d,\"bs\":%lu,\"ops\":%llu,\"elapsed_ns\":%llu,"
+           "\"iops\":%.1f",
+           workload, opts->target, opts->raw, (unsigned long)bytes_per_op,
+           (unsigned long long)lat->count, (unsigned long long)elapsed_ns,
+           secs > 0 ? lat->count / secs : 0.0);
+
+    if (bytes_per_op) {
+        printf(",\"mb_per_sec\":%.2f",
+               secs > 0 ? (double)bytes_per_op * lat->count / secs /
+                              (1024 * 1024)
+                        : 0.0);
+    }
+
+    if (lat->count) {
+        printf(",\"lat_ns\":{\"min\":%llu,\"avg\":%llu,\"p50\":%llu,"
+               "\"p90\":%llu,\"p99\":%llu,\"p999\":%llu,\"max\":%llu}",
+               (unsigned long long)lat->min,
+               (unsigned long long)(lat->total / lat->count),
+               (unsigned long long)hist_percentile(lat, 500),
+               (unsigned long long)hist_percentile(lat, 900),
+               (unsigned long long)hist_percentile(lat, 990),
+               (unsigned long long)hist_percentile(lat, 999),
+               (unsigned long long)lat->max);
+    }
+
+    printf("}\n");
+    fflush(stdout);
+}
+
+void fsbench_error(const char* workload, const char* what, int error)
+{
+    printf("{\"tool\":\"fsbench\",\"workload\":\"%s\",\"status\":\"error\","
+           "\"what\":\"%s\",\"error\":%d}\n",
+           workload, what, error);
+    fflush(stdout);
+}
+
+/* xorshift32, seeded with -S so that random offsets are reproducible. */
+unsigned int fsbench_rand(void)
+{
+    unsigned int x = rand_state;
+
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+
+    return rand_state = x;
+}
+
+int main(int argc, char* argv[])
+{
+    struct fsbench_opts opts;
+    const char* wname = "all";
+    struct workload* w;
+    u64 size;
+    int secs, retval, status = EXIT_SUCCESS, found = 0;
+
+    fsbench_prog = argv[0];
+
+    memset(&opts, 0, sizeof(opts));
+    opts.block_size = DEF_BLOCK_SIZE;
+    opts.file_size = DEF_FILE_SIZE;
+    opts.duration_ns = DEF_DURATION * 1000000000ULL;
+    opts.nr_files = DEF_NR_FILES;
+    opts.sync_every = -1;
+    opts.seed = 1;
+
+    while (--argc) {
+        ++argv;
+
+        if (strcmp(*argv, "-w") == 0) {
+            if (--argc == 0) usage();
+            wname = *++argv;
+        } else if (strcmp(*argv, "-b") == 0) {
+            if (--argc == 0 || parse_size(*++argv, &size) != 0) usage();
+            opts.block_size = size;
+        } else if (strcmp(*argv, "-s") == 0) {
+            if (--argc == 0 || parse_size(*++argv, &opts.file_size) != 0)
+                usage();
+        } else if (strcmp(*argv, "-t") == 0) {
+            if (--argc == 0) usage();
+            if (sscanf(*++argv, "%d", &secs) != 1 || secs <= 0) usage();
+            opts.duration_ns = secs * 1000000000ULL;
+        } else if (strcmp(*argv, "-n") == 0) {
+            if (--argc == 0) usage();
+            if (sscanf(*++argv, "%d", &opts.nr_files) != 1 ||
+                opts.nr_files <= 0)
+                usage();
+        } else if (strcmp(*argv, "-f") == 0) {
+            if (--argc == 0) usage();
+            if (sscanf(*++argv, "%d", &opts.sync_every) != 1 ||
+                opts.sync_every < 0)
+                usage();
+        } else if (strcmp(*argv, "-S") == 0) {
+            if (--argc == 0) usage();
+            if (sscanf(*++argv, "%u", &opts.seed) != 1) usage();
+        } else if (strcmp(*argv, "-k") == 0) {
+            opts.keep = 1;
+        } else if (strcmp(*argv, "-r") == 0) {
+            opts.raw = 1;
+        } else if (strcmp(*argv, "-F") == 0) {
+            opts.force = 1;
+        } else if (**argv == '-' || opts.target) {
+            usage();
+        } else {
+            opts.target = *argv;
+        }
+    }
+
+    if (!opts.target || opts.block_size > opts.file_size) usage();
+
+    clock_init();
+
+    for (w = workloads; w->name; w++) {
+        if (strcmp(wname, "all") != 0 && strcmp(wname, w->name) != 0)
+            continue;
+        found = 1;
+
+        if (opts.raw && !w->raw) continue;
+
+        /* raw writes destroy whatever is on the device */
+        if (opts.raw && w->write && !opts.force) {
+            if (strcmp(wname, "all") != 0) {
+                fprintf(stderr, "%s: raw writes need -F\n", fsbench_prog);
+                return EXIT_FAILURE;
+            }
+            continue;
+        }
+
+        rand_state = opts.seed ? opts.seed : 1;
+
+        if ((retval = w->run(w, &opts)) != 0) {
+            fsbench_error(w->name, "run", retval);
+            status = EXIT_FAILURE;
+        }
+    }
+
+    if (!found) usage();
+
+    return status;
+}
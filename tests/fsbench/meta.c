@@ -0,0 +1,129 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <limits.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "fsbench.h"
+
+#define META_DIR "fsbench.d"
+
+enum meta_phase { PHASE_CREATE, PHASE_STAT, PHASE_UNLINK, NR_PHASES };
+
+static const char* phase_names[] = {
+    [PHASE_CREATE] = "meta.create",
+    [PHASE_STAT] = "meta.stat",
+    [PHASE_UNLINK] = "meta.unlink",
+};
+
+static char dir_path[PATH_MAX];
+
+static void file_path(char* buf, size_t len, int i)
+{
+    snprintf(buf, len, "%s/f%08x", dir_path, i);
+}
+
+static int meta_op(enum meta_phase phase, const char* path)
+{
+    struct stat sbuf;
+    int fd;
+
+    switch (phase) {
+    case PHASE_CREATE:
+        fd = open(path, O_WRONLY | O_CREAT | O_EXCL, 0644);
+        if (fd < 0) return errno;
+        close(fd);
+        return 0;
+    case PHASE_STAT:
+        return stat(path, &sbuf) == 0 ? 0 : errno;
+    case PHASE_UNLINK:
+        return unlink(path) == 0 ? 0 : errno;
+    default:
+        return EINVAL;
+    }
+}
+
+/* Stat in random order so that directory lookups cannot just follow the
+ * insertion order. */
+static void shuffle(int* order, int n)
+{
+    int i, j, tmp;
+
+    for (i = n - 1; i > 0; i--) {
+        j = fsbench_rand() % (i + 1);
+        tmp = order[i];
+        order[i] = order[j];
+        order[j] = tmp;
+    }
+}
+
+/* Create, stat and unlink nr_files files in one fresh directory and report
+ * each phase separately. */
+int run_meta(const struct workload* w, const struct fsbench_opts* opts)
+{
+    char path[PATH_MAX];
+    struct hist* lat;
+    int *order, phase, i, retval = 0;
+    u64 start, op_start, now;
+
+    snprintf(dir_path, sizeof(dir_path), "%s/%s", opts->target, META_DIR);
+
+    lat = malloc(sizeof(*lat));
+    order = malloc(sizeof(int) * opts->nr_files);
+    if (!lat || !order) {
+        retval = ENOMEM;
+        goto out;
+    }
+
+    for (i = 0; i < opts->nr_files; i++)
+        order[i] = i;
+
+    if (mkdir(dir_path, 0755) != 0) {
+        retval = errno;
+        goto out;
+    }
+
+    for (phase = 0; phase < NR_PHASES; phase++) {
+        hist_init(lat);
+
+        if (phase == PHASE_STAT) shuffle(order, opts->nr_files);
+
+        start = now = clock_now_ns();
+
+        for (i = 0; i < opts->nr_files; i++) {
+            file_path(path, sizeof(path),
+                      phase == PHASE_UNLINK ? i : order[i]);
+
+            op_start = now;
+            if ((retval = meta_op(phase, path)) != 0) break;
+
+            now = clock_now_ns();
+            hist_add(lat, now - op_start);
+        }
+
+        if (retval) {
+            fsbench_error(phase_names[phase], path, retval);
+            break;
+        }
+
+        fsbench_report(phase_names[phase], opts, 0, now - start, lat);
+    }
+
+    /* clean up after a failed phase */
+    if (retval) {
+        for (i = 0; i < opts->nr_files; i++) {
+            file_path(path, sizeof(path), i);
+            unlink(path);
+        }
+    }
+
+    rmdir(dir_path);
+
+out:
+    free(lat);
+    free(order);
+    return retval;
+}
@@ -18,6 +18,10 @@ static const MunitSuite all_suites[] = {
     {(char*)"/inotify", inotify_tests, NULL, 0, MUNIT_SUITE_OPTION_NONE},
     {(char*)"/pty", pty_tests, NULL, 0, MUNIT_SUITE_OPTION_NONE},
     {(char*)"/tcp", tcp_tests, NULL, 0, MUNIT_SUITE_OPTION_NONE},
+    {(char*)"/vfs_ring", vfs_ring_tests, NULL, 0, MUNIT_SUITE_OPTION_NONE},
+    {(char*)"/procfs", procfs_tests, NULL, 0, MUNIT_SUITE_OPTION_NONE},
+    {(char*)"/spawn", spawn_tests, NULL, 0, MUNIT_SUITE_OPTION_NONE},
+    {(char*)"/sysv_ipc", sysv_ipc_tests, NULL, 0, MUNIT_SUITE_OPTION_NONE},
     {NULL, NULL, NULL, 0, MUNIT_SUITE_OPTION_NONE},
 };
 
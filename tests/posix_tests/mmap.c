@@ -6,6 +6,8 @@
 #include <string.h>
 #include <limits.h>
 #include <sys/mman.h>
+#include <fcntl.h>
+#include <errno.h>
 
 #include "munit/munit.h"
 
@@ -122,9 +124,285 @@ static MunitResult test_shared_filemap(const MunitParameter params[],
     return MUNIT_OK;
 }
 
+static MunitResult test_shared_filemap_coherent(const MunitParameter params[],
+                                                void* data)
+{
+#define TEST_FILE_SIZE (160 * 1024)
+#define TEST_MAP_OFFSET 4096
+    char template[] = "/tmp/mmap-test-XXXXXX";
+    unsigned char *buf, *map;
+    int tmpfd, rdfd;
+    int i, n, ok;
+
+    tmpfd = mkstemp(template);
+    munit_assert_int(tmpfd, >=, 0);
+
+    buf = malloc(TEST_FILE_SIZE);
+    munit_assert_not_null(buf);
+    for (i = 0; i < TEST_FILE_SIZE; i++) {
+        buf[i] = (i * 7) & 0xff;
+    }
+
+    n = write(tmpfd, buf, TEST_FILE_SIZE);
+    munit_assert_int(n, ==, TEST_FILE_SIZE);
+
+    /* the mapping spans several chunks of the file */
+    map = mmap(NULL, TEST_FILE_SIZE - TEST_MAP_OFFSET, PROT_READ | PROT_WRITE,
+               MAP_SHARED, tmpfd, TEST_MAP_OFFSET);
+    munit_assert_ptr(map, !=, MAP_FAILED);
+
+    ok = !memcmp(map, buf + TEST_MAP_OFFSET, TEST_FILE_SIZE - TEST_MAP_OFFSET);
+    munit_assert(ok);
+
+    /* stores through the mapping are seen by read() */
+    map[100000] = 0x5a;
+    n = pread(tmpfd, buf, 1, TEST_MAP_OFFSET + 100000);
+    munit_assert_int(n, ==, 1);
+    munit_assert_int(buf[0], ==, 0x5a);
+
+    /* and write() is seen by the mapping */
+    buf[0] = 0xa5;
+    n = pwrite(tmpfd, buf, 1, TEST_MAP_OFFSET + 70000);
+    munit_assert_int(n, ==, 1);
+    munit_assert_int(map[70000], ==, 0xa5);
+
+    munmap(map, TEST_FILE_SIZE - TEST_MAP_OFFSET);
+
+    /* a writable shared mapping needs a writable descriptor */
+    rdfd = open(template, O_RDONLY);
+    munit_assert_int(rdfd, >=, 0);
+    map = mmap(NULL, 4096, PROT_READ | PROT_WRITE, MAP_SHARED, rdfd, 0);
+    munit_assert_ptr(map, ==, MAP_FAILED);
+    munit_assert_int(errno, ==, EACCES);
+    close(rdfd);
+
+    free(buf);
+    close(tmpfd);
+    unlink(template);
+
+    return MUNIT_OK;
+}
+
+static MunitResult test_shared_filemap_lifetime(const MunitParameter params[],
+                                                void* data)
+{
+#define LIFETIME_TEST_SIZE (160 * 1024)
+    char template[] = "/tmp/mmap-test-XXXXXX";
+    unsigned char* map;
+    unsigned char c;
+    int fd, i, n;
+
+    fd = mkstemp(template);
+    munit_assert_int(fd, >=, 0);
+    munit_assert_int(ftruncate(fd, LIFETIME_TEST_SIZE), ==, 0);
+
+    map = mmap(NULL, LIFETIME_TEST_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED,
+               fd, 0);
+    munit_assert_ptr(map, !=, MAP_FAILED);
+
+    /* shrink the file under the mapping and grow it back, the mapping and
+     * the file must still share the pages */
+    munit_assert_int(ftruncate(fd, 0), ==, 0);
+    munit_assert_int(ftruncate(fd, LIFETIME_TEST_SIZE), ==, 0);
+
+    map[LIFETIME_TEST_SIZE - 1] = 0x5a;
+    n = pread(fd, &c, 1, LIFETIME_TEST_SIZE - 1);
+    munit_assert_int(n, ==, 1);
+    munit_assert_int(c, ==, 0x5a);
+
+    /* the mapping outlives the descriptor and the name, untouched pages can
+     * still be faulted in */
+    close(fd);
+    unlink(template);
+
+    for (i = 0; i < LIFETIME_TEST_SIZE; i += 4096)
+        map[i] = i >> 12;
+    for (i = 0; i < LIFETIME_TEST_SIZE; i += 4096)
+        munit_assert_int(map[i], ==, (i >> 12) & 0xff);
+
+    munmap(map, LIFETIME_TEST_SIZE);
+
+    return MUNIT_OK;
+#undef LIFETIME_TEST_SIZE
+}
+
+static MunitResult test_hugetlb(const MunitParameter params[], void* data)
+{
+#define HUGE_TEST_SIZE (8 << 20)
+    size_t pgsize = getpagesize();
+    unsigned char* buf;
+    size_t i;
+    pid_t cpid;
+    int status;
+
+    buf = mmap(NULL, HUGE_TEST_SIZE, PROT_READ | PROT_WRITE,
+               MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    munit_assert_ptr(buf, !=, MAP_FAILED);
+
+    for (i = 0; i < HUGE_TEST_SIZE; i += pgsize) {
+        munit_assert_int(buf[i], ==, 0);
+        buf[i] = (unsigned char)(i / pgsize);
+    }
+
+    /* the child writes to its copy of one page */
+    cpid = fork();
+    munit_assert_int(cpid, >=, 0);
+
+    if (cpid == 0) {
+        for (i = 0; i < HUGE_TEST_SIZE; i += pgsize) {
+            if (buf[i] != (unsigned char)(i / pgsize)) _exit(1);
+        }
+
+        buf[pgsize] = 0xff;
+        _exit(buf[pgsize] == 0xff ? 0 : 1);
+    }
+
+    munit_assert_int(waitpid(cpid, &status, 0), ==, cpid);
+    munit_assert_true(WIFEXITED(status));
+    munit_assert_int(WEXITSTATUS(status), ==, 0);
+    munit_assert_int(buf[pgsize], ==, 1);
+
+    /* punch a hole in the middle of a big page */
+    munit_assert_int(munmap(buf + 3 * pgsize, pgsize), ==, 0);
+
+    munit_assert_int(buf[2 * pgsize], ==, 2);
+    munit_assert_int(buf[4 * pgsize], ==, 4);
+    buf[4 * pgsize] = 0x44;
+    munit_assert_int(buf[4 * pgsize], ==, 0x44);
+
+    munmap(buf, 3 * pgsize);
+    munmap(buf + 4 * pgsize, HUGE_TEST_SIZE - 4 * pgsize);
+
+    return MUNIT_OK;
+#undef HUGE_TEST_SIZE
+}
+
+static MunitResult test_sparse_anon(const MunitParameter params[], void* data)
+{
+#define SPARSE_TEST_SIZE (256 << 20)
+    size_t pgsize = getpagesize();
+    size_t stride = SPARSE_TEST_SIZE / 8;
+    char* buf;
+    size_t i;
+
+    buf = mmap(NULL, SPARSE_TEST_SIZE, PROT_READ | PROT_WRITE,
+               MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    munit_assert_ptr(buf, !=, MAP_FAILED);
+
+    /* touch one page in every stride of the reservation */
+    for (i = 0; i < 8; i++)
+        buf[i * stride + pgsize] = (char)('a' + i);
+
+    /* trim both ends and split the middle */
+    munit_assert_int(munmap(buf, stride), ==, 0);
+    munit_assert_int(munmap(buf + 7 * stride, stride), ==, 0);
+    munit_assert_int(munmap(buf + 4 * stride, pgsize * 2), ==, 0);
+
+    for (i = 1; i < 7; i++) {
+        if (i == 4) continue;
+        munit_assert_int(buf[i * stride + pgsize], ==, 'a' + i);
+    }
+
+    buf[4 * stride + 2 * pgsize] = 'x';
+    munit_assert_int(buf[4 * stride + 2 * pgsize], ==, 'x');
+
+    munmap(buf + stride, 6 * stride);
+
+    return MUNIT_OK;
+#undef SPARSE_TEST_SIZE
+}
+
+static MunitResult test_file_read_coherent(const MunitParameter params[],
+                                           void* data)
+{
+#define READ_TEST_SIZE (3 * 4096 + 100)
+    /* on the root filesystem so that reads go through the page cache */
+    char template[] = "/page-cache-test-XXXXXX";
+    static char buf[READ_TEST_SIZE], rdbuf[READ_TEST_SIZE];
+    int fd, i;
+
+    for (i = 0; i < READ_TEST_SIZE; i++)
+        buf[i] = 'a' + i % 26;
+
+    fd = mkstemp(template);
+    munit_assert_int(fd, >=, 0);
+    munit_assert_int(write(fd, buf, READ_TEST_SIZE), ==, READ_TEST_SIZE);
+
+    /* the first read fills the cache, the second one is served from it */
+    for (i = 0; i < 2; i++) {
+        memset(rdbuf, 0, sizeof(rdbuf));
+        munit_assert_int(pread(fd, rdbuf, READ_TEST_SIZE, 0), ==,
+                         READ_TEST_SIZE);
+        munit_assert_memory_equal(READ_TEST_SIZE, rdbuf, buf);
+    }
+
+    /* an unaligned read across page boundaries */
+    munit_assert_int(pread(fd, rdbuf, 5000, 4000), ==, 5000);
+    munit_assert_memory_equal(5000, rdbuf, buf + 4000);
+
+    /* writes must be visible to later reads */
+    memset(buf + 4090, 'X', 20);
+    munit_assert_int(pwrite(fd, buf + 4090, 20, 4090), ==, 20);
+    munit_assert_int(pread(fd, rdbuf, READ_TEST_SIZE, 0), ==, READ_TEST_SIZE);
+    munit_assert_memory_equal(READ_TEST_SIZE, rdbuf, buf);
+
+    /* nothing is read past the end of a truncated file */
+    munit_assert_int(ftruncate(fd, 5000), ==, 0);
+    munit_assert_int(pread(fd, rdbuf, READ_TEST_SIZE, 0), ==, 5000);
+    munit_assert_memory_equal(5000, rdbuf, buf);
+    munit_assert_int(pread(fd, rdbuf, 100, 8192), ==, 0);
+
+    close(fd);
+    unlink(template);
+
+    return MUNIT_OK;
+#undef READ_TEST_SIZE
+}
+
+static MunitResult test_file_read_hole(const MunitParameter params[],
+                                       void* data)
+{
+    char template[] = "/page-cache-test-XXXXXX";
+    static char buf[3 * 4096];
+    int fd, i, j;
+
+    fd = mkstemp(template);
+    munit_assert_int(fd, >=, 0);
+
+    /* leave a hole of two blocks before the data */
+    munit_assert_int(pwrite(fd, "end", 3, 2 * 4096), ==, 3);
+
+    /* twice so that the second read comes from the cache */
+    for (i = 0; i < 2; i++) {
+        memset(buf, 'x', sizeof(buf));
+        munit_assert_int(pread(fd, buf, sizeof(buf), 0), ==, 2 * 4096 + 3);
+
+        for (j = 0; j < 2 * 4096; j++)
+            munit_assert_int(buf[j], ==, 0);
+        munit_assert_memory_equal(3, buf + 2 * 4096, "end");
+    }
+
+    close(fd);
+    unlink(template);
+
+    return MUNIT_OK;
+}
+
 MunitTest mmap_tests[] = {
     {(char*)"/shared-anon", test_shared_anon, NULL, NULL,
      MUNIT_TEST_OPTION_NONE, NULL},
     {(char*)"/shared-filemap", test_shared_filemap, NULL, NULL,
      MUNIT_TEST_OPTION_NONE, NULL},
+    {(char*)"/shared-filemap-coherent", test_shared_filemap_coherent, NULL,
+     NULL, MUNIT_TEST_OPTION_NONE, NULL},
+    {(char*)"/shared-filemap-lifetime", test_shared_filemap_lifetime, NULL,
+     NULL, MUNIT_TEST_OPTION_NONE, NULL},
+    {(char*)"/hugetlb", test_hugetlb, NULL, NULL, MUNIT_TEST_OPTION_NONE,
+     NULL},
+    {(char*)"/sparse-anon", test_sparse_anon, NULL, NULL,
+     MUNIT_TEST_OPTION_NONE, NULL},
+    {(char*)"/file-read-coherent", test_file_read_coherent, NULL, NULL,
+     MUNIT_TEST_OPTION_NONE, NULL},
+    {(char*)"/file-read-hole", test_file_read_hole, NULL, NULL,
+     MUNIT_TEST_OPTION_NONE, NULL},
     {NULL, NULL, NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL}};
@@ -0,0 +1,161 @@
+#include <unistd.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <string.h>
+#include <fcntl.h>
+#include <errno.h>
+
+#include "munit/munit.h"
+
+static int read_file(const char* path, char* buf, size_t size)
+{
+    int fd, n;
+
+    fd = open(path, O_RDONLY);
+    if (fd < 0) return -1;
+
+    n = read(fd, buf, size - 1);
+    close(fd);
+
+    if (n < 0) return -1;
+    buf[n] = '\0';
+
+    return n;
+}
+
+static MunitResult test_procfs_stat(const MunitParameter params[], void* data)
+{
+    char buf[512];
+    char comm[64];
+    char state;
+    int pid, ppid;
+    unsigned long utime, stime;
+    char* p;
+
+    munit_assert_int(read_file("/proc/self/stat", buf, sizeof(buf)), >, 0);
+
+    munit_assert_int(sscanf(buf, "%d (%63[^)]) %c %d", &pid, comm, &state,
+                            &ppid),
+                     ==, 4);
+    munit_assert_int(pid, ==, getpid());
+    munit_assert_int(ppid, ==, getppid());
+    /* we are blocked on the read while procfs looks at us */
+    munit_assert_not_null(strchr("RS", state));
+
+    /* utime and stime are the 14th and 15th fields */
+    p = strrchr(buf, ')');
+    munit_assert_not_null(p);
+    munit_assert_int(sscanf(p + 2, "%*c %*d %*d %*d %*d %*d %*u %*u %*u %*u "
+                                   "%*u %lu %lu",
+                            &utime, &stime),
+                     ==, 2);
+
+    return MUNIT_OK;
+}
+
+static MunitResult test_procfs_statm(const MunitParameter params[], void* data)
+{
+    char buf[128];
+    unsigned long size, resident, shared, text, lib, dat;
+    static char touched[16 * 4096];
+    unsigned long resident2;
+
+    munit_assert_int(read_file("/proc/self/statm", buf, sizeof(buf)), >, 0);
+    munit_assert_int(sscanf(buf, "%lu %lu %lu %lu %lu %lu", &size, &resident,
+                            &shared, &text, &lib, &dat),
+                     ==, 6);
+
+    munit_assert_ulong(size, >, 0);
+    munit_assert_ulong(resident, >, 0);
+    munit_assert_ulong(resident, <=, size);
+    munit_assert_ulong(text, >, 0);
+
+    /* fault in some bss pages */
+    memset(touched, 1, sizeof(touched));
+
+    munit_assert_int(read_file("/proc/self/statm", buf, sizeof(buf)), >, 0);
+    munit_assert_int(sscanf(buf, "%*u %lu", &resident2), ==, 1);
+    munit_assert_ulong(resident2, >=, resident);
+
+    return MUNIT_OK;
+}
+
+static MunitResult test_procfs_io(const MunitParameter params[], void* data)
+{
+    char buf[256];
+    char block[100];
+    unsigned long long rchar, wchar, syscr, syscw;
+    unsigned long long wchar2, syscw2;
+    int pfd[2];
+
+    munit_assert_int(read_file("/proc/self/io", buf, sizeof(buf)), >, 0);
+    munit_assert_int(sscanf(buf, "rchar: %llu wchar: %llu syscr: %llu "
+                                 "syscw: %llu",
+                            &rchar, &wchar, &syscr, &syscw),
+                     ==, 4);
+    munit_assert_ullong(syscr, >, 0);
+
+    munit_assert_int(pipe(pfd), ==, 0);
+    memset(block, 'x', sizeof(block));
+    munit_assert_int(write(pfd[1], block, sizeof(block)), ==, sizeof(block));
+    munit_assert_int(read(pfd[0], block, sizeof(block)), ==, sizeof(block));
+    close(pfd[0]);
+    close(pfd[1]);
+
+    munit_assert_int(read_file("/proc/self/io", buf, sizeof(buf)), >, 0);
+    munit_assert_int(sscanf(buf, "rchar: %*u wchar: %llu syscr: %*u "
+                                 "syscw: %llu",
+                            &wchar2, &syscw2),
+                     ==, 2);
+    munit_assert_ullong(wchar2, >=, wchar + sizeof(block));
+    munit_assert_ullong(syscw2, >=, syscw + 1);
+
+    return MUNIT_OK;
+}
+
+static MunitResult test_procfs_new_pid(const MunitParameter params[],
+                                       void* data)
+{
+    char path[32];
+    char buf[512];
+    int pfd[2];
+    pid_t pid;
+    char c;
+
+    munit_assert_int(pipe(pfd), ==, 0);
+
+    pid = fork();
+    munit_assert_int(pid, >=, 0);
+
+    if (pid == 0) {
+        close(pfd[1]);
+        read(pfd[0], &c, 1);
+        _exit(0);
+    }
+
+    close(pfd[0]);
+
+    /* the snapshot is refreshed for the new process */
+    snprintf(path, sizeof(path), "/proc/%d/stat", pid);
+    munit_assert_int(read_file(path, buf, sizeof(buf)), >, 0);
+    munit_assert_int(atoi(buf), ==, pid);
+
+    write(pfd[1], &c, 1);
+    close(pfd[1]);
+    munit_assert_int(waitpid(pid, NULL, 0), ==, pid);
+
+    return MUNIT_OK;
+}
+
+MunitTest procfs_tests[] = {
+    {(char*)"/procfs-stat", test_procfs_stat, NULL, NULL,
+     MUNIT_TEST_OPTION_NONE, NULL},
+    {(char*)"/procfs-statm", test_procfs_statm, NULL, NULL,
+     MUNIT_TEST_OPTION_NONE, NULL},
+    {(char*)"/procfs-io", test_procfs_io, NULL, NULL, MUNIT_TEST_OPTION_NONE,
+     NULL},
+    {(char*)"/procfs-new-pid", test_procfs_new_pid, NULL, NULL,
+     MUNIT_TEST_OPTION_NONE, NULL},
+    {NULL, NULL, NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL}};
@@ -0,0 +1,122 @@
+#include <unistd.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <spawn.h>
+#include <string.h>
+#include <fcntl.h>
+#include <errno.h>
+
+#include "munit/munit.h"
+
+extern char** environ;
+
+static const char* shell = "/bin/sh";
+
+static int wait_exit_status(pid_t pid)
+{
+    int status;
+
+    munit_assert_int(waitpid(pid, &status, 0), ==, pid);
+    munit_assert_true(WIFEXITED(status));
+
+    return WEXITSTATUS(status);
+}
+
+static MunitResult test_vfork(const MunitParameter params[], void* data)
+{
+    volatile int shared = 0;
+    pid_t pid;
+
+    pid = vfork();
+    munit_assert_int(pid, >=, 0);
+
+    if (pid == 0) {
+        shared = 1;
+        _exit(3);
+    }
+
+    munit_assert_int(wait_exit_status(pid), ==, 3);
+
+#if defined(__i386__) || defined(__x86_64__)
+    /* the child ran in our address space */
+    munit_assert_int(shared, ==, 1);
+#endif
+
+    return MUNIT_OK;
+}
+
+static MunitResult test_posix_spawn(const MunitParameter params[], void* data)
+{
+    char* argv[] = {(char*)"sh", (char*)"-c", (char*)"exit 7", NULL};
+    pid_t pid;
+
+    if (access(shell, X_OK) != 0) return MUNIT_SKIP;
+
+    munit_assert_int(posix_spawn(&pid, shell, NULL, NULL, argv, environ), ==,
+                     0);
+    munit_assert_int(wait_exit_status(pid), ==, 7);
+
+    return MUNIT_OK;
+}
+
+static MunitResult test_posix_spawn_file_actions(const MunitParameter params[],
+                                                 void* data)
+{
+    char* argv[] = {(char*)"sh", (char*)"-c", (char*)"echo spawned", NULL};
+    posix_spawn_file_actions_t fa;
+    char buf[32];
+    int fds[2];
+    pid_t pid;
+    int n;
+
+    if (access(shell, X_OK) != 0) return MUNIT_SKIP;
+
+    munit_assert_int(pipe(fds), ==, 0);
+
+    munit_assert_int(posix_spawn_file_actions_init(&fa), ==, 0);
+    munit_assert_int(posix_spawn_file_actions_adddup2(&fa, fds[1], 1), ==, 0);
+    munit_assert_int(posix_spawn_file_actions_addclose(&fa, fds[0]), ==, 0);
+    munit_assert_int(posix_spawn_file_actions_addclose(&fa, fds[1]), ==, 0);
+
+    munit_assert_int(posix_spawnp(&pid, "sh", &fa, NULL, argv, environ), ==,
+                     0);
+    posix_spawn_file_actions_destroy(&fa);
+    close(fds[1]);
+
+    munit_assert_int(wait_exit_status(pid), ==, 0);
+
+    n = read(fds[0], buf, sizeof(buf) - 1);
+    munit_assert_int(n, ==, 8);
+    buf[n] = '\0';
+    munit_assert_string_equal(buf, "spawned\n");
+
+    close(fds[0]);
+
+    return MUNIT_OK;
+}
+
+static MunitResult test_posix_spawn_enoent(const MunitParameter params[],
+                                           void* data)
+{
+    char* argv[] = {(char*)"missing", NULL};
+    pid_t pid;
+
+    /* the error comes back from the child instead of an exit status */
+    munit_assert_int(posix_spawn(&pid, "/nonexistent/missing", NULL, NULL,
+                                 argv, environ),
+                     ==, ENOENT);
+
+    return MUNIT_OK;
+}
+
+MunitTest spawn_tests[] = {
+    {(char*)"/vfork", test_vfork, NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL},
+    {(char*)"/posix-spawn", test_posix_spawn, NULL, NULL,
+     MUNIT_TEST_OPTION_NONE, NULL},
+    {(char*)"/posix-spawn-file-actions", test_posix_spawn_file_actions, NULL,
+     NULL, MUNIT_TEST_OPTION_NONE, NULL},
+    {(char*)"/posix-spawn-enoent", test_posix_spawn_enoent, NULL, NULL,
+     MUNIT_TEST_OPTION_NONE, NULL},
+    {NULL, NULL, NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL}};
@@ -13,5 +13,9 @@ extern MunitTest netlink_tests[];
 extern MunitTest inotify_tests[];
 extern MunitTest pty_tests[];
 extern MunitTest tcp_tests[];
+extern MunitTest vfs_ring_tests[];
+extern MunitTest procfs_tests[];
+extern MunitTest spawn_tests[];
+extern MunitTest sysv_ipc_tests[];
 
 #endif
@@ -0,0 +1,238 @@
+#include <unistd.h>
+#include <stdio.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <sys/ipc.h>
+#include <sys/shm.h>
+#include <sys/sem.h>
+#include <sys/msg.h>
+#include <string.h>
+#include <errno.h>
+
+#include "munit/munit.h"
+
+static MunitResult test_shm_rmid_after_detach(const MunitParameter params[],
+                                              void* data)
+{
+#define SHM_TEST_SIZE 8192
+    struct shmid_ds ds;
+    char *a, *b;
+    pid_t pid;
+    int shmid, status;
+
+    shmid = shmget(IPC_PRIVATE, SHM_TEST_SIZE, IPC_CREAT | 0600);
+    munit_assert_int(shmid, >=, 0);
+
+    a = shmat(shmid, NULL, 0);
+    munit_assert_ptr(a, !=, (void*)-1);
+    b = shmat(shmid, NULL, 0);
+    munit_assert_ptr(b, !=, (void*)-1);
+    munit_assert_ptr(a, !=, b);
+
+    /* both attaches share the pages, and so does a forked child */
+    strcpy(a, "hello");
+    munit_assert_string_equal(b, "hello");
+
+    pid = fork();
+    munit_assert_int(pid, >=, 0);
+    if (pid == 0) {
+        strcpy(b + SHM_TEST_SIZE - 6, "child");
+        _exit(0);
+    }
+    munit_assert_int(waitpid(pid, &status, 0), ==, pid);
+    munit_assert_string_equal(a + SHM_TEST_SIZE - 6, "child");
+
+    munit_assert_int(shmctl(shmid, IPC_STAT, &ds), ==, 0);
+    munit_assert_int(ds.shm_segsz, ==, SHM_TEST_SIZE);
+    munit_assert_int(ds.shm_nattch, ==, 2);
+
+    /* the segment outlives IPC_RMID until the last detach */
+    munit_assert_int(shmctl(shmid, IPC_RMID, NULL), ==, 0);
+    munit_assert_int(shmdt(a), ==, 0);
+
+    munit_assert_int(shmctl(shmid, IPC_STAT, &ds), ==, 0);
+    munit_assert_int(ds.shm_nattch, ==, 1);
+    munit_assert_string_equal(b, "hello");
+
+    munit_assert_int(shmdt(b), ==, 0);
+
+    munit_assert_int(shmctl(shmid, IPC_STAT, &ds), ==, -1);
+    munit_assert_int(errno, ==, EINVAL);
+    munit_assert_ptr(shmat(shmid, NULL, 0), ==, (void*)-1);
+
+    /* not attached any more */
+    munit_assert_int(shmdt(b), ==, -1);
+    munit_assert_int(errno, ==, EINVAL);
+
+    return MUNIT_OK;
+#undef SHM_TEST_SIZE
+}
+
+static MunitResult test_sem_block_wakeup(const MunitParameter params[],
+                                         void* data)
+{
+    struct sembuf op;
+    pid_t pid;
+    int semid, status, i;
+
+    semid = semget(IPC_PRIVATE, 1, IPC_CREAT | 0600);
+    munit_assert_int(semid, >=, 0);
+    munit_assert_int(semctl(semid, 0, SETVAL, 0), ==, 0);
+
+    /* nothing to take, don't wait */
+    op.sem_num = 0;
+    op.sem_op = -1;
+    op.sem_flg = IPC_NOWAIT;
+    munit_assert_int(semop(semid, &op, 1), ==, -1);
+    munit_assert_int(errno, ==, EAGAIN);
+
+    pid = fork();
+    munit_assert_int(pid, >=, 0);
+    if (pid == 0) {
+        op.sem_flg = 0;
+        _exit(semop(semid, &op, 1) == 0 ? 0 : 1);
+    }
+
+    /* wait for the child to go to sleep on the semaphore */
+    for (i = 0; i < 1000 && semctl(semid, 0, GETNCNT) != 1; i++)
+        usleep(1000);
+    munit_assert_int(semctl(semid, 0, GETNCNT), ==, 1);
+    munit_assert_int(waitpid(pid, &status, WNOHANG), ==, 0);
+
+    op.sem_op = 1;
+    op.sem_flg = 0;
+    munit_assert_int(semop(semid, &op, 1), ==, 0);
+
+    munit_assert_int(waitpid(pid, &status, 0), ==, pid);
+    munit_assert_true(WIFEXITED(status));
+    munit_assert_int(WEXITSTATUS(status), ==, 0);
+
+    munit_assert_int(semctl(semid, 0, GETVAL), ==, 0);
+    munit_assert_int(semctl(semid, 0, GETNCNT), ==, 0);
+
+    munit_assert_int(semctl(semid, 0, IPC_RMID), ==, 0);
+
+    return MUNIT_OK;
+}
+
+static MunitResult test_sem_ctl_semnum(const MunitParameter params[],
+                                       void* data)
+{
+    unsigned short vals[3] = {1, 2, 3};
+    int semid;
+
+    semid = semget(IPC_PRIVATE, 3, IPC_CREAT | 0600);
+    munit_assert_int(semid, >=, 0);
+
+    /* commands that don't read anything return 0 whatever semnum is */
+    munit_assert_int(semctl(semid, 2, SETALL, vals), ==, 0);
+    munit_assert_int(semctl(semid, 1, SETVAL, 5), ==, 0);
+    munit_assert_int(semctl(semid, 1, GETVAL), ==, 5);
+    munit_assert_int(semctl(semid, 2, GETVAL), ==, 3);
+
+    memset(vals, 0, sizeof(vals));
+    munit_assert_int(semctl(semid, 2, GETALL, vals), ==, 0);
+    munit_assert_int(vals[0], ==, 1);
+    munit_assert_int(vals[1], ==, 5);
+    munit_assert_int(vals[2], ==, 3);
+
+    munit_assert_int(semctl(semid, 2, IPC_RMID), ==, 0);
+    munit_assert_int(semctl(semid, 0, GETVAL), ==, -1);
+
+    return MUNIT_OK;
+}
+
+struct test_msg {
+    long mtype;
+    char mtext[16];
+};
+
+static void send_msg(int msqid, long type, const char* text)
+{
+    struct test_msg msg;
+
+    msg.mtype = type;
+    strcpy(msg.mtext, text);
+    munit_assert_int(msgsnd(msqid, &msg, strlen(text) + 1, 0), ==, 0);
+}
+
+static MunitResult test_msg_type_select(const MunitParameter params[],
+                                        void* data)
+{
+    struct test_msg msg;
+    struct msqid_ds ds;
+    pid_t pid;
+    int msqid, status;
+
+    msqid = msgget(IPC_PRIVATE, IPC_CREAT | 0600);
+    munit_assert_int(msqid, >=, 0);
+
+    send_msg(msqid, 3, "three");
+    send_msg(msqid, 1, "one");
+    send_msg(msqid, 2, "two");
+
+    munit_assert_int(msgctl(msqid, IPC_STAT, &ds), ==, 0);
+    munit_assert_int(ds.msg_qnum, ==, 3);
+
+    /* an exact type skips the older messages */
+    munit_assert_int(msgrcv(msqid, &msg, sizeof(msg.mtext), 2, 0), ==, 4);
+    munit_assert_long(msg.mtype, ==, 2);
+    munit_assert_string_equal(msg.mtext, "two");
+
+    /* a negative type takes the lowest type up to its absolute value */
+    send_msg(msqid, 2, "two");
+    munit_assert_int(msgrcv(msqid, &msg, sizeof(msg.mtext), -2, 0), ==, 4);
+    munit_assert_long(msg.mtype, ==, 1);
+
+    munit_assert_int(msgrcv(msqid, &msg, sizeof(msg.mtext), 3, MSG_EXCEPT),
+                     ==, 4);
+    munit_assert_long(msg.mtype, ==, 2);
+
+    /* too big unless it may be cut */
+    munit_assert_int(msgrcv(msqid, &msg, 2, 0, 0), ==, -1);
+    munit_assert_int(errno, ==, E2BIG);
+    munit_assert_int(msgrcv(msqid, &msg, 2, 0, MSG_NOERROR), ==, 2);
+    munit_assert_long(msg.mtype, ==, 3);
+    munit_assert_memory_equal(2, msg.mtext, "th");
+
+    munit_assert_int(msgrcv(msqid, &msg, sizeof(msg.mtext), 0, IPC_NOWAIT),
+                     ==, -1);
+    munit_assert_int(errno, ==, ENOMSG);
+
+    /* a receiver waiting for one type is not woken by another */
+    pid = fork();
+    munit_assert_int(pid, >=, 0);
+    if (pid == 0) {
+        if (msgrcv(msqid, &msg, sizeof(msg.mtext), 5, 0) != 5) _exit(1);
+        _exit(strcmp(msg.mtext, "five") ? 1 : 0);
+    }
+
+    send_msg(msqid, 4, "four");
+    usleep(10000);
+    munit_assert_int(waitpid(pid, &status, WNOHANG), ==, 0);
+
+    send_msg(msqid, 5, "five");
+    munit_assert_int(waitpid(pid, &status, 0), ==, pid);
+    munit_assert_true(WIFEXITED(status));
+    munit_assert_int(WEXITSTATUS(status), ==, 0);
+
+    munit_assert_int(msgrcv(msqid, &msg, sizeof(msg.mtext), 0, IPC_NOWAIT),
+                     ==, 5);
+    munit_assert_long(msg.mtype, ==, 4);
+
+    munit_assert_int(msgctl(msqid, IPC_RMID, NULL), ==, 0);
+    munit_assert_int(msgsnd(msqid, &msg, 5, IPC_NOWAIT), ==, -1);
+
+    return MUNIT_OK;
+}
+
+MunitTest sysv_ipc_tests[] = {
+    {(char*)"/shm-rmid-after-detach", test_shm_rmid_after_detach, NULL, NULL,
+     MUNIT_TEST_OPTION_NONE, NULL},
+    {(char*)"/sem-block-wakeup", test_sem_block_wakeup, NULL, NULL,
+     MUNIT_TEST_OPTION_NONE, NULL},
+    {(char*)"/sem-ctl-semnum", test_sem_ctl_semnum, NULL, NULL,
+     MUNIT_TEST_OPTION_NONE, NULL},
+    {(char*)"/msg-type-select", test_msg_type_select, NULL, NULL,
+     MUNIT_TEST_OPTION_NONE, NULL},
+    {NULL, NULL, NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL}};
@@ -508,6 +508,70 @@ static MunitResult test_socketpair(const MunitParameter params[], void* data)
     return MUNIT_OK;
 }
 
+static MunitResult test_socketpair_bufsize(const MunitParameter params[],
+                                           void* data)
+{
+#define LARGE_SIZE (100 * 1024)
+    unsigned char *wbuf, *rbuf;
+    int fds[2];
+    int val, retval;
+    socklen_t len;
+    ssize_t n, total, queued;
+
+    retval = socketpair(AF_UNIX, SOCK_STREAM, 0, fds);
+    munit_assert_int(retval, ==, 0);
+
+    wbuf = malloc(LARGE_SIZE);
+    rbuf = malloc(LARGE_SIZE);
+    munit_assert_not_null(wbuf);
+    munit_assert_not_null(rbuf);
+    for (n = 0; n < LARGE_SIZE; n++) {
+        wbuf[n] = n % 251;
+    }
+
+    /* a large write is queued in pieces and read back intact */
+    n = write(fds[0], wbuf, LARGE_SIZE);
+    munit_assert_int(n, ==, LARGE_SIZE);
+
+    for (total = 0; total < LARGE_SIZE; total += n) {
+        n = read(fds[1], rbuf + total, LARGE_SIZE - total);
+        munit_assert_int(n, >, 0);
+    }
+    munit_assert_memory_equal(LARGE_SIZE, rbuf, wbuf);
+
+    /* the receive buffer limits how much can be queued */
+    val = 4096;
+    retval = setsockopt(fds[1], SOL_SOCKET, SO_RCVBUF, &val, sizeof(val));
+    munit_assert_int(retval, ==, 0);
+
+    len = sizeof(val);
+    retval = getsockopt(fds[1], SOL_SOCKET, SO_RCVBUF, &val, &len);
+    munit_assert_int(retval, ==, 0);
+    munit_assert_int(val, ==, 8192);
+
+    for (queued = 0; queued < LARGE_SIZE; queued += n) {
+        n = send(fds[0], wbuf, 1000, MSG_DONTWAIT);
+        if (n < 0) break;
+    }
+    munit_assert_int(n, <, 0);
+    munit_assert_int(errno, ==, EAGAIN);
+    munit_assert_int(queued, >, 0);
+    munit_assert_int(queued, <, LARGE_SIZE);
+
+    for (total = 0; total < queued; total += n) {
+        n = read(fds[1], rbuf, LARGE_SIZE);
+        munit_assert_int(n, >, 0);
+    }
+    munit_assert_int(total, ==, queued);
+
+    free(wbuf);
+    free(rbuf);
+    close(fds[0]);
+    close(fds[1]);
+
+    return MUNIT_OK;
+}
+
 static int run_client_fds(int event_fd)
 {
     int sock_fd;
@@ -714,4 +778,6 @@ MunitTest uds_tests[] = {
      MUNIT_TEST_OPTION_NONE, NULL},
     {(char*)"/socketpair", test_socketpair, NULL, NULL, MUNIT_TEST_OPTION_NONE,
      NULL},
+    {(char*)"/socketpair-bufsize", test_socketpair_bufsize, NULL, NULL,
+     MUNIT_TEST_OPTION_NONE, NULL},
     {NULL, NULL, NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL}};
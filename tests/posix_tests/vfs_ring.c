@@ -0,0 +1,237 @@
+#include <unistd.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <sys/vfs_ring.h>
+#include <string.h>
+#include <fcntl.h>
+#include <errno.h>
+
+#include "munit/munit.h"
+
+static struct vfs_ring_cqe wait_cqe(struct vfs_ring* ring)
+{
+    struct vfs_ring_cqe* cqe;
+    struct vfs_ring_cqe copy;
+
+    cqe = vfs_ring_peek_cqe(ring);
+    if (!cqe) {
+        munit_assert_int(vfs_ring_submit_and_wait(ring, 1), >=, 0);
+        cqe = vfs_ring_peek_cqe(ring);
+    }
+    munit_assert_not_null(cqe);
+
+    copy = *cqe;
+    vfs_ring_cqe_seen(ring);
+
+    return copy;
+}
+
+static MunitResult test_vfs_ring_nop(const MunitParameter params[],
+                                     void* data)
+{
+    struct vfs_ring ring;
+    struct vfs_ring_sqe* sqe;
+    struct vfs_ring_cqe cqe;
+    int i, retval;
+
+    retval = vfs_ring_init(&ring, 8, 0, 0);
+    munit_assert_int(retval, ==, 0);
+
+    for (i = 0; i < 8; i++) {
+        sqe = vfs_ring_get_sqe(&ring);
+        munit_assert_not_null(sqe);
+        sqe->opcode = VRING_OP_NOP;
+        sqe->user_data = i;
+    }
+
+    /* the SQ is full */
+    munit_assert_null(vfs_ring_get_sqe(&ring));
+
+    retval = vfs_ring_submit_and_wait(&ring, 8);
+    munit_assert_int(retval, ==, 8);
+
+    /* completions come back in submission order */
+    for (i = 0; i < 8; i++) {
+        cqe = wait_cqe(&ring);
+        munit_assert_int(cqe.res, ==, 0);
+        munit_assert_int(cqe.user_data, ==, i);
+    }
+
+    munit_assert_null(vfs_ring_peek_cqe(&ring));
+
+    vfs_ring_exit(&ring);
+
+    return MUNIT_OK;
+}
+
+static MunitResult test_vfs_ring_read_write(const MunitParameter params[],
+                                            void* data)
+{
+    char tempfile[] = "/tmp/vfs-ring-test-XXXXXX";
+    const char* msg = "hello, ring";
+    struct vfs_ring ring;
+    struct vfs_ring_sqe* sqe;
+    struct vfs_ring_cqe cqe;
+    struct stat sbuf;
+    char buf[32];
+    int fd, retval;
+
+    fd = mkstemp(tempfile);
+    munit_assert_int(fd, >=, 0);
+
+    retval = vfs_ring_init(&ring, 4, 0, 0);
+    munit_assert_int(retval, ==, 0);
+
+    /* write at the file position */
+    sqe = vfs_ring_get_sqe(&ring);
+    vfs_ring_prep_rw(sqe, VRING_OP_WRITE, fd, (void*)msg, strlen(msg), -1);
+    sqe->flags |= VRSQE_LINK;
+
+    /* then read back part of it at an explicit offset */
+    memset(buf, 0, sizeof(buf));
+    sqe = vfs_ring_get_sqe(&ring);
+    vfs_ring_prep_rw(sqe, VRING_OP_READ, fd, buf, 4, 7);
+    sqe->flags |= VRSQE_LINK;
+
+    sqe = vfs_ring_get_sqe(&ring);
+    sqe->opcode = VRING_OP_FSTAT;
+    sqe->fd = fd;
+    sqe->addr2 = (__u64)(unsigned long)&sbuf;
+
+    retval = vfs_ring_submit_and_wait(&ring, 3);
+    munit_assert_int(retval, ==, 3);
+
+    cqe = wait_cqe(&ring);
+    munit_assert_int(cqe.res, ==, strlen(msg));
+    cqe = wait_cqe(&ring);
+    munit_assert_int(cqe.res, ==, 4);
+    munit_assert_memory_equal(4, buf, "ring");
+    cqe = wait_cqe(&ring);
+    munit_assert_int(cqe.res, ==, 0);
+    munit_assert_int(sbuf.st_size, ==, strlen(msg));
+
+    /* the positioned read leaves the file position alone */
+    munit_assert_int(lseek(fd, 0, SEEK_CUR), ==, strlen(msg));
+
+    vfs_ring_exit(&ring);
+    close(fd);
+    unlink(tempfile);
+
+    return MUNIT_OK;
+}
+
+static MunitResult test_vfs_ring_link_cancel(const MunitParameter params[],
+                                             void* data)
+{
+    struct vfs_ring ring;
+    struct vfs_ring_sqe* sqe;
+    struct vfs_ring_cqe cqe;
+    char buf[8];
+    int retval;
+
+    retval = vfs_ring_init(&ring, 4, 0, 0);
+    munit_assert_int(retval, ==, 0);
+
+    sqe = vfs_ring_get_sqe(&ring);
+    vfs_ring_prep_rw(sqe, VRING_OP_READ, -1, buf, sizeof(buf), -1);
+    sqe->flags |= VRSQE_LINK;
+
+    sqe = vfs_ring_get_sqe(&ring);
+    sqe->opcode = VRING_OP_NOP;
+
+    /* not linked to the failed chain */
+    sqe = vfs_ring_get_sqe(&ring);
+    sqe->opcode = VRING_OP_NOP;
+
+    retval = vfs_ring_submit_and_wait(&ring, 3);
+    munit_assert_int(retval, ==, 3);
+
+    cqe = wait_cqe(&ring);
+    munit_assert_int(cqe.res, ==, -EBADF);
+    cqe = wait_cqe(&ring);
+    munit_assert_int(cqe.res, ==, -ECANCELED);
+    cqe = wait_cqe(&ring);
+    munit_assert_int(cqe.res, ==, 0);
+
+    vfs_ring_exit(&ring);
+
+    return MUNIT_OK;
+}
+
+static MunitResult test_vfs_ring_fixed(const MunitParameter params[],
+                                       void* data)
+{
+    const char* path = "/etc/passwd";
+    struct vfs_ring ring;
+    struct vfs_ring_sqe* sqe;
+    struct vfs_ring_cqe cqe;
+    struct iovec iov;
+    char fixed[64], buf[64];
+    int fd, n, retval;
+
+    fd = open(path, O_RDONLY);
+    if (fd < 0) return MUNIT_SKIP;
+    n = read(fd, buf, sizeof(buf));
+    munit_assert_int(n, >, 0);
+    close(fd);
+
+    retval = vfs_ring_init(&ring, 4, VRING_SETUP_SQPOLL, 100);
+    munit_assert_int(retval, ==, 0);
+
+    iov.iov_base = fixed;
+    iov.iov_len = sizeof(fixed);
+    retval = vfs_ring_register_buffers(&ring, &iov, 1);
+    munit_assert_int(retval, ==, 0);
+
+    sqe = vfs_ring_get_sqe(&ring);
+    sqe->opcode = VRING_OP_OPENAT;
+    sqe->fd = AT_FDCWD;
+    sqe->addr = (__u64)(unsigned long)path;
+    sqe->len = strlen(path);
+    sqe->op_flags = O_RDONLY;
+
+    retval = vfs_ring_submit_and_wait(&ring, 1);
+    munit_assert_int(retval, ==, 1);
+    cqe = wait_cqe(&ring);
+    munit_assert_int(cqe.res, >=, 0);
+    fd = cqe.res;
+
+    memset(fixed, 0, sizeof(fixed));
+    sqe = vfs_ring_get_sqe(&ring);
+    vfs_ring_prep_rw(sqe, VRING_OP_READ_FIXED, fd, fixed, sizeof(fixed), 0);
+    sqe->buf_index = 0;
+
+    sqe = vfs_ring_get_sqe(&ring);
+    sqe->opcode = VRING_OP_CLOSE;
+    sqe->fd = fd;
+
+    retval = vfs_ring_submit_and_wait(&ring, 2);
+    munit_assert_int(retval, ==, 2);
+
+    cqe = wait_cqe(&ring);
+    munit_assert_int(cqe.res, ==, n);
+    munit_assert_memory_equal(n, fixed, buf);
+    cqe = wait_cqe(&ring);
+    munit_assert_int(cqe.res, ==, 0);
+
+    retval = vfs_ring_unregister_buffers(&ring);
+    munit_assert_int(retval, ==, 0);
+
+    vfs_ring_exit(&ring);
+
+    return MUNIT_OK;
+}
+
+MunitTest vfs_ring_tests[] = {
+    {(char*)"/vfs-ring-nop", test_vfs_ring_nop, NULL, NULL,
+     MUNIT_TEST_OPTION_NONE, NULL},
+    {(char*)"/vfs-ring-read-write", test_vfs_ring_read_write, NULL, NULL,
+     MUNIT_TEST_OPTION_NONE, NULL},
+    {(char*)"/vfs-ring-link-cancel", test_vfs_ring_link_cancel, NULL, NULL,
+     MUNIT_TEST_OPTION_NONE, NULL},
+    {(char*)"/vfs-ring-fixed", test_vfs_ring_fixed, NULL, NULL,
+     MUNIT_TEST_OPTION_NONE, NULL},
+    {NULL, NULL, NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL}};
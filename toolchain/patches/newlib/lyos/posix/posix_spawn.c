@@ -80,10 +80,10 @@ argument is unspecified.
 PORTABILITY
 POSIX.1-2008 requires <<posix_spawn>> and <<posix_spawnp>>.
 
-Supporting OS subroutines required: <<_close>>, <<dup2>>, <<_fcntl>>,
-<<_execve>>, <<execvpe>>, <<_exit>>, <<_open>>, <<sigaction>>,
-<<sigprocmask>>, <<waitpid>>, <<sched_setscheduler>>,
-<<sched_setparam>>, <<setegid>>, <<seteuid>>, <<setpgid>>, <<vfork>>.
+Supporting OS subroutines required: <<_close>>, <<dup2>>, <<fcntl>>,
+<<_execve>>, <<_exit>>, <<_open>>, <<sigaction>>, <<sigprocmask>>,
+<<waitpid>>, <<sched_setscheduler>>, <<sched_setparam>>, <<setegid>>,
+<<seteuid>>, <<setpgid>>, <<clone>>, <<mmap>>, <<vfork>>.
 */
 
 #ifndef _NO_POSIX_SPAWN
@@ -93,6 +93,8 @@ Supporting OS subroutines required: <<_close>>, <<dup2>>, <<_fcntl>>,
 #include <sys/signal.h>
 #include <sys/queue.h>
 #include <sys/wait.h>
+#include <sys/mman.h>
+#include <sys/syslimits.h>
 
 #include <errno.h>
 #include <fcntl.h>
@@ -206,16 +208,14 @@ static int process_file_actions_entry(posix_spawn_file_actions_entry_t* fae)
                 if (errno == EBADF) return (EBADF);
             }
         }
-#ifdef HAVE_FCNTL
-        if (_fcntl(fae->fae_fildes, F_SETFD, 0) == -1) return (errno);
-#endif /* HAVE_FCNTL */
         break;
     case FAE_DUP2:
-        /* Perform a dup2() */
-        if (dup2(fae->fae_fildes, fae->fae_newfildes) == -1) return (errno);
-#ifdef HAVE_FCNTL
-        if (_fcntl(fae->fae_newfildes, F_SETFD, 0) == -1) return (errno);
-#endif /* HAVE_FCNTL */
+        /* Perform a dup2(), which leaves the descriptor alone if both are the
+         * same, so clear close-on-exec by hand then */
+        if (fae->fae_fildes == fae->fae_newfildes) {
+            if (fcntl(fae->fae_fildes, F_SETFD, 0) == -1) return (errno);
+        } else if (dup2(fae->fae_fildes, fae->fae_newfildes) == -1)
+            return (errno);
         break;
     case FAE_CLOSE:
         /* Perform a close(), do not fail if already closed */
@@ -239,40 +239,149 @@ static int process_file_actions(const posix_spawn_file_actions_t fa)
     return (0);
 }
 
+/* execve() builds the ARG_MAX argument block on the stack and the PATH
+ * search needs a PATH_MAX buffer on top of it, leave room for the rest of
+ * the call chain. */
+#define SPAWN_STACK_SIZE \
+    (((ARG_MAX + PATH_MAX + 64 * 1024) + 4095) & ~(size_t)4095)
+/* Left unmapped below the stack so that an overflow faults in the child
+ * instead of scribbling over the parent's memory. */
+#define SPAWN_GUARD_SIZE 4096
+
+struct spawn_args {
+    const char* path;
+    const posix_spawn_file_actions_t* fa;
+    const posix_spawnattr_t* sa;
+    char* const* argv;
+    char* const* envp;
+    int use_env_path;
+    const char* env_path;
+    sigset_t oldmask;
+    volatile int error;
+};
+
+static void spawn_execvpe(const struct spawn_args* args)
+{
+    const char *p, *end;
+    char buf[PATH_MAX];
+    size_t dir_len, name_len;
+    int seen_eacces = 0;
+
+    if (!args->use_env_path || strchr(args->path, '/')) {
+        execve(args->path, args->argv, args->envp);
+        return;
+    }
+
+    name_len = strlen(args->path);
+    for (p = args->env_path; p; p = *end ? end + 1 : NULL) {
+        end = strchr(p, ':');
+        if (!end) end = p + strlen(p);
+
+        /* an empty entry means the current directory */
+        dir_len = end - p;
+        if (dir_len + name_len + 2 > sizeof(buf)) continue;
+
+        memcpy(buf, p, dir_len);
+        if (dir_len) buf[dir_len++] = '/';
+        memcpy(buf + dir_len, args->path, name_len + 1);
+
+        execve(buf, args->argv, args->envp);
+
+        if (errno == EACCES)
+            seen_eacces = 1;
+        else if (errno != ENOENT && errno != ENOTDIR)
+            return;
+    }
+
+    if (seen_eacces) errno = EACCES;
+}
+
+/* Runs in the child on its own stack while sharing the parent's address
+ * space. The parent is suspended until we exec or exit. */
+static int spawn_child(void* arg)
+{
+    struct spawn_args* args = arg;
+    int error;
+
+    if (args->sa != NULL) {
+        error = process_spawnattr(*args->sa);
+        if (error) goto fail;
+    }
+    if (args->fa != NULL) {
+        error = process_file_actions(*args->fa);
+        if (error) goto fail;
+    }
+
+    /* the parent blocked every signal around the spawn, put back the mask
+     * it had unless the attributes asked for another one */
+    if (args->sa == NULL || !((*args->sa)->sa_flags & POSIX_SPAWN_SETSIGMASK))
+        sigprocmask(SIG_SETMASK, &args->oldmask, NULL);
+
+    spawn_execvpe(args);
+    error = errno;
+
+fail:
+    args->error = error;
+    _exit(127);
+}
+
 static int do_posix_spawn(pid_t* pid, const char* path,
                           const posix_spawn_file_actions_t* fa,
                           const posix_spawnattr_t* sa, char* const argv[],
                           char* const envp[], int use_env_path)
 {
+    struct spawn_args args;
+    sigset_t allmask;
+    char* stack;
     pid_t p;
-    volatile int error = 0;
-
-    p = vfork();
-    switch (p) {
-    case -1:
-        return (errno);
-    case 0:
-        if (sa != NULL) {
-            error = process_spawnattr(*sa);
-            if (error) _exit(127);
-        }
-        if (fa != NULL) {
-            error = process_file_actions(*fa);
-            if (error) _exit(127);
-        }
-        /* if (use_env_path) */
-        /*      execvpe(path, argv, envp != NULL ? envp : *p_environ); */
-        /* else */
-        execve(path, argv, envp != NULL ? envp : *p_environ);
-        error = errno;
-        _exit(127);
-    default:
-        if (error != 0)
-            waitpid(p, NULL, WNOHANG);
-        else if (pid != NULL)
-            *pid = p;
-        return (error);
+
+    args.path = path;
+    args.fa = fa;
+    args.sa = sa;
+    args.argv = argv;
+    args.envp = envp != NULL ? envp : *p_environ;
+    args.use_env_path = use_env_path;
+    args.env_path = getenv("PATH");
+    if (args.env_path == NULL) args.env_path = "/bin:/usr/bin";
+    args.error = 0;
+
+    stack = mmap(NULL, SPAWN_GUARD_SIZE + SPAWN_STACK_SIZE,
+                 PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (stack == MAP_FAILED) return (ENOMEM);
+
+    /* there is no mprotect(), punch the guard out of the mapping instead */
+    munmap(stack, SPAWN_GUARD_SIZE);
+    stack += SPAWN_GUARD_SIZE;
+
+    /* no handler of ours may run in the child on the shared memory */
+    sigfillset(&allmask);
+    sigprocmask(SIG_BLOCK, &allmask, &args.oldmask);
+
+    /* the child borrows our address space instead of copying it, and we do
+     * not return before it has exec'd or exited */
+    p = clone(spawn_child, stack + SPAWN_STACK_SIZE,
+              CLONE_VM | CLONE_VFORK, &args);
+
+    if (p == -ENOSYS) {
+        /* no clone() on this architecture, vfork() on the current stack */
+        p = vfork();
+        if (p == 0) spawn_child(&args);
+        if (p < 0) p = -errno;
+    }
+
+    sigprocmask(SIG_SETMASK, &args.oldmask, NULL);
+    munmap(stack, SPAWN_STACK_SIZE);
+
+    if (p < 0) return (-p);
+
+    if (args.error != 0) {
+        /* the child has exited already, reap it */
+        waitpid(p, NULL, 0);
+        return (args.error);
     }
+
+    if (pid != NULL) *pid = p;
+    return (0);
 }
 
 int posix_spawn(pid_t* pid, const char* path,
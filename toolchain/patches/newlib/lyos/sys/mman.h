@@ -25,6 +25,7 @@
 #define MAP_FIXED    0x0008
 #define MAP_POPULATE 0x0010
 #define MAP_CONTIG   0x0020
+#define MAP_HUGETLB  0x0040
 
 /*
  * Error indicator returned by mmap(2)
@@ -0,0 +1,35 @@
+#ifndef _SYS_MSG_H_
+#define _SYS_MSG_H_
+
+#include <sys/types.h>
+#include <sys/ipc.h>
+
+/* Flags for `msgrcv'.  */
+#define MSG_NOERROR 010000 /* no error if message is too big */
+#define MSG_EXCEPT  020000 /* recv any msg except of specified type */
+
+typedef unsigned long msgqnum_t;
+typedef unsigned long msglen_t;
+
+struct msqid_ds {
+    struct ipc_perm msg_perm;
+    msgqnum_t msg_qnum;
+    msglen_t msg_qbytes;
+    msglen_t msg_cbytes;
+    pid_t msg_lspid;
+    pid_t msg_lrpid;
+    time_t msg_stime;
+    time_t msg_rtime;
+    time_t msg_ctime;
+};
+
+#define MSGMNI 128   /* max number of message queues */
+#define MSGMAX 8192  /* max size of a message */
+#define MSGMNB 16384 /* default max size of a message queue */
+
+int msgget(key_t key, int msgflg);
+int msgctl(int msqid, int cmd, struct msqid_ds* buf);
+int msgsnd(int msqid, const void* msgp, size_t msgsz, int msgflg);
+ssize_t msgrcv(int msqid, void* msgp, size_t msgsz, long msgtyp, int msgflg);
+
+#endif
@@ -0,0 +1,42 @@
+#ifndef _SYS_SEM_H_
+#define _SYS_SEM_H_
+
+#include <sys/types.h>
+#include <sys/ipc.h>
+
+/* Flags for `semop'.  */
+#define SEM_UNDO 0x1000 /* undo the operation on exit */
+
+/* Commands for `semctl'.  */
+#define GETPID  11 /* get sempid */
+#define GETVAL  12 /* get semval */
+#define GETALL  13 /* get all semval's */
+#define GETNCNT 14 /* get semncnt */
+#define GETZCNT 15 /* get semzcnt */
+#define SETVAL  16 /* set semval */
+#define SETALL  17 /* set all semval's */
+
+struct semid_ds {
+    struct ipc_perm sem_perm;
+    unsigned short sem_nsems;
+    time_t sem_otime;
+    time_t sem_ctime;
+};
+
+struct sembuf {
+    unsigned short sem_num;
+    short sem_op;
+    short sem_flg;
+};
+
+#define SEMMNI 128   /* max number of semaphore sets */
+#define SEMMSL 250   /* max number of semaphores per set */
+#define SEMOPM 32    /* max number of ops per semop call */
+#define SEMVMX 32767 /* max semaphore value */
+#define SEMAEM SEMVMX /* max adjust on exit */
+
+int semget(key_t key, int nsems, int semflg);
+int semctl(int semid, int semnum, int cmd, ...);
+int semop(int semid, struct sembuf* sops, size_t nsops);
+
+#endif
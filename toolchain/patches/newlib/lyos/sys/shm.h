@@ -12,7 +12,9 @@ struct shmid_ds {
     size_t shm_segsz;
     pid_t shm_lpid;
     pid_t shm_cpid;
+    unsigned long shm_nattch;
     time_t shm_atime;
+    time_t shm_dtime;
     time_t shm_ctime;
 };
 
@@ -0,0 +1,104 @@
+#ifndef _SYS_VFS_RING_H
+#define _SYS_VFS_RING_H 1
+
+#include <sys/cdefs.h>
+#include <sys/types.h>
+#include <sys/uio.h>
+#include <lyos/vfs_ring.h>
+
+__BEGIN_DECLS
+
+/* A ring as seen by the process. */
+struct vfs_ring {
+    int id;
+    int flags;
+    void* addr;
+    size_t size;
+
+    struct vfs_ring_hdr* hdr;
+    struct vfs_ring_sqe* sqes;
+    struct vfs_ring_cqe* cqes;
+    unsigned int sq_mask;
+    unsigned int cq_mask;
+
+    unsigned int sq_tail; /* entries handed out but not submitted yet */
+};
+
+/* Raw calls */
+extern int vfs_ring_setup(unsigned int __entries, int __flags,
+                          unsigned int __sq_idle, void** __addr,
+                          size_t* __size);
+extern int vfs_ring_enter(int __ring, unsigned int __to_submit,
+                          unsigned int __min_complete, int __flags);
+extern int vfs_ring_register(int __ring, int __opcode, void* __arg,
+                             unsigned int __nr_args);
+
+/* Create a ring with room for entries submissions. With VRING_SETUP_SQPOLL
+ * VFS keeps polling for new submissions for sq_idle milliseconds. */
+extern int vfs_ring_init(struct vfs_ring* __ring, unsigned int __entries,
+                         int __flags, unsigned int __sq_idle);
+extern void vfs_ring_exit(struct vfs_ring* __ring);
+
+extern int vfs_ring_register_buffers(struct vfs_ring* __ring,
+                                     const struct iovec* __iov,
+                                     unsigned int __nr);
+extern int vfs_ring_unregister_buffers(struct vfs_ring* __ring);
+
+/* Pass the entries taken with vfs_ring_get_sqe() to VFS and wait until at
+ * least wait_nr completions are ready. The call is skipped if VFS is still
+ * polling and nothing has to be waited for. */
+extern int vfs_ring_submit_and_wait(struct vfs_ring* __ring,
+                                    unsigned int __wait_nr);
+
+static inline int vfs_ring_submit(struct vfs_ring* ring)
+{
+    return vfs_ring_submit_and_wait(ring, 0);
+}
+
+/* Get a free submission entry or NULL if the SQ is full. */
+static inline struct vfs_ring_sqe* vfs_ring_get_sqe(struct vfs_ring* ring)
+{
+    struct vfs_ring_sqe* sqe;
+
+    if (ring->sq_tail - ring->hdr->sq_head > ring->sq_mask) return NULL;
+
+    sqe = &ring->sqes[ring->sq_tail++ & ring->sq_mask];
+    sqe->flags = 0;
+    sqe->buf_index = 0;
+    sqe->op_flags = 0;
+    sqe->addr2 = 0;
+    sqe->user_data = 0;
+
+    return sqe;
+}
+
+/* Get the next completion without entering VFS, or NULL if there is none. */
+static inline struct vfs_ring_cqe* vfs_ring_peek_cqe(struct vfs_ring* ring)
+{
+    unsigned int head = ring->hdr->cq_head;
+
+    if (head == ring->hdr->cq_tail) return NULL;
+
+    __sync_synchronize();
+    return &ring->cqes[head & ring->cq_mask];
+}
+
+static inline void vfs_ring_cqe_seen(struct vfs_ring* ring)
+{
+    __sync_synchronize();
+    ring->hdr->cq_head++;
+}
+
+static inline void vfs_ring_prep_rw(struct vfs_ring_sqe* sqe, int opcode,
+                                    int fd, void* buf, size_t len, off_t off)
+{
+    sqe->opcode = opcode;
+    sqe->fd = fd;
+    sqe->addr = (__u64)(unsigned long)buf;
+    sqe->len = len;
+    sqe->off = (off < 0) ? VRING_OFF_CURRENT : (__u64)off;
+}
+
+__END_DECLS
+
+#endif /* sys/vfs_ring.h */
@@ -27,7 +27,10 @@
 #include <sys/ptrace.h>
 #include <sys/statfs.h>
 #include <sys/futex.h>
+#include <sys/sched.h>
 #include <sys/shm.h>
+#include <sys/sem.h>
+#include <sys/msg.h>
 #include <grp.h>
 #include <asm/sigcontext.h>
 
@@ -341,7 +344,33 @@ int fork(void)
     return msg.PID;
 }
 
+#if defined(__i386__) || defined(__x86_64__)
+/* Called by vfork() in __vfork.S to fill in the sendrec message and the
+ * FORK request right after it, so the assembly part only has to trap. */
+void __vfork_prepare(MESSAGE* msgs)
+{
+    MESSAGE* msg = &msgs[1];
+
+    memset(msgs, 0, 2 * sizeof(MESSAGE));
+
+    msg->type = FORK;
+    msg->u.m_pm_clone.flags = CLONE_VM | CLONE_VFORK;
+    msg->u.m_pm_clone.stack = NULL;
+
+    msgs[0].type = NR_SENDREC;
+    msgs[0].SR_FUNCTION = BOTH;
+    msgs[0].SR_SRCDEST = TASK_PM;
+    msgs[0].SR_MSG = msg;
+}
+
+int __vfork_error(int err)
+{
+    errno = err;
+    return -1;
+}
+#else
 int vfork(void) { return fork(); }
+#endif
 
 int kill(int pid, int signo)
 {
@@ -1866,7 +1895,10 @@ int shmget(key_t key, size_t size, int flags)
 
     send_recv(BOTH, TASK_IPC, &m);
 
-    if (m.RETVAL != 0) return -m.RETVAL;
+    if (m.RETVAL != 0) {
+        errno = m.RETVAL;
+        return -1;
+    }
     return m.IPC_RETID;
 }
 
@@ -1883,19 +1915,220 @@ void* shmat(int shmid, const void* shmaddr, int shmflg)
 
     send_recv(BOTH, TASK_IPC, &m);
 
+    if (m.RETVAL != 0) {
+        errno = m.RETVAL;
+        return (void*)-1;
+    }
     return m.IPC_RETADDR;
 }
 
 int shmctl(int shmid, int cmd, struct shmid_ds* buf)
 {
-    errno = ENOSYS;
-    return -1;
+    MESSAGE m;
+    memset(&m, 0, sizeof(MESSAGE));
+
+    m.type = IPC_SHMCTL;
+    m.IPC_ID = shmid;
+    m.IPC_CMD = cmd;
+    m.IPC_ADDR = buf;
+    cmb();
+
+    send_recv(BOTH, TASK_IPC, &m);
+
+    if (m.RETVAL != 0) {
+        errno = m.RETVAL;
+        return -1;
+    }
+    return 0;
 }
 
 int shmdt(const void* shmaddr)
 {
-    errno = ENOSYS;
-    return -1;
+    MESSAGE m;
+    memset(&m, 0, sizeof(MESSAGE));
+
+    m.type = IPC_SHMDT;
+    m.IPC_ADDR = (void*)shmaddr;
+    cmb();
+
+    send_recv(BOTH, TASK_IPC, &m);
+
+    if (m.RETVAL != 0) {
+        errno = m.RETVAL;
+        return -1;
+    }
+    return 0;
+}
+
+int semget(key_t key, int nsems, int semflg)
+{
+    MESSAGE m;
+    memset(&m, 0, sizeof(MESSAGE));
+
+    m.type = IPC_SEMGET;
+    m.IPC_KEY = key;
+    m.IPC_SIZE = nsems;
+    m.IPC_FLAGS = semflg;
+    cmb();
+
+    send_recv(BOTH, TASK_IPC, &m);
+
+    if (m.RETVAL != 0) {
+        errno = m.RETVAL;
+        return -1;
+    }
+    return m.IPC_RETID;
+}
+
+int semctl(int semid, int semnum, int cmd, ...)
+{
+    MESSAGE m;
+    va_list ap;
+    union {
+        int val;
+        struct semid_ds* buf;
+        unsigned short* array;
+    } arg;
+
+    memset(&m, 0, sizeof(MESSAGE));
+    m.type = IPC_SEMCTL;
+    m.IPC_ID = semid;
+    m.IPC_SEMNUM = semnum;
+    m.IPC_CMD = cmd;
+
+    switch (cmd) {
+    case SETVAL:
+        va_start(ap, cmd);
+        arg.val = va_arg(ap, int);
+        va_end(ap);
+        m.IPC_VAL = arg.val;
+        break;
+    case IPC_STAT:
+    case IPC_SET:
+        va_start(ap, cmd);
+        arg.buf = va_arg(ap, struct semid_ds*);
+        va_end(ap);
+        m.IPC_ADDR = arg.buf;
+        break;
+    case GETALL:
+    case SETALL:
+        va_start(ap, cmd);
+        arg.array = va_arg(ap, unsigned short*);
+        va_end(ap);
+        m.IPC_ADDR = arg.array;
+        break;
+    }
+    cmb();
+
+    send_recv(BOTH, TASK_IPC, &m);
+
+    if (m.RETVAL != 0) {
+        errno = m.RETVAL;
+        return -1;
+    }
+    return m.IPC_RETNUM;
+}
+
+int semop(int semid, struct sembuf* sops, size_t nsops)
+{
+    MESSAGE m;
+    memset(&m, 0, sizeof(MESSAGE));
+
+    m.type = IPC_SEMOP;
+    m.IPC_ID = semid;
+    m.IPC_ADDR = sops;
+    m.IPC_SIZE = nsops;
+    cmb();
+
+    send_recv(BOTH, TASK_IPC, &m);
+
+    if (m.RETVAL != 0) {
+        errno = m.RETVAL;
+        return -1;
+    }
+    return 0;
+}
+
+int msgget(key_t key, int msgflg)
+{
+    MESSAGE m;
+    memset(&m, 0, sizeof(MESSAGE));
+
+    m.type = IPC_MSGGET;
+    m.IPC_KEY = key;
+    m.IPC_FLAGS = msgflg;
+    cmb();
+
+    send_recv(BOTH, TASK_IPC, &m);
+
+    if (m.RETVAL != 0) {
+        errno = m.RETVAL;
+        return -1;
+    }
+    return m.IPC_RETID;
+}
+
+int msgctl(int msqid, int cmd, struct msqid_ds* buf)
+{
+    MESSAGE m;
+    memset(&m, 0, sizeof(MESSAGE));
+
+    m.type = IPC_MSGCTL;
+    m.IPC_ID = msqid;
+    m.IPC_CMD = cmd;
+    m.IPC_ADDR = buf;
+    cmb();
+
+    send_recv(BOTH, TASK_IPC, &m);
+
+    if (m.RETVAL != 0) {
+        errno = m.RETVAL;
+        return -1;
+    }
+    return 0;
+}
+
+int msgsnd(int msqid, const void* msgp, size_t msgsz, int msgflg)
+{
+    MESSAGE m;
+    memset(&m, 0, sizeof(MESSAGE));
+
+    m.type = IPC_MSGSND;
+    m.IPC_ID = msqid;
+    m.IPC_ADDR = (void*)msgp;
+    m.IPC_SIZE = msgsz;
+    m.IPC_FLAGS = msgflg;
+    cmb();
+
+    send_recv(BOTH, TASK_IPC, &m);
+
+    if (m.RETVAL != 0) {
+        errno = m.RETVAL;
+        return -1;
+    }
+    return 0;
+}
+
+ssize_t msgrcv(int msqid, void* msgp, size_t msgsz, long msgtyp, int msgflg)
+{
+    MESSAGE m;
+    memset(&m, 0, sizeof(MESSAGE));
+
+    m.type = IPC_MSGRCV;
+    m.IPC_ID = msqid;
+    m.IPC_ADDR = msgp;
+    m.IPC_SIZE = msgsz;
+    m.IPC_MSGTYP = msgtyp;
+    m.IPC_FLAGS = msgflg;
+    cmb();
+
+    send_recv(BOTH, TASK_IPC, &m);
+
+    if (m.RETVAL != 0) {
+        errno = m.RETVAL;
+        return -1;
+    }
+    return m.IPC_RETNUM;
 }
 
 int getentropy(void* buffer, size_t length)
@@ -0,0 +1,144 @@
+#include <sys/vfs_ring.h>
+#include <sys/mman.h>
+#include <lyos/types.h>
+#include <lyos/ipc.h>
+#include <lyos/const.h>
+#include <string.h>
+#include <errno.h>
+
+int vfs_ring_setup(unsigned int entries, int flags, unsigned int sq_idle,
+                   void** addr, size_t* size)
+{
+    MESSAGE msg;
+
+    memset(&msg, 0, sizeof(msg));
+    msg.type = RING_SETUP;
+    msg.u.m_vfs_ring.entries = entries;
+    msg.u.m_vfs_ring.flags = flags;
+    msg.u.m_vfs_ring.sq_idle = sq_idle;
+
+    __asm__ __volatile__("" ::: "memory");
+
+    send_recv(BOTH, TASK_FS, &msg);
+
+    if (msg.RETVAL < 0) {
+        errno = -msg.RETVAL;
+        return -1;
+    }
+
+    *addr = msg.u.m_vfs_ring.addr;
+    *size = msg.u.m_vfs_ring.size;
+
+    return msg.RETVAL;
+}
+
+int vfs_ring_enter(int ring, unsigned int to_submit, unsigned int min_complete,
+                   int flags)
+{
+    MESSAGE msg;
+
+    memset(&msg, 0, sizeof(msg));
+    msg.type = RING_ENTER;
+    msg.u.m_vfs_ring.ring = ring;
+    msg.u.m_vfs_ring.to_submit = to_submit;
+    msg.u.m_vfs_ring.min_complete = min_complete;
+    msg.u.m_vfs_ring.flags = flags;
+
+    __asm__ __volatile__("" ::: "memory");
+
+    send_recv(BOTH, TASK_FS, &msg);
+
+    if (msg.RETVAL < 0) {
+        errno = -msg.RETVAL;
+        return -1;
+    }
+
+    return msg.RETVAL;
+}
+
+int vfs_ring_register(int ring, int opcode, void* arg, unsigned int nr_args)
+{
+    MESSAGE msg;
+
+    memset(&msg, 0, sizeof(msg));
+    msg.type = RING_REGISTER;
+    msg.u.m_vfs_ring.ring = ring;
+    msg.u.m_vfs_ring.opcode = opcode;
+    msg.u.m_vfs_ring.addr = arg;
+    msg.u.m_vfs_ring.nr_args = nr_args;
+
+    __asm__ __volatile__("" ::: "memory");
+
+    send_recv(BOTH, TASK_FS, &msg);
+
+    if (msg.RETVAL < 0) {
+        errno = -msg.RETVAL;
+        return -1;
+    }
+
+    return 0;
+}
+
+int vfs_ring_init(struct vfs_ring* ring, unsigned int entries, int flags,
+                  unsigned int sq_idle)
+{
+    int id;
+
+    memset(ring, 0, sizeof(*ring));
+
+    id = vfs_ring_setup(entries, flags, sq_idle, &ring->addr, &ring->size);
+    if (id < 0) return -1;
+
+    ring->id = id;
+    ring->flags = flags;
+    ring->hdr = ring->addr;
+    ring->sqes = ring->addr + ring->hdr->sqes_off;
+    ring->cqes = ring->addr + ring->hdr->cqes_off;
+    ring->sq_mask = ring->hdr->sq_entries - 1;
+    ring->cq_mask = ring->hdr->cq_entries - 1;
+    ring->sq_tail = ring->hdr->sq_tail;
+
+    return 0;
+}
+
+void vfs_ring_exit(struct vfs_ring* ring)
+{
+    /* VFS unmaps the ring from us */
+    vfs_ring_register(ring->id, VRING_RELEASE, NULL, 0);
+    ring->hdr = NULL;
+}
+
+int vfs_ring_register_buffers(struct vfs_ring* ring, const struct iovec* iov,
+                              unsigned int nr)
+{
+    return vfs_ring_register(ring->id, VRING_REGISTER_BUFFERS, (void*)iov, nr);
+}
+
+int vfs_ring_unregister_buffers(struct vfs_ring* ring)
+{
+    return vfs_ring_register(ring->id, VRING_UNREGISTER_BUFFERS, NULL, 0);
+}
+
+int vfs_ring_submit_and_wait(struct vfs_ring* ring, unsigned int wait_nr)
+{
+    struct vfs_ring_hdr* hdr = ring->hdr;
+    unsigned int submitted = ring->sq_tail - hdr->sq_tail;
+    int flags = 0;
+
+    /* make the entries visible before the new tail */
+    __sync_synchronize();
+    hdr->sq_tail = ring->sq_tail;
+    __sync_synchronize();
+
+    if (wait_nr) {
+        if (hdr->cq_tail - hdr->cq_head >= wait_nr) return submitted;
+        flags |= VRING_ENTER_GETEVENTS;
+    } else if (!(hdr->flags & VRING_SQ_NEED_WAKEUP)) {
+        /* VFS is still polling the SQ */
+        return submitted;
+    }
+
+    if (vfs_ring_enter(ring->id, submitted, wait_nr, flags) < 0) return -1;
+
+    return submitted;
+}
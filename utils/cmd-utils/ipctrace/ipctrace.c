@@ -0,0 +1,257 @@
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <unistd.h>
+#include <lyos/profile.h>
+
+#define DEF_DURATION   5
+#define DRAIN_INTERVAL 100000 /* us */
+#define DRAIN_RECORDS  32768
+
+#define NR_BUCKETS 20 /* log2 buckets of microseconds */
+#define NR_SLOTS   4096
+
+#define BY_SOURCE 0x1
+#define SHOW_HIST 0x2
+
+struct ipc_stat {
+    int used;
+    int event;
+    endpoint_t src;
+    endpoint_t dest;
+    int type;
+
+    unsigned long count;
+    unsigned long blocked;
+    unsigned long long total_wait;
+    unsigned long long max_wait;
+    unsigned long hist[NR_BUCKETS];
+};
+
+static const char* prog_name;
+static int duration = DEF_DURATION;
+static int options = 0;
+static char* outfile = NULL;
+static FILE* foutput;
+
+static struct kprof_ipc_record* records;
+static struct kprof_ipc_info info;
+static struct ipc_stat stats[NR_SLOTS];
+static int nr_stats;
+
+static const char* event_names[] = {
+    [KPROF_IPC_SEND] = "send",
+    [KPROF_IPC_NOTIFY] = "notify",
+    [KPROF_IPC_ASYNC] = "async",
+    [KPROF_IPC_CALL] = "call",
+};
+
+static void usage(void)
+{
+    fprintf(stderr, "usage: %s [-t seconds] [-o rawfile] [-s] [-H]\n",
+            prog_name);
+    exit(EXIT_FAILURE);
+}
+
+static void die(int error, const char* msg)
+{
+    fprintf(stderr, "%s: %s (%d)\n", prog_name, msg, error);
+    exit(EXIT_FAILURE);
+}
+
+static int parse_args(int argc, char* argv[])
+{
+    prog_name = argv[0];
+
+    while (--argc) {
+        ++argv;
+
+        if (strcmp(*argv, "-t") == 0) {
+            if (--argc == 0) return EINVAL;
+            if (sscanf(*++argv, "%d", &duration) != 1) return EINVAL;
+        } else if (strcmp(*argv, "-o") == 0) {
+            if (--argc == 0) return EINVAL;
+            outfile = *++argv;
+        } else if (strcmp(*argv, "-s") == 0) {
+            options |= BY_SOURCE;
+        } else if (strcmp(*argv, "-H") == 0) {
+            options |= SHOW_HIST;
+        } else {
+            return EINVAL;
+        }
+    }
+
+    return 0;
+}
+
+static int bucket_of(unsigned long long ns)
+{
+    unsigned long long us = ns / 1000;
+    int b = 0;
+
+    while (us > 1 && b < NR_BUCKETS - 1) {
+        us >>= 1;
+        b++;
+    }
+
+    return b;
+}
+
+static struct ipc_stat* get_stat(const struct kprof_ipc_record* rec)
+{
+    endpoint_t src = (options & BY_SOURCE) ? rec->src : 0;
+    unsigned int hash;
+    struct ipc_stat* st;
+
+    hash = ((unsigned int)rec->event * 31 + (unsigned int)src) * 31 +
+           (unsigned int)rec->dest;
+    hash = (hash * 31 + (unsigned int)rec->type) % NR_SLOTS;
+
+    for (;;) {
+        st = &stats[hash];
+
+        if (!st->used) {
+            if (nr_stats == NR_SLOTS - 1) return NULL;
+
+            st->used = 1;
+            st->event = rec->event;
+            st->src = src;
+            st->dest = rec->dest;
+            st->type = rec->type;
+            nr_stats++;
+            return st;
+        }
+
+        if (st->event == rec->event && st->src == src &&
+            st->dest == rec->dest && st->type == rec->type)
+            return st;
+
+        hash = (hash + 1) % NR_SLOTS;
+    }
+}
+
+static void account(const struct kprof_ipc_record* rec, int count)
+{
+    int i;
+
+    for (i = 0; i < count; i++, rec++) {
+        struct ipc_stat* st = get_stat(rec);
+        if (!st) continue;
+
+        st->count++;
+        if (rec->flags & KPROF_IPC_BLOCKED) st->blocked++;
+        st->total_wait += rec->wait;
+        if (rec->wait > st->max_wait) st->max_wait = rec->wait;
+        st->hist[bucket_of(rec->wait)]++;
+    }
+}
+
+static int drain(int action)
+{
+    size_t size = DRAIN_RECORDS * sizeof(struct kprof_ipc_record);
+    int retval, count;
+
+    retval = kprof(action, size, 0, &info, records);
+    if (retval) return retval;
+
+    count = info.mem_used / sizeof(struct kprof_ipc_record);
+    account(records, count);
+
+    if (foutput && count) {
+        if (fwrite(records, sizeof(struct kprof_ipc_record), count, foutput) !=
+            count)
+            die(errno, "cannot write to output");
+    }
+
+    return 0;
+}
+
+/* Upper bound in us of the bucket holding the given percentile. */
+static unsigned long percentile(const struct ipc_stat* st, int pct)
+{
+    unsigned long seen = 0, target = (st->count * pct + 99) / 100;
+    int b;
+
+    for (b = 0; b < NR_BUCKETS; b++) {
+        seen += st->hist[b];
+        if (seen >= target) break;
+    }
+
+    return 2UL << b;
+}
+
+static int compare_stat(const void* a, const void* b)
+{
+    const struct ipc_stat* sa = a;
+    const struct ipc_stat* sb = b;
+
+    if (sa->used != sb->used) return sb->used - sa->used;
+    if (sa->total_wait != sb->total_wait)
+        return sa->total_wait < sb->total_wait ? 1 : -1;
+    if (sa->count != sb->count) return sa->count < sb->count ? 1 : -1;
+    return 0;
+}
+
+static void print_report(void)
+{
+    int i, b;
+
+    qsort(stats, NR_SLOTS, sizeof(stats[0]), compare_stat);
+
+    printf("# records %d dropped %d\n", info.records, info.dropped);
+    printf("%-7s %6s %6s %6s %10s %10s %12s %10s %10s %10s\n", "event", "src",
+           "dest", "type", "count", "blocked", "total_us", "avg_us",
+           "p99_us", "max_us");
+
+    for (i = 0; i < nr_stats; i++) {
+        struct ipc_stat* st = &stats[i];
+
+        printf("%-7s %6d %6d %6d %10lu %10lu %12llu %10llu %10lu %10llu\n",
+               event_names[st->event], st->src, st->dest, st->type,
+               st->count, st->blocked, st->total_wait / 1000,
+               st->total_wait / 1000 / st->count, percentile(st, 99),
+               st->max_wait / 1000);
+
+        if (options & SHOW_HIST) {
+            printf("  hist");
+            for (b = 0; b < NR_BUCKETS; b++) {
+                printf(" %lu", st->hist[b]);
+            }
+            printf("\n");
+        }
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    int retval, elapsed;
+
+    if (parse_args(argc, argv)) usage();
+
+    records = malloc(DRAIN_RECORDS * sizeof(struct kprof_ipc_record));
+    if (!records) die(ENOMEM, "cannot allocate trace buffer");
+
+    if (outfile) {
+        foutput = fopen(outfile, "wb");
+        if (!foutput) die(errno, "cannot open output file");
+    }
+
+    if ((retval = kprof(KPROF_IPC_START, 0, 0, NULL, NULL)) != 0)
+        die(retval, "cannot start tracing");
+
+    for (elapsed = 0; elapsed < duration * 1000000; elapsed += DRAIN_INTERVAL) {
+        usleep(DRAIN_INTERVAL);
+
+        if ((retval = drain(KPROF_IPC_DRAIN)) != 0) break;
+    }
+
+    if ((retval = drain(KPROF_IPC_STOP)) != 0)
+        die(retval, "cannot stop tracing");
+
+    if (foutput) fclose(foutput);
+
+    print_report();
+
+    return EXIT_SUCCESS;
+}
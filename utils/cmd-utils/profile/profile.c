@@ -2,14 +2,18 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <errno.h>
+#include <unistd.h>
 #include <lyos/profile.h>
 
-#define START 1
-#define STOP 2
+#define START  1
+#define STOP   2
+#define RECORD 3
 
 #define DEF_FREQ 6
 #define DEF_OUTFILE "profile.out"
 #define DEF_MEMSIZE 4
+#define DEF_DURATION 10
+#define DRAIN_INTERVAL 100000 /* us */
 
 #define OUTPUT_MAGIC 0x4652504b /* kprf */
 
@@ -19,12 +23,15 @@ static char* outfile = "";
 static FILE* foutput;
 static int freq = 0;
 static size_t memsize = 0;
+static int duration = 0;
 static char* sample_buf = NULL;
 static struct kprof_info kprof_info;
+static size_t total_used = 0;
 
 static int parse_args(int argc, char* argv[]);
 static int start();
 static int stop();
+static int record();
 
 void die(int error, const char* msg)
 {
@@ -46,6 +53,9 @@ int main(int argc, char* argv[])
     case STOP:
         if (stop()) return EXIT_FAILURE;
         break;
+    case RECORD:
+        if (record()) return EXIT_FAILURE;
+        break;
     default:
         return EXIT_FAILURE;
     }
@@ -70,22 +80,32 @@ static int parse_args(int argc, char* argv[])
                 return EINVAL;
             }
             action = STOP;
+        } else if (strcmp(*argv, "record") == 0) {
+            if (action) {
+                return EINVAL;
+            }
+            action = RECORD;
         } else if (strcmp(*argv, "-f") == 0) {
             if (--argc == 0) return EINVAL;
             if (sscanf(*++argv, "%u", &freq) != 1) return EINVAL;
         } else if (strcmp(*argv, "-o") == 0) {
             if (--argc == 0) return EINVAL;
             outfile = *++argv;
+        } else if (strcmp(*argv, "-t") == 0) {
+            if (--argc == 0) return EINVAL;
+            if (sscanf(*++argv, "%d", &duration) != 1) return EINVAL;
         }
     }
 
-    if (action == START) {
+    if (action == START || action == RECORD) {
         if (!freq) freq = DEF_FREQ;
-    } else if (action == STOP) {
+    }
+
+    if (action == STOP || action == RECORD) {
         if (strcmp(outfile, "") == 0) outfile = DEF_OUTFILE;
         if (!memsize) memsize = DEF_MEMSIZE;
         memsize *= (1024 * 1024);
-        memsize -= (memsize % sizeof(struct kprof_sample));
+        if (!duration) duration = DEF_DURATION;
     }
 
     return 0;
@@ -113,22 +133,42 @@ int init_outfile()
     return 0;
 }
 
-int write_outfile()
+/* Layout: header, kprof_info, then the records of every drain in order.
+ * kprof_info is rewritten with the final counters once recording ends. */
+int write_header()
 {
-    int header[4];
+    int header[5];
     header[0] = OUTPUT_MAGIC;
     header[1] = sizeof(struct kprof_info);
     header[2] = sizeof(struct kprof_proc);
     header[3] = sizeof(struct kprof_sample);
+    header[4] = sizeof(void*);
 
-    if (fwrite(header, sizeof(int), 4, foutput) < 0) return errno;
-    if (fwrite(&kprof_info, sizeof(struct kprof_info), 1, foutput) < 0)
+    if (fwrite(header, sizeof(int), 5, foutput) != 5) return errno;
+    if (fwrite(&kprof_info, sizeof(struct kprof_info), 1, foutput) != 1)
         return errno;
 
-    size_t size = memsize;
-    if (size > kprof_info.mem_used) size = kprof_info.mem_used;
+    return 0;
+}
+
+int write_samples()
+{
+    size_t size = kprof_info.mem_used;
+
+    if (fwrite(sample_buf, 1, size, foutput) != size) return errno;
+    total_used += size;
+
+    return 0;
+}
+
+int write_info()
+{
+    kprof_info.mem_used = total_used;
+
+    if (fseek(foutput, 5 * sizeof(int), SEEK_SET) != 0) return errno;
+    if (fwrite(&kprof_info, sizeof(struct kprof_info), 1, foutput) != 1)
+        return errno;
 
-    if (fwrite(sample_buf, 1, size, foutput) < 0) return errno;
     return 0;
 }
 
@@ -140,11 +180,14 @@ static int stop()
     if ((retval = init_outfile()) != 0) {
         die(retval, "cannot open output file");
     }
+    if ((retval = write_header()) != 0) {
+        die(retval, "cannot write to output");
+    }
 
     retval = kprof(KPROF_STOP, memsize, 0, &kprof_info, sample_buf);
     if (retval) return retval;
 
-    if ((retval = write_outfile()) != 0) {
+    if ((retval = write_samples()) != 0 || (retval = write_info()) != 0) {
         die(retval, "cannot write to output");
     }
 
@@ -152,3 +195,47 @@ static int stop()
 
     return 0;
 }
+
+/* Sample for duration seconds, draining the per-CPU buffers periodically so
+ * that the kernel buffer size does not limit the length of the profile. */
+static int record()
+{
+    int retval, elapsed;
+
+    if ((retval = alloc_mem()) != 0) return retval;
+    if ((retval = init_outfile()) != 0) {
+        die(retval, "cannot open output file");
+    }
+    if ((retval = write_header()) != 0) {
+        die(retval, "cannot write to output");
+    }
+
+    if ((retval = start()) != 0) return retval;
+
+    for (elapsed = 0; elapsed < duration * 1000000; elapsed += DRAIN_INTERVAL) {
+        usleep(DRAIN_INTERVAL);
+
+        retval = kprof(KPROF_DRAIN, memsize, 0, &kprof_info, sample_buf);
+        if (retval) break;
+
+        if ((retval = write_samples()) != 0) {
+            die(retval, "cannot write to output");
+        }
+    }
+
+    retval = kprof(KPROF_STOP, memsize, 0, &kprof_info, sample_buf);
+    if (retval) return retval;
+
+    if ((retval = write_samples()) != 0 || (retval = write_info()) != 0) {
+        die(retval, "cannot write to output");
+    }
+
+    fclose(foutput);
+
+    if (kprof_info.dropped_samples) {
+        fprintf(stderr, "%s: %d samples dropped\n", prog_name,
+                kprof_info.dropped_samples);
+    }
+
+    return 0;
+}
@@ -87,6 +87,27 @@ int ldso_relocate_plt_object(struct so_info* si, ElfW(Rela) * rel,
     return 0;
 }
 
+int ldso_relocate_plt_now(struct so_info* si)
+{
+    ElfW(Rela) * rela;
+
+    for (rela = si->pltrela; rela < si->pltrelaend; rela++) {
+        if (ELFW(R_TYPE)(rela->r_info) != R_TYPE(JUMP_SLOT)) continue;
+
+        if (ldso_relocate_plt_object(si, rela, NULL) == 0) continue;
+
+        ElfW(Sym)* sym = si->symtab + ELFW(R_SYM)(rela->r_info);
+
+        /* leave undefined weak functions to be bound lazily */
+        if (ELFW(ST_BIND)(sym->st_info) == STB_WEAK) continue;
+
+        xprintf("can't lookup symbol %s\n", si->strtab + sym->st_name);
+        return -1;
+    }
+
+    return 0;
+}
+
 int ldso_relocate_nonplt_objects(struct so_info* si)
 {
     ElfW(Rela) * rela;
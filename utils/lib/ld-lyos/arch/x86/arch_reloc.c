@@ -74,6 +74,25 @@ int ldso_relocate_plt_object(struct so_info* si, ElfW(Rel) * rel,
     return 0;
 }
 
+int ldso_relocate_plt_now(struct so_info* si)
+{
+    ElfW(Rel) * rel;
+
+    for (rel = si->pltrel; rel < si->pltrelend; rel++) {
+        if (ldso_relocate_plt_object(si, rel, NULL) == 0) continue;
+
+        ElfW(Sym)* sym = si->symtab + ELFW(R_SYM)(rel->r_info);
+
+        /* leave undefined weak functions to be bound lazily */
+        if (ELFW(ST_BIND)(sym->st_info) == STB_WEAK) continue;
+
+        xprintf("can't lookup symbol %s\n", si->strtab + sym->st_name);
+        return -1;
+    }
+
+    return 0;
+}
+
 int ldso_relocate_nonplt_objects(struct so_info* si)
 {
     ElfW(Rel) * rel;
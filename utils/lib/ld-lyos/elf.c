@@ -97,6 +97,24 @@ int ldso_process_dynamic(struct so_info* si)
             si->chains = si->buckets + si->nbuckets;
             break;
         }
+        case DT_GNU_HASH: {
+            const uint32_t* hash_table =
+                (const uint32_t*)(si->relocbase + dp->d_un.d_ptr);
+            unsigned nmaskwords = hash_table[2];
+
+            /* the bloom filter size must be a power of two */
+            if (nmaskwords == 0 || (nmaskwords & (nmaskwords - 1))) break;
+
+            si->gnu_nbuckets = hash_table[0];
+            si->gnu_symndx = hash_table[1];
+            si->gnu_maskwords_bm = nmaskwords - 1;
+            si->gnu_shift2 = hash_table[3];
+            si->gnu_bloom = (const ElfW(Addr)*)(hash_table + 4);
+            si->gnu_buckets = (const uint32_t*)(si->gnu_bloom + nmaskwords);
+            si->gnu_chain_zero =
+                si->gnu_buckets + si->gnu_nbuckets - si->gnu_symndx;
+            break;
+        }
         }
     }
 
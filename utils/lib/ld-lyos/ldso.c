@@ -15,6 +15,9 @@ struct so_info *si_list = NULL, *si_list_tail;
 struct search_paths ld_paths;
 struct search_paths ld_default_paths;
 
+int ldso_show_stats;
+struct ldso_stats ldso_stats;
+
 extern __attribute__((visibility("hidden"))) char _DYNAMIC;
 extern __attribute__((visibility("hidden"))) char _GLOBAL_OFFSET_TABLE_;
 
@@ -143,6 +146,26 @@ static void ldso_init_tpsort(struct list_head* head, int rev)
     }
 }
 
+void ldso_print_stats(void)
+{
+    uint64_t total = ldso_read_cycles() - ldso_stats.start_cycles;
+    unsigned int pct = total ? ldso_stats.reloc_cycles * 100 / total : 0;
+
+    xprintf("runtime linker statistics:\n");
+    xprintf("  total startup time in dynamic loader: %llu cycles\n", total);
+    xprintf("            time needed for relocation: %llu cycles (%u%%)\n",
+            ldso_stats.reloc_cycles, pct);
+    xprintf("                      symbol lookups: %lu\n", ldso_stats.lookups);
+    xprintf("                   symbol cache hits: %lu\n",
+            ldso_stats.cache_hits);
+    xprintf("                    objects searched: %lu\n",
+            ldso_stats.objs_searched);
+    xprintf("               bloom filter rejects: %lu\n",
+            ldso_stats.bloom_rejects);
+    xprintf("                   PLT entries bound: %lu\n",
+            ldso_stats.plt_bound);
+}
+
 static void ldso_call_initfini_function(ElfW(Addr) func)
 {
     ((void (*)(void))(uintptr_t)func)();
@@ -181,6 +204,9 @@ void* ldso_main(int argc, char* argv[], char* envp[])
 {
     ElfW(Addr) got0;
     char* got_addr;
+    uint64_t reloc_start;
+
+    ldso_stats.start_cycles = ldso_read_cycles();
 
     init_si_pool();
     /* parse environments and aux vectors */
@@ -199,6 +225,11 @@ void* ldso_main(int argc, char* argv[], char* envp[])
         bind_now = bind_now_env[0] - '0';
     }
 
+    const char* show_stats_env = env_get("LD_SHOW_STATS");
+    if (show_stats_env) {
+        ldso_show_stats = show_stats_env[0] - '0';
+    }
+
     const char* ld_debug = env_get("LD_DEBUG");
     debug = 0;
     if (ld_debug) {
@@ -231,14 +262,20 @@ void* ldso_main(int argc, char* argv[], char* envp[])
     }
 #endif
 
+    reloc_start = ldso_read_cycles();
+
     ldso_relocate_objects(si, bind_now);
 
     ldso_do_copy_relocations(si);
 
+    ldso_stats.reloc_cycles = ldso_read_cycles() - reloc_start;
+
 #if defined(__HAVE_TLS_VARIANT_1) || defined(__HAVE_TLS_VARIANT_2)
     ldso_tls_initial_allocation();
 #endif
 
+    if (ldso_show_stats) ldso_print_stats();
+
     ldso_call_init_functions();
 
     return si->entry;
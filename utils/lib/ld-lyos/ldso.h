@@ -2,6 +2,7 @@
 #define _LDSO_H_
 
 #include <sys/types.h>
+#include <stdint.h>
 #include <sys/tls.h>
 #include <sys/syslimits.h>
 #include <stdarg.h>
@@ -73,6 +74,15 @@ struct so_info {
     unsigned nchains;
     int* chains;
 
+    /* DT_GNU_HASH */
+    unsigned gnu_nbuckets;
+    unsigned gnu_symndx;
+    unsigned gnu_maskwords_bm; /* bloom filter words - 1 */
+    unsigned gnu_shift2;
+    const ElfW(Addr) * gnu_bloom;
+    const uint32_t* gnu_buckets;
+    const uint32_t* gnu_chain_zero; /* chain indexed by symbol number */
+
     size_t tls_index;
     void* tls_init;
     size_t tls_init_size;
@@ -99,6 +109,43 @@ struct so_info {
 
 extern struct so_info si_self;
 
+struct sym_hash {
+    unsigned long sysv;
+    uint32_t gnu;
+};
+
+struct ldso_stats {
+    unsigned long lookups;       /* global symbol lookups */
+    unsigned long cache_hits;    /* lookups answered by the symbol cache */
+    unsigned long objs_searched; /* objects whose hash table was probed */
+    unsigned long bloom_rejects; /* objects skipped by the bloom filter */
+    unsigned long plt_bound;     /* PLT entries bound at startup or lazily */
+    uint64_t start_cycles;
+    uint64_t reloc_cycles;
+};
+
+extern int ldso_show_stats;
+extern struct ldso_stats ldso_stats;
+
+static inline uint64_t ldso_read_cycles(void)
+{
+#if defined(__i386__) || defined(__x86_64__)
+    uint32_t lo, hi;
+    __asm__ __volatile__("rdtsc" : "=a"(lo), "=d"(hi));
+    return ((uint64_t)hi << 32) | lo;
+#elif defined(__aarch64__)
+    uint64_t val;
+    __asm__ __volatile__("mrs %0, cntvct_el0" : "=r"(val));
+    return val;
+#elif defined(__riscv)
+    unsigned long val;
+    __asm__ __volatile__("rdtime %0" : "=r"(val));
+    return val;
+#else
+    return 0;
+#endif
+}
+
 extern size_t ldso_tls_dtv_generation;
 extern size_t ldso_tls_max_index;
 
@@ -136,13 +183,17 @@ struct so_info* ldso_get_obj_from_addr(const void* addr);
 struct so_info* ldso_check_handle(void* handle);
 void ldso_setup_pltgot(struct so_info* si);
 int ldso_relocate_plt_lazy(struct so_info* si);
+int ldso_relocate_plt_now(struct so_info* si);
 int ldso_relocate_nonplt_objects(struct so_info* si);
 int ldso_do_copy_relocations(struct so_info* si);
 ElfW(Sym) * ldso_find_plt_sym(struct so_info* si, unsigned long symnum,
                               struct so_info** obj);
 struct so_info* ldso_map_object(const char* pathname, int fd);
 unsigned long ldso_elf_hash(const char* name);
-ElfW(Sym) * ldso_lookup_symbol_obj(const char* name, unsigned long hash,
+uint32_t ldso_gnu_hash(const char* name);
+void ldso_hash_name(const char* name, struct sym_hash* hash);
+ElfW(Sym) * ldso_lookup_symbol_obj(const char* name,
+                                   const struct sym_hash* hash,
                                    struct so_info* si, int in_plt);
 ElfW(Sym) * ldso_find_sym(struct so_info* si, unsigned long symnum,
                           struct so_info** obj, int in_plt);
@@ -151,6 +202,7 @@ int ldso_load_needed(struct so_info* first);
 int ldso_relocate_objects(struct so_info* first, int bind_now);
 void ldso_init_paths(struct search_paths* list);
 void ldso_add_paths(struct search_paths* list, const char* paths);
+void ldso_print_stats(void);
 
 LDSO_PUBLIC void* dlopen(const char* filename, int flags);
 LDSO_PUBLIC void* dlsym(void* handle, const char* name);
@@ -9,12 +9,14 @@ static int ldso_do_copy_relocation(struct so_info* si, const ElfW(Rela) * rela)
     ElfW(Sym)* dest_sym = si->symtab + ELFW(R_SYM)(rela->r_info);
     size_t size = dest_sym->st_size;
     char* name = si->strtab + dest_sym->st_name;
-    unsigned long hash = ldso_elf_hash(name);
+    struct sym_hash hash;
 
     struct so_info* src_obj;
     ElfW(Sym) * src_sym;
+
+    ldso_hash_name(name, &hash);
     for (src_obj = si->next; src_obj != NULL; src_obj = src_obj->next) {
-        src_sym = ldso_lookup_symbol_obj(name, hash, src_obj, 0);
+        src_sym = ldso_lookup_symbol_obj(name, &hash, src_obj, 0);
         if (src_sym) break;
     }
 
@@ -68,6 +70,8 @@ int ldso_relocate_objects(struct so_info* first, int bind_now)
         if (ldso_relocate_nonplt_objects(si) != 0) return -1;
 
         if (si->pltgot) ldso_setup_pltgot(si);
+
+        if (bind_now && ldso_relocate_plt_now(si) != 0) return -1;
     }
 
     return 0;
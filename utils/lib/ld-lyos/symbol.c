@@ -5,6 +5,22 @@
 
 #include "ldso.h"
 
+/* Global scope lookups are cached by name. Objects are only ever appended to
+ * the search list so a definition found once stays the one that wins. */
+#define SYM_CACHE_SIZE  1024
+#define SYM_CACHE_PROBE 8
+
+struct sym_cache_entry {
+    const char* name;
+    uint32_t hash;
+    int in_plt;
+    ElfW(Sym) * def;
+    struct so_info* obj;
+};
+
+static struct sym_cache_entry sym_cache[SYM_CACHE_SIZE];
+static unsigned int sym_cache_used;
+
 static int __strcmp(const char* s1, const char* s2)
 {
     while (*s1 != '\0' && *s1 == *s2) {
@@ -58,35 +74,123 @@ unsigned long ldso_elf_hash(const char* name)
     return h;
 }
 
-ElfW(Sym) * ldso_lookup_symbol_obj(const char* name, unsigned long hash,
+uint32_t ldso_gnu_hash(const char* name)
+{
+    const unsigned char* p = (const unsigned char*)name;
+    uint32_t h = 5381;
+    unsigned char c;
+
+    for (; (c = *p) != '\0'; p++)
+        h = h * 33 + c;
+
+    return h;
+}
+
+void ldso_hash_name(const char* name, struct sym_hash* hash)
+{
+    hash->sysv = ldso_elf_hash(name);
+    hash->gnu = ldso_gnu_hash(name);
+}
+
+static ElfW(Sym) * ldso_match_sym(const char* name, struct so_info* si,
+                                  unsigned long symnum, int in_plt)
+{
+    ElfW(Sym)* sym = si->symtab + symnum;
+    char* str = si->strtab + sym->st_name;
+
+    if (__strcmp(name, str)) return NULL;
+
+    if (sym->st_shndx == SHN_UNDEF &&
+        (in_plt || sym->st_value == 0 ||
+         ELFW(ST_TYPE)(sym->st_info) != STT_FUNC))
+        return NULL;
+
+    return sym;
+}
+
+static ElfW(Sym) * ldso_lookup_gnu_hash(const char* name, uint32_t h1,
+                                        struct so_info* si, int in_plt)
+{
+    const unsigned int bits = sizeof(ElfW(Addr)) * 8;
+    ElfW(Addr) word;
+    ElfW(Sym) * sym;
+    unsigned long symnum;
+    uint32_t h2;
+
+    /* both bits must be set in the bloom filter if the object defines the
+     * name, so most objects are rejected without touching their buckets */
+    word = si->gnu_bloom[(h1 / bits) & si->gnu_maskwords_bm];
+    h2 = h1 >> si->gnu_shift2;
+    if (!((word >> (h1 % bits)) & (word >> (h2 % bits)) & 1)) {
+        ldso_stats.bloom_rejects++;
+        return NULL;
+    }
+
+    symnum = si->gnu_buckets[h1 % si->gnu_nbuckets];
+    if (symnum < si->gnu_symndx) return NULL;
+
+    do {
+        h2 = si->gnu_chain_zero[symnum];
+
+        /* the low bit marks the end of the chain */
+        if (((h1 ^ h2) >> 1) == 0 &&
+            (sym = ldso_match_sym(name, si, symnum, in_plt)) != NULL)
+            return sym;
+
+        symnum++;
+    } while (!(h2 & 1));
+
+    return NULL;
+}
+
+ElfW(Sym) * ldso_lookup_symbol_obj(const char* name,
+                                   const struct sym_hash* hash,
                                    struct so_info* si, int in_plt)
 {
     unsigned long symnum;
+    ElfW(Sym) * sym;
+
+    if (si->gnu_buckets) {
+        ldso_stats.objs_searched++;
+        return ldso_lookup_gnu_hash(name, hash->gnu, si, in_plt);
+    }
 
     if (!si->nbuckets) {
         return NULL;
     }
 
-    for (symnum = si->buckets[hash % si->nbuckets]; symnum != 0;
+    ldso_stats.objs_searched++;
+
+    for (symnum = si->buckets[hash->sysv % si->nbuckets]; symnum != 0;
          symnum = si->chains[symnum]) {
+        if ((sym = ldso_match_sym(name, si, symnum, in_plt)) != NULL)
+            return sym;
+    }
 
-        ElfW(Sym)* sym = si->symtab + symnum;
-        char* str = si->strtab + sym->st_name;
+    return NULL;
+}
 
-        if (__strcmp(name, str)) continue;
+static struct sym_cache_entry* sym_cache_lookup(const char* name,
+                                                uint32_t hash, int in_plt)
+{
+    struct sym_cache_entry* ent;
+    unsigned int i, slot;
 
-        if (sym->st_shndx == SHN_UNDEF &&
-            (in_plt || sym->st_value == 0 ||
-             ELFW(ST_TYPE)(sym->st_info) != STT_FUNC))
-            continue;
+    for (i = 0; i < SYM_CACHE_PROBE; i++) {
+        slot = (hash + i) & (SYM_CACHE_SIZE - 1);
+        ent = &sym_cache[slot];
 
-        return sym;
+        if (!ent->name) return ent;
+        if (ent->hash == hash && ent->in_plt == in_plt &&
+            !__strcmp(name, ent->name))
+            return ent;
     }
 
     return NULL;
 }
 
-static ElfW(Sym) * ldso_lookup_symbol_list(const char* name, unsigned long hash,
+static ElfW(Sym) * ldso_lookup_symbol_list(const char* name,
+                                           const struct sym_hash* hash,
                                            struct so_info* list,
                                            struct so_info** obj, int in_plt)
 {
@@ -104,13 +208,24 @@ static ElfW(Sym) * ldso_lookup_symbol_list(const char* name, unsigned long hash,
     return NULL;
 }
 
-static ElfW(Sym) * ldso_lookup_symbol(const char* name, unsigned long hash,
+static ElfW(Sym) * ldso_lookup_symbol(const char* name,
+                                      const struct sym_hash* hash,
                                       struct so_info* so, struct so_info** obj,
                                       int in_plt)
 {
     ElfW(Sym)* def = NULL;
     ElfW(Sym)* sym = NULL;
     struct so_info* def_obj = NULL;
+    struct sym_cache_entry* ent;
+
+    ldso_stats.lookups++;
+
+    ent = sym_cache_lookup(name, hash->gnu, in_plt);
+    if (ent && ent->name) {
+        ldso_stats.cache_hits++;
+        *obj = ent->obj;
+        return ent->def;
+    }
 
     if (!def) {
         sym = ldso_lookup_symbol_list(name, hash, si_list, &def_obj, in_plt);
@@ -128,6 +243,15 @@ static ElfW(Sym) * ldso_lookup_symbol(const char* name, unsigned long hash,
 
     if (def) {
         *obj = def_obj;
+
+        if (ent && sym_cache_used < SYM_CACHE_SIZE * 3 / 4) {
+            ent->name = name;
+            ent->hash = hash->gnu;
+            ent->in_plt = in_plt;
+            ent->def = def;
+            ent->obj = def_obj;
+            sym_cache_used++;
+        }
     }
 
     return def;
@@ -144,8 +268,10 @@ ElfW(Sym) * ldso_find_sym(struct so_info* si, unsigned long symnum,
     char* name = si->strtab + sym->st_name;
 
     if (ELFW(ST_BIND)(sym->st_info) != STB_LOCAL) {
-        unsigned long hash = ldso_elf_hash(name);
-        def = ldso_lookup_symbol(name, hash, si, &def_obj, in_plt);
+        struct sym_hash hash;
+
+        ldso_hash_name(name, &hash);
+        def = ldso_lookup_symbol(name, &hash, si, &def_obj, in_plt);
     } else {
         def = sym;
         def_obj = si;
@@ -161,18 +287,19 @@ ElfW(Sym) * ldso_find_sym(struct so_info* si, unsigned long symnum,
 ElfW(Sym) * ldso_find_plt_sym(struct so_info* si, unsigned long symnum,
                               struct so_info** obj)
 {
+    ldso_stats.plt_bound++;
     return ldso_find_sym(si, symnum, obj, 1);
 }
 
 void* do_dlsym(void* handle, const char* name, void* retaddr)
 {
-    unsigned long hash;
+    struct sym_hash hash;
     ElfW(Sym) * def;
     struct so_info *si, *def_obj;
 
     def = NULL;
     def_obj = NULL;
-    hash = ldso_elf_hash(name);
+    ldso_hash_name(name, &hash);
 
     switch ((intptr_t)handle) {
     case (intptr_t)RTLD_NEXT:
@@ -183,19 +310,19 @@ void* do_dlsym(void* handle, const char* name, void* retaddr)
         case (intptr_t)RTLD_NEXT:
             si = si->next;
             for (; si != NULL; si = si->next) {
-                if ((def = ldso_lookup_symbol_obj(name, hash, si, 1)) != NULL)
+                if ((def = ldso_lookup_symbol_obj(name, &hash, si, 1)) != NULL)
                     def_obj = si;
             }
             break;
         case (intptr_t)RTLD_DEFAULT:
-            def = ldso_lookup_symbol(name, hash, si, &def_obj, 1);
+            def = ldso_lookup_symbol(name, &hash, si, &def_obj, 1);
             break;
         }
         break;
     default:
         if ((si = ldso_check_handle(handle)) == NULL) return NULL;
 
-        if ((def = ldso_lookup_symbol_obj(name, hash, si, 1)) != NULL)
+        if ((def = ldso_lookup_symbol_obj(name, &hash, si, 1)) != NULL)
             def_obj = si;
         break;
     }